@@ -0,0 +1,50 @@
+#include "arena.hh"
+
+// stdlib
+#include <algorithm>
+#include <cstring>
+
+Arena::Arena(size_t block_size) : m_block_size(block_size) {}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  if (size == 0)
+    size = 1;
+
+  if (!m_blocks.empty()) {
+    block &current = m_blocks.back();
+    uintptr_t base = (uintptr_t)current.data.get();
+    size_t aligned = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+    if (aligned + size <= current.size) {
+      m_offset = aligned + size;
+      m_bytes_used += size;
+      return current.data.get() + aligned;
+    }
+  }
+
+  // new blocks are aligned for everything new[] hands out, bigger
+  // allocations get a block of their own size
+  size_t block_size = std::max(m_block_size, size + alignment);
+  m_blocks.push_back({std::make_unique<uint8_t[]>(block_size), block_size});
+  m_bytes_reserved += block_size;
+
+  block &current = m_blocks.back();
+  uintptr_t base = (uintptr_t)current.data.get();
+  size_t aligned = ((base + alignment - 1) & ~(alignment - 1)) - base;
+  m_offset = aligned + size;
+  m_bytes_used += size;
+  return current.data.get() + aligned;
+}
+
+std::string_view Arena::copy_string(const char *data, size_t size) {
+  char *copy = allocate_array<char>(size + 1);
+  memcpy(copy, data, size);
+  copy[size] = '\0';
+  return std::string_view(copy, size);
+}
+
+void Arena::clear() {
+  m_blocks.clear();
+  m_offset = 0;
+  m_bytes_used = 0;
+  m_bytes_reserved = 0;
+}
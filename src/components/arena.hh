@@ -0,0 +1,72 @@
+#pragma once
+
+// stdlib
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// bump allocator. nothing gets freed on its own, everything goes at once
+// with clear() or the arena itself. no destructors are run, only put
+// trivially destructible things in here
+class Arena {
+public:
+  explicit Arena(size_t block_size = 64 * 1024);
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  template <typename T> T *allocate_array(size_t count) {
+    return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // copy with a trailing zero, the view doesnt include it
+  std::string_view copy_string(const char *data, size_t size);
+
+  void clear();
+
+  // handed out / allocated from the system
+  size_t bytes_used() const { return m_bytes_used; }
+  size_t bytes_reserved() const { return m_bytes_reserved; }
+
+private:
+  struct block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  std::vector<block> m_blocks;
+  size_t m_block_size;
+  size_t m_offset = 0;
+  size_t m_bytes_used = 0;
+  size_t m_bytes_reserved = 0;
+};
+
+// array inside an arena, the arena owns the elements
+template <typename T> struct arena_span {
+  T *data = nullptr;
+  uint32_t count = 0;
+
+  T *begin() const { return data; }
+  T *end() const { return data + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](size_t i) const { return data[i]; }
+};
+
+// copies a scratch vector into the arena
+template <typename T>
+arena_span<T> copy_to_arena(Arena &arena, const std::vector<T> &items) {
+  arena_span<T> span;
+  if (items.empty())
+    return span;
+
+  span.data = arena.allocate_array<T>(items.size());
+  span.count = (uint32_t)items.size();
+  std::copy(items.begin(), items.end(), span.data);
+  return span;
+}
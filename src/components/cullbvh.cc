@@ -0,0 +1,370 @@
+#include "cullbvh.hh"
+
+#if CORTEX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// stdlib
+#include <algorithm>
+#include <cmath>
+
+world_bounds get_world_bounds(const glm::vec3 &local_min,
+                              const glm::vec3 &local_max,
+                              const glm::mat4 &world) {
+  // per axis: translation + the smaller / larger product of every column
+  world_bounds bounds;
+  bounds.min = bounds.max = glm::vec3(world[3]);
+  for (int column = 0; column < 3; column++) {
+    glm::vec3 axis = glm::vec3(world[column]);
+    glm::vec3 a = axis * local_min[column];
+    glm::vec3 b = axis * local_max[column];
+    bounds.min += glm::min(a, b);
+    bounds.max += glm::max(a, b);
+  }
+
+  glm::vec3 local_center = (local_min + local_max) * 0.5f;
+  float scale = std::max({glm::length(glm::vec3(world[0])),
+                          glm::length(glm::vec3(world[1])),
+                          glm::length(glm::vec3(world[2]))});
+  float sphere_radius = glm::length(local_max - local_min) * 0.5f * scale;
+  float box_radius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+  if (sphere_radius < box_radius) {
+    bounds.center = glm::vec3(world * glm::vec4(local_center, 1.0f));
+    bounds.radius = sphere_radius;
+  } else {
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    bounds.radius = box_radius;
+  }
+  return bounds;
+}
+
+void merge_world_bounds(world_bounds &bounds, const world_bounds &other) {
+  bounds.min = glm::min(bounds.min, other.min);
+  bounds.max = glm::max(bounds.max, other.max);
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  bounds.radius = glm::length(bounds.max - bounds.min) * 0.5f;
+}
+
+frustum_planes get_frustum_planes(const glm::mat4 &view_projection) {
+  // gribb / hartmann, rows of the matrix. gl clip space, -w <= z <= w
+  glm::vec4 rows[4];
+  for (int row = 0; row < 4; row++)
+    rows[row] = glm::vec4(view_projection[0][row], view_projection[1][row],
+                          view_projection[2][row], view_projection[3][row]);
+
+  glm::vec4 planes[FRUSTUM_PLANES] = {
+      rows[3] + rows[0], rows[3] - rows[0], // left, right
+      rows[3] + rows[1], rows[3] - rows[1], // bottom, top
+      rows[3] + rows[2], rows[3] - rows[2], // near, far
+  };
+
+  frustum_planes frustum;
+  for (int p = 0; p < 8; p++) {
+    glm::vec4 plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    if (p < FRUSTUM_PLANES) {
+      plane = planes[p];
+      float length = glm::length(glm::vec3(plane));
+      if (length > 0.0f)
+        plane /= length;
+    }
+
+    frustum.nx[p] = plane.x;
+    frustum.ny[p] = plane.y;
+    frustum.nz[p] = plane.z;
+    frustum.d[p] = plane.w;
+    frustum.ax[p] = std::fabs(plane.x);
+    frustum.ay[p] = std::fabs(plane.y);
+    frustum.az[p] = std::fabs(plane.z);
+  }
+  return frustum;
+}
+
+////////////////////////////////////
+// box vs frustum
+////////////////////////////////////
+
+// center / extent form: distance of the center against how far the box
+// reaches along the plane normal
+typedef e_cull_result (*box_cull_kernel)(const frustum_planes &frustum,
+                                         const glm::vec3 &min,
+                                         const glm::vec3 &max);
+
+static e_cull_result cull_box_scalar(const frustum_planes &frustum,
+                                     const glm::vec3 &min,
+                                     const glm::vec3 &max) {
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+
+  bool inside = true;
+  for (int p = 0; p < FRUSTUM_PLANES; p++) {
+    float distance = frustum.nx[p] * center.x + frustum.ny[p] * center.y +
+                     frustum.nz[p] * center.z + frustum.d[p];
+    float reach = frustum.ax[p] * extent.x + frustum.ay[p] * extent.y +
+                  frustum.az[p] * extent.z;
+    if (distance + reach < 0.0f)
+      return E_CULL_OUTSIDE;
+    if (distance - reach < 0.0f)
+      inside = false;
+  }
+  return inside ? E_CULL_INSIDE : E_CULL_PARTIAL;
+}
+
+#if CORTEX_SIMD_X86
+
+CORTEX_TARGET_SSE41 static e_cull_result
+cull_box_sse41(const frustum_planes &frustum, const glm::vec3 &min,
+               const glm::vec3 &max) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  __m128 cx = _mm_mul_ps(_mm_set1_ps(min.x + max.x), half);
+  __m128 cy = _mm_mul_ps(_mm_set1_ps(min.y + max.y), half);
+  __m128 cz = _mm_mul_ps(_mm_set1_ps(min.z + max.z), half);
+  __m128 ex = _mm_mul_ps(_mm_set1_ps(max.x - min.x), half);
+  __m128 ey = _mm_mul_ps(_mm_set1_ps(max.y - min.y), half);
+  __m128 ez = _mm_mul_ps(_mm_set1_ps(max.z - min.z), half);
+
+  int outside = 0;
+  int partial = 0;
+  for (int p = 0; p < 8; p += 4) {
+    __m128 distance = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(cx, _mm_load_ps(frustum.nx + p)),
+                   _mm_mul_ps(cy, _mm_load_ps(frustum.ny + p))),
+        _mm_add_ps(_mm_mul_ps(cz, _mm_load_ps(frustum.nz + p)),
+                   _mm_load_ps(frustum.d + p)));
+    __m128 reach = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(ex, _mm_load_ps(frustum.ax + p)),
+                   _mm_mul_ps(ey, _mm_load_ps(frustum.ay + p))),
+        _mm_mul_ps(ez, _mm_load_ps(frustum.az + p)));
+    outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+    partial |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, reach), zero));
+  }
+
+  if (outside)
+    return E_CULL_OUTSIDE;
+  return partial ? E_CULL_PARTIAL : E_CULL_INSIDE;
+}
+
+CORTEX_TARGET_AVX2 static e_cull_result
+cull_box_avx2(const frustum_planes &frustum, const glm::vec3 &min,
+              const glm::vec3 &max) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 cx = _mm256_mul_ps(_mm256_set1_ps(min.x + max.x), half);
+  __m256 cy = _mm256_mul_ps(_mm256_set1_ps(min.y + max.y), half);
+  __m256 cz = _mm256_mul_ps(_mm256_set1_ps(min.z + max.z), half);
+  __m256 ex = _mm256_mul_ps(_mm256_set1_ps(max.x - min.x), half);
+  __m256 ey = _mm256_mul_ps(_mm256_set1_ps(max.y - min.y), half);
+  __m256 ez = _mm256_mul_ps(_mm256_set1_ps(max.z - min.z), half);
+
+  __m256 distance = _mm256_fmadd_ps(
+      cx, _mm256_load_ps(frustum.nx),
+      _mm256_fmadd_ps(cy, _mm256_load_ps(frustum.ny),
+                      _mm256_fmadd_ps(cz, _mm256_load_ps(frustum.nz),
+                                      _mm256_load_ps(frustum.d))));
+  __m256 reach = _mm256_fmadd_ps(
+      ex, _mm256_load_ps(frustum.ax),
+      _mm256_fmadd_ps(ey, _mm256_load_ps(frustum.ay),
+                      _mm256_mul_ps(ez, _mm256_load_ps(frustum.az))));
+
+  if (_mm256_movemask_ps(
+          _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_LT_OQ)))
+    return E_CULL_OUTSIDE;
+  if (_mm256_movemask_ps(
+          _mm256_cmp_ps(_mm256_sub_ps(distance, reach), zero, _CMP_LT_OQ)))
+    return E_CULL_PARTIAL;
+  return E_CULL_INSIDE;
+}
+
+#endif
+
+static box_cull_kernel get_box_cull_kernel(e_simd_level level) {
+#if CORTEX_SIMD_X86
+  // never more than the cpu can actually run
+  level = std::min(level, get_simd_level());
+  if (level == E_SIMD_AVX2)
+    return cull_box_avx2;
+  if (level == E_SIMD_SSE41)
+    return cull_box_sse41;
+#endif
+  return cull_box_scalar;
+}
+
+static bool sphere_in_frustum(const frustum_planes &frustum,
+                              const world_bounds &bounds) {
+  for (int p = 0; p < FRUSTUM_PLANES; p++)
+    if (frustum.nx[p] * bounds.center.x + frustum.ny[p] * bounds.center.y +
+            frustum.nz[p] * bounds.center.z + frustum.d[p] <
+        -bounds.radius)
+      return false;
+  return true;
+}
+
+////////////////////////////////////
+// bvh
+////////////////////////////////////
+
+void Cull_Bvh::fit_leaf(bvh_node &node) const {
+  node.min = glm::vec3(INFINITY);
+  node.max = glm::vec3(-INFINITY);
+  for (uint32_t i = node.first; i < node.first + node.count; i++) {
+    node.min = glm::min(node.min, m_bounds[m_items[i]].min);
+    node.max = glm::max(node.max, m_bounds[m_items[i]].max);
+  }
+}
+
+void Cull_Bvh::build_node(uint32_t index,
+                          const std::vector<glm::vec3> &centroids) {
+  // nodes grows below, no references across the recursion
+  fit_leaf(m_nodes[index]);
+  uint32_t first = m_nodes[index].first;
+  uint32_t count = m_nodes[index].count;
+
+  if (count <= LEAF_ITEMS) {
+    for (uint32_t i = first; i < first + count; i++)
+      m_item_leaf[m_items[i]] = index;
+    return;
+  }
+
+  glm::vec3 centroid_min = glm::vec3(INFINITY);
+  glm::vec3 centroid_max = glm::vec3(-INFINITY);
+  for (uint32_t i = first; i < first + count; i++) {
+    centroid_min = glm::min(centroid_min, centroids[m_items[i]]);
+    centroid_max = glm::max(centroid_max, centroids[m_items[i]]);
+  }
+  glm::vec3 size = centroid_max - centroid_min;
+  int axis = size.x > size.y ? (size.x > size.z ? 0 : 2)
+                             : (size.y > size.z ? 1 : 2);
+
+  uint32_t half = count / 2;
+  auto *items = m_items.data() + first;
+  std::nth_element(items, items + half, items + count,
+                   [&](uint32_t a, uint32_t b) {
+                     return centroids[a][axis] < centroids[b][axis];
+                   });
+
+  uint32_t left = (uint32_t)m_nodes.size();
+  m_nodes[index].left = left;
+
+  bvh_node child;
+  child.parent = index;
+  child.first = first;
+  child.count = half;
+  m_nodes.push_back(child);
+  child.first = first + half;
+  child.count = count - half;
+  m_nodes.push_back(child);
+
+  build_node(left, centroids);
+  build_node(left + 1, centroids);
+}
+
+void Cull_Bvh::build(const std::vector<world_bounds> &bounds) {
+  m_bounds = bounds;
+  m_nodes.clear();
+  m_dirty_leaves.clear();
+  m_nodes_refit = 0;
+
+  uint32_t count = (uint32_t)bounds.size();
+  m_items.resize(count);
+  m_item_leaf.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    m_items[i] = i;
+    m_item_leaf[i] = INVALID;
+  }
+
+  if (count > 0) {
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++)
+      centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+
+    m_nodes.reserve(count / LEAF_ITEMS * 2 + 1);
+    bvh_node root;
+    root.count = count;
+    m_nodes.push_back(root);
+    build_node(0, centroids);
+  }
+
+  m_leaf_dirty.assign(m_nodes.size(), 0);
+}
+
+void Cull_Bvh::update_item(uint32_t item, const world_bounds &bounds) {
+  if (item >= m_bounds.size())
+    return;
+
+  m_bounds[item] = bounds;
+  uint32_t leaf = m_item_leaf[item];
+  if (!m_leaf_dirty[leaf]) {
+    m_leaf_dirty[leaf] = 1;
+    m_dirty_leaves.push_back(leaf);
+  }
+}
+
+void Cull_Bvh::refit() {
+  for (uint32_t leaf : m_dirty_leaves) {
+    m_leaf_dirty[leaf] = 0;
+    fit_leaf(m_nodes[leaf]);
+    m_nodes_refit++;
+
+    // up until a box doesnt change anymore
+    for (uint32_t index = m_nodes[leaf].parent; index != INVALID;
+         index = m_nodes[index].parent) {
+      bvh_node &node = m_nodes[index];
+      const bvh_node &left = m_nodes[node.left];
+      const bvh_node &right = m_nodes[node.left + 1];
+      glm::vec3 min = glm::min(left.min, right.min);
+      glm::vec3 max = glm::max(left.max, right.max);
+      if (min == node.min && max == node.max)
+        break;
+
+      node.min = min;
+      node.max = max;
+      m_nodes_refit++;
+    }
+  }
+  m_dirty_leaves.clear();
+}
+
+void Cull_Bvh::cull(const frustum_planes &frustum,
+                    std::vector<uint8_t> &visible, cull_stats &stats,
+                    e_simd_level level) const {
+  visible.assign(m_bounds.size(), 0);
+  stats = cull_stats();
+  if (m_nodes.empty())
+    return;
+
+  box_cull_kernel cull_box = get_box_cull_kernel(level);
+
+  uint32_t stack[64];
+  uint32_t stack_size = 0;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0) {
+    const bvh_node &node = m_nodes[stack[--stack_size]];
+    stats.nodes_tested++;
+
+    e_cull_result result = cull_box(frustum, node.min, node.max);
+    if (result == E_CULL_OUTSIDE)
+      continue;
+
+    if (result == E_CULL_INSIDE) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++)
+        visible[m_items[i]] = 1;
+      continue;
+    }
+
+    if (node.left == 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++)
+        visible[m_items[i]] = sphere_in_frustum(frustum, m_bounds[m_items[i]]);
+      continue;
+    }
+
+    // median splits keep the depth at log2(items / LEAF_ITEMS)
+    stack[stack_size++] = node.left + 1;
+    stack[stack_size++] = node.left;
+  }
+
+  for (uint8_t item_visible : visible)
+    stats.items_visible += item_visible;
+  stats.items_culled = visible.size() - stats.items_visible;
+}
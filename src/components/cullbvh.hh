@@ -0,0 +1,104 @@
+#pragma once
+
+#include "simd.hh"
+
+#include <glm/glm.hpp>
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// world space box + sphere around everything a mesh draws (all instances)
+struct world_bounds {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+  glm::vec3 center = glm::vec3(0.0f);
+  float radius = 0.0f;
+};
+
+// local aabb through world. the box is exact for the transformed corners,
+// the sphere is the smaller one of the transformed local sphere and the one
+// around the box
+world_bounds get_world_bounds(const glm::vec3 &local_min,
+                              const glm::vec3 &local_max,
+                              const glm::mat4 &world);
+// box around both, sphere around that box
+void merge_world_bounds(world_bounds &bounds, const world_bounds &other);
+
+// planes of a view projection matrix (perspective camera or the ortho light
+// alike), inside is dot(n, p) + d >= 0. stored soa and padded to 8 with
+// planes that pass everything, one avx2 / two sse registers test all of
+// them. a* are the absolute normals for the box extent
+static const int FRUSTUM_PLANES = 6;
+struct frustum_planes {
+  alignas(32) float nx[8];
+  alignas(32) float ny[8];
+  alignas(32) float nz[8];
+  alignas(32) float d[8];
+  alignas(32) float ax[8];
+  alignas(32) float ay[8];
+  alignas(32) float az[8];
+};
+frustum_planes get_frustum_planes(const glm::mat4 &view_projection);
+
+enum e_cull_result { E_CULL_OUTSIDE, E_CULL_PARTIAL, E_CULL_INSIDE };
+
+// one cull() call. tested counts bvh nodes, visible / culled items
+struct cull_stats {
+  size_t nodes_tested = 0;
+  size_t items_visible = 0;
+  size_t items_culled = 0;
+};
+
+// binary bvh over item bounds for frustum culling. built top down (median
+// split along the widest centroid axis), items that move only refit the
+// boxes above them, the tree itself stays until the next build. every node
+// covers a contiguous run of m_items, fully visible subtrees get taken
+// without testing their children
+class Cull_Bvh {
+public:
+  static const uint32_t INVALID = UINT32_MAX;
+  static const uint32_t LEAF_ITEMS = 4;
+
+  // items 0..bounds.size() - 1, replaces whatever was built before
+  void build(const std::vector<world_bounds> &bounds);
+
+  // new bounds of a moved item, the boxes above it follow with refit()
+  void update_item(uint32_t item, const world_bounds &bounds);
+  void refit();
+
+  // visible[item] = 1 if the item is (at least partially) inside. leaves
+  // that intersect the frustum test their items spheres
+  void cull(const frustum_planes &frustum, std::vector<uint8_t> &visible,
+            cull_stats &stats, e_simd_level level = get_simd_level()) const;
+
+  size_t item_count() const { return m_bounds.size(); }
+  size_t node_count() const { return m_nodes.size(); }
+  // nodes whose box got recomputed by refit() since the last build
+  size_t refit_count() const { return m_nodes_refit; }
+
+private:
+  struct bvh_node {
+    glm::vec3 min;
+    glm::vec3 max;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    // children are left and left + 1, 0 for leaves (the root is nobodys
+    // child)
+    uint32_t left = 0;
+    uint32_t parent = INVALID;
+  };
+
+  void build_node(uint32_t index, const std::vector<glm::vec3> &centroids);
+  void fit_leaf(bvh_node &node) const;
+
+  std::vector<bvh_node> m_nodes;
+  std::vector<uint32_t> m_items;
+  std::vector<uint32_t> m_item_leaf;
+  std::vector<world_bounds> m_bounds;
+
+  std::vector<uint32_t> m_dirty_leaves;
+  std::vector<uint8_t> m_leaf_dirty;
+  size_t m_nodes_refit = 0;
+};
@@ -2,6 +2,7 @@
 
 #include "animation.hh"
 #include "mesh.hh"
+#include "scenegraph.hh"
 
 #include <glm/ext/matrix_float4x4.hpp>
 #include <GLFW/glfw3.h>
@@ -23,7 +24,10 @@ public:
   
   std::vector<Mesh> m_mesh;
 
+  // local transform of the entity root when it gets added to a scene, from
+  // then on the scene graph owns it (Scene::m_graph, m_scene_node)
   glm::mat4 m_model_matrix = glm::mat4(1.0f);
+  uint32_t m_scene_node = SCENE_NODE_NONE;
 
   std::vector<animation>* m_animation_table;
   
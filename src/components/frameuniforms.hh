@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// everything that is the same for every draw of a frame. mirrors the std140
+// frame_data block in the shaders, uploaded once per frame and bound at
+// FRAME_UNIFORM_BINDING (see shaderclass.hh). vec3s are stored as vec4,
+// std140 pads them to 16 bytes anyway
+struct frame_uniforms {
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 projection = glm::mat4(1.0f);
+  glm::mat4 light_space_matrix = glm::mat4(1.0f);
+  glm::vec4 view_position = glm::vec4(0.0f);
+  glm::vec4 light_position = glm::vec4(0.0f);
+  glm::vec4 light_color = glm::vec4(0.0f);
+};
+
+static_assert(sizeof(frame_uniforms) == 3 * 64 + 3 * 16,
+              "frame_uniforms has to match the std140 frame_data block");
@@ -0,0 +1,435 @@
+#include "geometryarena.hh"
+#include "glresources.hh"
+#include "logging.hh"
+
+#include <glm/gtc/type_ptr.hpp>
+
+// stdlib
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+static const uint32_t INITIAL_VERTICES = 64 * 1024;
+static const uint32_t INITIAL_INDEX_WORDS = 256 * 1024;
+static const uint32_t INITIAL_DRAW_SLOTS = 1024;
+
+// location of the draw id, free since binormals arent uploaded anymore
+static const GLuint DRAW_ID_LOCATION = 4;
+
+void Range_Allocator::reset(uint32_t capacity) {
+  m_free_by_offset.clear();
+  m_free_by_size.clear();
+  m_capacity = capacity;
+  m_used = 0;
+  if (capacity > 0)
+    insert_free(0, capacity);
+}
+
+void Range_Allocator::grow(uint32_t new_capacity) {
+  if (new_capacity <= m_capacity)
+    return;
+  uint32_t offset = m_capacity;
+  uint32_t size = new_capacity - m_capacity;
+  m_capacity = new_capacity;
+
+  if (!m_free_by_offset.empty()) {
+    auto last = std::prev(m_free_by_offset.end());
+    if (last->first + last->second == offset) {
+      offset = last->first;
+      size += last->second;
+      erase_free(last);
+    }
+  }
+  insert_free(offset, size);
+}
+
+uint32_t Range_Allocator::allocate(uint32_t size) {
+  if (size == 0)
+    return INVALID;
+
+  // smallest free range that fits
+  auto best = m_free_by_size.lower_bound(size);
+  if (best == m_free_by_size.end())
+    return INVALID;
+
+  uint32_t offset = best->second;
+  uint32_t range_size = best->first;
+  erase_free(m_free_by_offset.find(offset));
+  if (range_size > size)
+    insert_free(offset + size, range_size - size);
+
+  m_used += size;
+  return offset;
+}
+
+void Range_Allocator::release(uint32_t offset, uint32_t size) {
+  if (size == 0)
+    return;
+  m_used -= size;
+
+  // merge with the free range right behind
+  auto next = m_free_by_offset.lower_bound(offset);
+  if (next != m_free_by_offset.end() && next->first == offset + size) {
+    size += next->second;
+    next = std::next(next);
+    erase_free(std::prev(next));
+  }
+
+  // and the one in front
+  if (next != m_free_by_offset.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      erase_free(previous);
+    }
+  }
+
+  insert_free(offset, size);
+}
+
+void Range_Allocator::insert_free(uint32_t offset, uint32_t size) {
+  m_free_by_offset.emplace(offset, size);
+  m_free_by_size.emplace(size, offset);
+}
+
+void Range_Allocator::erase_free(std::map<uint32_t, uint32_t>::iterator range) {
+  auto [first, last] = m_free_by_size.equal_range(range->second);
+  for (auto it = first; it != last; ++it) {
+    if (it->second == range->first) {
+      m_free_by_size.erase(it);
+      break;
+    }
+  }
+  m_free_by_offset.erase(range);
+}
+
+static GLenum get_attribute_gl_type(e_vertex_encoding encoding) {
+  switch (encoding) {
+  case E_ENCODING_FLOAT:
+    return GL_FLOAT;
+  case E_ENCODING_HALF:
+    return GL_HALF_FLOAT;
+  case E_ENCODING_UNORM16:
+    return GL_UNSIGNED_SHORT;
+  case E_ENCODING_OCTAHEDRAL_SNORM16:
+    return GL_SHORT;
+  case E_ENCODING_SNORM_2_10_10_10:
+    return GL_INT_2_10_10_10_REV;
+  }
+  return GL_FLOAT;
+}
+
+void set_vertex_attribute_pointers(const vertex_stream_format &stream) {
+  for (uint32_t i = 0; i < stream.attribute_count; i++) {
+    const vertex_attribute &attribute = stream.attributes[i];
+    // floats and halfs as is, the integer formats are normalized
+    GLboolean normalized = attribute.encoding == E_ENCODING_FLOAT ||
+                                   attribute.encoding == E_ENCODING_HALF
+                               ? GL_FALSE
+                               : GL_TRUE;
+    glVertexAttribPointer(attribute.semantic, attribute.components,
+                          get_attribute_gl_type(attribute.encoding),
+                          normalized, (GLsizei)stream.stride,
+                          (void *)(uintptr_t)attribute.offset);
+    glEnableVertexAttribArray(attribute.semantic);
+  }
+}
+
+// new buffer of new_bytes with the first old_bytes of the old one. always
+// dynamic, the arena fills its buffers range by range
+static void grow_buffer(const Gl_Caps *gl_caps, GLuint &buffer,
+                        size_t old_bytes, size_t new_bytes) {
+  GLuint grown = create_gl_buffer(gl_caps, new_bytes, nullptr, true);
+
+  if (buffer != 0) {
+    if (old_bytes > 0)
+      copy_gl_buffer(gl_caps, buffer, grown, old_bytes);
+    glDeleteBuffers(1, &buffer);
+  }
+
+  buffer = grown;
+}
+
+Geometry_Arena::Geometry_Arena(const Gl_Caps *gl_caps)
+    : m_gl_caps(gl_caps) {
+  // every attribute in both pools, meshes without some of them upload zeros
+  m_pools[E_GEOMETRY_POOL_FLOAT].format =
+      get_vertex_format(false, true, true, true);
+  m_pools[E_GEOMETRY_POOL_COMPACT].format =
+      get_vertex_format(true, true, true, true);
+
+  GLint max_texels = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+  m_max_draw_slots = (uint32_t)max_texels / DRAW_DATA_TEXELS;
+
+  for (geometry_pool &pool : m_pools) {
+    glGenVertexArrays(1, &pool.vao);
+    pool.vertices.reset(INITIAL_VERTICES);
+    grow_buffer(m_gl_caps, pool.position_buffer, 0,
+                (size_t)INITIAL_VERTICES * pool.format.position.stride);
+    grow_buffer(m_gl_caps, pool.shading_buffer, 0,
+                (size_t)INITIAL_VERTICES * pool.format.shading.stride);
+  }
+
+  m_index_words.reset(INITIAL_INDEX_WORDS);
+  grow_buffer(m_gl_caps, m_index_buffer, 0, (size_t)INITIAL_INDEX_WORDS * 4);
+
+  if (m_gl_caps && m_gl_caps->m_has_direct_state_access)
+    m_gl_caps->glCreateTextures(GL_TEXTURE_BUFFER, 1, &m_draw_data_texture);
+  else
+    glGenTextures(1, &m_draw_data_texture);
+  m_draw_slots.reset(0);
+  allocate_draw_slots(0);
+}
+
+Geometry_Arena::~Geometry_Arena() {
+  for (geometry_pool &pool : m_pools) {
+    glDeleteVertexArrays(1, &pool.vao);
+    glDeleteBuffers(1, &pool.position_buffer);
+    glDeleteBuffers(1, &pool.shading_buffer);
+  }
+  glDeleteBuffers(1, &m_index_buffer);
+  glDeleteBuffers(1, &m_draw_id_buffer);
+  glDeleteBuffers(1, &m_draw_data_buffer);
+  glDeleteTextures(1, &m_draw_data_texture);
+}
+
+void Geometry_Arena::clear() {
+  for (geometry_pool &pool : m_pools)
+    pool.vertices.reset(pool.vertices.capacity());
+  m_index_words.reset(m_index_words.capacity());
+  m_draw_slots.reset(m_draw_slots.capacity());
+  m_dirty_first = UINT32_MAX;
+  m_dirty_end = 0;
+}
+
+void Geometry_Arena::setup_pool_vao(geometry_pool &pool) {
+  glBindVertexArray(pool.vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pool.position_buffer);
+  set_vertex_attribute_pointers(pool.format.position);
+  glBindBuffer(GL_ARRAY_BUFFER, pool.shading_buffer);
+  set_vertex_attribute_pointers(pool.format.shading);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_draw_id_buffer);
+  glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0, (void *)0);
+  glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+  glEnableVertexAttribArray(DRAW_ID_LOCATION);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+uint32_t Geometry_Arena::allocate_vertices(geometry_pool &pool,
+                                           uint32_t count) {
+  uint32_t offset = pool.vertices.allocate(count);
+  if (offset != Range_Allocator::INVALID)
+    return offset;
+
+  uint32_t old_capacity = pool.vertices.capacity();
+  uint32_t new_capacity = old_capacity;
+  while (new_capacity - old_capacity < count)
+    new_capacity *= 2;
+
+  grow_buffer(m_gl_caps, pool.position_buffer,
+              (size_t)old_capacity * pool.format.position.stride,
+              (size_t)new_capacity * pool.format.position.stride);
+  grow_buffer(m_gl_caps, pool.shading_buffer,
+              (size_t)old_capacity * pool.format.shading.stride,
+              (size_t)new_capacity * pool.format.shading.stride);
+  pool.vertices.grow(new_capacity);
+  setup_pool_vao(pool);
+  m_buffer_grows++;
+
+  return pool.vertices.allocate(count);
+}
+
+uint32_t Geometry_Arena::allocate_index_words(uint32_t count) {
+  uint32_t offset = m_index_words.allocate(count);
+  if (offset != Range_Allocator::INVALID)
+    return offset;
+
+  uint32_t old_capacity = m_index_words.capacity();
+  uint32_t new_capacity = old_capacity;
+  while (new_capacity - old_capacity < count)
+    new_capacity *= 2;
+
+  // the ebo binding is vao state, every pool needs the new one
+  grow_buffer(m_gl_caps, m_index_buffer, (size_t)old_capacity * 4,
+              (size_t)new_capacity * 4);
+  m_index_words.grow(new_capacity);
+  for (geometry_pool &pool : m_pools)
+    setup_pool_vao(pool);
+  m_buffer_grows++;
+
+  return m_index_words.allocate(count);
+}
+
+uint32_t Geometry_Arena::allocate_draw_slots(uint32_t count) {
+  uint32_t offset = count > 0 ? m_draw_slots.allocate(count)
+                              : Range_Allocator::INVALID;
+  if (offset != Range_Allocator::INVALID)
+    return offset;
+
+  uint32_t old_capacity = m_draw_slots.capacity();
+  uint32_t new_capacity = std::max(old_capacity, INITIAL_DRAW_SLOTS);
+  while (new_capacity - old_capacity < count)
+    new_capacity *= 2;
+  if (new_capacity > m_max_draw_slots) {
+    log_error("geometry arena: out of draw slots (" +
+              std::to_string(m_max_draw_slots) + " max)");
+    return Range_Allocator::INVALID;
+  }
+
+  size_t slot_bytes = DRAW_DATA_TEXELS * sizeof(glm::vec4);
+  grow_buffer(m_gl_caps, m_draw_data_buffer, old_capacity * slot_bytes,
+              new_capacity * slot_bytes);
+  m_draw_data.resize((size_t)new_capacity * DRAW_DATA_TEXELS,
+                     glm::vec4(0.0f));
+  if (m_gl_caps && m_gl_caps->m_has_direct_state_access) {
+    m_gl_caps->glTextureBuffer(m_draw_data_texture, GL_RGBA32F,
+                               m_draw_data_buffer);
+  } else {
+    glBindTexture(GL_TEXTURE_BUFFER, m_draw_data_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_draw_data_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+
+  // ids never change, only the count goes up. static, replaced as a whole
+  std::vector<uint32_t> draw_ids(new_capacity);
+  for (uint32_t i = 0; i < new_capacity; i++)
+    draw_ids[i] = i;
+  if (m_draw_id_buffer != 0)
+    glDeleteBuffers(1, &m_draw_id_buffer);
+  m_draw_id_buffer =
+      create_gl_buffer(m_gl_caps, draw_ids.size() * sizeof(uint32_t),
+                       draw_ids.data(), false);
+
+  m_draw_slots.grow(new_capacity);
+  for (geometry_pool &pool : m_pools)
+    setup_pool_vao(pool);
+  if (old_capacity > 0)
+    m_buffer_grows++;
+
+  return count > 0 ? m_draw_slots.allocate(count) : Range_Allocator::INVALID;
+}
+
+bool Geometry_Arena::add(e_geometry_pool pool_id,
+                         const interleaved_vertices &vertices,
+                         uint32_t vertex_count,
+                         const std::vector<uint32_t> &indices,
+                         const std::vector<uint32_t> &lod_indices,
+                         GLenum index_type, uint32_t draw_slots,
+                         geometry_allocation &out) {
+  geometry_pool &pool = m_pools[pool_id];
+  size_t index_count = indices.size() + lod_indices.size();
+  if (vertex_count == 0 || index_count == 0 || draw_slots == 0)
+    return false;
+
+  geometry_allocation allocation;
+  allocation.pool = pool_id;
+  allocation.vertex_count = vertex_count;
+  allocation.index_count = (uint32_t)indices.size();
+  allocation.index_type = index_type;
+  allocation.draw_slots = draw_slots;
+  allocation.index_words = index_type == GL_UNSIGNED_SHORT
+                               ? (uint32_t)((index_count + 1) / 2)
+                               : (uint32_t)index_count;
+
+  allocation.base_vertex = allocate_vertices(pool, vertex_count);
+  allocation.first_index_word = allocate_index_words(allocation.index_words);
+  allocation.first_draw_slot = allocate_draw_slots(draw_slots);
+  if (allocation.base_vertex == Range_Allocator::INVALID ||
+      allocation.first_index_word == Range_Allocator::INVALID ||
+      allocation.first_draw_slot == Range_Allocator::INVALID) {
+    release(allocation);
+    return false;
+  }
+
+  update_gl_buffer(m_gl_caps, pool.position_buffer,
+                   (size_t)allocation.base_vertex * pool.format.position.stride,
+                   vertices.positions.size(), vertices.positions.data());
+  update_gl_buffer(m_gl_caps, pool.shading_buffer,
+                   (size_t)allocation.base_vertex * pool.format.shading.stride,
+                   vertices.shading.size(), vertices.shading.data());
+
+  std::vector<uint32_t> words(allocation.index_words, 0);
+  if (index_type == GL_UNSIGNED_SHORT) {
+    uint16_t *packed = reinterpret_cast<uint16_t *>(words.data());
+    std::copy(indices.begin(), indices.end(), packed);
+    std::copy(lod_indices.begin(), lod_indices.end(), packed + indices.size());
+  } else {
+    std::copy(indices.begin(), indices.end(), words.begin());
+    std::copy(lod_indices.begin(), lod_indices.end(),
+              words.begin() + indices.size());
+  }
+  update_gl_buffer(m_gl_caps, m_index_buffer,
+                   (size_t)allocation.first_index_word * 4,
+                   words.size() * sizeof(uint32_t), words.data());
+
+  out = allocation;
+  return true;
+}
+
+void Geometry_Arena::release(geometry_allocation &allocation) {
+  if (!allocation.valid())
+    return;
+
+  if (allocation.base_vertex != Range_Allocator::INVALID)
+    m_pools[allocation.pool].vertices.release(allocation.base_vertex,
+                                              allocation.vertex_count);
+  if (allocation.first_index_word != Range_Allocator::INVALID)
+    m_index_words.release(allocation.first_index_word, allocation.index_words);
+  if (allocation.first_draw_slot != Range_Allocator::INVALID)
+    m_draw_slots.release(allocation.first_draw_slot, allocation.draw_slots);
+
+  allocation = geometry_allocation();
+}
+
+void Geometry_Arena::set_draw_data(uint32_t slot, const glm::mat4 &model,
+                                   const glm::vec4 &material) {
+  glm::vec4 *texels = &m_draw_data[(size_t)slot * DRAW_DATA_TEXELS];
+  for (int column = 0; column < 4; column++)
+    texels[column] = model[column];
+  texels[4] = material;
+
+  m_dirty_first = std::min(m_dirty_first, slot);
+  m_dirty_end = std::max(m_dirty_end, slot + 1);
+}
+
+void Geometry_Arena::upload_draw_data() {
+  if (m_dirty_first >= m_dirty_end)
+    return;
+
+  size_t slot_bytes = DRAW_DATA_TEXELS * sizeof(glm::vec4);
+  update_gl_buffer(m_gl_caps, m_draw_data_buffer, m_dirty_first * slot_bytes,
+                   (m_dirty_end - m_dirty_first) * slot_bytes,
+                   &m_draw_data[(size_t)m_dirty_first * DRAW_DATA_TEXELS]);
+
+  m_dirty_first = UINT32_MAX;
+  m_dirty_end = 0;
+}
+
+void Geometry_Arena::log_stats() const {
+  log_success("geometry arena: " + std::to_string(m_draw_slots.used()) +
+              " draw slots, " + std::to_string(m_buffer_grows) +
+              " buffer grows");
+  const char *pool_names[E_GEOMETRY_POOL_COUNT] = {"float", "compact"};
+  for (int i = 0; i < E_GEOMETRY_POOL_COUNT; i++) {
+    const geometry_pool &pool = m_pools[i];
+    if (pool.vertices.used() == 0)
+      continue;
+    log_debug_sub(std::string(pool_names[i]) + " pool: " +
+                  std::to_string(pool.vertices.used()) + " of " +
+                  std::to_string(pool.vertices.capacity()) + " vertices, " +
+                  std::to_string(pool.vertices.free_range_count()) +
+                  " free ranges");
+  }
+  log_debug_sub("indices: " + std::to_string(m_index_words.used() * 4 / 1024) +
+                " of " + std::to_string(m_index_words.capacity() * 4 / 1024) +
+                " KiB, " + std::to_string(m_index_words.free_range_count()) +
+                " free ranges");
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "../glad/glad.h"
+#include "glcaps.hh"
+#include "vertexformat.hh"
+
+#include <glm/glm.hpp>
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// ranges [offset, offset + size) out of a growable capacity. best fit from
+// a free list, released ranges merge with their neighbours. the unit is up
+// to the user (vertices, index words, draw slots)
+class Range_Allocator {
+public:
+  static const uint32_t INVALID = UINT32_MAX;
+
+  void reset(uint32_t capacity);
+
+  // [capacity, new_capacity) becomes free, merged with a free tail
+  void grow(uint32_t new_capacity);
+
+  // INVALID if no free range is big enough, grow and try again then
+  uint32_t allocate(uint32_t size);
+  void release(uint32_t offset, uint32_t size);
+
+  uint32_t capacity() const { return m_capacity; }
+  uint32_t used() const { return m_used; }
+  size_t free_range_count() const { return m_free_by_offset.size(); }
+
+private:
+  void insert_free(uint32_t offset, uint32_t size);
+  void erase_free(std::map<uint32_t, uint32_t>::iterator range);
+
+  // offset -> size and size -> offset of every free range
+  std::map<uint32_t, uint32_t> m_free_by_offset;
+  std::multimap<uint32_t, uint32_t> m_free_by_size;
+  uint32_t m_capacity = 0;
+  uint32_t m_used = 0;
+};
+
+enum e_geometry_pool : int8_t {
+  E_GEOMETRY_POOL_NONE = -1,
+  E_GEOMETRY_POOL_FLOAT = 0,
+  E_GEOMETRY_POOL_COMPACT = 1,
+  E_GEOMETRY_POOL_COUNT = 2,
+};
+
+// where a mesh lives inside the arena. indices are allocated in 4 byte
+// words so 16 and 32 bit meshes can share the index buffer, the lods sit
+// right behind the full index list like in a meshes own ebo
+struct geometry_allocation {
+  e_geometry_pool pool = E_GEOMETRY_POOL_NONE;
+  uint32_t base_vertex = 0;
+  uint32_t vertex_count = 0;
+  uint32_t first_index_word = 0;
+  uint32_t index_words = 0;
+  // full mesh, without the lods
+  uint32_t index_count = 0;
+  GLenum index_type = GL_UNSIGNED_INT;
+  // one slot per instance
+  uint32_t first_draw_slot = 0;
+  uint32_t draw_slots = 0;
+
+  bool valid() const { return pool != E_GEOMETRY_POOL_NONE; }
+
+  // first index of the mesh in units of index_type, what the draw calls
+  // take as firstIndex
+  uint32_t first_index() const {
+    return index_type == GL_UNSIGNED_SHORT ? first_index_word * 2
+                                           : first_index_word;
+  }
+};
+
+// same layout as glMultiDrawElementsIndirect reads it
+struct draw_elements_indirect_command {
+  uint32_t count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t base_vertex;
+  uint32_t base_instance;
+};
+
+// per draw data, DRAW_DATA_TEXELS rgba32f texels per slot in a texture
+// buffer (the shaders texelFetch it with the slot):
+//   0..3  model matrix columns (world * dequantization)
+//   4     x = material type, y = diffuse texture, not read by the shaders yet
+static const uint32_t DRAW_DATA_TEXELS = 5;
+
+// glVertexAttribPointer for every attribute of stream, the buffer has to be
+// bound to GL_ARRAY_BUFFER and the vao to be bound
+void set_vertex_attribute_pointers(const vertex_stream_format &stream);
+
+// scene geometry in a few big buffers instead of a vao + vbos per mesh.
+// one vertex pool per vertex format (float / compact), each with a single
+// vao, all pools share the index buffer and the per draw data. meshes only
+// keep ranges (geometry_allocation) and get drawn with base vertex / first
+// index. with multi draw the vaos also read a draw id at location 4 (one
+// per instance, divisor 1), baseInstance of the indirect command picks the
+// slot. buffers grow by doubling, gl thread only. gl_caps picks dsa /
+// immutable storage for the buffers (see glresources.hh), can be null
+class Geometry_Arena {
+public:
+  Geometry_Arena(const Gl_Caps *gl_caps);
+  ~Geometry_Arena();
+
+  Geometry_Arena(const Geometry_Arena &) = delete;
+  Geometry_Arena &operator=(const Geometry_Arena &) = delete;
+
+  // every allocation is forgotten, the buffers are kept
+  void clear();
+
+  // what a pool expects from build_interleaved_vertices
+  const vertex_format &get_format(e_geometry_pool pool) const {
+    return m_pools[pool].format;
+  }
+
+  // uploads vertices (built with get_format(pool)) and indices (full list +
+  // lods) and reserves draw_slots slots. indices are packed to index_type
+  bool add(e_geometry_pool pool, const interleaved_vertices &vertices,
+           uint32_t vertex_count, const std::vector<uint32_t> &indices,
+           const std::vector<uint32_t> &lod_indices, GLenum index_type,
+           uint32_t draw_slots, geometry_allocation &out);
+  void release(geometry_allocation &allocation);
+
+  // goes up with the next upload_draw_data
+  void set_draw_data(uint32_t slot, const glm::mat4 &model,
+                     const glm::vec4 &material);
+  // changed slots since the last call, one range
+  void upload_draw_data();
+
+  GLuint vao(e_geometry_pool pool) const { return m_pools[pool].vao; }
+  GLuint draw_data_texture() const { return m_draw_data_texture; }
+
+  void log_stats() const;
+
+private:
+  struct geometry_pool {
+    vertex_format format;
+    GLuint vao = 0;
+    GLuint position_buffer = 0;
+    GLuint shading_buffer = 0;
+    Range_Allocator vertices;
+  };
+
+  void setup_pool_vao(geometry_pool &pool);
+
+  // doubles allocator + buffers until size fits, INVALID if that fails
+  uint32_t allocate_vertices(geometry_pool &pool, uint32_t count);
+  uint32_t allocate_index_words(uint32_t count);
+  uint32_t allocate_draw_slots(uint32_t count);
+
+  const Gl_Caps *m_gl_caps = nullptr;
+  geometry_pool m_pools[E_GEOMETRY_POOL_COUNT];
+
+  GLuint m_index_buffer = 0;
+  Range_Allocator m_index_words;
+
+  // slot i holds i, read through the instance divisor (see above)
+  GLuint m_draw_id_buffer = 0;
+
+  GLuint m_draw_data_buffer = 0;
+  GLuint m_draw_data_texture = 0;
+  Range_Allocator m_draw_slots;
+  uint32_t m_max_draw_slots = 0;
+
+  // cpu copy of the draw data, [m_dirty_first, m_dirty_end) not uploaded
+  std::vector<glm::vec4> m_draw_data;
+  uint32_t m_dirty_first = UINT32_MAX;
+  uint32_t m_dirty_end = 0;
+
+  size_t m_buffer_grows = 0;
+};
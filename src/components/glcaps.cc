@@ -0,0 +1,181 @@
+#include "glcaps.hh"
+#include "logging.hh"
+
+#include <GLFW/glfw3.h>
+
+static std::string get_gl_string(GLenum name) {
+  const GLubyte *value = glGetString(name);
+  return value ? reinterpret_cast<const char *>(value) : "";
+}
+
+void Gl_Caps::load() {
+  glGetIntegerv(GL_MAJOR_VERSION, &m_major);
+  glGetIntegerv(GL_MINOR_VERSION, &m_minor);
+
+  m_vendor = get_gl_string(GL_VENDOR);
+  m_renderer = get_gl_string(GL_RENDERER);
+  m_version = get_gl_string(GL_VERSION);
+
+  m_extensions.clear();
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; i++) {
+    const GLubyte *extension = glGetStringi(GL_EXTENSIONS, i);
+    if (extension)
+      m_extensions.insert(reinterpret_cast<const char *>(extension));
+  }
+
+  // program binaries: core in 4.1, else the arb extension
+  if (version_at_least(4, 1) || has_extension("GL_ARB_get_program_binary")) {
+    glGetProgramBinary =
+        (CX_PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+    glProgramBinary =
+        (CX_PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+    glProgramParameteri = (CX_PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress(
+        "glProgramParameteri");
+
+    // drivers are allowed to support the api with zero formats (no caching)
+    GLint num_binary_formats = 0;
+    glGetIntegerv(CX_GL_NUM_PROGRAM_BINARY_FORMATS, &num_binary_formats);
+
+    m_has_program_binary = glGetProgramBinary && glProgramBinary &&
+                           glProgramParameteri && num_binary_formats > 0;
+  }
+
+  m_has_s3tc = has_extension("GL_EXT_texture_compression_s3tc");
+
+  // debug output: core in 4.3, else KHR_debug (same entry point names)
+  if (version_at_least(4, 3) || has_extension("GL_KHR_debug")) {
+    glDebugMessageCallback = (CX_PFNGLDEBUGMESSAGECALLBACKPROC)
+        glfwGetProcAddress("glDebugMessageCallback");
+    glDebugMessageControl = (CX_PFNGLDEBUGMESSAGECONTROLPROC)glfwGetProcAddress(
+        "glDebugMessageControl");
+    m_has_debug_output = glDebugMessageCallback && glDebugMessageControl;
+  }
+
+  // multi draw indirect: core in 4.3. baseInstance has to be honored too,
+  // thats how the draw id gets to the shaders
+  if (version_at_least(4, 3) ||
+      (has_extension("GL_ARB_multi_draw_indirect") &&
+       has_extension("GL_ARB_base_instance"))) {
+    glMultiDrawElementsIndirect =
+        (CX_PFNGLMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress(
+            "glMultiDrawElementsIndirect");
+    m_has_multi_draw_indirect = glMultiDrawElementsIndirect != nullptr;
+  }
+
+  m_has_compute_shader =
+      version_at_least(4, 3) || has_extension("GL_ARB_compute_shader");
+
+  if (version_at_least(4, 2) || has_extension("GL_ARB_texture_storage")) {
+    glTexStorage2D =
+        (CX_PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+    m_has_texture_storage = glTexStorage2D != nullptr;
+  }
+
+  if (version_at_least(4, 4) || has_extension("GL_ARB_buffer_storage")) {
+    glBufferStorage =
+        (CX_PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+    m_has_buffer_storage = glBufferStorage != nullptr;
+  }
+
+  // dsa: core in 4.5. the named buffer storage needs buffer storage as well
+  if ((version_at_least(4, 5) ||
+       has_extension("GL_ARB_direct_state_access")) &&
+      m_has_buffer_storage && m_has_texture_storage) {
+    glCreateBuffers =
+        (CX_PFNGLCREATEBUFFERSPROC)glfwGetProcAddress("glCreateBuffers");
+    glNamedBufferStorage = (CX_PFNGLNAMEDBUFFERSTORAGEPROC)glfwGetProcAddress(
+        "glNamedBufferStorage");
+    glNamedBufferSubData = (CX_PFNGLNAMEDBUFFERSUBDATAPROC)glfwGetProcAddress(
+        "glNamedBufferSubData");
+    glCopyNamedBufferSubData =
+        (CX_PFNGLCOPYNAMEDBUFFERSUBDATAPROC)glfwGetProcAddress(
+            "glCopyNamedBufferSubData");
+    glCreateTextures =
+        (CX_PFNGLCREATETEXTURESPROC)glfwGetProcAddress("glCreateTextures");
+    glTextureStorage2D = (CX_PFNGLTEXTURESTORAGE2DPROC)glfwGetProcAddress(
+        "glTextureStorage2D");
+    glTextureSubImage2D = (CX_PFNGLTEXTURESUBIMAGE2DPROC)glfwGetProcAddress(
+        "glTextureSubImage2D");
+    glCompressedTextureSubImage2D =
+        (CX_PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC)glfwGetProcAddress(
+            "glCompressedTextureSubImage2D");
+    glTextureParameteri = (CX_PFNGLTEXTUREPARAMETERIPROC)glfwGetProcAddress(
+        "glTextureParameteri");
+    glTextureParameterfv = (CX_PFNGLTEXTUREPARAMETERFVPROC)glfwGetProcAddress(
+        "glTextureParameterfv");
+    glTextureBuffer =
+        (CX_PFNGLTEXTUREBUFFERPROC)glfwGetProcAddress("glTextureBuffer");
+    glBindTextureUnit =
+        (CX_PFNGLBINDTEXTUREUNITPROC)glfwGetProcAddress("glBindTextureUnit");
+
+    m_has_direct_state_access =
+        glCreateBuffers && glNamedBufferStorage && glNamedBufferSubData &&
+        glCopyNamedBufferSubData && glCreateTextures && glTextureStorage2D &&
+        glTextureSubImage2D && glCompressedTextureSubImage2D &&
+        glTextureParameteri && glTextureParameterfv && glTextureBuffer &&
+        glBindTextureUnit;
+  }
+
+  if (m_has_direct_state_access && m_has_multi_draw_indirect &&
+      m_has_compute_shader)
+    m_tier = E_GL_TIER_45;
+  else if (m_has_multi_draw_indirect && m_has_compute_shader &&
+           m_has_texture_storage)
+    m_tier = E_GL_TIER_43;
+  else
+    m_tier = E_GL_TIER_33;
+
+  GLint context_flags = 0;
+  glGetIntegerv(GL_CONTEXT_FLAGS, &context_flags);
+  m_is_debug_context = (context_flags & CX_GL_CONTEXT_FLAG_DEBUG_BIT) != 0;
+
+  log_caps();
+}
+
+bool Gl_Caps::version_at_least(int major, int minor) const {
+  return m_major > major || (m_major == major && m_minor >= minor);
+}
+
+bool Gl_Caps::has_extension(const std::string &name) const {
+  return m_extensions.count(name) != 0;
+}
+
+std::string Gl_Caps::driver_string() const {
+  return m_vendor + "|" + m_renderer + "|" + m_version;
+}
+
+const char *Gl_Caps::get_tier_name(e_gl_tier tier) {
+  switch (tier) {
+  case E_GL_TIER_33:
+    return "3.3";
+  case E_GL_TIER_43:
+    return "4.3";
+  case E_GL_TIER_45:
+    return "4.5";
+  }
+  return "?";
+}
+
+void Gl_Caps::log_caps() const {
+  log_success("gl " + std::to_string(m_major) + "." + std::to_string(m_minor) +
+              " on " + m_renderer + " (" + m_vendor + "), feature tier " +
+              get_tier_name(m_tier));
+  log_debug_sub(std::to_string(m_extensions.size()) + " extensions");
+  log_debug_sub(std::string("program binaries: ") +
+                (m_has_program_binary ? "yes" : "no"));
+  log_debug_sub(std::string("s3tc: ") + (m_has_s3tc ? "yes" : "no"));
+  log_debug_sub(std::string("multi draw indirect: ") +
+                (m_has_multi_draw_indirect ? "yes" : "no"));
+  log_debug_sub(std::string("compute shaders: ") +
+                (m_has_compute_shader ? "yes" : "no"));
+  log_debug_sub(std::string("immutable textures / buffers: ") +
+                (m_has_texture_storage ? "yes" : "no") + " / " +
+                (m_has_buffer_storage ? "yes" : "no"));
+  log_debug_sub(std::string("direct state access: ") +
+                (m_has_direct_state_access ? "yes" : "no"));
+  log_debug_sub(std::string("debug output: ") +
+                (m_has_debug_output ? "yes" : "no") +
+                (m_is_debug_context ? " (debug context)" : ""));
+}
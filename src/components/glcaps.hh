@@ -0,0 +1,191 @@
+#pragma once
+
+#include "../glad/glad.h"
+
+// stdlib
+#include <string>
+#include <unordered_set>
+
+// glad only knows 3.3 core, everything newer is loaded by hand in here
+
+// ARB_get_program_binary / 4.1
+#define CX_GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define CX_GL_PROGRAM_BINARY_LENGTH 0x8741
+#define CX_GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+// EXT_texture_compression_s3tc
+#define CX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define CX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+// KHR_debug / 4.3
+#define CX_GL_DEBUG_OUTPUT 0x92E0
+#define CX_GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define CX_GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#define CX_GL_DEBUG_TYPE_ERROR 0x824C
+#define CX_GL_DEBUG_SEVERITY_HIGH 0x9146
+#define CX_GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define CX_GL_DEBUG_SEVERITY_LOW 0x9148
+#define CX_GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+
+// ARB_multi_draw_indirect + ARB_base_instance / 4.3
+#define CX_GL_DRAW_INDIRECT_BUFFER 0x8F3F
+
+// ARB_buffer_storage / 4.4
+#define CX_GL_DYNAMIC_STORAGE_BIT 0x0100
+
+typedef void(APIENTRYP CX_PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(
+    GLenum mode, GLenum type, const void *indirect, GLsizei drawcount,
+    GLsizei stride);
+
+// ARB_texture_storage / 4.2, ARB_buffer_storage / 4.4
+typedef void(APIENTRYP CX_PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels,
+                                                 GLenum internal_format,
+                                                 GLsizei width, GLsizei height);
+typedef void(APIENTRYP CX_PFNGLBUFFERSTORAGEPROC)(GLenum target,
+                                                  GLsizeiptr size,
+                                                  const void *data,
+                                                  GLbitfield flags);
+
+// ARB_direct_state_access / 4.5
+typedef void(APIENTRYP CX_PFNGLCREATEBUFFERSPROC)(GLsizei n, GLuint *buffers);
+typedef void(APIENTRYP CX_PFNGLNAMEDBUFFERSTORAGEPROC)(GLuint buffer,
+                                                       GLsizeiptr size,
+                                                       const void *data,
+                                                       GLbitfield flags);
+typedef void(APIENTRYP CX_PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer,
+                                                       GLintptr offset,
+                                                       GLsizeiptr size,
+                                                       const void *data);
+typedef void(APIENTRYP CX_PFNGLCOPYNAMEDBUFFERSUBDATAPROC)(
+    GLuint read_buffer, GLuint write_buffer, GLintptr read_offset,
+    GLintptr write_offset, GLsizeiptr size);
+typedef void(APIENTRYP CX_PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n,
+                                                   GLuint *textures);
+typedef void(APIENTRYP CX_PFNGLTEXTURESTORAGE2DPROC)(GLuint texture,
+                                                     GLsizei levels,
+                                                     GLenum internal_format,
+                                                     GLsizei width,
+                                                     GLsizei height);
+typedef void(APIENTRYP CX_PFNGLTEXTURESUBIMAGE2DPROC)(
+    GLuint texture, GLint level, GLint x_offset, GLint y_offset, GLsizei width,
+    GLsizei height, GLenum format, GLenum type, const void *pixels);
+typedef void(APIENTRYP CX_PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC)(
+    GLuint texture, GLint level, GLint x_offset, GLint y_offset, GLsizei width,
+    GLsizei height, GLenum format, GLsizei image_size, const void *data);
+typedef void(APIENTRYP CX_PFNGLTEXTUREPARAMETERIPROC)(GLuint texture,
+                                                      GLenum name, GLint value);
+typedef void(APIENTRYP CX_PFNGLTEXTUREPARAMETERFVPROC)(GLuint texture,
+                                                       GLenum name,
+                                                       const GLfloat *value);
+typedef void(APIENTRYP CX_PFNGLTEXTUREBUFFERPROC)(GLuint texture,
+                                                  GLenum internal_format,
+                                                  GLuint buffer);
+typedef void(APIENTRYP CX_PFNGLBINDTEXTUREUNITPROC)(GLuint unit,
+                                                    GLuint texture);
+
+typedef void(APIENTRY *CX_GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
+                                       GLenum severity, GLsizei length,
+                                       const GLchar *message,
+                                       const void *user_param);
+typedef void(APIENTRYP CX_PFNGLDEBUGMESSAGECALLBACKPROC)(
+    CX_GLDEBUGPROC callback, const void *user_param);
+typedef void(APIENTRYP CX_PFNGLDEBUGMESSAGECONTROLPROC)(
+    GLenum source, GLenum type, GLenum severity, GLsizei count,
+    const GLuint *ids, GLboolean enabled);
+
+typedef void(APIENTRYP CX_PFNGLGETPROGRAMBINARYPROC)(GLuint program,
+                                                     GLsizei bufSize,
+                                                     GLsizei *length,
+                                                     GLenum *binaryFormat,
+                                                     void *binary);
+typedef void(APIENTRYP CX_PFNGLPROGRAMBINARYPROC)(GLuint program,
+                                                  GLenum binaryFormat,
+                                                  const void *binary,
+                                                  GLsizei length);
+typedef void(APIENTRYP CX_PFNGLPROGRAMPARAMETERIPROC)(GLuint program,
+                                                      GLenum pname,
+                                                      GLint value);
+
+// coarse feature level, picked from what load() found. everything below
+// the tier still gets used on its own where it exists (see the m_has_*)
+//   3.3  glad only, bind to edit
+//   4.3  + multi draw indirect, compute shaders, immutable textures
+//   4.5  + direct state access, immutable buffers
+enum e_gl_tier : uint8_t {
+  E_GL_TIER_33,
+  E_GL_TIER_43,
+  E_GL_TIER_45,
+};
+
+// what the current context can do + the entry points that go with it.
+// load() needs a current context and glad already initialized
+class Gl_Caps {
+public:
+  int m_major = 3;
+  int m_minor = 3;
+
+  std::string m_vendor;
+  std::string m_renderer;
+  std::string m_version;
+
+  // program binaries (shader cache on disk)
+  bool m_has_program_binary = false;
+  CX_PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;
+  CX_PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;
+  CX_PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+
+  // bc1/bc3 textures
+  bool m_has_s3tc = false;
+
+  // driver side error reporting (see gldebug.hh)
+  bool m_has_debug_output = false;
+  bool m_is_debug_context = false;
+  CX_PFNGLDEBUGMESSAGECALLBACKPROC glDebugMessageCallback = nullptr;
+  CX_PFNGLDEBUGMESSAGECONTROLPROC glDebugMessageControl = nullptr;
+
+  e_gl_tier m_tier = E_GL_TIER_33;
+
+  // whole render queue buckets in one call (see geometryarena.hh)
+  bool m_has_multi_draw_indirect = false;
+  CX_PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect = nullptr;
+
+  // nothing uses them yet, part of the tier
+  bool m_has_compute_shader = false;
+
+  // immutable storage (see glresources.hh)
+  bool m_has_texture_storage = false;
+  bool m_has_buffer_storage = false;
+  CX_PFNGLTEXSTORAGE2DPROC glTexStorage2D = nullptr;
+  CX_PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
+
+  // editing buffers / textures by name instead of binding them first
+  bool m_has_direct_state_access = false;
+  CX_PFNGLCREATEBUFFERSPROC glCreateBuffers = nullptr;
+  CX_PFNGLNAMEDBUFFERSTORAGEPROC glNamedBufferStorage = nullptr;
+  CX_PFNGLNAMEDBUFFERSUBDATAPROC glNamedBufferSubData = nullptr;
+  CX_PFNGLCOPYNAMEDBUFFERSUBDATAPROC glCopyNamedBufferSubData = nullptr;
+  CX_PFNGLCREATETEXTURESPROC glCreateTextures = nullptr;
+  CX_PFNGLTEXTURESTORAGE2DPROC glTextureStorage2D = nullptr;
+  CX_PFNGLTEXTURESUBIMAGE2DPROC glTextureSubImage2D = nullptr;
+  CX_PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC glCompressedTextureSubImage2D =
+      nullptr;
+  CX_PFNGLTEXTUREPARAMETERIPROC glTextureParameteri = nullptr;
+  CX_PFNGLTEXTUREPARAMETERFVPROC glTextureParameterfv = nullptr;
+  CX_PFNGLTEXTUREBUFFERPROC glTextureBuffer = nullptr;
+  CX_PFNGLBINDTEXTUREUNITPROC glBindTextureUnit = nullptr;
+
+  void load();
+
+  bool version_at_least(int major, int minor) const;
+  bool has_extension(const std::string &name) const;
+
+  // vendor + renderer + version, binaries are only valid for this exact one
+  std::string driver_string() const;
+
+  void log_caps() const;
+
+  static const char *get_tier_name(e_gl_tier tier);
+
+private:
+  std::unordered_set<std::string> m_extensions;
+};
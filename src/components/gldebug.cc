@@ -0,0 +1,83 @@
+#include "gldebug.hh"
+#include "logging.hh"
+
+// stdlib
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// the same message every frame would drown everything else
+static const size_t MAX_REPORTS_PER_MESSAGE = 8;
+
+static std::atomic<size_t> s_error_count = 0;
+static std::mutex s_reports_mutex;
+static std::unordered_map<GLuint, size_t> s_reports;
+
+static const char *get_debug_severity_name(GLenum severity) {
+  switch (severity) {
+  case CX_GL_DEBUG_SEVERITY_HIGH:
+    return "high";
+  case CX_GL_DEBUG_SEVERITY_MEDIUM:
+    return "medium";
+  case CX_GL_DEBUG_SEVERITY_LOW:
+    return "low";
+  default:
+    return "info";
+  }
+}
+
+// may run on a driver thread unless the output is synchronous
+static void APIENTRY on_gl_debug_message(GLenum source, GLenum type, GLuint id,
+                                         GLenum severity, GLsizei length,
+                                         const GLchar *message,
+                                         const void *user_param) {
+  (void)source;
+  (void)user_param;
+
+  bool is_error = type == CX_GL_DEBUG_TYPE_ERROR;
+  if (is_error)
+    s_error_count++;
+
+  size_t reports = 0;
+  {
+    std::lock_guard<std::mutex> lock(s_reports_mutex);
+    reports = ++s_reports[id];
+  }
+  if (reports > MAX_REPORTS_PER_MESSAGE)
+    return;
+
+  std::string text = "gl " + std::string(get_debug_severity_name(severity)) +
+                     " (" + std::to_string(id) + "): " +
+                     (length >= 0 ? std::string(message, (size_t)length)
+                                  : std::string(message));
+  if (reports == MAX_REPORTS_PER_MESSAGE)
+    text += " (repeats from here on arent logged)";
+
+  if (is_error || severity == CX_GL_DEBUG_SEVERITY_HIGH)
+    log_error(text);
+  else
+    log_debug(text);
+}
+
+bool enable_gl_debug_output(const Gl_Caps &gl_caps, bool synchronous) {
+  if (!gl_caps.m_has_debug_output)
+    return false;
+
+  glEnable(CX_GL_DEBUG_OUTPUT);
+  if (synchronous)
+    glEnable(CX_GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  else
+    glDisable(CX_GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+  gl_caps.glDebugMessageCallback(on_gl_debug_message, nullptr);
+  gl_caps.glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE,
+                                CX_GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr,
+                                GL_FALSE);
+
+  log_success(std::string("gl debug output on") +
+              (synchronous ? " (synchronous)" : ""));
+  return true;
+}
+
+size_t get_gl_debug_error_count() { return s_error_count; }
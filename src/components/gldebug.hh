@@ -0,0 +1,17 @@
+#pragma once
+
+#include "glcaps.hh"
+
+// stdlib
+#include <cstddef>
+
+// gl errors through KHR_debug instead of glGetError after every call. the
+// driver reports each message through a callback, nothing has to wait for
+// the gpu. synchronous makes the callback run inside the failing call (a
+// breakpoint in there shows the culprit) at the cost of some driver
+// threading. notifications are filtered out. false if the context has no
+// debug output, callers fall back to checking glGetError themselves
+bool enable_gl_debug_output(const Gl_Caps &gl_caps, bool synchronous);
+
+// errors reported through the callback so far
+size_t get_gl_debug_error_count();
@@ -0,0 +1,113 @@
+#include "glresources.hh"
+
+static bool use_dsa(const Gl_Caps *caps) {
+  return caps && caps->m_has_direct_state_access;
+}
+
+GLuint create_gl_buffer(const Gl_Caps *caps, size_t size, const void *data,
+                        bool dynamic) {
+  GLuint buffer = 0;
+
+  if (use_dsa(caps)) {
+    caps->glCreateBuffers(1, &buffer);
+    caps->glNamedBufferStorage(buffer, size, data,
+                               dynamic ? CX_GL_DYNAMIC_STORAGE_BIT : 0);
+    return buffer;
+  }
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  if (caps && caps->m_has_buffer_storage)
+    caps->glBufferStorage(GL_COPY_WRITE_BUFFER, size, data,
+                          dynamic ? CX_GL_DYNAMIC_STORAGE_BIT : 0);
+  else
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data,
+                 dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return buffer;
+}
+
+void update_gl_buffer(const Gl_Caps *caps, GLuint buffer, size_t offset,
+                      size_t size, const void *data) {
+  if (use_dsa(caps)) {
+    caps->glNamedBufferSubData(buffer, offset, size, data);
+    return;
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void copy_gl_buffer(const Gl_Caps *caps, GLuint source, GLuint destination,
+                    size_t size) {
+  if (use_dsa(caps)) {
+    caps->glCopyNamedBufferSubData(source, destination, 0, 0, size);
+    return;
+  }
+
+  glBindBuffer(GL_COPY_READ_BUFFER, source);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool has_immutable_textures(const Gl_Caps *caps) {
+  return caps && caps->m_has_texture_storage;
+}
+
+GLuint create_gl_texture_2d(const Gl_Caps *caps, GLenum internal_format,
+                            int levels, int width, int height) {
+  GLuint texture = 0;
+
+  if (use_dsa(caps)) {
+    caps->glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    caps->glTextureStorage2D(texture, levels, internal_format, width, height);
+    return texture;
+  }
+
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  caps->glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+  return texture;
+}
+
+void upload_gl_texture_level(const Gl_Caps *caps, GLuint texture, int level,
+                             int width, int height, GLenum format, GLenum type,
+                             const void *pixels) {
+  if (use_dsa(caps))
+    caps->glTextureSubImage2D(texture, level, 0, 0, width, height, format,
+                              type, pixels);
+  else
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, type,
+                    pixels);
+}
+
+void upload_gl_compressed_texture_level(const Gl_Caps *caps, GLuint texture,
+                                        int level, int width, int height,
+                                        GLenum internal_format, size_t size,
+                                        const void *data) {
+  if (use_dsa(caps))
+    caps->glCompressedTextureSubImage2D(texture, level, 0, 0, width, height,
+                                        internal_format, (GLsizei)size, data);
+  else
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height,
+                              internal_format, (GLsizei)size, data);
+}
+
+void set_gl_texture_parameter(const Gl_Caps *caps, GLuint texture, GLenum name,
+                              GLint value) {
+  if (use_dsa(caps))
+    caps->glTextureParameteri(texture, name, value);
+  else
+    glTexParameteri(GL_TEXTURE_2D, name, value);
+}
+
+void set_gl_texture_parameter(const Gl_Caps *caps, GLuint texture, GLenum name,
+                              const GLfloat *value) {
+  if (use_dsa(caps))
+    caps->glTextureParameterfv(texture, name, value);
+  else
+    glTexParameterfv(GL_TEXTURE_2D, name, value);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../glad/glad.h"
+#include "glcaps.hh"
+
+// stdlib
+#include <cstddef>
+
+// buffer / texture creation and updates that use whatever the context has:
+// dsa + immutable storage at tier 4.5, immutable storage bound to a target
+// below that, the plain 3.3 calls otherwise. the result is a normal gl name
+// either way. caps can be null (3.3 path)
+
+// buffers go through GL_COPY_WRITE_BUFFER without dsa so no vao or
+// GL_ARRAY_BUFFER / GL_ELEMENT_ARRAY_BUFFER binding changes. dynamic has to
+// be set if the contents change later (update / copy), immutable storage
+// wants to know that up front. data can be null
+GLuint create_gl_buffer(const Gl_Caps *caps, size_t size, const void *data,
+                        bool dynamic);
+void update_gl_buffer(const Gl_Caps *caps, GLuint buffer, size_t offset,
+                      size_t size, const void *data);
+void copy_gl_buffer(const Gl_Caps *caps, GLuint source, GLuint destination,
+                    size_t size);
+
+// immutable 2d textures, only with caps->m_has_texture_storage. without dsa
+// the texture stays bound to GL_TEXTURE_2D on the active unit, which is what
+// the non dsa calls below expect
+bool has_immutable_textures(const Gl_Caps *caps);
+GLuint create_gl_texture_2d(const Gl_Caps *caps, GLenum internal_format,
+                            int levels, int width, int height);
+void upload_gl_texture_level(const Gl_Caps *caps, GLuint texture, int level,
+                             int width, int height, GLenum format, GLenum type,
+                             const void *pixels);
+void upload_gl_compressed_texture_level(const Gl_Caps *caps, GLuint texture,
+                                        int level, int width, int height,
+                                        GLenum internal_format, size_t size,
+                                        const void *data);
+
+// parameters of a GL_TEXTURE_2D, without dsa it has to be bound
+void set_gl_texture_parameter(const Gl_Caps *caps, GLuint texture, GLenum name,
+                              GLint value);
+void set_gl_texture_parameter(const Gl_Caps *caps, GLuint texture, GLenum name,
+                              const GLfloat *value);
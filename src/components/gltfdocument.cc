@@ -0,0 +1,616 @@
+#include "gltfdocument.hh"
+
+#define JSON_NOEXCEPTION
+#include "../libs/json.hpp"
+
+// stdlib
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+void Gltf_Document::clear() {
+  m_default_scene = -1;
+  m_scenes.clear();
+  m_nodes.clear();
+  m_meshes.clear();
+  m_accessors.clear();
+  m_buffer_views.clear();
+  m_buffers.clear();
+  m_materials.clear();
+  m_textures.clear();
+  m_images.clear();
+  m_samplers.clear();
+  m_arena.clear();
+}
+
+size_t Gltf_Document::memory_size() const {
+  return m_scenes.capacity() * sizeof(gltf_scene) +
+         m_nodes.capacity() * sizeof(gltf_node) +
+         m_meshes.capacity() * sizeof(gltf_mesh) +
+         m_accessors.capacity() * sizeof(gltf_accessor) +
+         m_buffer_views.capacity() * sizeof(gltf_buffer_view) +
+         m_buffers.capacity() * sizeof(gltf_buffer) +
+         m_materials.capacity() * sizeof(gltf_material) +
+         m_textures.capacity() * sizeof(gltf_texture) +
+         m_images.capacity() * sizeof(gltf_image) +
+         m_samplers.capacity() * sizeof(gltf_sampler) +
+         m_arena.bytes_reserved();
+}
+
+int get_gltf_component_size(int component_type) {
+  switch (component_type) {
+  case 5120: // BYTE
+  case 5121: // UNSIGNED_BYTE
+    return 1;
+  case 5122: // SHORT
+  case 5123: // UNSIGNED_SHORT
+    return 2;
+  case 5124: // INT
+  case 5125: // UNSIGNED_INT
+  case 5126: // FLOAT
+    return 4;
+  case 5130: // DOUBLE
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+int get_gltf_accessor_stride(const gltf_accessor &accessor,
+                             const gltf_buffer_view &view) {
+  int component_size = get_gltf_component_size(accessor.component_type);
+  if (component_size <= 0 || accessor.components <= 0)
+    return -1;
+
+  if (view.byte_stride == 0)
+    return component_size * accessor.components;
+
+  if (view.byte_stride < 0 || view.byte_stride % component_size != 0)
+    return -1;
+  return view.byte_stride;
+}
+
+// every key the importer cares about. the same name means the same thing
+// everywhere, which object it belongs to comes from the frame stack
+enum e_gltf_key : uint8_t {
+  E_KEY_OTHER,
+  // sections
+  E_KEY_SCENE,
+  E_KEY_SCENES,
+  E_KEY_NODES,
+  E_KEY_MESHES,
+  E_KEY_ACCESSORS,
+  E_KEY_BUFFER_VIEWS,
+  E_KEY_BUFFERS,
+  E_KEY_MATERIALS,
+  E_KEY_TEXTURES,
+  E_KEY_IMAGES,
+  E_KEY_SAMPLERS,
+  // nodes
+  E_KEY_MESH,
+  E_KEY_CHILDREN,
+  E_KEY_MATRIX,
+  E_KEY_TRANSLATION,
+  E_KEY_ROTATION,
+  E_KEY_SCALE,
+  // meshes
+  E_KEY_PRIMITIVES,
+  E_KEY_ATTRIBUTES,
+  E_KEY_INDICES,
+  E_KEY_MATERIAL,
+  E_KEY_POSITION,
+  E_KEY_NORMAL,
+  E_KEY_TEXCOORD_0,
+  E_KEY_TANGENT,
+  // accessors, views, buffers
+  E_KEY_BUFFER_VIEW,
+  E_KEY_BYTE_OFFSET,
+  E_KEY_COMPONENT_TYPE,
+  E_KEY_COUNT,
+  E_KEY_NORMALIZED,
+  E_KEY_TYPE,
+  E_KEY_BUFFER,
+  E_KEY_BYTE_LENGTH,
+  E_KEY_BYTE_STRIDE,
+  E_KEY_URI,
+  // materials, textures, samplers
+  E_KEY_PBR_METALLIC_ROUGHNESS,
+  E_KEY_BASE_COLOR_TEXTURE,
+  E_KEY_INDEX,
+  E_KEY_SOURCE,
+  E_KEY_SAMPLER,
+  E_KEY_MIN_FILTER,
+  E_KEY_MAG_FILTER,
+  E_KEY_WRAP_S,
+  E_KEY_WRAP_T,
+};
+
+static e_gltf_key lookup_gltf_key(std::string_view name) {
+  static const std::unordered_map<std::string_view, e_gltf_key> keys = {
+      {"scene", E_KEY_SCENE},
+      {"scenes", E_KEY_SCENES},
+      {"nodes", E_KEY_NODES},
+      {"meshes", E_KEY_MESHES},
+      {"accessors", E_KEY_ACCESSORS},
+      {"bufferViews", E_KEY_BUFFER_VIEWS},
+      {"buffers", E_KEY_BUFFERS},
+      {"materials", E_KEY_MATERIALS},
+      {"textures", E_KEY_TEXTURES},
+      {"images", E_KEY_IMAGES},
+      {"samplers", E_KEY_SAMPLERS},
+      {"mesh", E_KEY_MESH},
+      {"children", E_KEY_CHILDREN},
+      {"matrix", E_KEY_MATRIX},
+      {"translation", E_KEY_TRANSLATION},
+      {"rotation", E_KEY_ROTATION},
+      {"scale", E_KEY_SCALE},
+      {"primitives", E_KEY_PRIMITIVES},
+      {"attributes", E_KEY_ATTRIBUTES},
+      {"indices", E_KEY_INDICES},
+      {"material", E_KEY_MATERIAL},
+      {"POSITION", E_KEY_POSITION},
+      {"NORMAL", E_KEY_NORMAL},
+      {"TEXCOORD_0", E_KEY_TEXCOORD_0},
+      {"TANGENT", E_KEY_TANGENT},
+      {"bufferView", E_KEY_BUFFER_VIEW},
+      {"byteOffset", E_KEY_BYTE_OFFSET},
+      {"componentType", E_KEY_COMPONENT_TYPE},
+      {"count", E_KEY_COUNT},
+      {"normalized", E_KEY_NORMALIZED},
+      {"type", E_KEY_TYPE},
+      {"buffer", E_KEY_BUFFER},
+      {"byteLength", E_KEY_BYTE_LENGTH},
+      {"byteStride", E_KEY_BYTE_STRIDE},
+      {"uri", E_KEY_URI},
+      {"pbrMetallicRoughness", E_KEY_PBR_METALLIC_ROUGHNESS},
+      {"baseColorTexture", E_KEY_BASE_COLOR_TEXTURE},
+      {"index", E_KEY_INDEX},
+      {"source", E_KEY_SOURCE},
+      {"sampler", E_KEY_SAMPLER},
+      {"minFilter", E_KEY_MIN_FILTER},
+      {"magFilter", E_KEY_MAG_FILTER},
+      {"wrapS", E_KEY_WRAP_S},
+      {"wrapT", E_KEY_WRAP_T},
+  };
+
+  auto it = keys.find(name);
+  return it == keys.end() ? E_KEY_OTHER : it->second;
+}
+
+static int get_gltf_type_components(std::string_view type) {
+  if (type == "SCALAR")
+    return 1;
+  if (type == "VEC2")
+    return 2;
+  if (type == "VEC3")
+    return 3;
+  if (type == "VEC4" || type == "MAT2")
+    return 4;
+  if (type == "MAT3")
+    return 9;
+  if (type == "MAT4")
+    return 16;
+  return 0;
+}
+
+// what the container currently being parsed is
+enum e_gltf_frame : uint8_t {
+  E_FRAME_NONE,
+  E_FRAME_ROOT,
+  E_FRAME_SECTION,      // top level array (nodes, meshes, ...)
+  E_FRAME_ELEMENT,      // one object of a section
+  E_FRAME_INTS,         // scene nodes, node children
+  E_FRAME_FLOATS,       // matrix / trs
+  E_FRAME_PRIMITIVES,   // mesh primitives array
+  E_FRAME_PRIMITIVE,    // one primitive
+  E_FRAME_ATTRIBUTES,   // primitive attributes
+  E_FRAME_PBR,          // material pbrMetallicRoughness
+  E_FRAME_TEXTURE_INFO, // baseColorTexture
+};
+
+struct gltf_frame {
+  e_gltf_frame type;
+  // section the frame is in, key = last key seen inside the frame
+  e_gltf_key section;
+  e_gltf_key key;
+};
+
+// nlohmann sax interface. the document is written while the tokens come
+// in, containers nobody needs are skipped as a whole. lists are collected
+// in reused scratch vectors and copied into the arena once they are done
+class Gltf_Sax_Handler {
+public:
+  using json = nlohmann::json;
+
+  Gltf_Sax_Handler(Gltf_Document &document, std::string &error)
+      : m_document(document), m_error(error) {
+    m_stack.reserve(16);
+  }
+
+  bool null() { return value_event(); }
+  bool boolean(bool value) {
+    if (!value_event())
+      return false;
+    if (!m_skip_depth && in_element(E_KEY_ACCESSORS, E_KEY_NORMALIZED))
+      m_document.m_accessors.back().normalized = value;
+    return true;
+  }
+  bool number_integer(json::number_integer_t value) {
+    return number((double)value);
+  }
+  bool number_unsigned(json::number_unsigned_t value) {
+    return number((double)value);
+  }
+  bool number_float(json::number_float_t value, const json::string_t &) {
+    return number((double)value);
+  }
+  bool binary(json::binary_t &) { return value_event(); }
+
+  bool string(json::string_t &value) {
+    if (!value_event())
+      return false;
+    if (m_skip_depth)
+      return true;
+
+    if (in_element(E_KEY_BUFFERS, E_KEY_URI))
+      m_document.m_buffers.back().uri =
+          m_document.m_arena.copy_string(value.data(), value.size());
+    else if (in_element(E_KEY_IMAGES, E_KEY_URI))
+      m_document.m_images.back().uri =
+          m_document.m_arena.copy_string(value.data(), value.size());
+    else if (in_element(E_KEY_ACCESSORS, E_KEY_TYPE))
+      m_document.m_accessors.back().components =
+          get_gltf_type_components(value);
+    return true;
+  }
+
+  bool key(json::string_t &name) {
+    if (!m_skip_depth)
+      m_stack.back().key = lookup_gltf_key(name);
+    return true;
+  }
+
+  bool start_object(std::size_t) { return start_container(false); }
+  bool start_array(std::size_t) { return start_container(true); }
+  bool end_object() { return end_container(); }
+  bool end_array() { return end_container(); }
+
+  bool parse_error(std::size_t position, const std::string &,
+                   const nlohmann::detail::exception &exception) {
+    m_error = "json error at byte " + std::to_string(position) + ": " +
+              exception.what();
+    return false;
+  }
+
+private:
+  Gltf_Document &m_document;
+  std::string &m_error;
+
+  std::vector<gltf_frame> m_stack;
+  // > 0 while inside a container that gets ignored
+  size_t m_skip_depth = 0;
+
+  std::vector<int> m_ints;
+  float m_floats[16];
+  size_t m_float_count = 0;
+  std::vector<gltf_primitive> m_primitives;
+
+  bool in_element(e_gltf_key section, e_gltf_key key) const {
+    const gltf_frame &top = m_stack.back();
+    return top.type == E_FRAME_ELEMENT && top.section == section &&
+           top.key == key;
+  }
+
+  // scalars are only valid inside the root object
+  bool value_event() {
+    if (m_stack.empty() && !m_skip_depth) {
+      m_error = "gltf json root has to be an object";
+      return false;
+    }
+    return true;
+  }
+
+  bool number(double value) {
+    if (!value_event())
+      return false;
+    if (m_skip_depth)
+      return true;
+
+    gltf_frame &top = m_stack.back();
+    int as_int = (int)value;
+
+    switch (top.type) {
+    case E_FRAME_ROOT:
+      if (top.key == E_KEY_SCENE)
+        m_document.m_default_scene = as_int;
+      break;
+    case E_FRAME_ELEMENT:
+      set_element_number(top.section, top.key, value);
+      break;
+    case E_FRAME_INTS:
+      m_ints.push_back(as_int);
+      break;
+    case E_FRAME_FLOATS:
+      if (m_float_count < 16)
+        m_floats[m_float_count] = (float)value;
+      m_float_count++;
+      break;
+    case E_FRAME_PRIMITIVE:
+      if (top.key == E_KEY_INDICES)
+        m_primitives.back().indices = as_int;
+      else if (top.key == E_KEY_MATERIAL)
+        m_primitives.back().material = as_int;
+      break;
+    case E_FRAME_ATTRIBUTES: {
+      gltf_primitive &primitive = m_primitives.back();
+      if (top.key == E_KEY_POSITION)
+        primitive.position = as_int;
+      else if (top.key == E_KEY_NORMAL)
+        primitive.normal = as_int;
+      else if (top.key == E_KEY_TEXCOORD_0)
+        primitive.texcoord_0 = as_int;
+      else if (top.key == E_KEY_TANGENT)
+        primitive.tangent = as_int;
+      break;
+    }
+    case E_FRAME_TEXTURE_INFO:
+      if (top.key == E_KEY_INDEX)
+        m_document.m_materials.back().base_color_texture = as_int;
+      break;
+    default:
+      break;
+    }
+    return true;
+  }
+
+  void set_element_number(e_gltf_key section, e_gltf_key key, double value) {
+    int as_int = (int)value;
+    size_t as_size = value > 0.0 ? (size_t)value : 0;
+
+    switch (section) {
+    case E_KEY_NODES:
+      if (key == E_KEY_MESH)
+        m_document.m_nodes.back().mesh = as_int;
+      break;
+    case E_KEY_ACCESSORS: {
+      gltf_accessor &accessor = m_document.m_accessors.back();
+      if (key == E_KEY_BUFFER_VIEW)
+        accessor.buffer_view = as_int;
+      else if (key == E_KEY_BYTE_OFFSET)
+        accessor.byte_offset = as_size;
+      else if (key == E_KEY_COMPONENT_TYPE)
+        accessor.component_type = as_int;
+      else if (key == E_KEY_COUNT)
+        accessor.count = as_size;
+      break;
+    }
+    case E_KEY_BUFFER_VIEWS: {
+      gltf_buffer_view &view = m_document.m_buffer_views.back();
+      if (key == E_KEY_BUFFER)
+        view.buffer = as_int;
+      else if (key == E_KEY_BYTE_OFFSET)
+        view.byte_offset = as_size;
+      else if (key == E_KEY_BYTE_LENGTH)
+        view.byte_length = as_size;
+      else if (key == E_KEY_BYTE_STRIDE)
+        view.byte_stride = as_int;
+      break;
+    }
+    case E_KEY_BUFFERS:
+      if (key == E_KEY_BYTE_LENGTH)
+        m_document.m_buffers.back().byte_length = as_size;
+      break;
+    case E_KEY_TEXTURES: {
+      gltf_texture &texture = m_document.m_textures.back();
+      if (key == E_KEY_SOURCE)
+        texture.source = as_int;
+      else if (key == E_KEY_SAMPLER)
+        texture.sampler = as_int;
+      break;
+    }
+    case E_KEY_IMAGES:
+      if (key == E_KEY_BUFFER_VIEW)
+        m_document.m_images.back().buffer_view = as_int;
+      break;
+    case E_KEY_SAMPLERS: {
+      gltf_sampler &sampler = m_document.m_samplers.back();
+      if (key == E_KEY_MIN_FILTER)
+        sampler.min_filter = as_int;
+      else if (key == E_KEY_MAG_FILTER)
+        sampler.mag_filter = as_int;
+      else if (key == E_KEY_WRAP_S)
+        sampler.wrap_s = as_int;
+      else if (key == E_KEY_WRAP_T)
+        sampler.wrap_t = as_int;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  static bool is_section(e_gltf_key key) {
+    return key >= E_KEY_SCENES && key <= E_KEY_SAMPLERS;
+  }
+
+  // which frame a new container opens, E_FRAME_NONE = skip it
+  static e_gltf_frame get_child_frame(const gltf_frame &parent, bool is_array) {
+    switch (parent.type) {
+    case E_FRAME_ROOT:
+      return is_array && is_section(parent.key) ? E_FRAME_SECTION
+                                                : E_FRAME_NONE;
+    case E_FRAME_SECTION:
+      return is_array ? E_FRAME_NONE : E_FRAME_ELEMENT;
+    case E_FRAME_ELEMENT:
+      if (is_array && parent.section == E_KEY_SCENES &&
+          parent.key == E_KEY_NODES)
+        return E_FRAME_INTS;
+      if (is_array && parent.section == E_KEY_NODES) {
+        if (parent.key == E_KEY_CHILDREN)
+          return E_FRAME_INTS;
+        if (parent.key == E_KEY_MATRIX || parent.key == E_KEY_TRANSLATION ||
+            parent.key == E_KEY_ROTATION || parent.key == E_KEY_SCALE)
+          return E_FRAME_FLOATS;
+      }
+      if (is_array && parent.section == E_KEY_MESHES &&
+          parent.key == E_KEY_PRIMITIVES)
+        return E_FRAME_PRIMITIVES;
+      if (!is_array && parent.section == E_KEY_MATERIALS &&
+          parent.key == E_KEY_PBR_METALLIC_ROUGHNESS)
+        return E_FRAME_PBR;
+      return E_FRAME_NONE;
+    case E_FRAME_PRIMITIVES:
+      return is_array ? E_FRAME_NONE : E_FRAME_PRIMITIVE;
+    case E_FRAME_PRIMITIVE:
+      return !is_array && parent.key == E_KEY_ATTRIBUTES ? E_FRAME_ATTRIBUTES
+                                                         : E_FRAME_NONE;
+    case E_FRAME_PBR:
+      return !is_array && parent.key == E_KEY_BASE_COLOR_TEXTURE
+                 ? E_FRAME_TEXTURE_INFO
+                 : E_FRAME_NONE;
+    default:
+      return E_FRAME_NONE;
+    }
+  }
+
+  void add_section_element(e_gltf_key section) {
+    switch (section) {
+    case E_KEY_SCENES:
+      m_document.m_scenes.emplace_back();
+      break;
+    case E_KEY_NODES:
+      m_document.m_nodes.emplace_back();
+      break;
+    case E_KEY_MESHES:
+      m_document.m_meshes.emplace_back();
+      break;
+    case E_KEY_ACCESSORS:
+      m_document.m_accessors.emplace_back();
+      break;
+    case E_KEY_BUFFER_VIEWS:
+      m_document.m_buffer_views.emplace_back();
+      break;
+    case E_KEY_BUFFERS:
+      m_document.m_buffers.emplace_back();
+      break;
+    case E_KEY_MATERIALS:
+      m_document.m_materials.emplace_back();
+      break;
+    case E_KEY_TEXTURES:
+      m_document.m_textures.emplace_back();
+      break;
+    case E_KEY_IMAGES:
+      m_document.m_images.emplace_back();
+      break;
+    case E_KEY_SAMPLERS:
+      m_document.m_samplers.emplace_back();
+      break;
+    default:
+      break;
+    }
+  }
+
+  bool start_container(bool is_array) {
+    if (m_skip_depth) {
+      m_skip_depth++;
+      return true;
+    }
+
+    if (m_stack.empty()) {
+      if (is_array) {
+        m_error = "gltf json root has to be an object";
+        return false;
+      }
+      m_stack.push_back({E_FRAME_ROOT, E_KEY_OTHER, E_KEY_OTHER});
+      return true;
+    }
+
+    const gltf_frame &parent = m_stack.back();
+    e_gltf_frame type = get_child_frame(parent, is_array);
+    if (type == E_FRAME_NONE) {
+      m_skip_depth = 1;
+      return true;
+    }
+
+    e_gltf_key section =
+        type == E_FRAME_SECTION ? parent.key : parent.section;
+
+    switch (type) {
+    case E_FRAME_ELEMENT:
+      add_section_element(section);
+      break;
+    case E_FRAME_INTS:
+      m_ints.clear();
+      break;
+    case E_FRAME_FLOATS:
+      m_float_count = 0;
+      break;
+    case E_FRAME_PRIMITIVES:
+      m_primitives.clear();
+      break;
+    case E_FRAME_PRIMITIVE:
+      m_primitives.emplace_back();
+      break;
+    default:
+      break;
+    }
+
+    m_stack.push_back({type, section, E_KEY_OTHER});
+    return true;
+  }
+
+  bool end_container() {
+    if (m_skip_depth) {
+      m_skip_depth--;
+      return true;
+    }
+
+    gltf_frame frame = m_stack.back();
+    m_stack.pop_back();
+    if (m_stack.empty())
+      return true;
+
+    e_gltf_key parent_key = m_stack.back().key;
+    Arena &arena = m_document.m_arena;
+
+    if (frame.type == E_FRAME_INTS) {
+      if (frame.section == E_KEY_SCENES)
+        m_document.m_scenes.back().nodes = copy_to_arena(arena, m_ints);
+      else
+        m_document.m_nodes.back().children = copy_to_arena(arena, m_ints);
+    } else if (frame.type == E_FRAME_FLOATS) {
+      // wrong sized arrays are ignored, the defaults stay
+      gltf_node &node = m_document.m_nodes.back();
+      if (parent_key == E_KEY_MATRIX && m_float_count == 16) {
+        std::copy(m_floats, m_floats + 16, node.matrix);
+        node.has_matrix = true;
+      } else if (parent_key == E_KEY_TRANSLATION && m_float_count == 3)
+        std::copy(m_floats, m_floats + 3, node.translation);
+      else if (parent_key == E_KEY_ROTATION && m_float_count == 4)
+        std::copy(m_floats, m_floats + 4, node.rotation);
+      else if (parent_key == E_KEY_SCALE && m_float_count == 3)
+        std::copy(m_floats, m_floats + 3, node.scale);
+    } else if (frame.type == E_FRAME_PRIMITIVES) {
+      m_document.m_meshes.back().primitives =
+          copy_to_arena(arena, m_primitives);
+    }
+
+    return true;
+  }
+};
+
+bool parse_gltf_json(const uint8_t *json, size_t size,
+                     Gltf_Document &document, std::string &error) {
+  document.clear();
+  error.clear();
+
+  Gltf_Sax_Handler handler(document, error);
+  bool ok = nlohmann::json::sax_parse(json, json + size, &handler);
+  if (!ok && error.empty())
+    error = "couldnt parse gltf json";
+
+  if (!ok)
+    document.clear();
+  return ok;
+}
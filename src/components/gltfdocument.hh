@@ -0,0 +1,127 @@
+#pragma once
+
+#include "arena.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the parts of a gltf document the importer reads, filled in one streaming
+// pass over the json (no dom). everything of variable size (child lists,
+// primitives, uris) lives in the documents arena. indices are -1 when unset,
+// enums are the raw gltf ones (same as gl)
+
+struct gltf_buffer {
+  std::string_view uri;
+  size_t byte_length = 0;
+};
+
+struct gltf_buffer_view {
+  int buffer = -1;
+  size_t byte_offset = 0;
+  size_t byte_length = 0;
+  int byte_stride = 0;
+};
+
+struct gltf_accessor {
+  int buffer_view = -1;
+  size_t byte_offset = 0;
+  int component_type = -1;
+  size_t count = 0;
+  bool normalized = false;
+  // from "type": SCALAR = 1 ... MAT4 = 16, 0 = unknown
+  int components = 0;
+};
+
+// accessor indices of the attributes we import
+struct gltf_primitive {
+  int position = -1;
+  int normal = -1;
+  int texcoord_0 = -1;
+  int tangent = -1;
+  int indices = -1;
+  int material = -1;
+};
+
+struct gltf_mesh {
+  arena_span<gltf_primitive> primitives;
+};
+
+struct gltf_node {
+  int mesh = -1;
+  arena_span<int> children;
+
+  // either the matrix or trs, whichever the file had
+  bool has_matrix = false;
+  float matrix[16];
+  float translation[3] = {0.0f, 0.0f, 0.0f};
+  float rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+  float scale[3] = {1.0f, 1.0f, 1.0f};
+};
+
+struct gltf_scene {
+  arena_span<int> nodes;
+};
+
+struct gltf_material {
+  // pbrMetallicRoughness.baseColorTexture.index
+  int base_color_texture = -1;
+};
+
+struct gltf_texture {
+  int source = -1;
+  int sampler = -1;
+};
+
+struct gltf_image {
+  std::string_view uri;
+  int buffer_view = -1;
+};
+
+// wrap defaults to REPEAT like the spec says
+struct gltf_sampler {
+  int min_filter = -1;
+  int mag_filter = -1;
+  int wrap_s = 10497;
+  int wrap_t = 10497;
+};
+
+class Gltf_Document {
+public:
+  int m_default_scene = -1;
+
+  std::vector<gltf_scene> m_scenes;
+  std::vector<gltf_node> m_nodes;
+  std::vector<gltf_mesh> m_meshes;
+  std::vector<gltf_accessor> m_accessors;
+  std::vector<gltf_buffer_view> m_buffer_views;
+  std::vector<gltf_buffer> m_buffers;
+  std::vector<gltf_material> m_materials;
+  std::vector<gltf_texture> m_textures;
+  std::vector<gltf_image> m_images;
+  std::vector<gltf_sampler> m_samplers;
+
+  // backs every span / string_view above
+  Arena m_arena;
+
+  void clear();
+
+  // approximate heap held by the document
+  size_t memory_size() const;
+};
+
+// false + error on broken json. unknown keys and extensions are skipped,
+// references arent validated here, the importer checks what it uses
+bool parse_gltf_json(const uint8_t *json, size_t size,
+                     Gltf_Document &document, std::string &error);
+
+// bytes of one component, 0 for an unknown component type
+int get_gltf_component_size(int component_type);
+
+// distance between two elements, byteStride or tightly packed. -1 when the
+// stride is invalid
+int get_gltf_accessor_stride(const gltf_accessor &accessor,
+                             const gltf_buffer_view &view);
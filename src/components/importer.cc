@@ -0,0 +1,461 @@
+#include "importer.hh"
+#include "logging.hh"
+
+#define JSON_NOEXCEPTION
+#include "../libs/json.hpp"
+#include "../libs/tiny_gltf.h"
+
+// stdlib
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace importer {
+
+// glb chunk types (little endian "JSON" / "BIN\0")
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+// one zero byte. only used by the tinygltf reference path in the benchmark,
+// tinygltf wants real data for every buffer/image, this keeps it from
+// reading (and copying) the actual payload
+static const char *PLACEHOLDER_BUFFER_URI =
+    "data:application/octet-stream;base64,AA==";
+static const char *PLACEHOLDER_IMAGE_URI = "data:image/png;base64,AA==";
+
+Mapped_File::~Mapped_File() { release(); }
+
+bool Mapped_File::open(const std::string &file_path) {
+  release();
+
+  int fd = ::open(file_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+    return false;
+
+  // accessors are mostly streamed front to back
+  madvise(mapping, (size_t)file_stat.st_size, MADV_SEQUENTIAL);
+
+  m_data = static_cast<const uint8_t *>(mapping);
+  m_size = (size_t)file_stat.st_size;
+  return true;
+}
+
+void Mapped_File::release() {
+  if (m_data)
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+const uint8_t *Gltf_Source::buffer_data(int buffer_index) const {
+  if (buffer_index < 0 || buffer_index >= (int)m_buffer_data.size())
+    return nullptr;
+  return m_buffer_data[buffer_index];
+}
+
+const uint8_t *Gltf_Source::accessor_data(const gltf_accessor &accessor) const {
+  if (accessor.buffer_view < 0 ||
+      accessor.buffer_view >= (int)m_document.m_buffer_views.size())
+    return nullptr;
+
+  const auto &view = m_document.m_buffer_views[accessor.buffer_view];
+  const uint8_t *base = buffer_data(view.buffer);
+  if (!base || view.byte_offset + accessor.byte_offset >
+                   m_buffer_size[view.buffer])
+    return nullptr;
+
+  // only the start is checked here, the reader knows how much follows
+  return base + view.byte_offset + accessor.byte_offset;
+}
+
+const uint8_t *Gltf_Source::embedded_image_data(int image_index,
+                                                size_t &size) const {
+  size = 0;
+  if (image_index < 0 || image_index >= (int)m_document.m_images.size())
+    return nullptr;
+
+  int view_index = m_document.m_images[image_index].buffer_view;
+  if (view_index < 0 || view_index >= (int)m_document.m_buffer_views.size())
+    return nullptr;
+
+  const auto &view = m_document.m_buffer_views[view_index];
+  const uint8_t *base = buffer_data(view.buffer);
+  if (!base || view.buffer < 0 ||
+      view.byte_offset + view.byte_length > m_buffer_size[view.buffer])
+    return nullptr;
+
+  size = view.byte_length;
+  return base + view.byte_offset;
+}
+
+void Gltf_Source::release() {
+  m_mapped_files.clear();
+  m_buffer_data.clear();
+  m_buffer_size.clear();
+}
+
+// json text of a .gltf or the json chunk of a .glb, plus the bin chunk if
+// there is one
+struct gltf_file_chunks {
+  bool is_binary = false;
+  const uint8_t *json = nullptr;
+  size_t json_size = 0;
+  const uint8_t *bin = nullptr;
+  size_t bin_size = 0;
+};
+
+static bool find_gltf_chunks(const Mapped_File &file,
+                             const std::string &file_path,
+                             gltf_file_chunks &chunks) {
+  chunks.json = file.data();
+  chunks.json_size = file.size();
+
+  // glb: 12 byte header, a json chunk and an optional bin chunk
+  chunks.is_binary = file.size() >= 20 && memcmp(file.data(), "glTF", 4) == 0;
+  if (!chunks.is_binary)
+    return true;
+
+  uint32_t json_chunk_length, json_chunk_type;
+  memcpy(&json_chunk_length, file.data() + 12, 4);
+  memcpy(&json_chunk_type, file.data() + 16, 4);
+
+  if (json_chunk_type != GLB_CHUNK_JSON ||
+      20 + (size_t)json_chunk_length > file.size()) {
+    log_error("invalid glb json chunk in " + file_path);
+    return false;
+  }
+
+  chunks.json = file.data() + 20;
+  chunks.json_size = json_chunk_length;
+
+  size_t bin_chunk_header = 20 + (size_t)json_chunk_length;
+  if (bin_chunk_header + 8 <= file.size()) {
+    uint32_t bin_chunk_length, bin_chunk_type;
+    memcpy(&bin_chunk_length, file.data() + bin_chunk_header, 4);
+    memcpy(&bin_chunk_type, file.data() + bin_chunk_header + 4, 4);
+
+    if (bin_chunk_type == GLB_CHUNK_BIN &&
+        bin_chunk_header + 8 + bin_chunk_length <= file.size()) {
+      chunks.bin = file.data() + bin_chunk_header + 8;
+      chunks.bin_size = bin_chunk_length;
+    }
+  }
+
+  return true;
+}
+
+static int get_base64_value(char c) {
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+' || c == '-')
+    return 62;
+  if (c == '/' || c == '_')
+    return 63;
+  return -1;
+}
+
+// "data:<mime>;base64,<payload>" decoded into the arena. nullptr if uri
+// isnt a base64 data uri or the payload is broken
+static const uint8_t *decode_data_uri(std::string_view uri, Arena &arena,
+                                      size_t &size) {
+  size = 0;
+  size_t payload = uri.find(";base64,");
+  if (uri.substr(0, 5) != "data:" || payload == std::string_view::npos)
+    return nullptr;
+  uri.remove_prefix(payload + 8);
+
+  // 16 byte aligned like a mapping would be, accessors get read in place
+  uint8_t *out =
+      static_cast<uint8_t *>(arena.allocate(uri.size() / 4 * 3 + 3, 16));
+  uint32_t bits = 0;
+  int bit_count = 0;
+  for (char c : uri) {
+    if (c == '=')
+      break;
+
+    int value = get_base64_value(c);
+    if (value < 0)
+      return nullptr;
+
+    bits = (bits << 6) | (uint32_t)value;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      out[size++] = (uint8_t)(bits >> bit_count);
+    }
+  }
+
+  return out;
+}
+
+bool load_gltf_source(const std::string &file_path, Gltf_Source &source) {
+
+  auto gltf_file = std::make_unique<Mapped_File>();
+  if (!gltf_file->open(file_path)) {
+    log_error("couldnt map gltf file: " + file_path);
+    return false;
+  }
+
+  gltf_file_chunks chunks;
+  if (!find_gltf_chunks(*gltf_file, file_path, chunks))
+    return false;
+  source.m_is_binary = chunks.is_binary;
+  source.m_file_paths.assign(1, file_path);
+
+  std::string error;
+  Gltf_Document &document = source.m_document;
+  if (!parse_gltf_json(chunks.json, chunks.json_size, document, error)) {
+    log_error("couldnt parse gltf json of " + file_path + ": " + error);
+    return false;
+  }
+
+  std::filesystem::path base_dir =
+      std::filesystem::path(file_path).parent_path();
+
+  // every buffer gets resolved to its mapping (or decoded data uri)
+  for (const gltf_buffer &buffer : document.m_buffers) {
+    const uint8_t *data = nullptr;
+    size_t size = buffer.byte_length;
+
+    if (buffer.uri.empty()) {
+      // glb bin chunk
+      if (!chunks.bin || buffer.byte_length > chunks.bin_size) {
+        log_error("gltf buffer without uri, but no matching bin chunk!");
+        return false;
+      }
+      data = chunks.bin;
+    } else if (buffer.uri.substr(0, 5) == "data:") {
+      data = decode_data_uri(buffer.uri, document.m_arena, size);
+      if (!data || size < buffer.byte_length) {
+        log_error("couldnt decode gltf data uri buffer in " + file_path);
+        return false;
+      }
+    } else {
+      auto bin_file = std::make_unique<Mapped_File>();
+      std::string bin_path = (base_dir / buffer.uri).string();
+
+      if (!bin_file->open(bin_path) || bin_file->size() < buffer.byte_length) {
+        log_error("couldnt map gltf buffer: " + bin_path);
+        return false;
+      }
+      data = bin_file->data();
+      source.m_mapped_files.push_back(std::move(bin_file));
+      source.m_file_paths.push_back(bin_path);
+    }
+
+    source.m_buffer_data.push_back(data);
+    source.m_buffer_size.push_back(size);
+  }
+
+  // the json of a plain .gltf is parsed now, only a glb has to stay mapped
+  if (source.m_is_binary)
+    source.m_mapped_files.push_back(std::move(gltf_file));
+  else
+    gltf_file->release();
+
+  log_success("gltf source ready (" +
+              std::string(source.m_is_binary ? "glb" : "gltf") + ", " +
+              std::to_string(source.m_mapped_files.size()) +
+              " mapped files, " +
+              std::to_string(document.memory_size() / 1024) +
+              " kb document)");
+  return true;
+}
+
+// images are decoded by the renderer itself, tinygltf doesnt need to
+static bool skip_image_decode(tinygltf::Image *, const int, std::string *,
+                              std::string *, int, int, const unsigned char *,
+                              int, void *) {
+  return true;
+}
+
+// what load_gltf_source did before the streaming parser: json dom, buffer
+// and image uris swapped for placeholders, dumped again and handed to
+// tinygltf, which parses it into its own dom and then into the model
+static bool parse_with_tinygltf(const uint8_t *json_data, size_t json_size,
+                                const std::string &base_dir,
+                                tinygltf::Model &model) {
+  nlohmann::json document =
+      nlohmann::json::parse(json_data, json_data + json_size, nullptr, false);
+  if (document.is_discarded() || !document.is_object())
+    return false;
+
+  if (document.contains("buffers") && document["buffers"].is_array()) {
+    for (auto &buffer : document["buffers"]) {
+      std::string uri = buffer.value("uri", std::string());
+      if (uri.empty() || !tinygltf::IsDataURI(uri)) {
+        buffer["uri"] = PLACEHOLDER_BUFFER_URI;
+        buffer["byteLength"] = 1;
+      }
+    }
+  }
+
+  if (document.contains("images") && document["images"].is_array()) {
+    for (auto &image : document["images"]) {
+      if (image.contains("bufferView") && image["bufferView"].is_number()) {
+        image.erase("bufferView");
+        image["uri"] = PLACEHOLDER_IMAGE_URI;
+      }
+    }
+  }
+
+  std::string json_text = document.dump();
+  document = nlohmann::json();
+
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(skip_image_decode, nullptr);
+
+  std::string err, warn;
+  return loader.LoadASCIIFromString(&model, &err, &warn, json_text.c_str(),
+                                    (unsigned int)json_text.size(), base_dir);
+}
+
+struct parse_measurement {
+  bool ok = false;
+  long peak_kb = 0;
+};
+
+// runs parse once in a forked child, so the peak rss growth isnt hidden by
+// heap pages an earlier run left behind in this process
+static parse_measurement measure_parse_memory(const std::function<bool()> &parse) {
+  parse_measurement result;
+
+  int fds[2];
+  if (pipe(fds) != 0)
+    return result;
+
+  pid_t child = fork();
+  if (child < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return result;
+  }
+
+  if (child == 0) {
+    close(fds[0]);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long before_kb = usage.ru_maxrss;
+
+    parse_measurement measured;
+    measured.ok = parse();
+    getrusage(RUSAGE_SELF, &usage);
+    measured.peak_kb = usage.ru_maxrss - before_kb;
+
+    ssize_t written = write(fds[1], &measured, sizeof(measured));
+    _exit(written == (ssize_t)sizeof(measured) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  if (read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result))
+    result = parse_measurement();
+  close(fds[0]);
+  waitpid(child, nullptr, 0);
+  return result;
+}
+
+// best of a few runs, in ms
+static double time_parse(const std::function<bool()> &parse) {
+  using clock = std::chrono::steady_clock;
+  double best = 0.0;
+  for (int run = 0; run < 10; run++) {
+    auto start = clock::now();
+    parse();
+    double ms =
+        std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    if (run == 0 || ms < best)
+      best = ms;
+  }
+  return best;
+}
+
+void benchmark_gltf_parse(const std::vector<std::string> &file_paths) {
+  log_success("gltf parse benchmark: streaming parser vs tinygltf");
+
+  // what a fork alone costs (stack, copied pages), taken off every result
+  long baseline_kb = measure_parse_memory([]() { return true; }).peak_kb;
+  auto peak_growth = [baseline_kb](const parse_measurement &measured) {
+    return std::to_string(std::max(measured.peak_kb - baseline_kb, 0L));
+  };
+
+  for (const std::string &file_path : file_paths) {
+    Mapped_File file;
+    gltf_file_chunks chunks;
+    if (!file.open(file_path) || !find_gltf_chunks(file, file_path, chunks)) {
+      log_error("couldnt open " + file_path);
+      continue;
+    }
+
+    std::string base_dir =
+        std::filesystem::path(file_path).parent_path().string();
+
+    auto parse_streaming = [&]() {
+      Gltf_Document document;
+      std::string error;
+      return parse_gltf_json(chunks.json, chunks.json_size, document, error);
+    };
+    auto parse_tinygltf = [&]() {
+      tinygltf::Model model;
+      return parse_with_tinygltf(chunks.json, chunks.json_size, base_dir,
+                                 model);
+    };
+
+    // memory first, before the timing runs warm up this process's heap
+    parse_measurement streaming_memory = measure_parse_memory(parse_streaming);
+    parse_measurement tinygltf_memory = measure_parse_memory(parse_tinygltf);
+    double streaming_ms = time_parse(parse_streaming);
+    double tinygltf_ms = time_parse(parse_tinygltf);
+
+    Gltf_Document document;
+    std::string error;
+    parse_gltf_json(chunks.json, chunks.json_size, document, error);
+
+    log_debug(file_path + " (" + std::to_string(chunks.json_size / 1024) +
+              " kb json)");
+    if (!streaming_memory.ok || !tinygltf_memory.ok)
+      log_debug_sub(std::string("parse failed: streaming ") +
+                    (streaming_memory.ok ? "ok" : "failed") + ", tinygltf " +
+                    (tinygltf_memory.ok ? "ok" : "failed"));
+    log_debug_sub("streaming: " + std::to_string(streaming_ms) +
+                  " ms, peak rss +" + peak_growth(streaming_memory) +
+                  " kb, document " +
+                  std::to_string(document.memory_size() / 1024) + " kb");
+    log_debug_sub("tinygltf: " + std::to_string(tinygltf_ms) +
+                  " ms, peak rss +" + peak_growth(tinygltf_memory) + " kb");
+    log_debug_sub("speedup " + std::to_string(tinygltf_ms / streaming_ms) + "x");
+  }
+}
+
+};
@@ -1,7 +1,70 @@
 #pragma once
 
+#include "gltfdocument.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace importer {
 
-  
-  
+  // read only mmap of a whole file. unmapped when released or destroyed
+  class Mapped_File {
+  public:
+    Mapped_File() = default;
+    ~Mapped_File();
+
+    Mapped_File(const Mapped_File &) = delete;
+    Mapped_File &operator=(const Mapped_File &) = delete;
+
+    bool open(const std::string &file_path);
+    void release();
+
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+  private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+  };
+
+  // a parsed gltf/glb document. the json is streamed into m_document, the
+  // buffers are read in place from the mapped .glb/.bin files
+  class Gltf_Source {
+  public:
+    Gltf_Document m_document;
+    bool m_is_binary = false;
+
+    // base pointer + size of every gltf buffer (mapping or decoded data uri
+    // in the documents arena)
+    std::vector<const uint8_t *> m_buffer_data;
+    std::vector<size_t> m_buffer_size;
+
+    std::vector<std::unique_ptr<Mapped_File>> m_mapped_files;
+
+    // the gltf/glb itself + every external buffer file it references,
+    // whatever has to stay unchanged for anything built from it
+    std::vector<std::string> m_file_paths;
+
+    const uint8_t *buffer_data(int buffer_index) const;
+
+    // start of the accessor inside its (mapped) buffer
+    const uint8_t *accessor_data(const gltf_accessor &accessor) const;
+
+    // encoded bytes of an image embedded through a bufferView, else nullptr
+    const uint8_t *embedded_image_data(int image_index, size_t &size) const;
+
+    // drops the mappings, all pointers handed out before are invalid after
+    void release();
+  };
+
+  bool load_gltf_source(const std::string &file_path, Gltf_Source &source);
+
+  // parse time and peak memory of the streaming parser against the old
+  // tinygltf path (json dom + tinygltf::Model) for every file, to the log
+  void benchmark_gltf_parse(const std::vector<std::string> &file_paths);
+
 };
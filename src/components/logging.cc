@@ -1,6 +1,7 @@
 #include "logging.hh"
 #include <iostream>
 #include <glm/matrix.hpp>
+#include <sys/resource.h>
 
 void log_success(const std::string& input) {
   std::cout << "\033[1;32m[S] " << input << "\033[0m" << std::endl;
@@ -27,3 +28,12 @@ void log_mat_4(glm::mat4 mat) {
         std::cout << "|" << std::endl;
     }
 }
+
+void log_peak_rss(const std::string& context) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  // ru_maxrss is reported in kilobytes on linux
+  std::cout << "\033[1;37m[D] peak rss " << context << ": "
+            << usage.ru_maxrss / 1024 << " MB\033[0m" << std::endl;
+}
@@ -10,5 +10,6 @@ void log_debug(const std::string& message);
 void log_debug_sub(const std::string& message);
 void log_error(const std::string& message);
 void log_mat_4(glm::mat4 mat);
+void log_peak_rss(const std::string& context);
 
 #endif // LOGGING_HH
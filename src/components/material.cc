@@ -14,7 +14,7 @@
 #include <string>
 
 //material constructor
-Material::Material(e_mat_type material_type, Shader use_shader) : m_shader(use_shader) {
+Material::Material(e_mat_type material_type, Shader_Handle use_shader) : m_shader(std::move(use_shader)) {
   
   m_material_type = material_type;
   
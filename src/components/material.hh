@@ -2,6 +2,7 @@
 
 // my files
 #include "../shaders/shaderclass.hh"
+#include "texturemanager.hh"
 
 // stdlib
 #include <cmath>
@@ -30,10 +31,14 @@ public:
 
   e_mat_type m_material_type;
 
-  Material(e_mat_type material_type, Shader use_shader);
+  Material(e_mat_type material_type, Shader_Handle use_shader);
 
-  Shader m_shader;
+  Shader_Handle m_shader;
   int bound_texture_id = -1;
+
+  // where bound_texture_id came from, kept for the mesh cache. encoded
+  // points into a mapping that is long gone, never use it from here
+  texture_request m_texture_source;
   
   //pbr with textures
   const char* m_material_pbr_tex_albedo_path;
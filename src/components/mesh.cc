@@ -1,8 +1,218 @@
 #include "mesh.hh"
 
-void Mesh::deserialize(char* file_path) {
+// stdlib
+#include <algorithm>
+#include <cstring>
 
-  return;
+// copies a mapped stream into one of the mesh arrays
+template <typename T>
+static void read_stream(const Mesh_Cache_File &cache_file,
+                        const mesh_cache_record &record,
+                        e_mesh_cache_stream which, std::vector<T> &out) {
+  const T *data = cache_file.stream<T>(record, which);
+  out.assign(data, data + record.streams[which].count);
+}
+
+template <typename T>
+static void write_stream(const std::vector<T> &stream,
+                         mesh_cache_stream &record_stream,
+                         std::vector<uint8_t> &payload,
+                         uint64_t payload_base) {
+  payload.resize((payload.size() + 15) & ~size_t(15), 0);
+
+  record_stream.offset = payload_base + payload.size();
+  record_stream.count = stream.size();
+
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(stream.data());
+  payload.insert(payload.end(), bytes, bytes + stream.size() * sizeof(T));
+}
+
+// every index has to point at a vertex
+static bool are_indices_in_range(const std::vector<uint32_t> &indices,
+                                 size_t vertex_count) {
+  for (uint32_t index : indices)
+    if (index >= vertex_count)
+      return false;
+  return true;
+}
+
+static void write_string(const std::string &str, mesh_cache_string &record_str,
+                         std::vector<uint8_t> &payload, uint64_t payload_base) {
+  record_str.offset = payload_base + payload.size();
+  record_str.length = str.size();
+  payload.insert(payload.end(), str.begin(), str.end());
+}
+
+bool Mesh::deserialize(const Mesh_Cache_File &cache_file, size_t index) {
+
+  if (index >= cache_file.mesh_count())
+    return false;
+
+  const mesh_cache_record &record = cache_file.record(index);
+
+  m_material.m_material_type = (e_mat_type)record.material_type;
+  m_type = (e_mesh_type)record.mesh_type;
+  m_render_mode = (e_mesh_render_mode)record.render_mode;
+  m_index_type = record.index_type;
+
+  memcpy(glm::value_ptr(m_model_matrix), record.model_matrix,
+         sizeof(record.model_matrix));
+  m_bounds_min = glm::vec3(record.bounds_min[0], record.bounds_min[1],
+                           record.bounds_min[2]);
+  m_bounds_max = glm::vec3(record.bounds_max[0], record.bounds_max[1],
+                           record.bounds_max[2]);
+
+  read_stream(cache_file, record, E_STREAM_VERTICES, m_vertices_array);
+  read_stream(cache_file, record, E_STREAM_TEX_COORDS, m_tex_coords_array);
+  read_stream(cache_file, record, E_STREAM_NORMALS, m_normals_array);
+  read_stream(cache_file, record, E_STREAM_TANGENTS, m_tangents_array);
+  read_stream(cache_file, record, E_STREAM_BINORMALS, m_binormals_array);
+  read_stream(cache_file, record, E_STREAM_INDICES, m_indices_array);
+  read_stream(cache_file, record, E_STREAM_LOD_INDICES, m_lod_indices_array);
+
+  // a stale or corrupt cache must not hand out of range vertices to the
+  // cpu side (occlusion, interleaving) or the gpu. per vertex streams are
+  // either missing or cover every vertex, 16 bit indices only where
+  // update_index_type would pick them
+  size_t vertex_count = m_vertices_array.size() / 3;
+  auto covers_vertices = [&](const std::vector<float> &stream,
+                             size_t components) {
+    return stream.empty() || stream.size() == vertex_count * components;
+  };
+  if (m_vertices_array.size() % 3 != 0 ||
+      !covers_vertices(m_tex_coords_array, 2) ||
+      !covers_vertices(m_normals_array, 3) ||
+      !covers_vertices(m_tangents_array, 3) ||
+      !covers_vertices(m_binormals_array, 3) ||
+      !are_indices_in_range(m_indices_array, vertex_count) ||
+      !are_indices_in_range(m_lod_indices_array, vertex_count))
+    return false;
+  if (m_index_type != GL_UNSIGNED_INT &&
+      (m_index_type != GL_UNSIGNED_SHORT || vertex_count >= 0xFFFF))
+    return false;
+
+  if (record.lod_count > MESH_MAX_LODS)
+    return false;
+  m_lods.assign(record.lods, record.lods + record.lod_count);
+  for (const auto &lod : m_lods)
+    if ((size_t)lod.index_offset + lod.index_count >
+        m_indices_array.size() + m_lod_indices_array.size())
+      return false;
+  m_current_lod = 0;
+
+  std::vector<float> instance_floats;
+  read_stream(cache_file, record, E_STREAM_INSTANCES, instance_floats);
+  if (instance_floats.size() % 16 != 0)
+    return false;
+  m_instance_matrices.resize(instance_floats.size() / 16);
+  for (size_t i = 0; i < m_instance_matrices.size(); i++)
+    memcpy(glm::value_ptr(m_instance_matrices[i]), &instance_floats[i * 16],
+           16 * sizeof(float));
+
+  // node indices were checked against the table by Mesh_Cache_File::open
+  m_scene_node = record.scene_node;
+  read_stream(cache_file, record, E_STREAM_INSTANCE_NODES, m_instance_nodes);
+  if (!m_instance_nodes.empty() &&
+      m_instance_nodes.size() != m_instance_matrices.size())
+    return false;
+
+  texture_request &texture_source = m_material.m_texture_source;
+  texture_source.key = cache_file.string(record.texture_key);
+  texture_source.file_path = cache_file.string(record.texture_file_path);
+  texture_source.cache_path = cache_file.string(record.texture_cache_path);
+  texture_source.sampler.min_filter = record.texture_sampler[0];
+  texture_source.sampler.mag_filter = record.texture_sampler[1];
+  texture_source.sampler.wrap_s = record.texture_sampler[2];
+  texture_source.sampler.wrap_t = record.texture_sampler[3];
+
+  // embedded images only exist in the glb, the transcoded cache has to do
+  texture_source.cache_only = texture_source.file_path.empty();
+
+  m_mesh_vbo_needs_refresh = true;
+  return true;
+}
+
+void Mesh::serialize(mesh_cache_record &record, std::vector<uint8_t> &payload,
+                     uint64_t payload_base) const {
+
+  memset(&record, 0, sizeof(record));
+  record.material_type = m_material.m_material_type;
+  record.mesh_type = m_type;
+  record.render_mode = m_render_mode;
+  record.index_type = m_index_type;
+
+  memcpy(record.model_matrix, glm::value_ptr(m_model_matrix),
+         sizeof(record.model_matrix));
+  for (int i = 0; i < 3; i++) {
+    record.bounds_min[i] = m_bounds_min[i];
+    record.bounds_max[i] = m_bounds_max[i];
+  }
+
+  write_stream(m_vertices_array, record.streams[E_STREAM_VERTICES], payload,
+               payload_base);
+  write_stream(m_tex_coords_array, record.streams[E_STREAM_TEX_COORDS],
+               payload, payload_base);
+  write_stream(m_normals_array, record.streams[E_STREAM_NORMALS], payload,
+               payload_base);
+  write_stream(m_tangents_array, record.streams[E_STREAM_TANGENTS], payload,
+               payload_base);
+  write_stream(m_binormals_array, record.streams[E_STREAM_BINORMALS], payload,
+               payload_base);
+  write_stream(m_indices_array, record.streams[E_STREAM_INDICES], payload,
+               payload_base);
+  write_stream(m_lod_indices_array, record.streams[E_STREAM_LOD_INDICES],
+               payload, payload_base);
+
+  // as plain floats, stream counts are in 4 byte elements
+  std::vector<float> instance_floats(m_instance_matrices.size() * 16);
+  for (size_t i = 0; i < m_instance_matrices.size(); i++)
+    memcpy(&instance_floats[i * 16], glm::value_ptr(m_instance_matrices[i]),
+           16 * sizeof(float));
+  write_stream(instance_floats, record.streams[E_STREAM_INSTANCES], payload,
+               payload_base);
+  write_stream(m_instance_nodes, record.streams[E_STREAM_INSTANCE_NODES],
+               payload, payload_base);
+  record.scene_node = m_scene_node;
+
+  record.lod_count = (uint32_t)std::min(m_lods.size(), MESH_MAX_LODS);
+  std::copy_n(m_lods.begin(), record.lod_count, record.lods);
+
+  const texture_request &texture_source = m_material.m_texture_source;
+  write_string(texture_source.key, record.texture_key, payload, payload_base);
+  write_string(texture_source.file_path, record.texture_file_path, payload,
+               payload_base);
+  write_string(texture_source.cache_path, record.texture_cache_path, payload,
+               payload_base);
+  record.texture_sampler[0] = texture_source.sampler.min_filter;
+  record.texture_sampler[1] = texture_source.sampler.mag_filter;
+  record.texture_sampler[2] = texture_source.sampler.wrap_s;
+  record.texture_sampler[3] = texture_source.sampler.wrap_t;
+}
+
+void Mesh::update_index_type() {
+
+  if (m_vertices_array.size() / 3 < 0xFFFF)
+    m_index_type = GL_UNSIGNED_SHORT;
+  else
+    m_index_type = GL_UNSIGNED_INT;
+}
+
+void Mesh::update_bounds() {
+
+  if (m_vertices_array.size() < 3) {
+    m_bounds_min = m_bounds_max = glm::vec3(0.0f);
+    return;
+  }
+
+  m_bounds_min = glm::vec3(m_vertices_array[0], m_vertices_array[1],
+                           m_vertices_array[2]);
+  m_bounds_max = m_bounds_min;
+  for (size_t i = 3; i + 2 < m_vertices_array.size(); i += 3) {
+    glm::vec3 vertex(m_vertices_array[i], m_vertices_array[i + 1],
+                     m_vertices_array[i + 2]);
+    m_bounds_min = glm::min(m_bounds_min, vertex);
+    m_bounds_max = glm::max(m_bounds_max, vertex);
+  }
 }
 
 Mesh::Mesh(Material use_material) : m_material(use_material) {
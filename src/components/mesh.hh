@@ -7,9 +7,14 @@
 #include <glm/gtc/type_ptr.hpp>
 
 // stdlib
+#include <cstdint>
 #include <vector>
 
+#include "../components/cullbvh.hh"
+#include "../components/geometryarena.hh"
 #include "../components/material.hh"
+#include "../components/meshcache.hh"
+#include "../components/scenegraph.hh"
 
 enum e_mesh_type {
 
@@ -35,7 +40,14 @@ public:
 
   bool m_mesh_vbo_needs_refresh = true;
   
-  void deserialize(char* file_path);
+  // fills the mesh from entry index of a mapped mesh cache. the shader is
+  // picked by the caller, the texture request is restored into the material
+  bool deserialize(const Mesh_Cache_File& cache_file, size_t index);
+
+  // appends the streams to payload (16 byte aligned) and fills the record.
+  // offsets in the record are payload_base + position in payload
+  void serialize(mesh_cache_record& record, std::vector<uint8_t>& payload,
+                 uint64_t payload_base) const;
   
   std::vector<float> m_vertices_array;
   std::vector<float> m_tex_coords_array;
@@ -43,15 +55,80 @@ public:
   std::vector<float> m_tangents_array;
   std::vector<float> m_binormals_array;
 
-  GLuint m_mesh_vao;
+  // triangle list into the arrays above. empty means plain triangle soup
+  std::vector<uint32_t> m_indices_array;
+  GLenum m_index_type = GL_UNSIGNED_INT;
+
+  // simplified levels, index into the same vertices as m_indices_array and
+  // get uploaded right behind it. m_lods[0] is the full mesh, empty = no
+  // lods (see meshsimplify.hh)
+  std::vector<uint32_t> m_lod_indices_array;
+  std::vector<mesh_lod> m_lods;
+
+  // picked once per frame by the renderer, read by every pass
+  size_t m_current_lod = 0;
+  bool m_lod_culled = false;
+
+  // picks 16 bit indices whenever every vertex can be addressed with them
+  void update_index_type();
+
+  // local space aabb of m_vertices_array
+  glm::vec3 m_bounds_min = glm::vec3(0.0f);
+  glm::vec3 m_bounds_max = glm::vec3(0.0f);
+  void update_bounds();
+
+  GLuint m_mesh_vao = 0;
   Material m_material;
+
+  // transform relative to the entity at import time. only used as is by
+  // meshes without a scene node (hitboxes etc.), see
+  // Scene::get_mesh_world_matrix
   glm::mat4 m_model_matrix = glm::mat4(1.0f);
 
-  GLuint m_vertices_glid;
-  GLuint m_tex_coords_glid;
-  GLuint m_normals_glid;
-  GLuint m_tangents_glid;
-  GLuint m_binormals_glid;
+  // node in the owning entities hierarchy, relative to the entity (see
+  // Scene::get_entity_node). instanced meshes use m_instance_nodes instead
+  uint32_t m_scene_node = SCENE_NODE_NONE;
+
+  // every placement of this geometry inside the entity, all drawn with one
+  // instanced call. empty = drawn once with m_model_matrix, which stays
+  // identity otherwise
+  std::vector<glm::mat4> m_instance_matrices;
+  std::vector<uint32_t> m_instance_nodes;
+  GLuint m_instances_glid = 0;
+  size_t instance_count() const {
+    return m_instance_matrices.empty() ? 1 : m_instance_matrices.size();
+  }
+
+  // unorm16 positions -> local space, identity for float vertices. goes
+  // right of m_model_matrix
+  glm::mat4 m_dequant_matrix = glm::mat4(1.0f);
+
+  // world transforms as of the last scene graph update, only recomputed
+  // when a node they depend on moved (Renderer::update_mesh_transforms).
+  // m_model_uniform = world * dequant, identity for instanced meshes
+  glm::mat4 m_world_matrix = glm::mat4(1.0f);
+  glm::mat4 m_model_uniform = glm::mat4(1.0f);
+  std::vector<glm::mat4> m_instance_world_matrices;
+  bool m_world_matrix_stale = true;
+
+  // m_bounds_* through the world matrices above, every instance included.
+  // m_cull_item is the meshes item in the renderers cull bvh, the
+  // frustum flags are what the last Renderer::cull_meshes left,
+  // m_occluded what Renderer::cull_occluded_meshes left (main pass only)
+  world_bounds m_world_bounds;
+  uint32_t m_cull_item = Cull_Bvh::INVALID;
+  bool m_in_camera_frustum = true;
+  bool m_in_light_frustum = true;
+  bool m_occluded = false;
+
+  // position stream + interleaved shading stream, see vertexformat.hh
+  GLuint m_vertices_glid = 0;
+  GLuint m_shading_glid = 0;
+
+  // ranges in the renderers geometry arena instead of the buffers above,
+  // m_mesh_vao is the arena pools vao then
+  geometry_allocation m_geometry;
+  GLuint m_indices_glid = 0;
 
   e_mesh_type m_type = E_MESH;
   e_mesh_render_mode m_render_mode = E_FILLED;
@@ -0,0 +1,234 @@
+#include "meshcache.hh"
+#include "logging.hh"
+#include "mesh.hh"
+
+// stdlib
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+static uint32_t get_import_flags(const mesh_import_options &import_options) {
+  return (import_options.optimize ? 1u : 0u) |
+         (import_options.generate_lods ? 2u : 0u);
+}
+
+bool Mesh_Cache_File::open(const std::string &file_path) {
+  m_header = nullptr;
+  if (!m_file.open(file_path))
+    return false;
+
+  if (m_file.size() < sizeof(mesh_cache_header))
+    return false;
+
+  const auto *header = reinterpret_cast<const mesh_cache_header *>(m_file.data());
+  if (header->magic != MESH_CACHE_MAGIC ||
+      header->version != MESH_CACHE_VERSION ||
+      header->record_size != sizeof(mesh_cache_record) ||
+      header->file_size != m_file.size() ||
+      header->records_offset + (uint64_t)header->mesh_count *
+                                   sizeof(mesh_cache_record) >
+          m_file.size() ||
+      header->nodes_offset + (uint64_t)header->node_count *
+                                 sizeof(scene_node_desc) >
+          m_file.size() ||
+      header->source_files_offset + (uint64_t)header->source_file_count *
+                                        sizeof(mesh_cache_string) >
+          m_file.size()) {
+    log_error("mesh cache " + file_path + " is broken or outdated");
+    return false;
+  }
+
+  // every stream has to be inside the file before anyone reads it
+  const auto *records = reinterpret_cast<const mesh_cache_record *>(
+      m_file.data() + header->records_offset);
+  for (uint32_t i = 0; i < header->mesh_count; i++) {
+    for (int s = 0; s < E_STREAM_COUNT; s++) {
+      const mesh_cache_stream &stream = records[i].streams[s];
+      if (stream.offset + stream.count * 4 > m_file.size()) {
+        log_error("mesh cache " + file_path + " has a truncated stream");
+        return false;
+      }
+    }
+
+    // node references have to stay inside the table, same for parents
+    bool nodes_valid = records[i].scene_node == SCENE_NODE_NONE ||
+                       records[i].scene_node < header->node_count;
+    const uint32_t *instance_nodes = reinterpret_cast<const uint32_t *>(
+        m_file.data() + records[i].streams[E_STREAM_INSTANCE_NODES].offset);
+    for (uint64_t n = 0;
+         n < records[i].streams[E_STREAM_INSTANCE_NODES].count; n++)
+      nodes_valid = nodes_valid && instance_nodes[n] < header->node_count;
+
+    if (!nodes_valid) {
+      log_error("mesh cache " + file_path + " refers to missing nodes");
+      return false;
+    }
+  }
+
+  const auto *nodes = reinterpret_cast<const scene_node_desc *>(
+      m_file.data() + header->nodes_offset);
+  for (uint32_t i = 0; i < header->node_count; i++) {
+    if (nodes[i].parent != SCENE_NODE_NONE && nodes[i].parent >= i) {
+      log_error("mesh cache " + file_path + " has a broken node table");
+      return false;
+    }
+  }
+
+  m_header = header;
+  return true;
+}
+
+const mesh_cache_record &Mesh_Cache_File::record(size_t index) const {
+  return reinterpret_cast<const mesh_cache_record *>(
+      m_file.data() + m_header->records_offset)[index];
+}
+
+std::vector<scene_node_desc> Mesh_Cache_File::nodes() const {
+  if (!m_header)
+    return {};
+
+  const auto *first = reinterpret_cast<const scene_node_desc *>(
+      m_file.data() + m_header->nodes_offset);
+  return std::vector<scene_node_desc>(first, first + m_header->node_count);
+}
+
+std::string Mesh_Cache_File::string(const mesh_cache_string &str) const {
+  if (str.length == 0 || str.offset + str.length > m_file.size())
+    return "";
+  return std::string(reinterpret_cast<const char *>(m_file.data()) + str.offset,
+                     str.length);
+}
+
+std::vector<std::string> Mesh_Cache_File::source_files() const {
+  if (!m_header)
+    return {};
+
+  const auto *first = reinterpret_cast<const mesh_cache_string *>(
+      m_file.data() + m_header->source_files_offset);
+  std::vector<std::string> files;
+  for (uint32_t i = 0; i < m_header->source_file_count; i++)
+    files.push_back(string(first[i]));
+  return files;
+}
+
+uint64_t get_mesh_cache_source_stamp(const std::vector<std::string> &files) {
+  uint64_t stamp = 0xcbf29ce484222325ull;
+
+  for (const std::string &file : files) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(file, ec);
+    if (ec)
+      return 0;
+    auto mtime = std::filesystem::last_write_time(file, ec);
+    if (ec)
+      return 0;
+
+    stamp ^= (uint64_t)size * 0x9e3779b97f4a7c15ull ^
+             (uint64_t)mtime.time_since_epoch().count();
+    stamp *= 0x100000001b3ull;
+  }
+  return stamp;
+}
+
+bool mesh_cache_is_fresh(const std::string &cache_path,
+                         const mesh_import_options &import_options) {
+  std::error_code ec;
+  if (!std::filesystem::exists(cache_path, ec))
+    return false;
+
+  Mesh_Cache_File cache_file;
+  if (!cache_file.open(cache_path) ||
+      cache_file.import_flags() != get_import_flags(import_options))
+    return false;
+
+  std::vector<std::string> files = cache_file.source_files();
+  uint64_t stamp = get_mesh_cache_source_stamp(files);
+  return !files.empty() && stamp != 0 && stamp == cache_file.source_stamp();
+}
+
+bool write_mesh_cache(const std::string &cache_path,
+                      const std::vector<Mesh> &meshes,
+                      const std::vector<scene_node_desc> &nodes,
+                      const mesh_import_options &import_options,
+                      const std::vector<std::string> &source_files) {
+  // nothing to check against later, the cache would never be fresh
+  uint64_t source_stamp = get_mesh_cache_source_stamp(source_files);
+  if (source_files.empty() || source_stamp == 0)
+    return false;
+
+  std::vector<const Mesh *> to_store;
+  for (const auto &mesh : meshes)
+    if (mesh.m_type == E_MESH)
+      to_store.push_back(&mesh);
+
+  std::vector<mesh_cache_record> records(to_store.size());
+  std::vector<uint8_t> payload;
+
+  // payload starts after header + records, offsets are absolute
+  uint64_t payload_base =
+      sizeof(mesh_cache_header) + records.size() * sizeof(mesh_cache_record);
+
+  for (size_t i = 0; i < to_store.size(); i++)
+    to_store[i]->serialize(records[i], payload, payload_base);
+
+  payload.resize((payload.size() + 15) & ~size_t(15), 0);
+  uint64_t nodes_offset = payload_base + payload.size();
+  const uint8_t *node_bytes = reinterpret_cast<const uint8_t *>(nodes.data());
+  payload.insert(payload.end(), node_bytes,
+                 node_bytes + nodes.size() * sizeof(scene_node_desc));
+
+  // source file paths as strings, then their table
+  std::vector<mesh_cache_string> source_strings;
+  for (const std::string &file : source_files) {
+    source_strings.push_back({payload_base + payload.size(), file.size()});
+    payload.insert(payload.end(), file.begin(), file.end());
+  }
+  payload.resize((payload.size() + 15) & ~size_t(15), 0);
+  uint64_t source_files_offset = payload_base + payload.size();
+  const uint8_t *source_bytes =
+      reinterpret_cast<const uint8_t *>(source_strings.data());
+  payload.insert(payload.end(), source_bytes,
+                 source_bytes +
+                     source_strings.size() * sizeof(mesh_cache_string));
+
+  mesh_cache_header header{MESH_CACHE_MAGIC,
+                           MESH_CACHE_VERSION,
+                           (uint32_t)records.size(),
+                           (uint32_t)sizeof(mesh_cache_record),
+                           sizeof(mesh_cache_header),
+                           payload_base + payload.size(),
+                           (uint32_t)nodes.size(),
+                           get_import_flags(import_options),
+                           nodes_offset,
+                           source_stamp,
+                           source_files_offset,
+                           (uint32_t)source_strings.size(),
+                           0};
+
+  // write + rename, a half written cache must never look fresh
+  std::string temp_path = cache_path + ".tmp";
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    cache_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    cache_file.write(reinterpret_cast<const char *>(records.data()),
+                     records.size() * sizeof(mesh_cache_record));
+    cache_file.write(reinterpret_cast<const char *>(payload.data()),
+                     payload.size());
+    if (!cache_file) {
+      log_error("couldnt write mesh cache " + temp_path);
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(temp_path, cache_path, ec);
+  if (ec) {
+    log_error("couldnt store mesh cache " + cache_path);
+    return false;
+  }
+
+  log_success("wrote mesh cache with " + std::to_string(records.size()) +
+              " meshes, " + std::to_string(nodes.size()) + " nodes (" + std::to_string(header.file_size / 1024) +
+              " KiB): " + cache_path);
+  return true;
+}
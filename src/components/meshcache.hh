@@ -0,0 +1,142 @@
+#pragma once
+
+#include "importer.hh"
+#include "meshoptimize.hh"
+#include "meshsimplify.hh"
+#include "scenegraph.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Mesh;
+
+// binary cache of fully processed meshes (final vertex streams, indices,
+// bounds, material refs) for one gltf scene. every stream is stored 16 byte
+// aligned so the whole file can be used straight out of a mapping
+
+static const uint32_t MESH_CACHE_MAGIC = 0x434D5843; // "CXMC"
+static const uint32_t MESH_CACHE_VERSION = 6;
+
+enum e_mesh_cache_stream {
+  E_STREAM_VERTICES,
+  E_STREAM_TEX_COORDS,
+  E_STREAM_NORMALS,
+  E_STREAM_TANGENTS,
+  E_STREAM_BINORMALS,
+  E_STREAM_INDICES,
+  E_STREAM_LOD_INDICES,
+  E_STREAM_INSTANCES,
+  E_STREAM_INSTANCE_NODES,
+  E_STREAM_COUNT
+};
+
+// offset from the start of the file, count in elements (float / uint32)
+struct mesh_cache_stream {
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct mesh_cache_string {
+  uint64_t offset;
+  uint64_t length;
+};
+
+struct mesh_cache_record {
+  uint32_t material_type;
+  uint32_t mesh_type;
+  uint32_t render_mode;
+  uint32_t index_type;
+
+  float model_matrix[16];
+  float bounds_min[3];
+  float bounds_max[3];
+
+  mesh_cache_stream streams[E_STREAM_COUNT];
+
+  // lod 0 always covers E_STREAM_INDICES, see mesh_lod
+  uint32_t lod_count;
+  // see Mesh::m_scene_node, indexes the node table of the file
+  uint32_t scene_node;
+  mesh_lod lods[MESH_MAX_LODS];
+
+  // texture the material was bound to, see texture_request
+  mesh_cache_string texture_key;
+  mesh_cache_string texture_file_path;
+  mesh_cache_string texture_cache_path;
+  int32_t texture_sampler[4];
+};
+
+struct mesh_cache_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t mesh_count;
+  uint32_t record_size;
+  uint64_t records_offset;
+  uint64_t file_size;
+
+  // node hierarchy of the scene, scene_node_desc each
+  uint32_t node_count;
+  // mesh_import_options the meshes went through, bit 0 = optimize,
+  // bit 1 = generate_lods
+  uint32_t import_flags;
+  uint64_t nodes_offset;
+
+  // files the meshes came from (mesh_cache_string each) and their stamp
+  // when the cache was written
+  uint64_t source_stamp;
+  uint64_t source_files_offset;
+  uint32_t source_file_count;
+  uint32_t reserved;
+};
+
+// read only view of a cache file, mapped as a whole
+class Mesh_Cache_File {
+public:
+  bool open(const std::string &file_path);
+
+  size_t mesh_count() const { return m_header ? m_header->mesh_count : 0; }
+  const mesh_cache_record &record(size_t index) const;
+  std::vector<scene_node_desc> nodes() const;
+
+  std::string string(const mesh_cache_string &str) const;
+
+  uint32_t import_flags() const {
+    return m_header ? m_header->import_flags : 0;
+  }
+  uint64_t source_stamp() const {
+    return m_header ? m_header->source_stamp : 0;
+  }
+  std::vector<std::string> source_files() const;
+
+  template <typename T>
+  const T *stream(const mesh_cache_record &record,
+                  e_mesh_cache_stream which) const {
+    return reinterpret_cast<const T *>(m_file.data() +
+                                       record.streams[which].offset);
+  }
+
+private:
+  importer::Mapped_File m_file;
+  const mesh_cache_header *m_header = nullptr;
+};
+
+// changes whenever one of the files does: size + mtime of each. 0 if any
+// of them is missing
+uint64_t get_mesh_cache_source_stamp(const std::vector<std::string> &files);
+
+// cache exists, was processed with the same options and none of the files
+// it was built from changed since
+bool mesh_cache_is_fresh(const std::string &cache_path,
+                         const mesh_import_options &import_options);
+
+// only plain scene meshes get stored, collision boxes etc. are skipped.
+// nodes = the hierarchy the meshes refer to (Scene_Graph::export_subtree),
+// source_files what they were imported from (Gltf_Source::m_file_paths)
+bool write_mesh_cache(const std::string &cache_path,
+                      const std::vector<Mesh> &meshes,
+                      const std::vector<scene_node_desc> &nodes,
+                      const mesh_import_options &import_options,
+                      const std::vector<std::string> &source_files);
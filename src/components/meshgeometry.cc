@@ -0,0 +1,1071 @@
+#include "meshgeometry.hh"
+#include "logging.hh"
+
+#include <glm/glm.hpp>
+
+#if CORTEX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// stdlib
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+std::vector<float>
+calculate_vert_normals(const std::vector<float> &mesh_vertices,
+                       const std::vector<uint32_t> &mesh_indices) {
+  std::vector<glm::vec3> vertexNormals; // buffer
+  std::vector<float> mesh_normals;
+  size_t numVertices = mesh_vertices.size() / 3;
+  vertexNormals.resize(numVertices, glm::vec3(0.0f));
+  mesh_normals.reserve(numVertices * 3);
+
+  size_t num_triangles = get_triangle_count(mesh_vertices, mesh_indices);
+  for (size_t tri = 0; tri < num_triangles; tri++) {
+    uint32_t ids[3];
+    get_triangle_vertex_ids(mesh_indices, tri, ids);
+
+    glm::vec3 v0(mesh_vertices[ids[0] * 3], mesh_vertices[ids[0] * 3 + 1],
+                 mesh_vertices[ids[0] * 3 + 2]); // Vertex 1
+    glm::vec3 v1(mesh_vertices[ids[1] * 3], mesh_vertices[ids[1] * 3 + 1],
+                 mesh_vertices[ids[1] * 3 + 2]); // Vertex 2
+    glm::vec3 v2(mesh_vertices[ids[2] * 3], mesh_vertices[ids[2] * 3 + 1],
+                 mesh_vertices[ids[2] * 3 + 2]); // Vertex 3
+
+    // Calculate the normal for the face
+    glm::vec3 faceNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+
+    // Accumulate the face normal to every vertex the face references
+    vertexNormals[ids[0]] += faceNormal; // Vertex 1
+    vertexNormals[ids[1]] += faceNormal; // Vertex 2
+    vertexNormals[ids[2]] += faceNormal; // Vertex 3
+  }
+
+  for (size_t i = 0; i < vertexNormals.size(); ++i) {
+    vertexNormals[i] = glm::normalize(vertexNormals[i]);
+  }
+
+  for (const auto &normal : vertexNormals) {
+    mesh_normals.push_back(normal.x);
+    mesh_normals.push_back(normal.y);
+    mesh_normals.push_back(normal.z);
+  }
+
+  std::cout << "done calculating " << (int)mesh_normals.size() << " normals"
+            << std::endl;
+  return mesh_normals;
+}
+
+tan_bin_glob calculate_vert_tan_bin(const std::vector<float> &mesh_vertices,
+                                    const std::vector<float> &mesh_normals,
+                                    const std::vector<float> &texture_coordinates,
+                                    const std::vector<uint32_t> &mesh_indices) {
+
+  std::vector<float> vert_tangents;
+  std::vector<float> vert_binormals;
+
+  tan_bin_glob return_glob;
+
+  vert_tangents.resize(mesh_vertices.size());
+  vert_binormals.resize(mesh_vertices.size());
+
+  size_t num_triangles = get_triangle_count(mesh_vertices, mesh_indices);
+  for (size_t tri = 0; tri < num_triangles; tri++) {
+    uint32_t ids[3];
+    get_triangle_vertex_ids(mesh_indices, tri, ids);
+
+    glm::vec3 v0(mesh_vertices[ids[0] * 3], mesh_vertices[ids[0] * 3 + 1],
+                 mesh_vertices[ids[0] * 3 + 2]); // Vertex 1
+    glm::vec3 v1(mesh_vertices[ids[1] * 3], mesh_vertices[ids[1] * 3 + 1],
+                 mesh_vertices[ids[1] * 3 + 2]); // Vertex 2
+    glm::vec3 v2(mesh_vertices[ids[2] * 3], mesh_vertices[ids[2] * 3 + 1],
+                 mesh_vertices[ids[2] * 3 + 2]); // Vertex 3
+
+    glm::vec2 t0(texture_coordinates[ids[0] * 2],
+                 texture_coordinates[ids[0] * 2 + 1]); // Vertex 1
+    glm::vec2 t1(texture_coordinates[ids[1] * 2],
+                 texture_coordinates[ids[1] * 2 + 1]); // Vertex 2
+    glm::vec2 t2(texture_coordinates[ids[2] * 2],
+                 texture_coordinates[ids[2] * 2 + 1]); // Vertex 3
+
+    glm::vec3 e1(v1 - v0);
+    glm::vec3 e2(v2 - v0);
+
+    glm::vec2 delta_uv_1(t1 - t0);
+    glm::vec2 delta_uv_2(t2 - t0);
+
+    // shoutout wikipedia
+    float f =
+        1 / ((delta_uv_1.x * delta_uv_2.y) - (delta_uv_1.y * delta_uv_2.x));
+
+    glm::vec3 tangent = f * ((delta_uv_2.y * e1) - (delta_uv_1.y * e2));
+
+    // shared vertices average the tangents of all faces around them
+    for (int vert_id = 0; vert_id < 3; vert_id++) {
+      vert_tangents[ids[vert_id] * 3] += tangent.x;
+      vert_tangents[ids[vert_id] * 3 + 1] += tangent.y;
+      vert_tangents[ids[vert_id] * 3 + 2] += tangent.z;
+    }
+  }
+
+  // normalize tangents
+  for (int i = 0; i < (int)vert_tangents.size(); i = i + 3) {
+
+    glm::vec3 to_norm(vert_tangents[i], vert_tangents[i + 1],
+                      vert_tangents[i + 2]);
+    to_norm = glm::normalize(to_norm);
+    vert_tangents[i] = to_norm.x;
+    vert_tangents[i + 1] = to_norm.y;
+    vert_tangents[i + 2] = to_norm.z;
+  }
+
+  for (size_t i = 0; i < vert_tangents.size(); i += 3) {
+    glm::vec3 normal(mesh_normals[i], mesh_normals[i + 1], mesh_normals[i + 2]);
+    glm::vec3 tangent(vert_tangents[i], vert_tangents[i + 1],
+                      vert_tangents[i + 2]);
+
+    // Orthogonalize tangent
+    tangent -= normal * glm::dot(normal, tangent);
+    tangent = glm::normalize(tangent);
+
+    // Recalculate bitangent
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    vert_tangents[i] = tangent.x;
+    vert_tangents[i + 1] = tangent.y;
+    vert_tangents[i + 2] = tangent.z;
+
+    vert_binormals[i] = bitangent.x;
+    vert_binormals[i + 1] = bitangent.y;
+    vert_binormals[i + 2] = bitangent.z;
+  }
+
+  return_glob.vert_binormals = std::move(vert_binormals);
+  return_glob.vert_tangents = std::move(vert_tangents);
+
+  return return_glob;
+}
+
+////////////////////////////////////
+// welding + vertex -> triangle map
+////////////////////////////////////
+
+static uint32_t get_position_bits(float value) {
+  // -0 and 0 are the same spot
+  if (value == 0.0f)
+    value = 0.0f;
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+std::vector<uint32_t> weld_positions(const std::vector<float> &positions,
+                                     size_t &unique_count) {
+  size_t vertex_count = positions.size() / 3;
+  std::vector<uint32_t> remap(vertex_count);
+
+  // open addressing, slot = first vertex at that position + 1, 0 = empty
+  size_t table_size = 16;
+  while (table_size < vertex_count * 2)
+    table_size <<= 1;
+  std::vector<uint32_t> table(table_size, 0);
+  std::vector<uint32_t> keys(vertex_count * 3);
+
+  unique_count = 0;
+  for (size_t v = 0; v < vertex_count; v++) {
+    uint32_t *key = &keys[v * 3];
+    for (int c = 0; c < 3; c++)
+      key[c] = get_position_bits(positions[v * 3 + c]);
+
+    uint64_t hash = ((uint64_t)key[0] << 32 | key[1]) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 29) ^ key[2]) * 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 32;
+
+    for (size_t slot = hash & (table_size - 1);;
+         slot = (slot + 1) & (table_size - 1)) {
+      if (table[slot] == 0) {
+        table[slot] = (uint32_t)v + 1;
+        remap[v] = (uint32_t)unique_count++;
+        break;
+      }
+
+      uint32_t other = table[slot] - 1;
+      if (memcmp(&keys[other * 3], key, 3 * sizeof(uint32_t)) == 0) {
+        remap[v] = remap[other];
+        break;
+      }
+    }
+  }
+
+  return remap;
+}
+
+// triangles around every vertex (or welded position), lets the per vertex
+// sums run in parallel without atomics
+struct vertex_triangle_map {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+};
+
+static vertex_triangle_map
+build_vertex_triangle_map(const std::vector<uint32_t> &indices,
+                          const uint32_t *remap, size_t vertex_count) {
+  vertex_triangle_map map;
+  map.offsets.assign(vertex_count + 1, 0);
+  map.triangles.resize(indices.size());
+
+  for (uint32_t index : indices)
+    map.offsets[(remap ? remap[index] : index) + 1]++;
+  for (size_t v = 0; v < vertex_count; v++)
+    map.offsets[v + 1] += map.offsets[v];
+
+  std::vector<uint32_t> cursor(map.offsets.begin(), map.offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    uint32_t vertex = remap ? remap[indices[i]] : indices[i];
+    map.triangles[cursor[vertex]++] = (uint32_t)(i / 3);
+  }
+
+  return map;
+}
+
+static void run_chunked(Thread_Pool *pool, size_t count,
+                        const std::function<void(size_t, size_t)> &job) {
+  size_t chunks = (count + VERTEX_BASIS_CHUNK - 1) / VERTEX_BASIS_CHUNK;
+  if (!pool || chunks <= 1) {
+    job(0, count);
+    return;
+  }
+
+  pool->parallel_for(chunks, [&](size_t chunk) {
+    size_t begin = chunk * VERTEX_BASIS_CHUNK;
+    job(begin, std::min(count, begin + VERTEX_BASIS_CHUNK));
+  });
+}
+
+// soa scratch, one float per triangle / vertex and axis
+struct soa_vec3 {
+  std::vector<float> x, y, z;
+  void resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+  }
+};
+
+////////////////////////////////////
+// per triangle kernels
+////////////////////////////////////
+
+// sin^2 of the smallest angle a face needs for its normal to count. below
+// that the cross product is mostly rounding noise and the simd levels (fma)
+// would disagree on its direction
+static const float FACE_SLIVER_SIN_SQ = 1e-10f;
+
+// unit face normal of triangles [begin, end), zero for degenerate ones
+typedef void (*face_normal_kernel)(const float *positions,
+                                   const uint32_t *indices, size_t begin,
+                                   size_t end, float *out_x, float *out_y,
+                                   float *out_z);
+
+// uv gradient tangent (not normalized, bigger faces weigh more). zero when
+// the uvs are degenerate
+typedef void (*face_tangent_kernel)(const float *positions,
+                                    const float *tex_coords,
+                                    const uint32_t *indices, size_t begin,
+                                    size_t end, float *out_x, float *out_y,
+                                    float *out_z);
+
+static void face_normals_scalar(const float *positions,
+                                const uint32_t *indices, size_t begin,
+                                size_t end, float *out_x, float *out_y,
+                                float *out_z) {
+  for (size_t t = begin; t < end; t++) {
+    const float *p0 = positions + (size_t)indices[t * 3] * 3;
+    const float *p1 = positions + (size_t)indices[t * 3 + 1] * 3;
+    const float *p2 = positions + (size_t)indices[t * 3 + 2] * 3;
+
+    float e1x = p1[0] - p0[0], e1y = p1[1] - p0[1], e1z = p1[2] - p0[2];
+    float e2x = p2[0] - p0[0], e2y = p2[1] - p0[1], e2z = p2[2] - p0[2];
+    float cx = e1y * e2z - e1z * e2y;
+    float cy = e1z * e2x - e1x * e2z;
+    float cz = e1x * e2y - e1y * e2x;
+
+    float length_sq = cx * cx + cy * cy + cz * cz;
+    float edges_sq = (e1x * e1x + e1y * e1y + e1z * e1z) *
+                     (e2x * e2x + e2y * e2y + e2z * e2z);
+    float inv_length = length_sq > FACE_SLIVER_SIN_SQ * edges_sq
+                           ? 1.0f / std::sqrt(length_sq)
+                           : 0.0f;
+    out_x[t] = cx * inv_length;
+    out_y[t] = cy * inv_length;
+    out_z[t] = cz * inv_length;
+  }
+}
+
+static void face_tangents_scalar(const float *positions,
+                                 const float *tex_coords,
+                                 const uint32_t *indices, size_t begin,
+                                 size_t end, float *out_x, float *out_y,
+                                 float *out_z) {
+  for (size_t t = begin; t < end; t++) {
+    size_t i0 = indices[t * 3], i1 = indices[t * 3 + 1],
+           i2 = indices[t * 3 + 2];
+    const float *p0 = positions + i0 * 3;
+    const float *p1 = positions + i1 * 3;
+    const float *p2 = positions + i2 * 3;
+
+    float e1x = p1[0] - p0[0], e1y = p1[1] - p0[1], e1z = p1[2] - p0[2];
+    float e2x = p2[0] - p0[0], e2y = p2[1] - p0[1], e2z = p2[2] - p0[2];
+    float du1 = tex_coords[i1 * 2] - tex_coords[i0 * 2];
+    float dv1 = tex_coords[i1 * 2 + 1] - tex_coords[i0 * 2 + 1];
+    float du2 = tex_coords[i2 * 2] - tex_coords[i0 * 2];
+    float dv2 = tex_coords[i2 * 2 + 1] - tex_coords[i0 * 2 + 1];
+
+    float f = 1.0f / (du1 * dv2 - dv1 * du2);
+    if (!std::isfinite(f))
+      f = 0.0f;
+
+    out_x[t] = f * (dv2 * e1x - dv1 * e2x);
+    out_y[t] = f * (dv2 * e1y - dv1 * e2y);
+    out_z[t] = f * (dv2 * e1z - dv1 * e2z);
+  }
+}
+
+#if CORTEX_SIMD_X86
+
+// one axis of 4 triangle corners, sse has no gather
+CORTEX_TARGET_SSE41 static inline __m128
+load_corners_sse41(const float *stream, size_t components,
+                   const uint32_t *indices, size_t t, int corner, int axis) {
+  return _mm_setr_ps(stream[(size_t)indices[t * 3 + corner] * components + axis],
+                     stream[(size_t)indices[t * 3 + 3 + corner] * components + axis],
+                     stream[(size_t)indices[t * 3 + 6 + corner] * components + axis],
+                     stream[(size_t)indices[t * 3 + 9 + corner] * components + axis]);
+}
+
+CORTEX_TARGET_SSE41 static void
+face_normals_sse41(const float *positions, const uint32_t *indices,
+                   size_t begin, size_t end, float *out_x, float *out_y,
+                   float *out_z) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 sliver = _mm_set1_ps(FACE_SLIVER_SIN_SQ);
+
+  size_t t = begin;
+  for (; t + 4 <= end; t += 4) {
+    __m128 p0x = load_corners_sse41(positions, 3, indices, t, 0, 0);
+    __m128 p0y = load_corners_sse41(positions, 3, indices, t, 0, 1);
+    __m128 p0z = load_corners_sse41(positions, 3, indices, t, 0, 2);
+    __m128 e1x = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 0), p0x);
+    __m128 e1y = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 1), p0y);
+    __m128 e1z = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 2), p0z);
+    __m128 e2x = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 0), p0x);
+    __m128 e2y = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 1), p0y);
+    __m128 e2z = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 2), p0z);
+
+    __m128 cx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+    __m128 cy = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+    __m128 cz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+    __m128 length_sq = _mm_add_ps(_mm_mul_ps(cx, cx),
+                                  _mm_add_ps(_mm_mul_ps(cy, cy), _mm_mul_ps(cz, cz)));
+    __m128 e1_sq = _mm_add_ps(_mm_mul_ps(e1x, e1x),
+                              _mm_add_ps(_mm_mul_ps(e1y, e1y), _mm_mul_ps(e1z, e1z)));
+    __m128 e2_sq = _mm_add_ps(_mm_mul_ps(e2x, e2x),
+                              _mm_add_ps(_mm_mul_ps(e2y, e2y), _mm_mul_ps(e2z, e2z)));
+    __m128 valid = _mm_cmpgt_ps(
+        length_sq, _mm_mul_ps(sliver, _mm_mul_ps(e1_sq, e2_sq)));
+    __m128 inv_length = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(length_sq)), valid);
+
+    _mm_storeu_ps(out_x + t, _mm_mul_ps(cx, inv_length));
+    _mm_storeu_ps(out_y + t, _mm_mul_ps(cy, inv_length));
+    _mm_storeu_ps(out_z + t, _mm_mul_ps(cz, inv_length));
+  }
+
+  face_normals_scalar(positions, indices, t, end, out_x, out_y, out_z);
+}
+
+CORTEX_TARGET_SSE41 static void
+face_tangents_sse41(const float *positions, const float *tex_coords,
+                    const uint32_t *indices, size_t begin, size_t end,
+                    float *out_x, float *out_y, float *out_z) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 infinity = _mm_set1_ps(INFINITY);
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+  size_t t = begin;
+  for (; t + 4 <= end; t += 4) {
+    __m128 p0x = load_corners_sse41(positions, 3, indices, t, 0, 0);
+    __m128 p0y = load_corners_sse41(positions, 3, indices, t, 0, 1);
+    __m128 p0z = load_corners_sse41(positions, 3, indices, t, 0, 2);
+    __m128 e1x = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 0), p0x);
+    __m128 e1y = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 1), p0y);
+    __m128 e1z = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 1, 2), p0z);
+    __m128 e2x = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 0), p0x);
+    __m128 e2y = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 1), p0y);
+    __m128 e2z = _mm_sub_ps(load_corners_sse41(positions, 3, indices, t, 2, 2), p0z);
+
+    __m128 u0 = load_corners_sse41(tex_coords, 2, indices, t, 0, 0);
+    __m128 v0 = load_corners_sse41(tex_coords, 2, indices, t, 0, 1);
+    __m128 du1 = _mm_sub_ps(load_corners_sse41(tex_coords, 2, indices, t, 1, 0), u0);
+    __m128 dv1 = _mm_sub_ps(load_corners_sse41(tex_coords, 2, indices, t, 1, 1), v0);
+    __m128 du2 = _mm_sub_ps(load_corners_sse41(tex_coords, 2, indices, t, 2, 0), u0);
+    __m128 dv2 = _mm_sub_ps(load_corners_sse41(tex_coords, 2, indices, t, 2, 1), v0);
+
+    // inf / nan for degenerate uvs, those lanes end up as zero
+    __m128 f = _mm_div_ps(one, _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2)));
+    f = _mm_and_ps(f, _mm_cmplt_ps(_mm_and_ps(f, abs_mask), infinity));
+
+    _mm_storeu_ps(out_x + t, _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1x),
+                                                      _mm_mul_ps(dv1, e2x))));
+    _mm_storeu_ps(out_y + t, _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1y),
+                                                      _mm_mul_ps(dv1, e2y))));
+    _mm_storeu_ps(out_z + t, _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(dv2, e1z),
+                                                      _mm_mul_ps(dv1, e2z))));
+  }
+
+  face_tangents_scalar(positions, tex_coords, indices, t, end, out_x, out_y,
+                       out_z);
+}
+
+// element offsets of one corner for 8 consecutive triangles
+CORTEX_TARGET_AVX2 static inline __m256i
+load_corner_indices_avx2(const uint32_t *indices, size_t t, int corner) {
+  const __m256i triangle_stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  return _mm256_i32gather_epi32((const int *)(indices + t * 3 + corner),
+                                triangle_stride, 4);
+}
+
+CORTEX_TARGET_AVX2 static void
+face_normals_avx2(const float *positions, const uint32_t *indices,
+                  size_t begin, size_t end, float *out_x, float *out_y,
+                  float *out_z) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 sliver = _mm256_set1_ps(FACE_SLIVER_SIN_SQ);
+
+  size_t t = begin;
+  for (; t + 8 <= end; t += 8) {
+    __m256i o0 = load_corner_indices_avx2(indices, t, 0);
+    __m256i o1 = load_corner_indices_avx2(indices, t, 1);
+    __m256i o2 = load_corner_indices_avx2(indices, t, 2);
+    o0 = _mm256_add_epi32(_mm256_slli_epi32(o0, 1), o0);
+    o1 = _mm256_add_epi32(_mm256_slli_epi32(o1, 1), o1);
+    o2 = _mm256_add_epi32(_mm256_slli_epi32(o2, 1), o2);
+
+    __m256 p0x = _mm256_i32gather_ps(positions, o0, 4);
+    __m256 p0y = _mm256_i32gather_ps(positions + 1, o0, 4);
+    __m256 p0z = _mm256_i32gather_ps(positions + 2, o0, 4);
+    __m256 e1x = _mm256_sub_ps(_mm256_i32gather_ps(positions, o1, 4), p0x);
+    __m256 e1y = _mm256_sub_ps(_mm256_i32gather_ps(positions + 1, o1, 4), p0y);
+    __m256 e1z = _mm256_sub_ps(_mm256_i32gather_ps(positions + 2, o1, 4), p0z);
+    __m256 e2x = _mm256_sub_ps(_mm256_i32gather_ps(positions, o2, 4), p0x);
+    __m256 e2y = _mm256_sub_ps(_mm256_i32gather_ps(positions + 1, o2, 4), p0y);
+    __m256 e2z = _mm256_sub_ps(_mm256_i32gather_ps(positions + 2, o2, 4), p0z);
+
+    __m256 cx = _mm256_fmsub_ps(e1y, e2z, _mm256_mul_ps(e1z, e2y));
+    __m256 cy = _mm256_fmsub_ps(e1z, e2x, _mm256_mul_ps(e1x, e2z));
+    __m256 cz = _mm256_fmsub_ps(e1x, e2y, _mm256_mul_ps(e1y, e2x));
+
+    __m256 length_sq = _mm256_fmadd_ps(
+        cx, cx, _mm256_fmadd_ps(cy, cy, _mm256_mul_ps(cz, cz)));
+    __m256 e1_sq = _mm256_fmadd_ps(
+        e1x, e1x, _mm256_fmadd_ps(e1y, e1y, _mm256_mul_ps(e1z, e1z)));
+    __m256 e2_sq = _mm256_fmadd_ps(
+        e2x, e2x, _mm256_fmadd_ps(e2y, e2y, _mm256_mul_ps(e2z, e2z)));
+    __m256 valid = _mm256_cmp_ps(
+        length_sq, _mm256_mul_ps(sliver, _mm256_mul_ps(e1_sq, e2_sq)),
+        _CMP_GT_OQ);
+    __m256 inv_length =
+        _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length_sq)), valid);
+
+    _mm256_storeu_ps(out_x + t, _mm256_mul_ps(cx, inv_length));
+    _mm256_storeu_ps(out_y + t, _mm256_mul_ps(cy, inv_length));
+    _mm256_storeu_ps(out_z + t, _mm256_mul_ps(cz, inv_length));
+  }
+
+  face_normals_scalar(positions, indices, t, end, out_x, out_y, out_z);
+}
+
+CORTEX_TARGET_AVX2 static void
+face_tangents_avx2(const float *positions, const float *tex_coords,
+                   const uint32_t *indices, size_t begin, size_t end,
+                   float *out_x, float *out_y, float *out_z) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 infinity = _mm256_set1_ps(INFINITY);
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+  size_t t = begin;
+  for (; t + 8 <= end; t += 8) {
+    __m256i i0 = load_corner_indices_avx2(indices, t, 0);
+    __m256i i1 = load_corner_indices_avx2(indices, t, 1);
+    __m256i i2 = load_corner_indices_avx2(indices, t, 2);
+    __m256i o0 = _mm256_add_epi32(_mm256_slli_epi32(i0, 1), i0);
+    __m256i o1 = _mm256_add_epi32(_mm256_slli_epi32(i1, 1), i1);
+    __m256i o2 = _mm256_add_epi32(_mm256_slli_epi32(i2, 1), i2);
+    __m256i uv0 = _mm256_slli_epi32(i0, 1);
+    __m256i uv1 = _mm256_slli_epi32(i1, 1);
+    __m256i uv2 = _mm256_slli_epi32(i2, 1);
+
+    __m256 p0x = _mm256_i32gather_ps(positions, o0, 4);
+    __m256 p0y = _mm256_i32gather_ps(positions + 1, o0, 4);
+    __m256 p0z = _mm256_i32gather_ps(positions + 2, o0, 4);
+    __m256 e1x = _mm256_sub_ps(_mm256_i32gather_ps(positions, o1, 4), p0x);
+    __m256 e1y = _mm256_sub_ps(_mm256_i32gather_ps(positions + 1, o1, 4), p0y);
+    __m256 e1z = _mm256_sub_ps(_mm256_i32gather_ps(positions + 2, o1, 4), p0z);
+    __m256 e2x = _mm256_sub_ps(_mm256_i32gather_ps(positions, o2, 4), p0x);
+    __m256 e2y = _mm256_sub_ps(_mm256_i32gather_ps(positions + 1, o2, 4), p0y);
+    __m256 e2z = _mm256_sub_ps(_mm256_i32gather_ps(positions + 2, o2, 4), p0z);
+
+    __m256 u0 = _mm256_i32gather_ps(tex_coords, uv0, 4);
+    __m256 v0 = _mm256_i32gather_ps(tex_coords + 1, uv0, 4);
+    __m256 du1 = _mm256_sub_ps(_mm256_i32gather_ps(tex_coords, uv1, 4), u0);
+    __m256 dv1 = _mm256_sub_ps(_mm256_i32gather_ps(tex_coords + 1, uv1, 4), v0);
+    __m256 du2 = _mm256_sub_ps(_mm256_i32gather_ps(tex_coords, uv2, 4), u0);
+    __m256 dv2 = _mm256_sub_ps(_mm256_i32gather_ps(tex_coords + 1, uv2, 4), v0);
+
+    // inf / nan for degenerate uvs, those lanes end up as zero
+    __m256 f = _mm256_div_ps(one, _mm256_fmsub_ps(du1, dv2, _mm256_mul_ps(dv1, du2)));
+    f = _mm256_and_ps(f, _mm256_cmp_ps(_mm256_and_ps(f, abs_mask), infinity,
+                                       _CMP_LT_OQ));
+
+    _mm256_storeu_ps(out_x + t,
+                     _mm256_mul_ps(f, _mm256_fmsub_ps(dv2, e1x,
+                                                      _mm256_mul_ps(dv1, e2x))));
+    _mm256_storeu_ps(out_y + t,
+                     _mm256_mul_ps(f, _mm256_fmsub_ps(dv2, e1y,
+                                                      _mm256_mul_ps(dv1, e2y))));
+    _mm256_storeu_ps(out_z + t,
+                     _mm256_mul_ps(f, _mm256_fmsub_ps(dv2, e1z,
+                                                      _mm256_mul_ps(dv1, e2z))));
+  }
+
+  face_tangents_scalar(positions, tex_coords, indices, t, end, out_x, out_y,
+                       out_z);
+}
+
+#endif
+
+////////////////////////////////////
+// per vertex kernels
+////////////////////////////////////
+
+// normalizes [begin, end) of a soa stream, zero vectors become +z
+typedef void (*normalize_kernel)(float *x, float *y, float *z, size_t begin,
+                                 size_t end);
+
+// tangent -= normal * dot(normal, tangent), normalized, binormal =
+// cross(normal, tangent). normals are aos. tangents that collapse to zero
+// stay zero, fix_degenerate_tangents picks one for them
+typedef void (*orthogonalize_kernel)(const float *normals, float *tx,
+                                     float *ty, float *tz, float *bx,
+                                     float *by, float *bz, size_t begin,
+                                     size_t end);
+
+static void normalize_scalar(float *x, float *y, float *z, size_t begin,
+                             size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    float length_sq = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+    if (length_sq > 0.0f) {
+      float inv_length = 1.0f / std::sqrt(length_sq);
+      x[i] *= inv_length;
+      y[i] *= inv_length;
+      z[i] *= inv_length;
+    } else {
+      x[i] = 0.0f;
+      y[i] = 0.0f;
+      z[i] = 1.0f;
+    }
+  }
+}
+
+static void orthogonalize_scalar(const float *normals, float *tx, float *ty,
+                                 float *tz, float *bx, float *by, float *bz,
+                                 size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    float nx = normals[i * 3], ny = normals[i * 3 + 1], nz = normals[i * 3 + 2];
+    float d = nx * tx[i] + ny * ty[i] + nz * tz[i];
+    float x = tx[i] - nx * d, y = ty[i] - ny * d, z = tz[i] - nz * d;
+
+    float length_sq = x * x + y * y + z * z;
+    float inv_length = length_sq > 0.0f ? 1.0f / std::sqrt(length_sq) : 0.0f;
+    tx[i] = x * inv_length;
+    ty[i] = y * inv_length;
+    tz[i] = z * inv_length;
+
+    bx[i] = ny * tz[i] - nz * ty[i];
+    by[i] = nz * tx[i] - nx * tz[i];
+    bz[i] = nx * ty[i] - ny * tx[i];
+  }
+}
+
+#if CORTEX_SIMD_X86
+
+CORTEX_TARGET_SSE41 static void normalize_sse41(float *x, float *y, float *z,
+                                                size_t begin, size_t end) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i),
+           vz = _mm_loadu_ps(z + i);
+    __m128 length_sq = _mm_add_ps(_mm_mul_ps(vx, vx),
+                                  _mm_add_ps(_mm_mul_ps(vy, vy), _mm_mul_ps(vz, vz)));
+    __m128 valid = _mm_cmpgt_ps(length_sq, zero);
+    __m128 inv_length = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(length_sq)), valid);
+
+    _mm_storeu_ps(x + i, _mm_mul_ps(vx, inv_length));
+    _mm_storeu_ps(y + i, _mm_mul_ps(vy, inv_length));
+    _mm_storeu_ps(z + i, _mm_blendv_ps(one, _mm_mul_ps(vz, inv_length), valid));
+  }
+
+  normalize_scalar(x, y, z, i, end);
+}
+
+CORTEX_TARGET_SSE41 static void
+orthogonalize_sse41(const float *normals, float *tx, float *ty, float *tz,
+                    float *bx, float *by, float *bz, size_t begin, size_t end) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float *n = normals + i * 3;
+    __m128 nx = _mm_setr_ps(n[0], n[3], n[6], n[9]);
+    __m128 ny = _mm_setr_ps(n[1], n[4], n[7], n[10]);
+    __m128 nz = _mm_setr_ps(n[2], n[5], n[8], n[11]);
+    __m128 x = _mm_loadu_ps(tx + i), y = _mm_loadu_ps(ty + i),
+           z = _mm_loadu_ps(tz + i);
+
+    __m128 d = _mm_add_ps(_mm_mul_ps(nx, x),
+                          _mm_add_ps(_mm_mul_ps(ny, y), _mm_mul_ps(nz, z)));
+    x = _mm_sub_ps(x, _mm_mul_ps(nx, d));
+    y = _mm_sub_ps(y, _mm_mul_ps(ny, d));
+    z = _mm_sub_ps(z, _mm_mul_ps(nz, d));
+
+    __m128 length_sq = _mm_add_ps(_mm_mul_ps(x, x),
+                                  _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)));
+    __m128 inv_length = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(length_sq)),
+                                   _mm_cmpgt_ps(length_sq, zero));
+    x = _mm_mul_ps(x, inv_length);
+    y = _mm_mul_ps(y, inv_length);
+    z = _mm_mul_ps(z, inv_length);
+
+    _mm_storeu_ps(tx + i, x);
+    _mm_storeu_ps(ty + i, y);
+    _mm_storeu_ps(tz + i, z);
+    _mm_storeu_ps(bx + i, _mm_sub_ps(_mm_mul_ps(ny, z), _mm_mul_ps(nz, y)));
+    _mm_storeu_ps(by + i, _mm_sub_ps(_mm_mul_ps(nz, x), _mm_mul_ps(nx, z)));
+    _mm_storeu_ps(bz + i, _mm_sub_ps(_mm_mul_ps(nx, y), _mm_mul_ps(ny, x)));
+  }
+
+  orthogonalize_scalar(normals, tx, ty, tz, bx, by, bz, i, end);
+}
+
+CORTEX_TARGET_AVX2 static void normalize_avx2(float *x, float *y, float *z,
+                                              size_t begin, size_t end) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i),
+           vz = _mm256_loadu_ps(z + i);
+    __m256 length_sq = _mm256_fmadd_ps(
+        vx, vx, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vz, vz)));
+    __m256 valid = _mm256_cmp_ps(length_sq, zero, _CMP_GT_OQ);
+    __m256 inv_length =
+        _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length_sq)), valid);
+
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(vx, inv_length));
+    _mm256_storeu_ps(y + i, _mm256_mul_ps(vy, inv_length));
+    _mm256_storeu_ps(z + i, _mm256_blendv_ps(one, _mm256_mul_ps(vz, inv_length),
+                                             valid));
+  }
+
+  normalize_scalar(x, y, z, i, end);
+}
+
+CORTEX_TARGET_AVX2 static void
+orthogonalize_avx2(const float *normals, float *tx, float *ty, float *tz,
+                   float *bx, float *by, float *bz, size_t begin, size_t end) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256i vertex_stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const float *n = normals + i * 3;
+    __m256 nx = _mm256_i32gather_ps(n, vertex_stride, 4);
+    __m256 ny = _mm256_i32gather_ps(n + 1, vertex_stride, 4);
+    __m256 nz = _mm256_i32gather_ps(n + 2, vertex_stride, 4);
+    __m256 x = _mm256_loadu_ps(tx + i), y = _mm256_loadu_ps(ty + i),
+           z = _mm256_loadu_ps(tz + i);
+
+    __m256 d = _mm256_fmadd_ps(nx, x, _mm256_fmadd_ps(ny, y, _mm256_mul_ps(nz, z)));
+    x = _mm256_fnmadd_ps(nx, d, x);
+    y = _mm256_fnmadd_ps(ny, d, y);
+    z = _mm256_fnmadd_ps(nz, d, z);
+
+    __m256 length_sq =
+        _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+    __m256 inv_length =
+        _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length_sq)),
+                      _mm256_cmp_ps(length_sq, zero, _CMP_GT_OQ));
+    x = _mm256_mul_ps(x, inv_length);
+    y = _mm256_mul_ps(y, inv_length);
+    z = _mm256_mul_ps(z, inv_length);
+
+    _mm256_storeu_ps(tx + i, x);
+    _mm256_storeu_ps(ty + i, y);
+    _mm256_storeu_ps(tz + i, z);
+    _mm256_storeu_ps(bx + i, _mm256_fmsub_ps(ny, z, _mm256_mul_ps(nz, y)));
+    _mm256_storeu_ps(by + i, _mm256_fmsub_ps(nz, x, _mm256_mul_ps(nx, z)));
+    _mm256_storeu_ps(bz + i, _mm256_fmsub_ps(nx, y, _mm256_mul_ps(ny, x)));
+  }
+
+  orthogonalize_scalar(normals, tx, ty, tz, bx, by, bz, i, end);
+}
+
+#endif
+
+struct vertex_basis_kernels {
+  face_normal_kernel face_normals = face_normals_scalar;
+  face_tangent_kernel face_tangents = face_tangents_scalar;
+  normalize_kernel normalize = normalize_scalar;
+  orthogonalize_kernel orthogonalize = orthogonalize_scalar;
+};
+
+static vertex_basis_kernels get_vertex_basis_kernels(e_simd_level level) {
+  vertex_basis_kernels kernels;
+#if CORTEX_SIMD_X86
+  // never more than the cpu can actually run
+  level = std::min(level, get_simd_level());
+  if (level == E_SIMD_AVX2) {
+    kernels.face_normals = face_normals_avx2;
+    kernels.face_tangents = face_tangents_avx2;
+    kernels.normalize = normalize_avx2;
+    kernels.orthogonalize = orthogonalize_avx2;
+  } else if (level == E_SIMD_SSE41) {
+    kernels.face_normals = face_normals_sse41;
+    kernels.face_tangents = face_tangents_sse41;
+    kernels.normalize = normalize_sse41;
+    kernels.orthogonalize = orthogonalize_sse41;
+  }
+#endif
+  return kernels;
+}
+
+// summing per vertex in parallel needs the vertex -> triangle map, which
+// alone costs about as much as one serial scatter over the triangles. only
+// worth it with a few threads to spread the sums over
+static bool use_parallel_sums(Thread_Pool *pool, size_t triangle_count) {
+  return pool && pool->num_threads() >= 3 &&
+         triangle_count >= 4 * VERTEX_BASIS_CHUNK;
+}
+
+// sums the per triangle vectors around every vertex of [begin, end)
+static void sum_around_vertices(const vertex_triangle_map &map,
+                                const soa_vec3 &faces, soa_vec3 &out,
+                                size_t begin, size_t end) {
+  for (size_t v = begin; v < end; v++) {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (uint32_t i = map.offsets[v]; i < map.offsets[v + 1]; i++) {
+      uint32_t triangle = map.triangles[i];
+      x += faces.x[triangle];
+      y += faces.y[triangle];
+      z += faces.z[triangle];
+    }
+    out.x[v] = x;
+    out.y[v] = y;
+    out.z[v] = z;
+  }
+}
+
+// triangles per block in the serial path, small enough to stay in l1
+// between the face kernel and the scatter
+static const size_t FACE_BLOCK = 1024;
+
+// per triangle vectors from face_kernel(indices, begin, end, x, y, z)
+// summed onto every (welded) vertex. sums has to be zeroed
+template <typename Face_Kernel>
+static void sum_faces_around_vertices(const std::vector<uint32_t> &indices,
+                                      const uint32_t *remap,
+                                      size_t vertex_count, Thread_Pool *pool,
+                                      const Face_Kernel &face_kernel,
+                                      soa_vec3 &sums) {
+  size_t triangle_count = indices.size() / 3;
+
+  if (use_parallel_sums(pool, triangle_count)) {
+    soa_vec3 faces;
+    faces.resize(triangle_count);
+    run_chunked(pool, triangle_count, [&](size_t begin, size_t end) {
+      face_kernel(indices.data(), begin, end, faces.x.data(), faces.y.data(),
+                  faces.z.data());
+    });
+
+    vertex_triangle_map map =
+        build_vertex_triangle_map(indices, remap, vertex_count);
+    run_chunked(pool, vertex_count, [&](size_t begin, size_t end) {
+      sum_around_vertices(map, faces, sums, begin, end);
+    });
+    return;
+  }
+
+  soa_vec3 block;
+  block.resize(FACE_BLOCK);
+  for (size_t first = 0; first < triangle_count; first += FACE_BLOCK) {
+    size_t count = std::min(FACE_BLOCK, triangle_count - first);
+    const uint32_t *block_indices = indices.data() + first * 3;
+    face_kernel(block_indices, 0, count, block.x.data(), block.y.data(),
+                block.z.data());
+
+    for (size_t i = 0; i < count * 3; i++) {
+      uint32_t vertex = remap ? remap[block_indices[i]] : block_indices[i];
+      sums.x[vertex] += block.x[i / 3];
+      sums.y[vertex] += block.y[i / 3];
+      sums.z[vertex] += block.z[i / 3];
+    }
+  }
+}
+
+// the kernels want an index buffer, non indexed meshes get the trivial one
+static const std::vector<uint32_t> &
+get_triangle_indices(const std::vector<float> &positions,
+                     const std::vector<uint32_t> &indices,
+                     std::vector<uint32_t> &sequential) {
+  if (!indices.empty())
+    return indices;
+
+  sequential.resize(positions.size() / 9 * 3);
+  for (size_t i = 0; i < sequential.size(); i++)
+    sequential[i] = (uint32_t)i;
+  return sequential;
+}
+
+void generate_vertex_normals(const std::vector<float> &positions,
+                             const std::vector<uint32_t> &indices,
+                             std::vector<float> &normals, Thread_Pool *pool,
+                             e_simd_level level) {
+  // indices without positions would only point at nothing
+  if (positions.empty()) {
+    normals.clear();
+    return;
+  }
+
+  vertex_basis_kernels kernels = get_vertex_basis_kernels(level);
+  std::vector<uint32_t> sequential;
+  const std::vector<uint32_t> &triangle_indices =
+      get_triangle_indices(positions, indices, sequential);
+  size_t vertex_count = positions.size() / 3;
+
+  size_t unique_count = 0;
+  std::vector<uint32_t> remap = weld_positions(positions, unique_count);
+
+  soa_vec3 sums;
+  sums.resize(unique_count);
+  sum_faces_around_vertices(
+      triangle_indices, remap.data(), unique_count, pool,
+      [&](const uint32_t *face_indices, size_t begin, size_t end, float *x,
+          float *y, float *z) {
+        kernels.face_normals(positions.data(), face_indices, begin, end, x, y,
+                             z);
+      },
+      sums);
+
+  run_chunked(pool, unique_count, [&](size_t begin, size_t end) {
+    kernels.normalize(sums.x.data(), sums.y.data(), sums.z.data(), begin, end);
+  });
+
+  normals.resize(vertex_count * 3);
+  run_chunked(pool, vertex_count, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      uint32_t welded = remap[v];
+      normals[v * 3] = sums.x[welded];
+      normals[v * 3 + 1] = sums.y[welded];
+      normals[v * 3 + 2] = sums.z[welded];
+    }
+  });
+}
+
+// tangents that collapsed (no uv gradient, or parallel to the normal) get
+// any vector perpendicular to the normal, better than a nan in the shader
+static void fix_degenerate_tangent(const float *normal, float *tangent,
+                                   float *binormal) {
+  if (tangent[0] != 0.0f || tangent[1] != 0.0f || tangent[2] != 0.0f)
+    return;
+
+  glm::vec3 n(normal[0], normal[1], normal[2]);
+  glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                         : glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::vec3 t = glm::cross(axis, n);
+  float length = glm::length(t);
+  t = length > 0.0f ? t / length : axis;
+  glm::vec3 b = glm::cross(n, t);
+
+  for (int c = 0; c < 3; c++) {
+    tangent[c] = t[c];
+    binormal[c] = b[c];
+  }
+}
+
+bool generate_vertex_tangents(const std::vector<float> &positions,
+                              const std::vector<float> &normals,
+                              const std::vector<float> &tex_coords,
+                              const std::vector<uint32_t> &indices,
+                              std::vector<float> &tangents,
+                              std::vector<float> &binormals, Thread_Pool *pool,
+                              e_simd_level level) {
+  size_t vertex_count = positions.size() / 3;
+  if (normals.size() != vertex_count * 3 ||
+      tex_coords.size() != vertex_count * 2)
+    return false;
+
+  vertex_basis_kernels kernels = get_vertex_basis_kernels(level);
+  std::vector<uint32_t> sequential;
+  const std::vector<uint32_t> &triangle_indices =
+      get_triangle_indices(positions, indices, sequential);
+
+  soa_vec3 sums, cross;
+  sums.resize(vertex_count);
+  cross.resize(vertex_count);
+  sum_faces_around_vertices(
+      triangle_indices, nullptr, vertex_count, pool,
+      [&](const uint32_t *face_indices, size_t begin, size_t end, float *x,
+          float *y, float *z) {
+        kernels.face_tangents(positions.data(), tex_coords.data(),
+                              face_indices, begin, end, x, y, z);
+      },
+      sums);
+
+  tangents.resize(vertex_count * 3);
+  binormals.resize(vertex_count * 3);
+  run_chunked(pool, vertex_count, [&](size_t begin, size_t end) {
+    kernels.orthogonalize(normals.data(), sums.x.data(), sums.y.data(),
+                          sums.z.data(), cross.x.data(), cross.y.data(),
+                          cross.z.data(), begin, end);
+
+    for (size_t v = begin; v < end; v++) {
+      float *tangent = &tangents[v * 3];
+      float *binormal = &binormals[v * 3];
+      tangent[0] = sums.x[v];
+      tangent[1] = sums.y[v];
+      tangent[2] = sums.z[v];
+      binormal[0] = cross.x[v];
+      binormal[1] = cross.y[v];
+      binormal[2] = cross.z[v];
+      fix_degenerate_tangent(&normals[v * 3], tangent, binormal);
+    }
+  });
+
+  return true;
+}
+
+////////////////////////////////////
+// benchmark
+////////////////////////////////////
+
+// uv sphere with a duplicated seam column, so welding has something to do
+static void build_benchmark_sphere(size_t rings, size_t segments,
+                                   std::vector<float> &positions,
+                                   std::vector<float> &tex_coords,
+                                   std::vector<uint32_t> &indices) {
+  for (size_t r = 0; r <= rings; r++) {
+    float theta = (float)r / rings * 3.14159265f;
+    for (size_t s = 0; s <= segments; s++) {
+      float phi = (float)(s % segments) / segments * 6.28318531f;
+      positions.push_back(std::sin(theta) * std::cos(phi));
+      positions.push_back(std::cos(theta));
+      positions.push_back(std::sin(theta) * std::sin(phi));
+      tex_coords.push_back((float)s / segments);
+      tex_coords.push_back((float)r / rings);
+    }
+  }
+
+  for (size_t r = 0; r < rings; r++) {
+    for (size_t s = 0; s < segments; s++) {
+      uint32_t a = (uint32_t)(r * (segments + 1) + s);
+      uint32_t b = a + (uint32_t)(segments + 1);
+      indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+    }
+  }
+}
+
+static float max_difference(const std::vector<float> &a,
+                            const std::vector<float> &b) {
+  float difference = 0.0f;
+  for (size_t i = 0; i < a.size() && i < b.size(); i++)
+    difference = std::max(difference, std::fabs(a[i] - b[i]));
+  return difference;
+}
+
+void benchmark_vertex_basis(Thread_Pool &pool) {
+  std::vector<float> positions, tex_coords;
+  std::vector<uint32_t> indices;
+  build_benchmark_sphere(512, 1024, positions, tex_coords, indices);
+
+  size_t triangle_count = indices.size() / 3;
+  log_success("vertex basis benchmark: " + std::to_string(triangle_count) +
+              " triangles, " + std::to_string(positions.size() / 3) +
+              " vertices, cpu supports " +
+              get_simd_level_name(get_simd_level()));
+
+  using clock = std::chrono::steady_clock;
+  auto ms_since = [](clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock::now() - start)
+        .count();
+  };
+
+  clock::time_point start = clock::now();
+  std::vector<float> reference_normals =
+      calculate_vert_normals(positions, indices);
+  double reference_normals_ms = ms_since(start);
+
+  start = clock::now();
+  tan_bin_glob reference_tangents =
+      calculate_vert_tan_bin(positions, reference_normals, tex_coords, indices);
+  double reference_tangents_ms = ms_since(start);
+
+  log_debug_sub("scalar reference: normals " +
+                std::to_string(reference_normals_ms) + " ms, tangents " +
+                std::to_string(reference_tangents_ms) + " ms");
+
+  std::vector<float> baseline_normals, baseline_tangents;
+  for (int level = E_SIMD_SCALAR; level <= get_simd_level(); level++) {
+    for (Thread_Pool *run_pool : {(Thread_Pool *)nullptr, &pool}) {
+      std::vector<float> normals, tangents, binormals;
+
+      start = clock::now();
+      generate_vertex_normals(positions, indices, normals, run_pool,
+                              (e_simd_level)level);
+      double normals_ms = ms_since(start);
+
+      start = clock::now();
+      generate_vertex_tangents(positions, normals, tex_coords, indices,
+                               tangents, binormals, run_pool,
+                               (e_simd_level)level);
+      double tangents_ms = ms_since(start);
+
+      if (baseline_normals.empty()) {
+        baseline_normals = normals;
+        baseline_tangents = tangents;
+      }
+
+      double speedup = (reference_normals_ms + reference_tangents_ms) /
+                       std::max(normals_ms + tangents_ms, 1e-6);
+      log_debug_sub(
+          std::string(get_simd_level_name((e_simd_level)level)) +
+          (run_pool ? ", " + std::to_string(pool.num_threads()) + " threads"
+                    : ", 1 thread") +
+          ": normals " + std::to_string(normals_ms) + " ms, tangents " +
+          std::to_string(tangents_ms) + " ms (" + std::to_string(speedup) +
+          "x), max deviation from scalar " +
+          std::to_string(std::max(max_difference(normals, baseline_normals),
+                                  max_difference(tangents, baseline_tangents))));
+    }
+  }
+}
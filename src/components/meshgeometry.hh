@@ -0,0 +1,79 @@
+#pragma once
+
+#include "simd.hh"
+#include "threadpool.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// per vertex normals / tangents for meshes that come without them. all
+// streams are flat float arrays like in Mesh, indices may be empty (then
+// every 3 vertices are a triangle, like glDrawArrays)
+
+struct tan_bin_glob {
+
+  std::vector<float> vert_tangents;
+  std::vector<float> vert_binormals;
+};
+
+// fetches the three vertex ids of a triangle. without an index buffer the
+// vertices are consumed in order like glDrawArrays would
+inline void get_triangle_vertex_ids(const std::vector<uint32_t> &mesh_indices,
+                                    size_t triangle, uint32_t ids[3]) {
+  for (int corner = 0; corner < 3; corner++) {
+    if (mesh_indices.empty())
+      ids[corner] = (uint32_t)(triangle * 3 + corner);
+    else
+      ids[corner] = mesh_indices[triangle * 3 + corner];
+  }
+}
+
+inline size_t get_triangle_count(const std::vector<float> &mesh_vertices,
+                                 const std::vector<uint32_t> &mesh_indices) {
+  if (mesh_indices.empty())
+    return mesh_vertices.size() / 9;
+  return mesh_indices.size() / 3;
+}
+
+// old scalar versions, kept as reference for benchmark_vertex_basis
+std::vector<float>
+calculate_vert_normals(const std::vector<float> &mesh_vertices,
+                       const std::vector<uint32_t> &mesh_indices);
+tan_bin_glob calculate_vert_tan_bin(const std::vector<float> &mesh_vertices,
+                                    const std::vector<float> &mesh_normals,
+                                    const std::vector<float> &texture_coordinates,
+                                    const std::vector<uint32_t> &mesh_indices);
+
+// triangles per task when a pool is given, smaller meshes run inline
+static const size_t VERTEX_BASIS_CHUNK = 16384;
+
+// vertex -> id shared by every vertex with bit identical position (-0 == 0).
+// ids are dense, unique_count gets the number of distinct positions
+std::vector<uint32_t> weld_positions(const std::vector<float> &positions,
+                                     size_t &unique_count);
+
+// smooth normals, averaged over every face touching the same position so
+// uv / material seams dont show up as hard edges. no positions, no normals
+void generate_vertex_normals(const std::vector<float> &positions,
+                             const std::vector<uint32_t> &indices,
+                             std::vector<float> &normals,
+                             Thread_Pool *pool = nullptr,
+                             e_simd_level level = get_simd_level());
+
+// tangents from the uv gradients, orthogonalized against the normals.
+// binormals = cross(normal, tangent). not welded, uv seams need their own.
+// false (nothing written) if normals / tex_coords dont match the vertices
+bool generate_vertex_tangents(const std::vector<float> &positions,
+                              const std::vector<float> &normals,
+                              const std::vector<float> &tex_coords,
+                              const std::vector<uint32_t> &indices,
+                              std::vector<float> &tangents,
+                              std::vector<float> &binormals,
+                              Thread_Pool *pool = nullptr,
+                              e_simd_level level = get_simd_level());
+
+// synthetic uv sphere through the scalar reference and every simd level
+// this cpu has, single threaded and on the pool. results go to the log
+void benchmark_vertex_basis(Thread_Pool &pool);
@@ -0,0 +1,1327 @@
+#include "meshimport.hh"
+#include "importer.hh"
+#include "logging.hh"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// stdlib
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace importer {
+
+// smallest piece of a file handed to a worker, below that splitting costs
+// more than it brings
+static const size_t MESH_FILE_CHUNK = 1 << 20;
+
+// elements per task for the passes over parsed data (resolve, weld, gather)
+static const size_t MESH_ELEMENT_CHUNK = 1 << 16;
+
+using import_clock = std::chrono::steady_clock;
+
+static double get_elapsed_ms(import_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(import_clock::now() - start)
+      .count();
+}
+
+// job(begin, end, chunk) over [0, count) in MESH_ELEMENT_CHUNK pieces
+static void run_element_chunks(
+    Thread_Pool &pool, size_t count,
+    const std::function<void(size_t, size_t, size_t)> &job) {
+  size_t chunks = (count + MESH_ELEMENT_CHUNK - 1) / MESH_ELEMENT_CHUNK;
+  if (chunks <= 1) {
+    job(0, count, 0);
+    return;
+  }
+
+  pool.parallel_for(chunks, [&](size_t chunk) {
+    size_t begin = chunk * MESH_ELEMENT_CHUNK;
+    job(begin, std::min(count, begin + MESH_ELEMENT_CHUNK), chunk);
+  });
+}
+
+////////////////////////////////////
+// number scanning
+
+static inline bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline void skip_spaces(const char *&p, const char *end) {
+  while (p < end && is_space(*p))
+    p++;
+}
+
+// length of the run of digits at p, 16 bytes per step where the buffer
+// has them
+static inline size_t count_digits(const char *p, const char *end) {
+  const char *start = p;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  while (end - p >= 16) {
+    __m128i bytes =
+        _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p), zero);
+    // digits end up as 0..9, everything else wraps around above that
+    __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(bytes, nine), bytes);
+    unsigned other = ~(unsigned)_mm_movemask_epi8(digits) & 0xFFFF;
+    if (other)
+      return (size_t)(p - start) + __builtin_ctz(other);
+    p += 16;
+  }
+#endif
+  while (p < end && is_digit(*p))
+    p++;
+  return (size_t)(p - start);
+}
+
+// eight ascii digits in one go (swar, little endian)
+static inline uint64_t parse_eight_digits(const char *p) {
+  uint64_t value;
+  memcpy(&value, p, 8);
+  value = (value & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+  value = (value & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+  return (value & 0x0000FFFF0000FFFF) * 42949672960001 >> 32;
+}
+
+// appends count digits to value, the caller keeps it below 20 digits
+static inline void accumulate_digits(const char *p, size_t count,
+                                     uint64_t &value) {
+  for (; count >= 8; count -= 8, p += 8)
+    value = value * 100000000 + parse_eight_digits(p);
+  for (; count > 0; count--, p++)
+    value = value * 10 + (uint64_t)(*p - '0');
+}
+
+static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+// everything parse_float cant do exactly (long mantissas, big exponents,
+// nan / inf) goes through strtof on a terminated copy
+static bool parse_float_slow(const char *&p, const char *end, float &out) {
+  char buffer[64];
+  size_t length = std::min((size_t)(end - p), sizeof(buffer) - 1);
+  memcpy(buffer, p, length);
+  buffer[length] = '\0';
+
+  char *number_end = nullptr;
+  out = strtof(buffer, &number_end);
+  if (number_end == buffer)
+    return false;
+
+  p += number_end - buffer;
+  return true;
+}
+
+// "-12.5e-3" style number at p, p is left behind it. up to 19 significant
+// digits and exponents within +-22 are exact in one double operation,
+// which covers about every number an exporter writes
+static bool parse_float(const char *&p, const char *end, float &out) {
+  const char *q = p;
+  bool negative = false;
+  if (q < end && (*q == '-' || *q == '+'))
+    negative = *q++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+
+  // leading zeros dont count against the 19 digits
+  const char *integer_start = q;
+  while (q < end && *q == '0')
+    q++;
+  size_t digits = count_digits(q, end);
+  bool any_digits = q > integer_start || digits > 0;
+  if (digits > 19)
+    return parse_float_slow(p, end, out);
+  accumulate_digits(q, digits, mantissa);
+  q += digits;
+
+  if (q < end && *q == '.') {
+    const char *fraction_start = ++q;
+    if (digits == 0)
+      while (q < end && *q == '0')
+        q++;
+
+    size_t fraction_digits = count_digits(q, end);
+    any_digits = any_digits || q > fraction_start || fraction_digits > 0;
+    if (digits + fraction_digits > 19)
+      return parse_float_slow(p, end, out);
+
+    accumulate_digits(q, fraction_digits, mantissa);
+    q += fraction_digits;
+    exponent = -(int)(q - fraction_start);
+  }
+
+  if (!any_digits)
+    return parse_float_slow(p, end, out);
+
+  if (q < end && (*q == 'e' || *q == 'E')) {
+    const char *r = q + 1;
+    bool exponent_negative = false;
+    if (r < end && (*r == '-' || *r == '+'))
+      exponent_negative = *r++ == '-';
+
+    size_t exponent_digits = count_digits(r, end);
+    if (exponent_digits > 4)
+      return parse_float_slow(p, end, out);
+
+    // "1e" without digits just ends at the e
+    if (exponent_digits > 0) {
+      uint64_t value = 0;
+      accumulate_digits(r, exponent_digits, value);
+      exponent += exponent_negative ? -(int)value : (int)value;
+      q = r + exponent_digits;
+    }
+  }
+
+  if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+    return parse_float_slow(p, end, out);
+
+  double value = (double)mantissa;
+  value = exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+  out = (float)(negative ? -value : value);
+  p = q;
+  return true;
+}
+
+static bool parse_int(const char *&p, const char *end, int64_t &out) {
+  const char *q = p;
+  bool negative = false;
+  if (q < end && (*q == '-' || *q == '+'))
+    negative = *q++ == '-';
+
+  size_t digits = count_digits(q, end);
+  if (digits == 0 || digits > 18)
+    return false;
+
+  uint64_t value = 0;
+  accumulate_digits(q, digits, value);
+  out = negative ? -(int64_t)value : (int64_t)value;
+  p = q + digits;
+  return true;
+}
+
+// [begin, end) pieces of about chunk_size that end on a line break
+static std::vector<std::pair<const char *, const char *>>
+split_lines(const char *data, size_t size, size_t chunk_size) {
+  std::vector<std::pair<const char *, const char *>> chunks;
+  const char *end = data + size;
+  const char *begin = data;
+
+  while (begin < end) {
+    const char *split = begin + std::min(chunk_size, (size_t)(end - begin));
+    if (split < end) {
+      const char *line_end =
+          (const char *)memchr(split, '\n', (size_t)(end - split));
+      split = line_end ? line_end + 1 : end;
+    }
+    chunks.push_back({begin, split});
+    begin = split;
+  }
+
+  return chunks;
+}
+
+static size_t get_file_chunk_size(Thread_Pool &pool, size_t size) {
+  size_t workers = pool.num_threads() + 1;
+  return std::max(MESH_FILE_CHUNK, size / (workers * 4) + 1);
+}
+
+static std::string get_file_stem(const std::string &file_path) {
+  return std::filesystem::path(file_path).stem().string();
+}
+
+////////////////////////////////////
+// obj
+
+// indices as written in the file: 1 based, negative = relative, 0 = not
+// given
+struct obj_corner {
+  int32_t position;
+  int32_t texcoord;
+  int32_t normal;
+};
+
+// a face with negative indices, those count back from the element counts
+// (of its chunk) right before it
+struct obj_relative_face {
+  size_t corner_begin;
+  size_t corner_end;
+  size_t positions;
+  size_t texcoords;
+  size_t normals;
+};
+
+struct obj_group_start {
+  size_t corner;
+  std::string name;
+};
+
+struct obj_chunk {
+  const char *begin;
+  const char *end;
+
+  std::vector<float> positions;
+  std::vector<float> texcoords;
+  std::vector<float> normals;
+  // 3 per triangle, polygons are fanned
+  std::vector<obj_corner> corners;
+  std::vector<obj_relative_face> relative_faces;
+  std::vector<obj_group_start> groups;
+  size_t bad_lines = 0;
+
+  // where this chunks elements start in the whole file
+  size_t position_base = 0;
+  size_t texcoord_base = 0;
+  size_t normal_base = 0;
+  size_t corner_base = 0;
+};
+
+// 0 based, -1 = not given / out of range
+struct obj_vertex_ref {
+  int32_t position;
+  int32_t texcoord;
+  int32_t normal;
+};
+
+// count floats, missing ones after the first required stay 0. always
+// appends so the element numbering stays right even for broken lines
+static bool parse_obj_floats(const char *p, const char *end, int count,
+                             int required, std::vector<float> &out) {
+  float values[3] = {0.0f, 0.0f, 0.0f};
+  bool ok = true;
+  for (int i = 0; i < count; i++) {
+    skip_spaces(p, end);
+    if (!parse_float(p, end, values[i])) {
+      values[i] = 0.0f;
+      ok = i >= required;
+      break;
+    }
+  }
+
+  out.insert(out.end(), values, values + count);
+  return ok;
+}
+
+static bool parse_obj_face(const char *p, const char *end, obj_chunk &chunk) {
+  size_t corner_begin = chunk.corners.size();
+  obj_corner first = {0, 0, 0}, previous = {0, 0, 0};
+  int corner_count = 0;
+  bool relative = false;
+
+  while (true) {
+    skip_spaces(p, end);
+    if (p >= end || *p == '#')
+      break;
+
+    obj_corner corner = {0, 0, 0};
+    int64_t value = 0;
+    if (!parse_int(p, end, value) || value == 0) {
+      chunk.corners.resize(corner_begin);
+      return false;
+    }
+    corner.position = (int32_t)value;
+
+    // v, v/vt, v//vn, v/vt/vn
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        if (!parse_int(p, end, value)) {
+          chunk.corners.resize(corner_begin);
+          return false;
+        }
+        corner.texcoord = (int32_t)value;
+      }
+      if (p < end && *p == '/') {
+        p++;
+        if (!parse_int(p, end, value)) {
+          chunk.corners.resize(corner_begin);
+          return false;
+        }
+        corner.normal = (int32_t)value;
+      }
+    }
+
+    relative = relative || corner.position < 0 || corner.texcoord < 0 ||
+               corner.normal < 0;
+
+    if (corner_count == 0)
+      first = corner;
+    else if (corner_count >= 2) {
+      chunk.corners.push_back(first);
+      chunk.corners.push_back(previous);
+      chunk.corners.push_back(corner);
+    }
+    previous = corner;
+    corner_count++;
+  }
+
+  // points and lines arent triangles
+  if (corner_count < 3)
+    return false;
+
+  if (relative)
+    chunk.relative_faces.push_back(
+        {corner_begin, chunk.corners.size(), chunk.positions.size() / 3,
+         chunk.texcoords.size() / 2, chunk.normals.size() / 3});
+  return true;
+}
+
+static std::string get_obj_name(const char *p, const char *end) {
+  skip_spaces(p, end);
+  while (end > p && is_space(end[-1]))
+    end--;
+  return std::string(p, end);
+}
+
+static void parse_obj_chunk(obj_chunk &chunk) {
+  const char *p = chunk.begin;
+
+  while (p < chunk.end) {
+    const char *line_end =
+        (const char *)memchr(p, '\n', (size_t)(chunk.end - p));
+    if (!line_end)
+      line_end = chunk.end;
+
+    skip_spaces(p, line_end);
+    size_t length = (size_t)(line_end - p);
+    bool ok = true;
+
+    if (length >= 2 && p[0] == 'v' && is_space(p[1]))
+      ok = parse_obj_floats(p + 2, line_end, 3, 3, chunk.positions);
+    else if (length >= 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2]))
+      ok = parse_obj_floats(p + 3, line_end, 2, 1, chunk.texcoords);
+    else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && is_space(p[2]))
+      ok = parse_obj_floats(p + 3, line_end, 3, 3, chunk.normals);
+    else if (length >= 2 && p[0] == 'f' && is_space(p[1]))
+      ok = parse_obj_face(p + 2, line_end, chunk);
+    else if (length >= 2 && (p[0] == 'o' || p[0] == 'g') && is_space(p[1]))
+      chunk.groups.push_back(
+          {chunk.corners.size(), get_obj_name(p + 2, line_end)});
+    else if (length >= 7 && memcmp(p, "usemtl", 6) == 0 && is_space(p[6]))
+      chunk.groups.push_back(
+          {chunk.corners.size(), get_obj_name(p + 7, line_end)});
+
+    if (!ok)
+      chunk.bad_lines++;
+    p = line_end + 1;
+  }
+}
+
+static inline int32_t resolve_obj_index(int32_t raw, size_t base,
+                                        size_t local_count, size_t total) {
+  int64_t index;
+  if (raw > 0)
+    index = (int64_t)raw - 1;
+  else if (raw < 0)
+    index = (int64_t)(base + local_count) + raw;
+  else
+    return -1;
+
+  return index >= 0 && index < (int64_t)total ? (int32_t)index : -1;
+}
+
+// raw corners of one chunk -> 0 based refs into the merged streams.
+// triangles with a broken position get position -1 on every corner
+static size_t resolve_obj_chunk(const obj_chunk &chunk, size_t position_count,
+                                size_t texcoord_count, size_t normal_count,
+                                obj_vertex_ref *out) {
+  size_t invalid_triangles = 0;
+  size_t next_relative = 0;
+
+  for (size_t i = 0; i < chunk.corners.size(); i += 3) {
+    while (next_relative < chunk.relative_faces.size() &&
+           chunk.relative_faces[next_relative].corner_end <= i)
+      next_relative++;
+
+    // counts before the face, only needed for negative indices
+    size_t positions = 0, texcoords = 0, normals = 0;
+    if (next_relative < chunk.relative_faces.size() &&
+        chunk.relative_faces[next_relative].corner_begin <= i) {
+      const obj_relative_face &face = chunk.relative_faces[next_relative];
+      positions = face.positions;
+      texcoords = face.texcoords;
+      normals = face.normals;
+    }
+
+    bool valid = true;
+    for (size_t c = i; c < i + 3; c++) {
+      const obj_corner &corner = chunk.corners[c];
+      obj_vertex_ref &ref = out[c];
+      ref.position = resolve_obj_index(corner.position, chunk.position_base,
+                                       positions, position_count);
+      ref.texcoord = resolve_obj_index(corner.texcoord, chunk.texcoord_base,
+                                       texcoords, texcoord_count);
+      ref.normal = resolve_obj_index(corner.normal, chunk.normal_base,
+                                     normals, normal_count);
+      valid = valid && ref.position >= 0;
+    }
+
+    if (!valid) {
+      for (size_t c = i; c < i + 3; c++)
+        out[c].position = -1;
+      invalid_triangles++;
+    }
+  }
+
+  return invalid_triangles;
+}
+
+static inline uint32_t hash_vertex_ref(const obj_vertex_ref &ref) {
+  uint64_t hash = ((uint64_t)(uint32_t)ref.position << 32 |
+                   (uint32_t)ref.texcoord) *
+                  0x9E3779B97F4A7C15ull;
+  hash = (hash ^ (hash >> 29) ^ (uint32_t)ref.normal) * 0xBF58476D1CE4E5B9ull;
+  return (uint32_t)(hash >> 32);
+}
+
+static inline bool same_vertex_ref(const obj_vertex_ref &a,
+                                   const obj_vertex_ref &b) {
+  return a.position == b.position && a.texcoord == b.texcoord &&
+         a.normal == b.normal;
+}
+
+static const uint32_t WELD_EMPTY = UINT32_MAX;
+
+// finds the first corner with the same ref for every corner of one hash
+// partition. first[i] = i for corners that start a new vertex
+static void weld_partition(const obj_vertex_ref *corners,
+                           const uint32_t *hashes, size_t count,
+                           uint32_t partition, uint32_t partition_count,
+                           uint32_t *first) {
+  size_t capacity = 1024;
+  while (capacity < count / partition_count / 2)
+    capacity <<= 1;
+
+  std::vector<uint32_t> table(capacity, WELD_EMPTY);
+  size_t mask = capacity - 1;
+  size_t used = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t hash = hashes[i];
+    if ((uint32_t)(((uint64_t)hash * partition_count) >> 32) != partition)
+      continue;
+
+    size_t slot = hash & mask;
+    while (table[slot] != WELD_EMPTY &&
+           !same_vertex_ref(corners[table[slot]], corners[i]))
+      slot = (slot + 1) & mask;
+
+    if (table[slot] != WELD_EMPTY) {
+      first[i] = table[slot];
+      continue;
+    }
+
+    table[slot] = (uint32_t)i;
+    first[i] = (uint32_t)i;
+
+    // keep it at most half full
+    if (++used * 2 > capacity) {
+      std::vector<uint32_t> grown(capacity * 2, WELD_EMPTY);
+      size_t grown_mask = capacity * 2 - 1;
+      for (uint32_t corner : table) {
+        if (corner == WELD_EMPTY)
+          continue;
+        size_t grown_slot = hashes[corner] & grown_mask;
+        while (grown[grown_slot] != WELD_EMPTY)
+          grown_slot = (grown_slot + 1) & grown_mask;
+        grown[grown_slot] = corner;
+      }
+      table.swap(grown);
+      capacity *= 2;
+      mask = grown_mask;
+    }
+  }
+}
+
+// corner -> vertex id, ids in order of first use. every thread owns a slice
+// of the hash range, so no locks and the result doesnt depend on the
+// thread count. vertex_corners gets the first corner of every vertex
+static void weld_obj_corners(const obj_vertex_ref *corners, size_t count,
+                             Thread_Pool &pool,
+                             std::vector<uint32_t> &vertex_of_corner,
+                             std::vector<uint32_t> &vertex_corners) {
+  std::vector<uint32_t> hashes(count);
+  run_element_chunks(pool, count, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; i++)
+      hashes[i] = hash_vertex_ref(corners[i]);
+  });
+
+  uint32_t partitions = 1;
+  if (count >= 4 * MESH_ELEMENT_CHUNK)
+    partitions = std::min(pool.num_threads() + 1, 16u);
+
+  std::vector<uint32_t> first(count);
+  pool.parallel_for(partitions, [&](size_t partition) {
+    weld_partition(corners, hashes.data(), count, (uint32_t)partition,
+                   partitions, first.data());
+  });
+
+  // new vertices get numbered by a prefix sum over the chunks, the others
+  // copy the id of their first corner
+  size_t chunks = (count + MESH_ELEMENT_CHUNK - 1) / MESH_ELEMENT_CHUNK;
+  std::vector<size_t> chunk_vertices(std::max(chunks, (size_t)1), 0);
+  run_element_chunks(pool, count, [&](size_t begin, size_t end, size_t chunk) {
+    for (size_t i = begin; i < end; i++)
+      chunk_vertices[chunk] += first[i] == i;
+  });
+
+  size_t vertex_count = 0;
+  for (size_t &vertices : chunk_vertices) {
+    size_t chunk_first = vertex_count;
+    vertex_count += vertices;
+    vertices = chunk_first;
+  }
+
+  vertex_of_corner.resize(count);
+  vertex_corners.resize(vertex_count);
+  run_element_chunks(pool, count, [&](size_t begin, size_t end, size_t chunk) {
+    uint32_t vertex = (uint32_t)chunk_vertices[chunk];
+    for (size_t i = begin; i < end; i++) {
+      if (first[i] != i)
+        continue;
+      vertex_corners[vertex] = (uint32_t)i;
+      vertex_of_corner[i] = vertex++;
+    }
+  });
+  run_element_chunks(pool, count, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; i++)
+      if (first[i] != i)
+        vertex_of_corner[i] = vertex_of_corner[first[i]];
+  });
+}
+
+// one obj group (o / g / usemtl range) welded into an indexed mesh
+static void build_obj_mesh(std::vector<obj_vertex_ref> &refs, size_t begin,
+                           size_t end, const std::vector<float> &positions,
+                           const std::vector<float> &texcoords,
+                           const std::vector<float> &normals,
+                           Thread_Pool &pool, imported_mesh &mesh) {
+  size_t count = end - begin;
+  obj_vertex_ref *corners = refs.data() + begin;
+
+  // texcoords if any corner has one, normals only if every corner has one,
+  // half normalled meshes get them generated instead
+  size_t chunks = (count + MESH_ELEMENT_CHUNK - 1) / MESH_ELEMENT_CHUNK;
+  std::vector<uint8_t> any_texcoords(std::max(chunks, (size_t)1), 0);
+  std::vector<uint8_t> all_normals(std::max(chunks, (size_t)1), 1);
+  std::vector<uint8_t> any_invalid(std::max(chunks, (size_t)1), 0);
+  run_element_chunks(pool, count, [&](size_t first, size_t last, size_t chunk) {
+    for (size_t i = first; i < last; i++) {
+      any_texcoords[chunk] |= corners[i].texcoord >= 0;
+      all_normals[chunk] &= corners[i].normal >= 0;
+      any_invalid[chunk] |= corners[i].position < 0;
+    }
+  });
+
+  bool has_texcoords = std::find(any_texcoords.begin(), any_texcoords.end(),
+                                 1) != any_texcoords.end();
+  bool has_normals = std::find(all_normals.begin(), all_normals.end(), 0) ==
+                     all_normals.end();
+  bool has_invalid = std::find(any_invalid.begin(), any_invalid.end(), 1) !=
+                     any_invalid.end();
+
+  // fields that dont make it into the mesh mustnt split vertices either
+  run_element_chunks(pool, count, [&](size_t first, size_t last, size_t) {
+    for (size_t i = first; i < last; i++) {
+      if (!has_texcoords)
+        corners[i].texcoord = -1;
+      if (!has_normals)
+        corners[i].normal = -1;
+    }
+  });
+
+  // broken triangles are rare, only then the group gets compacted
+  std::vector<obj_vertex_ref> compacted;
+  if (has_invalid) {
+    compacted.reserve(count);
+    for (size_t i = 0; i < count; i += 3)
+      if (corners[i].position >= 0)
+        compacted.insert(compacted.end(), corners + i, corners + i + 3);
+    corners = compacted.data();
+    count = compacted.size();
+  }
+
+  std::vector<uint32_t> vertex_corners;
+  weld_obj_corners(corners, count, pool, mesh.indices, vertex_corners);
+
+  size_t vertex_count = vertex_corners.size();
+  mesh.positions.resize(vertex_count * 3);
+  if (has_texcoords)
+    mesh.texcoords.resize(vertex_count * 2);
+  if (has_normals)
+    mesh.normals.resize(vertex_count * 3);
+
+  run_element_chunks(pool, vertex_count, [&](size_t first, size_t last, size_t) {
+    for (size_t v = first; v < last; v++) {
+      const obj_vertex_ref &ref = corners[vertex_corners[v]];
+      memcpy(&mesh.positions[v * 3], &positions[(size_t)ref.position * 3],
+             3 * sizeof(float));
+      if (has_texcoords && ref.texcoord >= 0)
+        memcpy(&mesh.texcoords[v * 2], &texcoords[(size_t)ref.texcoord * 2],
+               2 * sizeof(float));
+      if (has_normals)
+        memcpy(&mesh.normals[v * 3], &normals[(size_t)ref.normal * 3],
+               3 * sizeof(float));
+    }
+  });
+}
+
+bool load_obj_file(const std::string &file_path, Thread_Pool &pool,
+                   std::vector<imported_mesh> &meshes,
+                   mesh_file_stats &stats) {
+  auto start = import_clock::now();
+
+  Mapped_File file;
+  if (!file.open(file_path)) {
+    log_error("couldnt map obj file: " + file_path);
+    return false;
+  }
+  stats.file_bytes = file.size();
+
+  // phase 1: every chunk parsed on its own, indices stay raw
+  const char *data = (const char *)file.data();
+  std::vector<obj_chunk> chunks;
+  for (auto &range :
+       split_lines(data, file.size(), get_file_chunk_size(pool, file.size())))
+    chunks.push_back({range.first, range.second});
+
+  pool.parallel_for(chunks.size(),
+                    [&](size_t chunk) { parse_obj_chunk(chunks[chunk]); });
+
+  size_t position_count = 0, texcoord_count = 0, normal_count = 0;
+  size_t corner_count = 0, bad_lines = 0;
+  for (obj_chunk &chunk : chunks) {
+    chunk.position_base = position_count;
+    chunk.texcoord_base = texcoord_count;
+    chunk.normal_base = normal_count;
+    chunk.corner_base = corner_count;
+    position_count += chunk.positions.size() / 3;
+    texcoord_count += chunk.texcoords.size() / 2;
+    normal_count += chunk.normals.size() / 3;
+    corner_count += chunk.corners.size();
+    bad_lines += chunk.bad_lines;
+  }
+
+  // phase 2: merged streams, indices resolved against them
+  std::vector<float> positions(position_count * 3);
+  std::vector<float> texcoords(texcoord_count * 2);
+  std::vector<float> normals(normal_count * 3);
+  std::vector<obj_vertex_ref> refs(corner_count);
+  std::vector<size_t> invalid_triangles(chunks.size(), 0);
+
+  pool.parallel_for(chunks.size(), [&](size_t c) {
+    obj_chunk &chunk = chunks[c];
+    std::copy(chunk.positions.begin(), chunk.positions.end(),
+              positions.begin() + chunk.position_base * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+              texcoords.begin() + chunk.texcoord_base * 2);
+    std::copy(chunk.normals.begin(), chunk.normals.end(),
+              normals.begin() + chunk.normal_base * 3);
+    invalid_triangles[c] =
+        resolve_obj_chunk(chunk, position_count, texcoord_count, normal_count,
+                          refs.data() + chunk.corner_base);
+
+    // only the group starts are still needed
+    std::vector<float>().swap(chunk.positions);
+    std::vector<float>().swap(chunk.texcoords);
+    std::vector<float>().swap(chunk.normals);
+    std::vector<obj_corner>().swap(chunk.corners);
+  });
+  stats.parse_ms = get_elapsed_ms(start);
+
+  // groups with at least one triangle become meshes
+  std::vector<obj_group_start> groups = {{0, get_file_stem(file_path)}};
+  for (const obj_chunk &chunk : chunks)
+    for (const obj_group_start &group : chunk.groups)
+      groups.push_back({chunk.corner_base + group.corner, group.name});
+
+  size_t skipped_triangles = 0;
+  for (size_t count : invalid_triangles)
+    skipped_triangles += count;
+
+  if (corner_count > (size_t)UINT32_MAX) {
+    log_error("obj has too many triangles for 32 bit indices: " + file_path);
+    return false;
+  }
+
+  // phase 3: welding, the heavy groups use the whole pool themselves
+  auto weld_start = import_clock::now();
+  for (size_t g = 0; g < groups.size(); g++) {
+    size_t begin = groups[g].corner;
+    size_t end = g + 1 < groups.size() ? groups[g + 1].corner : corner_count;
+    if (end <= begin)
+      continue;
+
+    imported_mesh mesh;
+    mesh.name = groups[g].name;
+    build_obj_mesh(refs, begin, end, positions, texcoords, normals, pool,
+                   mesh);
+    if (mesh.indices.empty())
+      continue;
+
+    stats.vertex_count += mesh.positions.size() / 3;
+    stats.triangle_count += mesh.indices.size() / 3;
+    meshes.push_back(std::move(mesh));
+  }
+  stats.weld_ms = get_elapsed_ms(weld_start);
+  stats.total_ms = get_elapsed_ms(start);
+
+  if (bad_lines > 0 || skipped_triangles > 0)
+    log_debug_sub(std::to_string(bad_lines) + " broken lines, " +
+                  std::to_string(skipped_triangles) +
+                  " triangles with invalid indices skipped in " + file_path);
+  return true;
+}
+
+////////////////////////////////////
+// ply
+
+enum e_ply_type : uint8_t {
+  E_PLY_NONE,
+  E_PLY_INT8,
+  E_PLY_UINT8,
+  E_PLY_INT16,
+  E_PLY_UINT16,
+  E_PLY_INT32,
+  E_PLY_UINT32,
+  E_PLY_FLOAT32,
+  E_PLY_FLOAT64,
+};
+
+static e_ply_type get_ply_type(std::string_view name) {
+  if (name == "char" || name == "int8")
+    return E_PLY_INT8;
+  if (name == "uchar" || name == "uint8")
+    return E_PLY_UINT8;
+  if (name == "short" || name == "int16")
+    return E_PLY_INT16;
+  if (name == "ushort" || name == "uint16")
+    return E_PLY_UINT16;
+  if (name == "int" || name == "int32")
+    return E_PLY_INT32;
+  if (name == "uint" || name == "uint32")
+    return E_PLY_UINT32;
+  if (name == "float" || name == "float32")
+    return E_PLY_FLOAT32;
+  if (name == "double" || name == "float64")
+    return E_PLY_FLOAT64;
+  return E_PLY_NONE;
+}
+
+static size_t get_ply_type_size(e_ply_type type) {
+  switch (type) {
+  case E_PLY_INT8:
+  case E_PLY_UINT8:
+    return 1;
+  case E_PLY_INT16:
+  case E_PLY_UINT16:
+    return 2;
+  case E_PLY_INT32:
+  case E_PLY_UINT32:
+  case E_PLY_FLOAT32:
+    return 4;
+  case E_PLY_FLOAT64:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+struct ply_property {
+  std::string name;
+  e_ply_type type = E_PLY_NONE;
+  // set for list properties, type is the item type then
+  e_ply_type count_type = E_PLY_NONE;
+  // byte offset inside the element, fixed size elements only
+  size_t offset = 0;
+};
+
+struct ply_element {
+  std::string name;
+  size_t count = 0;
+  std::vector<ply_property> properties;
+  // bytes per element, 0 when it has list properties
+  size_t stride = 0;
+
+  int find_property(std::string_view property_name) const {
+    for (size_t i = 0; i < properties.size(); i++)
+      if (properties[i].name == property_name)
+        return (int)i;
+    return -1;
+  }
+};
+
+// reads a value of any ply type. the engine only runs on little endian
+// hosts, big endian files get swapped
+static inline double read_ply_value(const uint8_t *p, e_ply_type type,
+                                    bool swap) {
+  switch (type) {
+  case E_PLY_INT8:
+    return (double)(int8_t)p[0];
+  case E_PLY_UINT8:
+    return (double)p[0];
+  case E_PLY_INT16:
+  case E_PLY_UINT16: {
+    uint16_t bits;
+    memcpy(&bits, p, 2);
+    if (swap)
+      bits = __builtin_bswap16(bits);
+    return type == E_PLY_INT16 ? (double)(int16_t)bits : (double)bits;
+  }
+  case E_PLY_INT32:
+  case E_PLY_UINT32:
+  case E_PLY_FLOAT32: {
+    uint32_t bits;
+    memcpy(&bits, p, 4);
+    if (swap)
+      bits = __builtin_bswap32(bits);
+    if (type == E_PLY_FLOAT32) {
+      float value;
+      memcpy(&value, &bits, 4);
+      return value;
+    }
+    return type == E_PLY_INT32 ? (double)(int32_t)bits : (double)bits;
+  }
+  case E_PLY_FLOAT64: {
+    uint64_t bits;
+    memcpy(&bits, p, 8);
+    if (swap)
+      bits = __builtin_bswap64(bits);
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+  }
+  default:
+    return 0.0;
+  }
+}
+
+static std::vector<std::string_view> split_words(std::string_view line) {
+  std::vector<std::string_view> words;
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && is_space(line[i]))
+      i++;
+    size_t start = i;
+    while (i < line.size() && !is_space(line[i]))
+      i++;
+    if (i > start)
+      words.push_back(line.substr(start, i - start));
+  }
+  return words;
+}
+
+// header up to and including end_header. data_offset gets the first byte
+// of the body
+static bool parse_ply_header(const uint8_t *data, size_t size,
+                             std::vector<ply_element> &elements,
+                             bool &big_endian, bool &ascii,
+                             size_t &data_offset) {
+  std::string_view text((const char *)data, size);
+  if (text.substr(0, 3) != "ply")
+    return false;
+
+  bool has_format = false;
+  size_t line_start = 0;
+  while (line_start < text.size()) {
+    size_t line_end = text.find('\n', line_start);
+    if (line_end == std::string_view::npos)
+      return false;
+
+    std::vector<std::string_view> words =
+        split_words(text.substr(line_start, line_end - line_start));
+    line_start = line_end + 1;
+    if (words.empty())
+      continue;
+
+    if (words[0] == "end_header") {
+      data_offset = line_start;
+      return has_format;
+    }
+
+    if (words[0] == "format" && words.size() >= 2) {
+      has_format = true;
+      ascii = words[1] == "ascii";
+      big_endian = words[1] == "binary_big_endian";
+      if (!ascii && !big_endian && words[1] != "binary_little_endian")
+        return false;
+    } else if (words[0] == "element" && words.size() >= 3) {
+      ply_element element;
+      element.name = std::string(words[1]);
+      element.count = strtoull(std::string(words[2]).c_str(), nullptr, 10);
+      elements.push_back(element);
+    } else if (words[0] == "property" && !elements.empty()) {
+      ply_property property;
+      if (words.size() >= 5 && words[1] == "list") {
+        property.count_type = get_ply_type(words[2]);
+        property.type = get_ply_type(words[3]);
+        property.name = std::string(words[4]);
+        if (property.count_type == E_PLY_NONE)
+          return false;
+      } else if (words.size() >= 3) {
+        property.type = get_ply_type(words[1]);
+        property.name = std::string(words[2]);
+      }
+      if (property.type == E_PLY_NONE)
+        return false;
+      elements.back().properties.push_back(property);
+    }
+  }
+
+  return false;
+}
+
+static void layout_ply_element(ply_element &element) {
+  size_t offset = 0;
+  for (ply_property &property : element.properties) {
+    if (property.count_type != E_PLY_NONE) {
+      element.stride = 0;
+      return;
+    }
+    property.offset = offset;
+    offset += get_ply_type_size(property.type);
+  }
+  element.stride = offset;
+}
+
+// size of one element with list properties, 0 if it runs past end
+static size_t get_ply_element_size(const ply_element &element,
+                                   const uint8_t *p, const uint8_t *end,
+                                   bool swap) {
+  const uint8_t *start = p;
+  for (const ply_property &property : element.properties) {
+    if (property.count_type == E_PLY_NONE) {
+      p += get_ply_type_size(property.type);
+      continue;
+    }
+
+    size_t count_size = get_ply_type_size(property.count_type);
+    if (p + count_size > end)
+      return 0;
+    double items = read_ply_value(p, property.count_type, swap);
+    p += count_size + (size_t)std::max(items, 0.0) *
+                          get_ply_type_size(property.type);
+  }
+  return p <= end ? (size_t)(p - start) : 0;
+}
+
+static bool read_ply_vertices(const ply_element &element, const uint8_t *p,
+                              const uint8_t *end, bool swap,
+                              Thread_Pool &pool, imported_mesh &mesh) {
+  if (element.stride == 0 || (size_t)(end - p) < element.count * element.stride)
+    return false;
+
+  int position[3] = {element.find_property("x"), element.find_property("y"),
+                     element.find_property("z")};
+  int normal[3] = {element.find_property("nx"), element.find_property("ny"),
+                   element.find_property("nz")};
+  int texcoord[2] = {element.find_property("s"), element.find_property("t")};
+  if (texcoord[0] < 0 || texcoord[1] < 0) {
+    texcoord[0] = element.find_property("u");
+    texcoord[1] = element.find_property("v");
+  }
+  if (texcoord[0] < 0 || texcoord[1] < 0) {
+    texcoord[0] = element.find_property("texture_u");
+    texcoord[1] = element.find_property("texture_v");
+  }
+
+  if (position[0] < 0 || position[1] < 0 || position[2] < 0)
+    return false;
+  bool has_normals = normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;
+  bool has_texcoords = texcoord[0] >= 0 && texcoord[1] >= 0;
+
+  size_t count = element.count;
+  mesh.positions.resize(count * 3);
+  if (has_normals)
+    mesh.normals.resize(count * 3);
+  if (has_texcoords)
+    mesh.texcoords.resize(count * 2);
+
+  auto read_fields = [&](const uint8_t *vertex, const int *fields,
+                         int field_count, float *out) {
+    for (int f = 0; f < field_count; f++) {
+      const ply_property &property = element.properties[fields[f]];
+      out[f] = (float)read_ply_value(vertex + property.offset, property.type,
+                                     swap);
+    }
+  };
+
+  run_element_chunks(pool, count, [&](size_t begin, size_t last, size_t) {
+    for (size_t v = begin; v < last; v++) {
+      const uint8_t *vertex = p + v * element.stride;
+      read_fields(vertex, position, 3, &mesh.positions[v * 3]);
+      if (has_normals)
+        read_fields(vertex, normal, 3, &mesh.normals[v * 3]);
+      if (has_texcoords)
+        read_fields(vertex, texcoord, 2, &mesh.texcoords[v * 2]);
+    }
+  });
+
+  return true;
+}
+
+// faces, fanned into triangles. triangle only files (the usual case) are
+// read in parallel at a fixed stride, anything else walks the faces
+static bool read_ply_faces(const ply_element &element, const uint8_t *p,
+                           const uint8_t *end, bool swap, Thread_Pool &pool,
+                           size_t vertex_count, imported_mesh &mesh,
+                           size_t &skipped_triangles, const uint8_t *&next) {
+  int list = element.find_property("vertex_indices");
+  if (list < 0)
+    list = element.find_property("vertex_index");
+  if (list < 0 || element.properties[list].count_type == E_PLY_NONE)
+    return false;
+
+  const ply_property &indices = element.properties[list];
+  size_t count_size = get_ply_type_size(indices.count_type);
+  size_t index_size = get_ply_type_size(indices.type);
+  size_t triangle_stride = count_size + 3 * index_size;
+  size_t count = element.count;
+
+  bool fixed_triangles = element.properties.size() == 1 &&
+                         (size_t)(end - p) >= count * triangle_stride;
+  if (fixed_triangles) {
+    std::vector<uint8_t> chunk_ok((count + MESH_ELEMENT_CHUNK - 1) /
+                                      MESH_ELEMENT_CHUNK +
+                                  1,
+                                  1);
+    run_element_chunks(pool, count, [&](size_t begin, size_t last, size_t c) {
+      for (size_t f = begin; f < last && chunk_ok[c]; f++)
+        chunk_ok[c] = read_ply_value(p + f * triangle_stride,
+                                     indices.count_type, swap) == 3.0;
+    });
+    fixed_triangles = std::find(chunk_ok.begin(), chunk_ok.end(), 0) ==
+                      chunk_ok.end();
+  }
+
+  if (fixed_triangles) {
+    mesh.indices.resize(count * 3);
+    std::vector<size_t> chunk_invalid(
+        (count + MESH_ELEMENT_CHUNK - 1) / MESH_ELEMENT_CHUNK + 1, 0);
+    run_element_chunks(pool, count, [&](size_t begin, size_t last, size_t c) {
+      for (size_t f = begin; f < last; f++) {
+        const uint8_t *face = p + f * triangle_stride + count_size;
+        for (size_t k = 0; k < 3; k++) {
+          double index =
+              read_ply_value(face + k * index_size, indices.type, swap);
+          bool valid = index >= 0.0 && index < (double)vertex_count;
+          chunk_invalid[c] += !valid;
+          mesh.indices[f * 3 + k] = valid ? (uint32_t)index : UINT32_MAX;
+        }
+      }
+    });
+    next = p + count * triangle_stride;
+
+    size_t invalid = 0;
+    for (size_t chunk : chunk_invalid)
+      invalid += chunk;
+    if (invalid == 0)
+      return true;
+
+    // rare, drop the broken triangles serially
+    size_t kept = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+      if (mesh.indices[i] == UINT32_MAX || mesh.indices[i + 1] == UINT32_MAX ||
+          mesh.indices[i + 2] == UINT32_MAX) {
+        skipped_triangles++;
+        continue;
+      }
+      std::copy(&mesh.indices[i], &mesh.indices[i] + 3, &mesh.indices[kept]);
+      kept += 3;
+    }
+    mesh.indices.resize(kept);
+    return true;
+  }
+
+  mesh.indices.reserve(count * 3);
+  for (size_t f = 0; f < count; f++) {
+    for (size_t k = 0; k < element.properties.size(); k++) {
+      const ply_property &property = element.properties[k];
+      if (property.count_type == E_PLY_NONE) {
+        p += get_ply_type_size(property.type);
+        continue;
+      }
+
+      size_t item_size = get_ply_type_size(property.type);
+      if (p + count_size > end)
+        return false;
+      size_t items =
+          (size_t)std::max(read_ply_value(p, property.count_type, swap), 0.0);
+      p += get_ply_type_size(property.count_type);
+      if (p + items * item_size > end)
+        return false;
+
+      if ((int)k == list && items >= 3) {
+        double first = read_ply_value(p, property.type, swap);
+        for (size_t i = 2; i < items; i++) {
+          double second =
+              read_ply_value(p + (i - 1) * item_size, property.type, swap);
+          double third = read_ply_value(p + i * item_size, property.type, swap);
+          if (first < 0.0 || second < 0.0 || third < 0.0 ||
+              first >= (double)vertex_count || second >= (double)vertex_count ||
+              third >= (double)vertex_count) {
+            skipped_triangles++;
+            continue;
+          }
+          mesh.indices.push_back((uint32_t)first);
+          mesh.indices.push_back((uint32_t)second);
+          mesh.indices.push_back((uint32_t)third);
+        }
+      }
+      p += items * item_size;
+    }
+  }
+
+  next = p;
+  return true;
+}
+
+bool load_ply_file(const std::string &file_path, Thread_Pool &pool,
+                   std::vector<imported_mesh> &meshes,
+                   mesh_file_stats &stats) {
+  auto start = import_clock::now();
+
+  Mapped_File file;
+  if (!file.open(file_path)) {
+    log_error("couldnt map ply file: " + file_path);
+    return false;
+  }
+  stats.file_bytes = file.size();
+
+  std::vector<ply_element> elements;
+  bool big_endian = false, ascii = false;
+  size_t data_offset = 0;
+  if (!parse_ply_header(file.data(), file.size(), elements, big_endian, ascii,
+                        data_offset)) {
+    log_error("invalid ply header in " + file_path);
+    return false;
+  }
+  if (ascii) {
+    log_error("ascii ply isnt supported, only binary: " + file_path);
+    return false;
+  }
+
+  imported_mesh mesh;
+  mesh.name = get_file_stem(file_path);
+  bool has_vertices = false;
+  size_t skipped_triangles = 0;
+
+  const uint8_t *p = file.data() + data_offset;
+  const uint8_t *end = file.data() + file.size();
+  for (ply_element &element : elements) {
+    layout_ply_element(element);
+
+    if (element.name == "vertex") {
+      if (!read_ply_vertices(element, p, end, big_endian, pool, mesh)) {
+        log_error("couldnt read the ply vertices of " + file_path);
+        return false;
+      }
+      p += element.count * element.stride;
+      has_vertices = true;
+    } else if (element.name == "face" && has_vertices) {
+      if (!read_ply_faces(element, p, end, big_endian, pool,
+                          mesh.positions.size() / 3, mesh, skipped_triangles,
+                          p)) {
+        log_error("couldnt read the ply faces of " + file_path);
+        return false;
+      }
+    } else if (element.stride > 0) {
+      // anything else gets skipped
+      if ((size_t)(end - p) < element.count * element.stride)
+        return false;
+      p += element.count * element.stride;
+    } else {
+      for (size_t i = 0; i < element.count; i++) {
+        size_t element_size = get_ply_element_size(element, p, end, big_endian);
+        if (element_size == 0) {
+          log_error("truncated ply element " + element.name + " in " +
+                    file_path);
+          return false;
+        }
+        p += element_size;
+      }
+    }
+  }
+  stats.parse_ms = get_elapsed_ms(start);
+
+  if (skipped_triangles > 0)
+    log_debug_sub(std::to_string(skipped_triangles) +
+                  " triangles with invalid indices skipped in " + file_path);
+
+  // a point cloud isnt a mesh
+  if (mesh.indices.empty()) {
+    log_error("ply has no faces: " + file_path);
+    return false;
+  }
+
+  stats.vertex_count = mesh.positions.size() / 3;
+  stats.triangle_count = mesh.indices.size() / 3;
+  meshes.push_back(std::move(mesh));
+  stats.total_ms = get_elapsed_ms(start);
+  return true;
+}
+
+////////////////////////////////////
+
+static std::string get_lower_extension(const std::string &file_path) {
+  std::string extension = std::filesystem::path(file_path).extension().string();
+  for (char &c : extension)
+    c = (char)tolower((unsigned char)c);
+  return extension;
+}
+
+bool is_mesh_file(const std::string &file_path) {
+  std::string extension = get_lower_extension(file_path);
+  return extension == ".obj" || extension == ".ply";
+}
+
+bool load_mesh_file(const std::string &file_path, Thread_Pool &pool,
+                    std::vector<imported_mesh> &meshes) {
+  mesh_file_stats stats;
+  std::string extension = get_lower_extension(file_path);
+
+  bool ok = false;
+  if (extension == ".obj")
+    ok = load_obj_file(file_path, pool, meshes, stats);
+  else if (extension == ".ply")
+    ok = load_ply_file(file_path, pool, meshes, stats);
+  else
+    log_error("not an obj / ply file: " + file_path);
+
+  if (!ok)
+    return false;
+
+  double megabytes = stats.file_bytes / (1024.0 * 1024.0);
+  auto throughput = [megabytes](double ms) {
+    return std::to_string(ms > 0.0 ? megabytes / (ms / 1000.0) : 0.0);
+  };
+
+  log_success("imported " + file_path + ": " + std::to_string(meshes.size()) +
+              " meshes, " + std::to_string(stats.vertex_count) +
+              " vertices, " + std::to_string(stats.triangle_count) +
+              " triangles");
+  log_debug_sub(std::to_string(megabytes) + " MB in " +
+                std::to_string(stats.total_ms) + " ms on " +
+                std::to_string(pool.num_threads() + 1) + " threads (" +
+                throughput(stats.total_ms) + " MB/s)");
+  log_debug_sub("parse " + std::to_string(stats.parse_ms) + " ms (" +
+                throughput(stats.parse_ms) + " MB/s), weld " +
+                std::to_string(stats.weld_ms) + " ms");
+  return true;
+}
+
+};
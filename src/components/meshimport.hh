@@ -0,0 +1,56 @@
+#pragma once
+
+#include "threadpool.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// obj / ply scans and cad exports. the file is mapped, split into chunks and
+// parsed on the pool, obj corners get welded into an indexed mesh. the
+// result goes through the same pipeline as a decoded gltf primitive
+// (see load_all_meshes_from_mesh_file)
+
+namespace importer {
+
+  // one indexed triangle mesh, flat float streams like in Mesh. normals /
+  // texcoords are empty when the file didnt have them for every vertex
+  struct imported_mesh {
+    std::string name;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<uint32_t> indices;
+  };
+
+  struct mesh_file_stats {
+    size_t file_bytes = 0;
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    double parse_ms = 0.0;
+    double weld_ms = 0.0;
+    double total_ms = 0.0;
+  };
+
+  // .obj / .ply, by extension
+  bool is_mesh_file(const std::string &file_path);
+
+  // obj: v / vt / vn / f (polygons are fanned, negative indices work).
+  // o, g and usemtl start a new mesh, materials themselves are ignored
+  bool load_obj_file(const std::string &file_path, Thread_Pool &pool,
+                     std::vector<imported_mesh> &meshes,
+                     mesh_file_stats &stats);
+
+  // binary ply (either endianness): x/y/z, nx/ny/nz and s/t or u/v of the
+  // vertex element plus the vertex_indices list of the face element
+  bool load_ply_file(const std::string &file_path, Thread_Pool &pool,
+                     std::vector<imported_mesh> &meshes,
+                     mesh_file_stats &stats);
+
+  // either of the above, logs the throughput
+  bool load_mesh_file(const std::string &file_path, Thread_Pool &pool,
+                      std::vector<imported_mesh> &meshes);
+
+};
@@ -0,0 +1,379 @@
+#include "meshoptimize.hh"
+#include "logging.hh"
+
+// stdlib
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <string>
+
+static const uint32_t INVALID_VERTEX = 0xFFFFFFFF;
+
+namespace {
+
+// fifo cache by insertion stamp: a vertex is cached if it got inserted less
+// than cache_size misses ago
+struct fifo_cache {
+  std::vector<int64_t> stamps;
+  int64_t misses = 0;
+  size_t size;
+
+  fifo_cache(size_t vertex_count, size_t cache_size)
+      : stamps(vertex_count, -(int64_t)cache_size - 1), size(cache_size) {}
+
+  // 1 if v had to be transformed
+  int access(uint32_t v) {
+    if (misses - stamps[v] < (int64_t)size)
+      return 0;
+    stamps[v] = misses++;
+    return 1;
+  }
+
+  void reset() {
+    // everything ages out at once
+    misses += (int64_t)size + 1;
+  }
+};
+
+struct cluster_sort_key {
+  size_t start;
+  size_t end;
+  float depth;
+};
+
+} // namespace
+
+vertex_cache_stats analyze_vertex_cache(const std::vector<uint32_t> &indices,
+                                        size_t vertex_count,
+                                        size_t cache_size) {
+  vertex_cache_stats stats;
+  if (indices.size() < 3 || vertex_count == 0)
+    return stats;
+
+  fifo_cache cache(vertex_count, cache_size);
+  std::vector<bool> referenced(vertex_count, false);
+  size_t transformed = 0;
+  size_t unique = 0;
+
+  for (uint32_t v : indices) {
+    transformed += cache.access(v);
+    if (!referenced[v]) {
+      referenced[v] = true;
+      unique++;
+    }
+  }
+
+  stats.acmr = (float)transformed / (float)(indices.size() / 3);
+  stats.atvr = (float)transformed / (float)unique;
+  return stats;
+}
+
+std::vector<uint32_t>
+optimize_vertex_cache(const std::vector<uint32_t> &indices,
+                      size_t vertex_count,
+                      std::vector<size_t> &cluster_starts,
+                      size_t cache_size) {
+  size_t triangle_count = indices.size() / 3;
+  cluster_starts.clear();
+
+  // triangles per vertex (csr), live = not yet emitted
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (uint32_t v : indices)
+    live[v]++;
+
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++)
+    offsets[v + 1] = offsets[v] + live[v];
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangle_count; t++)
+    for (int k = 0; k < 3; k++)
+      adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+
+  std::vector<uint32_t> cache_time(vertex_count, 0);
+  uint32_t time = (uint32_t)cache_size + 1;
+
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  size_t cursor = 0;
+  auto skip_dead_end = [&]() -> uint32_t {
+    while (!dead_end.empty()) {
+      uint32_t v = dead_end.back();
+      dead_end.pop_back();
+      if (live[v] > 0)
+        return v;
+    }
+    for (; cursor < vertex_count; cursor++)
+      if (live[cursor] > 0)
+        return (uint32_t)cursor;
+    return INVALID_VERTEX;
+  };
+
+  uint32_t fanning = skip_dead_end();
+  if (fanning != INVALID_VERTEX)
+    cluster_starts.push_back(0);
+
+  while (fanning != INVALID_VERTEX) {
+    candidates.clear();
+
+    for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+      uint32_t t = adjacency[a];
+      if (emitted[t])
+        continue;
+      emitted[t] = true;
+
+      for (int k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        output.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+
+        if (time - cache_time[v] > cache_size)
+          cache_time[v] = time++;
+      }
+    }
+
+    // prefer the vertex that stays in cache while its fan gets emitted
+    uint32_t best = INVALID_VERTEX;
+    int64_t best_priority = -1;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0)
+        continue;
+
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live[v] <= cache_size)
+        priority = time - cache_time[v];
+
+      if (priority > best_priority) {
+        best_priority = priority;
+        best = v;
+      }
+    }
+
+    // nothing adjacent left = hard cluster boundary
+    if (best == INVALID_VERTEX) {
+      best = skip_dead_end();
+      if (best != INVALID_VERTEX)
+        cluster_starts.push_back(output.size() / 3);
+    }
+
+    fanning = best;
+  }
+
+  return output;
+}
+
+size_t optimize_overdraw(std::vector<uint32_t> &indices,
+                       const std::vector<size_t> &cluster_starts,
+                       const std::vector<float> &positions, float threshold,
+                       size_t cache_size) {
+  size_t triangle_count = indices.size() / 3;
+  size_t vertex_count = positions.size() / 3;
+  if (triangle_count == 0)
+    return 0;
+
+  vertex_cache_stats input_stats =
+      analyze_vertex_cache(indices, vertex_count, cache_size);
+
+  // split the hard clusters wherever restarting with a cold cache costs
+  // less than threshold * what the cluster needs anyway
+  std::vector<size_t> starts;
+  fifo_cache cache(vertex_count, cache_size);
+  for (size_t c = 0; c < cluster_starts.size(); c++) {
+    size_t start = cluster_starts[c];
+    size_t end = c + 1 < cluster_starts.size() ? cluster_starts[c + 1]
+                                               : triangle_count;
+
+    cache.reset();
+    size_t cluster_misses = 0;
+    for (size_t t = start; t < end; t++)
+      for (int k = 0; k < 3; k++)
+        cluster_misses += cache.access(indices[t * 3 + k]);
+    float cluster_acmr = (float)cluster_misses / (float)(end - start);
+
+    starts.push_back(start);
+    size_t hard_start = starts.size();
+    cache.reset();
+    size_t misses = 0, size = 0;
+    for (size_t t = start; t < end; t++) {
+      for (int k = 0; k < 3; k++)
+        misses += cache.access(indices[t * 3 + k]);
+      size++;
+
+      if (t + 1 < end && (float)misses <= threshold * cluster_acmr * size) {
+        starts.push_back(t + 1);
+        cache.reset();
+        misses = size = 0;
+      }
+    }
+
+    // a tail that never paid off its cold start stays glued to the piece
+    // before it, where it started out warm
+    if (size > 0 && starts.size() > hard_start &&
+        (float)misses > threshold * cluster_acmr * size)
+      starts.pop_back();
+  }
+
+  if (starts.size() < 2)
+    return 0;
+
+  // area weighted centroid + normal of every cluster and of the whole mesh
+  auto position = [&](uint32_t v) {
+    return &positions[(size_t)v * 3];
+  };
+
+  std::vector<cluster_sort_key> clusters(starts.size());
+  std::vector<float> centroids(starts.size() * 3, 0.0f);
+  std::vector<float> normals(starts.size() * 3, 0.0f);
+  float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+  float mesh_area = 0.0f;
+
+  for (size_t c = 0; c < starts.size(); c++) {
+    clusters[c].start = starts[c];
+    clusters[c].end = c + 1 < starts.size() ? starts[c + 1] : triangle_count;
+
+    float cluster_area = 0.0f;
+    for (size_t t = clusters[c].start; t < clusters[c].end; t++) {
+      const float *p0 = position(indices[t * 3 + 0]);
+      const float *p1 = position(indices[t * 3 + 1]);
+      const float *p2 = position(indices[t * 3 + 2]);
+
+      float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                    e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]};
+      float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+      for (int k = 0; k < 3; k++) {
+        float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+        centroids[c * 3 + k] += center * area;
+        mesh_centroid[k] += center * area;
+        normals[c * 3 + k] += n[k];
+      }
+      cluster_area += area;
+    }
+
+    if (cluster_area > 0.0f)
+      for (int k = 0; k < 3; k++)
+        centroids[c * 3 + k] /= cluster_area;
+    mesh_area += cluster_area;
+  }
+
+  if (mesh_area <= 0.0f)
+    return 0;
+  for (int k = 0; k < 3; k++)
+    mesh_centroid[k] /= mesh_area;
+
+  // clusters far out along their own normal occlude the rest, draw first
+  for (size_t c = 0; c < clusters.size(); c++) {
+    const float *n = &normals[c * 3];
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float depth = 0.0f;
+    if (length > 0.0f)
+      for (int k = 0; k < 3; k++)
+        depth += (centroids[c * 3 + k] - mesh_centroid[k]) * n[k] / length;
+    clusters[c].depth = depth;
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const cluster_sort_key &a, const cluster_sort_key &b) {
+                     return a.depth > b.depth;
+                   });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(indices.size());
+  for (const auto &cluster : clusters)
+    sorted.insert(sorted.end(), indices.begin() + cluster.start * 3,
+                  indices.begin() + cluster.end * 3);
+
+  // the soft boundaries should keep this in budget, but dont trust it
+  vertex_cache_stats sorted_stats =
+      analyze_vertex_cache(sorted, vertex_count, cache_size);
+  if (sorted_stats.acmr > input_stats.acmr * threshold)
+    return 0;
+
+  indices.swap(sorted);
+  return clusters.size();
+}
+
+size_t optimize_vertex_fetch(std::vector<uint32_t> &indices,
+                             size_t vertex_count,
+                             const std::vector<vertex_stream_ref> &streams) {
+  std::vector<uint32_t> remap(vertex_count, INVALID_VERTEX);
+  uint32_t next_vertex = 0;
+
+  for (uint32_t &v : indices) {
+    if (remap[v] == INVALID_VERTEX)
+      remap[v] = next_vertex++;
+    v = remap[v];
+  }
+
+  for (const auto &stream : streams) {
+    std::vector<float> &data = *stream.data;
+
+    // a stream that doesnt match the positions was useless before, drop it
+    // so it gets regenerated instead of read out of bounds
+    if (data.size() != vertex_count * stream.components) {
+      data.clear();
+      continue;
+    }
+
+    std::vector<float> reordered((size_t)next_vertex * stream.components);
+    for (size_t v = 0; v < vertex_count; v++) {
+      if (remap[v] == INVALID_VERTEX)
+        continue;
+      std::copy_n(&data[v * stream.components], stream.components,
+                  &reordered[(size_t)remap[v] * stream.components]);
+    }
+    data.swap(reordered);
+  }
+
+  return next_vertex;
+}
+
+mesh_optimize_report
+optimize_mesh_geometry(std::vector<uint32_t> &indices,
+                       const std::vector<vertex_stream_ref> &streams) {
+  mesh_optimize_report report;
+  if (streams.empty() || indices.size() < 3 || indices.size() % 3 != 0)
+    return report;
+
+  size_t vertex_count = streams[0].data->size() / 3;
+  for (uint32_t v : indices)
+    if (v >= vertex_count)
+      return report;
+
+  report.triangle_count = indices.size() / 3;
+  report.before = analyze_vertex_cache(indices, vertex_count);
+
+  std::vector<size_t> cluster_starts;
+  indices = optimize_vertex_cache(indices, vertex_count, cluster_starts);
+  report.cluster_count =
+      optimize_overdraw(indices, cluster_starts, *streams[0].data);
+
+  report.vertex_count = optimize_vertex_fetch(indices, vertex_count, streams);
+  report.after = analyze_vertex_cache(indices, report.vertex_count);
+  return report;
+}
+
+void log_optimize_report(const mesh_optimize_report &report) {
+  if (report.triangle_count == 0)
+    return;
+
+  char line[200];
+  snprintf(line, sizeof(line),
+           "%zu tris, acmr %.3f -> %.3f, atvr %.3f -> %.3f, %zu clusters, "
+           "%zu lods down to %zu tris",
+           report.triangle_count, report.before.acmr, report.after.acmr,
+           report.before.atvr, report.after.atvr, report.cluster_count,
+           report.lod_count, report.coarsest_lod_triangles);
+  log_debug_sub(line);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// which passes run on freshly imported geometry, before it gets uploaded
+// or written to the mesh cache
+struct mesh_import_options {
+  // vertex cache / overdraw / fetch reorder, see below
+  bool optimize = false;
+  // simplified levels, see meshsimplify.hh
+  bool generate_lods = false;
+};
+
+// fifo post transform cache, close enough to what the hardware does
+static const size_t VERTEX_CACHE_SIZE = 16;
+
+struct vertex_cache_stats {
+  // transformed vertices per triangle. 0.5 is perfect, 3 is no reuse
+  float acmr = 0.0f;
+  // transformed vertices per referenced vertex. 1 is perfect
+  float atvr = 0.0f;
+};
+
+struct mesh_optimize_report {
+  size_t triangle_count = 0;
+  size_t vertex_count = 0;
+  vertex_cache_stats before;
+  vertex_cache_stats after;
+  // clusters the overdraw pass got to sort (0 = pass skipped)
+  size_t cluster_count = 0;
+  // levels incl. the full mesh, 0 = no lods built
+  size_t lod_count = 0;
+  size_t coarsest_lod_triangles = 0;
+};
+
+// one per vertex stream, data has components floats per vertex
+struct vertex_stream_ref {
+  std::vector<float> *data;
+  size_t components;
+};
+
+vertex_cache_stats analyze_vertex_cache(const std::vector<uint32_t> &indices,
+                                        size_t vertex_count,
+                                        size_t cache_size = VERTEX_CACHE_SIZE);
+
+// tipsify (sander et al. 2007). returns the new index order, cluster_starts
+// gets the first triangle of every cluster the overdraw pass may move
+std::vector<uint32_t>
+optimize_vertex_cache(const std::vector<uint32_t> &indices,
+                      size_t vertex_count,
+                      std::vector<size_t> &cluster_starts,
+                      size_t cache_size = VERTEX_CACHE_SIZE);
+
+// sorts the clusters so outward facing ones come first (nehab et al.).
+// threshold = how much acmr the reorder may cost relative to the input.
+// returns the number of clusters that got sorted, 0 if nothing changed
+size_t optimize_overdraw(std::vector<uint32_t> &indices,
+                       const std::vector<size_t> &cluster_starts,
+                       const std::vector<float> &positions,
+                       float threshold = 1.05f,
+                       size_t cache_size = VERTEX_CACHE_SIZE);
+
+// renumbers vertices in first use order and drops unreferenced ones.
+// returns the new vertex count
+size_t optimize_vertex_fetch(std::vector<uint32_t> &indices,
+                             size_t vertex_count,
+                             const std::vector<vertex_stream_ref> &streams);
+
+// all three passes on one indexed triangle list. streams[0] has to be the
+// positions (3 floats). safe to run on pool threads
+mesh_optimize_report
+optimize_mesh_geometry(std::vector<uint32_t> &indices,
+                       const std::vector<vertex_stream_ref> &streams);
+
+void log_optimize_report(const mesh_optimize_report &report);
@@ -0,0 +1,334 @@
+#include "meshsimplify.hh"
+#include "meshoptimize.hh"
+
+// stdlib
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// symmetric 4x4, sum of plane equations p p^T
+struct quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0;
+  double c = 0;
+
+  void add_plane(double nx, double ny, double nz, double d) {
+    a00 += nx * nx;
+    a01 += nx * ny;
+    a02 += nx * nz;
+    a11 += ny * ny;
+    a12 += ny * nz;
+    a22 += nz * nz;
+    b0 += nx * d;
+    b1 += ny * d;
+    b2 += nz * d;
+    c += d * d;
+  }
+
+  void add(const quadric &other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+  }
+
+  // sum of squared distances of p to every plane
+  double evaluate(const float *p) const {
+    double x = p[0], y = p[1], z = p[2];
+    double result = a00 * x * x + a11 * y * y + a22 * z * z +
+                    2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                    2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(result, 0.0);
+  }
+};
+
+struct edge_collapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+void triangle_normal(const float *p0, const float *p1, const float *p2,
+                     double *n) {
+  double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+  if (a > b)
+    std::swap(a, b);
+  return ((uint64_t)a << 32) | b;
+}
+
+// vertices sharing a position get the smallest index of the group
+std::vector<uint32_t> find_position_groups(const std::vector<float> &positions,
+                                           size_t vertex_count) {
+  std::vector<uint32_t> canonical(vertex_count);
+  std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+  buckets.reserve(vertex_count);
+
+  for (size_t v = 0; v < vertex_count; v++) {
+    uint32_t bits[3];
+    memcpy(bits, &positions[v * 3], sizeof(bits));
+    uint64_t hash = (uint64_t)bits[0] * 73856093ull ^
+                    (uint64_t)bits[1] * 19349663ull ^
+                    (uint64_t)bits[2] * 83492791ull;
+
+    canonical[v] = (uint32_t)v;
+    for (uint32_t other : buckets[hash]) {
+      if (memcmp(&positions[(size_t)other * 3], &positions[v * 3],
+                 3 * sizeof(float)) == 0) {
+        canonical[v] = other;
+        break;
+      }
+    }
+    if (canonical[v] == v)
+      buckets[hash].push_back((uint32_t)v);
+  }
+
+  return canonical;
+}
+
+} // namespace
+
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t> &indices,
+                                    const std::vector<float> &positions,
+                                    size_t target_index_count, float max_error,
+                                    float &out_error) {
+  out_error = 0.0f;
+  size_t vertex_count = positions.size() / 3;
+  std::vector<uint32_t> result = indices;
+  if (result.size() <= target_index_count || vertex_count == 0)
+    return result;
+
+  auto position = [&](uint32_t v) { return &positions[(size_t)v * 3]; };
+
+  // seams: a position that is shared by more than one vertex
+  std::vector<uint32_t> canonical = find_position_groups(positions, vertex_count);
+  std::vector<bool> locked(vertex_count, false);
+  for (size_t v = 0; v < vertex_count; v++)
+    if (canonical[v] != v) {
+      locked[v] = true;
+      locked[canonical[v]] = true;
+    }
+
+  // borders: edges (by position) that only one triangle uses
+  std::unordered_map<uint64_t, uint32_t> edge_use;
+  edge_use.reserve(result.size());
+  for (size_t t = 0; t + 2 < result.size(); t += 3)
+    for (int k = 0; k < 3; k++)
+      edge_use[edge_key(canonical[result[t + k]],
+                        canonical[result[t + (k + 1) % 3]])]++;
+  for (size_t t = 0; t + 2 < result.size(); t += 3)
+    for (int k = 0; k < 3; k++) {
+      uint32_t a = result[t + k], b = result[t + (k + 1) % 3];
+      if (edge_use[edge_key(canonical[a], canonical[b])] == 1)
+        locked[a] = locked[b] = true;
+    }
+
+  std::vector<quadric> quadrics(vertex_count);
+  for (size_t t = 0; t + 2 < result.size(); t += 3) {
+    const float *p0 = position(result[t]);
+    double n[3];
+    triangle_normal(p0, position(result[t + 1]), position(result[t + 2]), n);
+    double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length <= 0.0)
+      continue;
+
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+    double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+    for (int k = 0; k < 3; k++)
+      quadrics[result[t + k]].add_plane(n[0], n[1], n[2], d);
+  }
+
+  double max_cost = (double)max_error * (double)max_error;
+  std::vector<uint32_t> collapse_target(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  std::vector<edge_collapse> collapses;
+  std::vector<uint32_t> triangle_offsets, vertex_triangles;
+
+  while (result.size() > target_index_count) {
+    size_t triangle_count = result.size() / 3;
+
+    // every directed collapse along a triangle edge, cheapest direction
+    collapses.clear();
+    for (size_t t = 0; t < triangle_count; t++) {
+      for (int k = 0; k < 3; k++) {
+        uint32_t a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+        // each interior edge shows up twice, keep one
+        if (a > b)
+          continue;
+
+        quadric sum = quadrics[a];
+        sum.add(quadrics[b]);
+        double cost_ab = locked[a] ? -1.0 : sum.evaluate(position(b));
+        double cost_ba = locked[b] ? -1.0 : sum.evaluate(position(a));
+
+        if (cost_ab >= 0.0 && (cost_ba < 0.0 || cost_ab <= cost_ba))
+          collapses.push_back({a, b, cost_ab});
+        else if (cost_ba >= 0.0)
+          collapses.push_back({b, a, cost_ba});
+      }
+    }
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const edge_collapse &x, const edge_collapse &y) {
+                return x.cost < y.cost;
+              });
+
+    // triangles around every vertex (csr) for the flip check
+    triangle_offsets.assign(vertex_count + 1, 0);
+    for (uint32_t v : result)
+      triangle_offsets[v + 1]++;
+    for (size_t v = 0; v < vertex_count; v++)
+      triangle_offsets[v + 1] += triangle_offsets[v];
+    vertex_triangles.resize(result.size());
+    {
+      std::vector<uint32_t> fill(triangle_offsets.begin(),
+                                 triangle_offsets.end() - 1);
+      for (size_t i = 0; i < result.size(); i++)
+        vertex_triangles[fill[result[i]]++] = (uint32_t)(i / 3);
+    }
+
+    for (size_t v = 0; v < vertex_count; v++)
+      collapse_target[v] = (uint32_t)v;
+    std::fill(touched.begin(), touched.end(), false);
+
+    size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+    size_t triangles_removed = 0;
+    size_t applied = 0;
+
+    for (const auto &collapse : collapses) {
+      if (collapse.cost > max_cost || triangles_removed >= triangles_to_remove)
+        break;
+      if (touched[collapse.from] || touched[collapse.to])
+        continue;
+
+      // moving from onto to must not flip any triangle that survives
+      bool flips = false;
+      size_t removes = 0;
+      for (uint32_t a = triangle_offsets[collapse.from];
+           a < triangle_offsets[collapse.from + 1] && !flips; a++) {
+        const uint32_t *tri = &result[(size_t)vertex_triangles[a] * 3];
+        if (tri[0] == collapse.to || tri[1] == collapse.to ||
+            tri[2] == collapse.to) {
+          removes++;
+          continue;
+        }
+
+        const float *before[3], *after[3];
+        for (int k = 0; k < 3; k++) {
+          before[k] = position(tri[k]);
+          after[k] = tri[k] == collapse.from ? position(collapse.to)
+                                             : before[k];
+        }
+
+        double n0[3], n1[3];
+        triangle_normal(before[0], before[1], before[2], n0);
+        triangle_normal(after[0], after[1], after[2], n1);
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double len0 = std::sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        double len1 = std::sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        flips = dot <= 0.2 * len0 * len1;
+      }
+      if (flips)
+        continue;
+
+      // whole one ring is off limits for the rest of this pass
+      for (uint32_t a = triangle_offsets[collapse.from];
+           a < triangle_offsets[collapse.from + 1]; a++)
+        for (int k = 0; k < 3; k++)
+          touched[result[(size_t)vertex_triangles[a] * 3 + k]] = true;
+      touched[collapse.to] = true;
+
+      collapse_target[collapse.from] = collapse.to;
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      out_error = std::max(out_error, (float)std::sqrt(collapse.cost));
+      triangles_removed += removes;
+      applied++;
+    }
+
+    if (applied == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+      uint32_t a = collapse_target[result[t * 3 + 0]];
+      uint32_t b = collapse_target[result[t * 3 + 1]];
+      uint32_t c = collapse_target[result[t * 3 + 2]];
+      if (a == b || b == c || a == c)
+        continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  return result;
+}
+
+void build_lod_chain(const std::vector<uint32_t> &indices,
+                     const std::vector<float> &positions,
+                     std::vector<uint32_t> &lod_indices,
+                     std::vector<mesh_lod> &lods) {
+  lod_indices.clear();
+  lods.clear();
+  lods.push_back({0, (uint32_t)indices.size(), 0.0f, 0});
+
+  size_t vertex_count = positions.size() / 3;
+  if (indices.size() / 3 < MESH_MIN_LOD_TRIANGLES * 2 || vertex_count == 0)
+    return;
+
+  // no level may drift further than a quarter of the mesh size
+  float extent_min[3], extent_max[3];
+  for (int k = 0; k < 3; k++)
+    extent_min[k] = extent_max[k] = positions[k];
+  for (size_t v = 1; v < vertex_count; v++)
+    for (int k = 0; k < 3; k++) {
+      extent_min[k] = std::min(extent_min[k], positions[v * 3 + k]);
+      extent_max[k] = std::max(extent_max[k], positions[v * 3 + k]);
+    }
+  float diagonal = 0.0f;
+  for (int k = 0; k < 3; k++)
+    diagonal += (extent_max[k] - extent_min[k]) * (extent_max[k] - extent_min[k]);
+  float max_error = 0.25f * std::sqrt(diagonal);
+
+  std::vector<uint32_t> previous = indices;
+  while (lods.size() < MESH_MAX_LODS) {
+    size_t target = previous.size() / 6 * 3;
+    if (target / 3 < MESH_MIN_LOD_TRIANGLES)
+      break;
+
+    float error = 0.0f;
+    std::vector<uint32_t> level =
+        simplify_mesh(previous, positions, target, max_error, error);
+
+    // locked seams etc. can keep a mesh from shrinking any further
+    if (level.size() * 100 > previous.size() * 85)
+      break;
+
+    std::vector<size_t> cluster_starts;
+    level = optimize_vertex_cache(level, vertex_count, cluster_starts);
+
+    // errors of consecutive levels add up, each one simplified the last
+    lods.push_back({(uint32_t)(indices.size() + lod_indices.size()),
+                    (uint32_t)level.size(), lods.back().error + error, 0});
+    lod_indices.insert(lod_indices.end(), level.begin(), level.end());
+    previous.swap(level);
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// lod 0 is the full mesh, every further level roughly halves the triangles
+static const size_t MESH_MAX_LODS = 6;
+
+// levels with fewer triangles than this arent worth a draw call of their own
+static const size_t MESH_MIN_LOD_TRIANGLES = 64;
+
+// one level inside the meshes index buffer. all levels share the vertices
+struct mesh_lod {
+  uint32_t index_offset;
+  uint32_t index_count;
+  // max object space distance to the full mesh (conservative)
+  float error;
+  uint32_t reserved;
+};
+
+// quadric error edge collapse (garland & heckbert), vertices only ever move
+// onto other existing vertices so the result indexes the same streams.
+// vertices on borders and attribute seams (same position, several
+// vertices) stay locked. stops at target_index_count or once the next
+// collapse would cost more than max_error. out_error gets the largest
+// error that was accepted
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t> &indices,
+                                    const std::vector<float> &positions,
+                                    size_t target_index_count, float max_error,
+                                    float &out_error);
+
+// fills lods (lod 0 included) and lod_indices with every level past 0.
+// offsets count from the start of indices, so indices + lod_indices is
+// exactly what goes into the element buffer
+void build_lod_chain(const std::vector<uint32_t> &indices,
+                     const std::vector<float> &positions,
+                     std::vector<uint32_t> &lod_indices,
+                     std::vector<mesh_lod> &lods);
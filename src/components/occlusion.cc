@@ -0,0 +1,350 @@
+#include "occlusion.hh"
+
+#if CORTEX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// stdlib
+#include <algorithm>
+#include <cmath>
+
+void Occlusion_Buffer::begin_frame(int width, int height,
+                                   const glm::mat4 &view_projection) {
+  m_tiles_x = std::max(1, (width + TILE_SIZE - 1) / TILE_SIZE);
+  m_tiles_y = std::max(1, (height + TILE_SIZE - 1) / TILE_SIZE);
+  m_width = m_tiles_x * TILE_SIZE;
+  m_height = m_tiles_y * TILE_SIZE;
+  m_view_projection = view_projection;
+
+  m_level_widths.assign(1, m_width);
+  m_level_heights.assign(1, m_height);
+  while (m_level_widths.back() > 1 || m_level_heights.back() > 1) {
+    m_level_widths.push_back((m_level_widths.back() + 1) / 2);
+    m_level_heights.push_back((m_level_heights.back() + 1) / 2);
+  }
+  m_levels.resize(m_level_widths.size());
+  for (size_t level = 0; level < m_levels.size(); level++)
+    m_levels[level].assign(
+        (size_t)m_level_widths[level] * m_level_heights[level], 1.0f);
+  m_triangles.clear();
+  m_row_bins.resize(m_tiles_y);
+  for (std::vector<uint32_t> &bin : m_row_bins)
+    bin.clear();
+}
+
+void Occlusion_Buffer::add_occluder(const float *positions,
+                                    const uint32_t *indices,
+                                    size_t index_count,
+                                    const glm::mat4 &world) {
+  glm::mat4 local_to_clip = m_view_projection * world;
+
+  for (size_t i = 0; i + 2 < index_count; i += 3) {
+    float x[3], y[3], z[3];
+    bool clipped = false;
+    for (int corner = 0; corner < 3 && !clipped; corner++) {
+      const float *position = positions + (size_t)indices[i + corner] * 3;
+      glm::vec4 clip = local_to_clip *
+                       glm::vec4(position[0], position[1], position[2], 1.0f);
+      if (clip.w <= 0.0f || clip.z < -clip.w) {
+        clipped = true;
+        break;
+      }
+
+      float inverse_w = 1.0f / clip.w;
+      x[corner] = (clip.x * inverse_w * 0.5f + 0.5f) * (float)m_width;
+      y[corner] = (clip.y * inverse_w * 0.5f + 0.5f) * (float)m_height;
+      z[corner] = clip.z * inverse_w * 0.5f + 0.5f;
+    }
+    if (clipped)
+      continue;
+
+    // counter clockwise, both faces get drawn
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (std::fabs(area) < 1e-6f)
+      continue;
+    if (area < 0.0f) {
+      std::swap(x[1], x[2]);
+      std::swap(y[1], y[2]);
+      std::swap(z[1], z[2]);
+      area = -area;
+    }
+
+    // pixel centers at + 0.5, clamped before going to int
+    float min_x = std::max(std::min({x[0], x[1], x[2]}) - 0.5f, 0.0f);
+    float max_x = std::min(std::max({x[0], x[1], x[2]}) - 0.5f,
+                           (float)(m_width - 1));
+    float min_y = std::max(std::min({y[0], y[1], y[2]}) - 0.5f, 0.0f);
+    float max_y = std::min(std::max({y[0], y[1], y[2]}) - 0.5f,
+                           (float)(m_height - 1));
+    if (min_x > max_x || min_y > max_y)
+      continue;
+
+    occluder_triangle triangle;
+    triangle.min_x = (int)std::ceil(min_x);
+    triangle.max_x = (int)std::floor(max_x);
+    triangle.min_y = (int)std::ceil(min_y);
+    triangle.max_y = (int)std::floor(max_y);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+      continue;
+
+    // the whole pixel square is inside an edge when its center is at least
+    // half a pixel (in the edges own metric) in
+    for (int edge = 0; edge < 3; edge++) {
+      int next = (edge + 1) % 3;
+      triangle.edge_a[edge] = y[edge] - y[next];
+      triangle.edge_b[edge] = x[next] - x[edge];
+      triangle.edge_c[edge] =
+          -triangle.edge_a[edge] * x[edge] - triangle.edge_b[edge] * y[edge] -
+          0.5f * (std::fabs(triangle.edge_a[edge]) +
+                  std::fabs(triangle.edge_b[edge]));
+    }
+
+    // farthest the plane gets inside a pixel around the center
+    float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+    float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+    triangle.depth_x = (dz1 * dy2 - dy1 * dz2) / area;
+    triangle.depth_y = (dx1 * dz2 - dz1 * dx2) / area;
+    triangle.depth_c =
+        z[0] - triangle.depth_x * x[0] - triangle.depth_y * y[0] +
+        0.5f * (std::fabs(triangle.depth_x) + std::fabs(triangle.depth_y));
+
+    uint32_t index = (uint32_t)m_triangles.size();
+    m_triangles.push_back(triangle);
+    for (int row = triangle.min_y / TILE_SIZE; row <= triangle.max_y / TILE_SIZE;
+         row++)
+      m_row_bins[row].push_back(index);
+  }
+}
+
+////////////////////////////////////
+// rasterization
+////////////////////////////////////
+
+// pixel rows [y_begin, y_end) of one triangle
+typedef void (*triangle_raster_kernel)(const occluder_triangle &triangle,
+                                       float *depth, int width, int y_begin,
+                                       int y_end);
+
+static void raster_triangle_scalar(const occluder_triangle &triangle,
+                                   float *depth, int width, int y_begin,
+                                   int y_end) {
+  int first_y = std::max(triangle.min_y, y_begin);
+  int last_y = std::min(triangle.max_y, y_end - 1);
+
+  for (int y = first_y; y <= last_y; y++) {
+    float py = (float)y + 0.5f;
+    float *row = depth + (size_t)y * width;
+
+    for (int x = triangle.min_x; x <= triangle.max_x; x++) {
+      float px = (float)x + 0.5f;
+      bool inside = true;
+      for (int edge = 0; edge < 3; edge++)
+        inside &= triangle.edge_a[edge] * px + triangle.edge_b[edge] * py +
+                      triangle.edge_c[edge] >=
+                  0.0f;
+      if (!inside)
+        continue;
+
+      float z = triangle.depth_x * px + triangle.depth_y * py +
+                triangle.depth_c;
+      row[x] = std::min(row[x], z);
+    }
+  }
+}
+
+#if CORTEX_SIMD_X86
+
+// 8 pixels of a row at a time. the buffer width is a multiple of 8, lanes
+// left of the bounding box are rejected by the edges like any other pixel
+CORTEX_TARGET_AVX2 static void
+raster_triangle_avx2(const occluder_triangle &triangle, float *depth,
+                     int width, int y_begin, int y_end) {
+  const __m256 lane_centers =
+      _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 edge_a0 = _mm256_set1_ps(triangle.edge_a[0]);
+  const __m256 edge_a1 = _mm256_set1_ps(triangle.edge_a[1]);
+  const __m256 edge_a2 = _mm256_set1_ps(triangle.edge_a[2]);
+  const __m256 depth_x = _mm256_set1_ps(triangle.depth_x);
+
+  int first_x = triangle.min_x & ~7;
+  int first_y = std::max(triangle.min_y, y_begin);
+  int last_y = std::min(triangle.max_y, y_end - 1);
+
+  for (int y = first_y; y <= last_y; y++) {
+    float py = (float)y + 0.5f;
+    float *row = depth + (size_t)y * width;
+
+    __m256 row_e0 = _mm256_set1_ps(triangle.edge_b[0] * py + triangle.edge_c[0]);
+    __m256 row_e1 = _mm256_set1_ps(triangle.edge_b[1] * py + triangle.edge_c[1]);
+    __m256 row_e2 = _mm256_set1_ps(triangle.edge_b[2] * py + triangle.edge_c[2]);
+    __m256 row_z = _mm256_set1_ps(triangle.depth_y * py + triangle.depth_c);
+
+    for (int x = first_x; x <= triangle.max_x; x += 8) {
+      __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane_centers);
+      __m256 e0 = _mm256_fmadd_ps(edge_a0, px, row_e0);
+      __m256 e1 = _mm256_fmadd_ps(edge_a1, px, row_e1);
+      __m256 e2 = _mm256_fmadd_ps(edge_a2, px, row_e2);
+      __m256 inside = _mm256_and_ps(
+          _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                        _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+          _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+      if (_mm256_movemask_ps(inside) == 0)
+        continue;
+
+      __m256 z = _mm256_fmadd_ps(depth_x, px, row_z);
+      __m256 old_depth = _mm256_loadu_ps(row + x);
+      __m256 new_depth =
+          _mm256_blendv_ps(old_depth, _mm256_min_ps(old_depth, z), inside);
+      _mm256_storeu_ps(row + x, new_depth);
+    }
+  }
+}
+
+#endif
+
+static triangle_raster_kernel get_triangle_raster_kernel(e_simd_level level) {
+#if CORTEX_SIMD_X86
+  // never more than the cpu can actually run
+  level = std::min(level, get_simd_level());
+  if (level == E_SIMD_AVX2)
+    return raster_triangle_avx2;
+#endif
+  return raster_triangle_scalar;
+}
+
+// rows [row_begin, row_end) of level from the one below
+void Occlusion_Buffer::build_level_rows(int level, int row_begin,
+                                        int row_end) {
+  const std::vector<float> &source = m_levels[level - 1];
+  int source_width = m_level_widths[level - 1];
+  int source_height = m_level_heights[level - 1];
+  std::vector<float> &target = m_levels[level];
+  int width = m_level_widths[level];
+
+  for (int y = row_begin; y < row_end; y++) {
+    const float *row0 = source.data() + (size_t)(y * 2) * source_width;
+    const float *row1 = y * 2 + 1 < source_height ? row0 + source_width : row0;
+    for (int x = 0; x < width; x++) {
+      int x1 = std::min(x * 2 + 1, source_width - 1);
+      target[(size_t)y * width + x] = std::max(
+          std::max(row0[x * 2], row0[x1]), std::max(row1[x * 2], row1[x1]));
+    }
+  }
+}
+
+void Occlusion_Buffer::rasterize_tile_row(int tile_row, e_simd_level level) {
+  triangle_raster_kernel raster_triangle = get_triangle_raster_kernel(level);
+  int y_begin = tile_row * TILE_SIZE;
+  int y_end = y_begin + TILE_SIZE;
+
+  for (uint32_t index : m_row_bins[tile_row])
+    raster_triangle(m_triangles[index], m_levels[0].data(), m_width, y_begin,
+                    y_end);
+
+  // the buffer is whole tiles, so the first levels of the pyramid line up
+  // with this row exactly
+  for (int pyramid_level = 1;
+       pyramid_level <= TILE_LEVELS && pyramid_level < (int)m_levels.size();
+       pyramid_level++) {
+    int rows = TILE_SIZE >> pyramid_level;
+    build_level_rows(pyramid_level, tile_row * rows, (tile_row + 1) * rows);
+  }
+}
+
+void Occlusion_Buffer::rasterize(Thread_Pool *pool, e_simd_level level) {
+  if (pool && m_tiles_y > 1 && !m_triangles.empty()) {
+    pool->parallel_for(m_tiles_y, [&](size_t tile_row) {
+      rasterize_tile_row((int)tile_row, level);
+    });
+  } else {
+    for (int tile_row = 0; tile_row < m_tiles_y; tile_row++)
+      rasterize_tile_row(tile_row, level);
+  }
+
+  // whats left is at most 1 / TILE_SIZE^2 of the buffer
+  for (int pyramid_level = TILE_LEVELS + 1;
+       pyramid_level < (int)m_levels.size(); pyramid_level++)
+    build_level_rows(pyramid_level, 0, m_level_heights[pyramid_level]);
+}
+
+////////////////////////////////////
+// occludee test
+////////////////////////////////////
+
+// anything under texel (x, y) of level that is inside rect and at least as
+// far as nearest
+bool Occlusion_Buffer::is_texel_visible(int level, int x, int y,
+                                        const pixel_rect &rect,
+                                        float nearest) const {
+  if (m_levels[level][(size_t)y * m_level_widths[level] + x] < nearest)
+    return false;
+  if (level == 0)
+    return true;
+
+  // children that overlap the rect, in level 0 pixels they are
+  // [child << shift, ((child + 1) << shift) - 1]
+  int shift = level - 1;
+  for (int child_y = y * 2; child_y <= y * 2 + 1; child_y++) {
+    if (child_y >= m_level_heights[level - 1] ||
+        (child_y << shift) > rect.max_y ||
+        ((child_y + 1) << shift) - 1 < rect.min_y)
+      continue;
+    for (int child_x = x * 2; child_x <= x * 2 + 1; child_x++) {
+      if (child_x >= m_level_widths[level - 1] ||
+          (child_x << shift) > rect.max_x ||
+          ((child_x + 1) << shift) - 1 < rect.min_x)
+        continue;
+      if (is_texel_visible(level - 1, child_x, child_y, rect, nearest))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool Occlusion_Buffer::is_visible(const glm::vec3 &min,
+                                  const glm::vec3 &max) const {
+  float min_x = INFINITY, max_x = -INFINITY;
+  float min_y = INFINITY, max_y = -INFINITY;
+  float nearest = INFINITY;
+
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec4 point = glm::vec4(corner & 1 ? max.x : min.x,
+                                corner & 2 ? max.y : min.y,
+                                corner & 4 ? max.z : min.z, 1.0f);
+    glm::vec4 clip = m_view_projection * point;
+    if (clip.w <= 0.0f || clip.z < -clip.w)
+      return true;
+
+    float inverse_w = 1.0f / clip.w;
+    float x = (clip.x * inverse_w * 0.5f + 0.5f) * (float)m_width;
+    float y = (clip.y * inverse_w * 0.5f + 0.5f) * (float)m_height;
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    nearest = std::min(nearest, clip.z * inverse_w * 0.5f + 0.5f);
+  }
+
+  // every pixel the box touches at all
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= (float)m_width ||
+      min_y >= (float)m_height)
+    return true;
+  pixel_rect rect;
+  rect.min_x = std::max((int)std::floor(min_x), 0);
+  rect.max_x = std::min((int)std::floor(max_x), m_width - 1);
+  rect.min_y = std::max((int)std::floor(min_y), 0);
+  rect.max_y = std::min((int)std::floor(max_y), m_height - 1);
+
+  int level = 0;
+  while (level + 1 < (int)m_levels.size() &&
+         ((rect.max_x >> level) - (rect.min_x >> level) > 1 ||
+          (rect.max_y >> level) - (rect.min_y >> level) > 1))
+    level++;
+
+  for (int y = rect.min_y >> level; y <= rect.max_y >> level; y++)
+    for (int x = rect.min_x >> level; x <= rect.max_x >> level; x++)
+      if (is_texel_visible(level, x, y, rect, nearest))
+        return true;
+  return false;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "simd.hh"
+#include "threadpool.hh"
+
+#include <glm/glm.hpp>
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one occluder triangle after setup, in pixels of the occlusion buffer.
+// edge i is a * x + b * y + c >= 0 at the centers of pixels the triangle
+// covers completely (the edges are moved in by half a pixel). depth is a
+// plane over the screen, moved back to the farthest point of each pixel
+struct occluder_triangle {
+  float edge_a[3];
+  float edge_b[3];
+  float edge_c[3];
+  float depth_x;
+  float depth_y;
+  float depth_c;
+  // pixels whose centers the triangle can cover, inclusive
+  int min_x;
+  int max_x;
+  int min_y;
+  int max_y;
+};
+
+// software occlusion culling. occluder triangles get rasterized on the cpu
+// into a small depth buffer (0..1 like gl) and a max pyramid is built on
+// top of it. boxes whose nearest point is behind everything in the pixels
+// they touch are hidden. rasterization is conservative: a pixel only takes
+// a triangle that covers all of it, at the triangles farthest depth inside
+// it, so a box is never hidden by less than the occluders really cover.
+// rows of tiles are independent, they and the pyramid levels below
+// TILE_SIZE get built in parallel
+class Occlusion_Buffer {
+public:
+  static const int TILE_SIZE = 8;
+  // pyramid levels that fit inside one row of tiles, log2(TILE_SIZE)
+  static const int TILE_LEVELS = 3;
+
+  // clears, width / height get rounded up to whole tiles
+  void begin_frame(int width, int height, const glm::mat4 &view_projection);
+
+  // index_count / 3 triangles of local xyz positions through world.
+  // triangles reaching in front of the near plane are left out, the part gl
+  // clips away doesnt hide anything
+  void add_occluder(const float *positions, const uint32_t *indices,
+                    size_t index_count, const glm::mat4 &world);
+
+  // everything added since begin_frame plus the pyramid, rows of tiles
+  // spread over the pool
+  void rasterize(Thread_Pool *pool, e_simd_level level = get_simd_level());
+
+  // world aabb against the buffer, starting at the pyramid level where the
+  // box covers at most 2x2 texels and going finer only where that isnt
+  // enough. boxes reaching in front of the near plane or completely off
+  // screen count as visible
+  bool is_visible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  size_t level_count() const { return m_levels.size(); }
+  size_t triangle_count() const { return m_triangles.size(); }
+
+private:
+  // inclusive pixel range of level 0
+  struct pixel_rect {
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+  };
+
+  void rasterize_tile_row(int tile_row, e_simd_level level);
+  void build_level_rows(int level, int row_begin, int row_end);
+  bool is_texel_visible(int level, int x, int y, const pixel_rect &rect,
+                        float nearest) const;
+
+  int m_width = 0;
+  int m_height = 0;
+  int m_tiles_x = 0;
+  int m_tiles_y = 0;
+  glm::mat4 m_view_projection = glm::mat4(1.0f);
+
+  // level 0 is the depth buffer, every level above the max of 2x2 below
+  // (rounded up, the last row / column takes what is there) down to 1x1
+  std::vector<std::vector<float>> m_levels;
+  std::vector<int> m_level_widths;
+  std::vector<int> m_level_heights;
+  std::vector<occluder_triangle> m_triangles;
+  // triangles touching each row of tiles
+  std::vector<std::vector<uint32_t>> m_row_bins;
+};
@@ -31,14 +31,15 @@ Mesh Physics_Manager::create_collision_box_mesh(const AABB &box) {
     vertices.insert(vertices.end(), {v2.x, v2.y, v2.z});
   }
 
-  Shader wireframe_shader("src/shaders/shader_src/wireframe.vert",
-                          "src/shaders/shader_src/wireframe.frag");
-  Material material(E_PHONG, wireframe_shader);
+  Material material(E_PHONG,
+                    m_shader_cache->get("src/shaders/shader_src/wireframe.vert",
+                                        "src/shaders/shader_src/wireframe.frag"));
 
   Mesh mesh(material);
   mesh.m_vertices_array = std::move(vertices);
   mesh.m_render_mode = E_WIREFRAME;
   mesh.m_type = E_COL_BOX;
+  mesh.update_bounds();
 
   return mesh;
 }
@@ -47,13 +48,11 @@ AABB Physics_Manager::compute_world_space_aabb(const Mesh &mesh,
                                                const glm::mat4 &transform) {
   AABB bbox{{10000.0f, 10000.0f, 10000.0f}, {-10000.0f, -10000.0f, -10000.0f}};
 
-  const glm::mat4 mesh_transform = transform * mesh.m_model_matrix;
-
   for (size_t i = 0; i + 2 < mesh.m_vertices_array.size(); i += 3) {
     glm::vec4 vertex{mesh.m_vertices_array[i], mesh.m_vertices_array[i + 1],
                      mesh.m_vertices_array[i + 2], 1.0f};
 
-    vertex = mesh_transform * vertex;
+    vertex = transform * vertex;
 
     bbox.min.x = std::min(bbox.min.x, vertex.x);
     bbox.min.y = std::min(bbox.min.y, vertex.y);
@@ -74,7 +73,6 @@ void Physics_Manager::calculate_phys_boxes() {
             << m_active_scene->m_loaded_entities.size() << std::endl;
 
   for (Entity &entity : m_active_scene->m_loaded_entities) {
-    glm::mat4 entity_transform = entity.m_model_matrix;
     std::cout << "Entity contains meshes: " << entity.m_mesh.size()
               << std::endl;
 
@@ -90,9 +88,17 @@ void Physics_Manager::calculate_phys_boxes() {
         continue;
       }
 
-      AABB bbox = compute_world_space_aabb(mesh, entity_transform);
-      Mesh col_box = create_collision_box_mesh(bbox);
-      mesh_buffer.push_back(col_box);
+      // one box per instance, they are separate objects after all
+      if (mesh.m_instance_matrices.empty()) {
+        AABB bbox = compute_world_space_aabb(
+            mesh, m_active_scene->get_mesh_world_matrix(entity, mesh));
+        mesh_buffer.push_back(create_collision_box_mesh(bbox));
+      }
+      for (size_t i = 0; i < mesh.m_instance_matrices.size(); i++) {
+        AABB bbox = compute_world_space_aabb(
+            mesh, m_active_scene->get_instance_world_matrix(entity, mesh, i));
+        mesh_buffer.push_back(create_collision_box_mesh(bbox));
+      }
 
       log_success("Calculated hitbox for mesh!");
     }
@@ -3,6 +3,7 @@
 #include <memory>
 #include "mesh.hh"
 #include "scene.hh"
+#include "shadercache.hh"
 
 struct AABB {
     glm::vec3 min;
@@ -13,6 +14,7 @@ class Physics_Manager {
 public:
   
   std::shared_ptr<Scene> m_active_scene = nullptr;
+  Shader_Cache* m_shader_cache = nullptr;
   bool m_phys_boxes_initialized = false;
   
   Physics_Manager(std::shared_ptr<Scene> set_scene);
@@ -0,0 +1,114 @@
+#include "renderqueue.hh"
+
+// stdlib
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t PROGRAM_BITS = 12;
+static const uint32_t TEXTURE_BITS = 14;
+static const uint32_t VAO_BITS = 16;
+
+static const uint32_t VAO_SHIFT = Render_Queue::DEPTH_BITS;
+static const uint32_t TEXTURE_SHIFT = VAO_SHIFT + VAO_BITS;
+static const uint32_t PROGRAM_SHIFT = TEXTURE_SHIFT + TEXTURE_BITS;
+static const uint32_t LAYER_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+
+static uint32_t get_dense_id(std::unordered_map<uint32_t, uint32_t> &ids,
+                             uint32_t name, uint32_t first_id,
+                             uint32_t field_bits) {
+  auto [found, inserted] = ids.try_emplace(name, 0);
+  if (inserted)
+    found->second = std::min<uint32_t>(first_id + (uint32_t)ids.size() - 1,
+                                       (1u << field_bits) - 1);
+  return found->second;
+}
+
+void Render_Queue::clear() {
+  m_items.clear();
+  m_program_ids.clear();
+  m_texture_ids.clear();
+  m_vao_ids.clear();
+}
+
+uint32_t Render_Queue::program_id(uint32_t program) {
+  return get_dense_id(m_program_ids, program, 0, PROGRAM_BITS);
+}
+
+uint32_t Render_Queue::texture_id(uint32_t texture) {
+  if (texture == 0)
+    return 0;
+  return get_dense_id(m_texture_ids, texture, 1, TEXTURE_BITS);
+}
+
+uint32_t Render_Queue::vao_id(uint32_t vao) {
+  return get_dense_id(m_vao_ids, vao, 0, VAO_BITS);
+}
+
+uint32_t Render_Queue::quantize_depth(float distance, float far_plane) {
+  const uint32_t max_depth = (1u << DEPTH_BITS) - 1;
+  if (!(distance > 0.0f) || far_plane <= 0.0f)
+    return 0;
+  if (distance >= far_plane)
+    return max_depth;
+  return (uint32_t)(distance / far_plane * (float)max_depth);
+}
+
+void Render_Queue::push(e_render_layer layer, uint32_t program_id,
+                        uint32_t texture_id, uint32_t vao_id, uint32_t depth,
+                        Mesh *mesh) {
+  uint64_t key = (uint64_t)(layer & 3) << LAYER_SHIFT |
+                 (uint64_t)program_id << PROGRAM_SHIFT |
+                 (uint64_t)texture_id << TEXTURE_SHIFT |
+                 (uint64_t)vao_id << VAO_SHIFT |
+                 (uint64_t)(depth & ((1u << DEPTH_BITS) - 1));
+  m_items.push_back({key, mesh});
+}
+
+void Render_Queue::sort() {
+  size_t count = m_items.size();
+  if (count < 2)
+    return;
+
+  // all eight histograms in one go
+  uint32_t histograms[8][256];
+  memset(histograms, 0, sizeof(histograms));
+  for (const render_item &item : m_items)
+    for (int byte = 0; byte < 8; byte++)
+      histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+
+  m_scratch.resize(count);
+  for (int byte = 0; byte < 8; byte++) {
+    uint32_t *histogram = histograms[byte];
+
+    // every key has the same byte here, nothing would move
+    if (histogram[(m_items[0].key >> (byte * 8)) & 0xFF] == count)
+      continue;
+
+    uint32_t offset = 0;
+    for (int bucket = 0; bucket < 256; bucket++) {
+      uint32_t bucket_count = histogram[bucket];
+      histogram[bucket] = offset;
+      offset += bucket_count;
+    }
+
+    for (const render_item &item : m_items)
+      m_scratch[histogram[(item.key >> (byte * 8)) & 0xFF]++] = item;
+    m_items.swap(m_scratch);
+  }
+}
+
+void Bind_Cache::reset() {
+  for (uint64_t &bound : m_bound)
+    bound = UNKNOWN;
+}
+
+bool Bind_Cache::change(e_bind_slot slot, uint32_t value) {
+  if (m_bound[slot] == value) {
+    m_binds_skipped++;
+    return false;
+  }
+
+  m_bound[slot] = value;
+  m_binds++;
+  return true;
+}
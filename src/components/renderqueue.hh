@@ -0,0 +1,106 @@
+#pragma once
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Mesh;
+
+// draws of one pass as 64 bit sort keys. sorting them clusters draws with
+// the same state and, inside one state, orders them front to back so early
+// z rejects as much as possible. key layout, high to low bits:
+//
+//   63..62  layer    (e_render_layer, filled before wireframe)
+//   61..50  program  (dense per queue ids, first seen order)
+//   49..36  texture
+//   35..20  vao
+//   19..0   depth    (quantized distance to the eye, near first)
+//
+// ids that dont fit their field share the last value, that only costs some
+// grouping, the submission compares the real gl names anyway
+
+enum e_render_layer : uint8_t {
+  E_RENDER_LAYER_FILLED = 0,
+  E_RENDER_LAYER_WIREFRAME = 1,
+};
+
+struct render_item {
+  uint64_t key;
+  Mesh *mesh;
+};
+
+class Render_Queue {
+public:
+  static const uint32_t DEPTH_BITS = 20;
+
+  // drops the items and the id tables, once per frame and pass
+  void clear();
+
+  // dense ids for the key fields. 0 stays "none" for textures
+  uint32_t program_id(uint32_t program);
+  uint32_t texture_id(uint32_t texture);
+  uint32_t vao_id(uint32_t vao);
+
+  // distance in [0, far_plane] -> depth field, clamped
+  static uint32_t quantize_depth(float distance, float far_plane);
+
+  void push(e_render_layer layer, uint32_t program_id, uint32_t texture_id,
+            uint32_t vao_id, uint32_t depth, Mesh *mesh);
+
+  // lsd radix sort over the key bytes, bytes that are the same for every
+  // item are skipped (usually the layer and most of the ids)
+  void sort();
+
+  const std::vector<render_item> &items() const { return m_items; }
+  size_t size() const { return m_items.size(); }
+
+private:
+  std::vector<render_item> m_items;
+  std::vector<render_item> m_scratch;
+
+  std::unordered_map<uint32_t, uint32_t> m_program_ids;
+  std::unordered_map<uint32_t, uint32_t> m_texture_ids;
+  std::unordered_map<uint32_t, uint32_t> m_vao_ids;
+};
+
+// consecutive queue items that share every bound state and go out
+// together. command_count > 0 means one multi draw over the frames indirect
+// commands [first_command, first_command + command_count)
+struct draw_batch {
+  uint32_t first_item;
+  uint32_t item_count;
+  uint32_t first_command;
+  uint32_t command_count;
+};
+
+enum e_bind_slot : uint8_t {
+  E_BIND_PROGRAM,
+  E_BIND_VAO,
+  E_BIND_POLYGON_MODE,
+  E_BIND_ACTIVE_TEXTURE,
+  // 2d texture per unit, see TEXTURE_UNIT_* in shaderclass.hh
+  E_BIND_TEXTURE_UNIT_0,
+  E_BIND_TEXTURE_UNIT_1,
+  E_BIND_SLOT_COUNT,
+};
+
+// what was bound last while submitting a queue. no gl calls in here, the
+// renderer asks before binding and skips whatever wouldnt change anything
+class Bind_Cache {
+public:
+  // forget everything, gl state might have been touched in between
+  void reset();
+
+  // true = value differs from the bound one and has to be bound now
+  bool change(e_bind_slot slot, uint32_t value);
+
+  size_t m_binds = 0;
+  size_t m_binds_skipped = 0;
+
+private:
+  static const uint64_t UNKNOWN = UINT64_MAX;
+  uint64_t m_bound[E_BIND_SLOT_COUNT] = {UNKNOWN, UNKNOWN, UNKNOWN,
+                                         UNKNOWN, UNKNOWN, UNKNOWN};
+};
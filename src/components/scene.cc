@@ -1,11 +1,74 @@
 #include "scene.hh"
 
-void Scene::add_entity_to_scene(Entity to_add) {
+void Scene::add_entity_to_scene(Entity to_add,
+                                const std::vector<scene_node_desc> &nodes) {
 
+  // entity roots are top level, appending one never moves other nodes
+  to_add.m_scene_node = m_graph.add_node(SCENE_NODE_NONE, to_add.m_model_matrix);
+  m_graph.insert_subtree(to_add.m_scene_node, nodes);
   m_loaded_entities.push_back(to_add);
   
 }
 
+void Scene::set_entity_nodes(size_t entity_index,
+                             const std::vector<scene_node_desc> &nodes) {
+
+  Entity &entity = m_loaded_entities[entity_index];
+  uint32_t first = m_graph.insert_subtree(entity.m_scene_node, nodes);
+
+  // roots of later entities moved back with everything else
+  for (auto &other : m_loaded_entities)
+    if (other.m_scene_node != SCENE_NODE_NONE && other.m_scene_node >= first)
+      other.m_scene_node += (uint32_t)nodes.size();
+}
+
+glm::mat4 Scene::get_mesh_world_matrix(const Entity &entity,
+                                       const Mesh &mesh) const {
+
+  if (entity.m_scene_node == SCENE_NODE_NONE)
+    return entity.m_model_matrix * mesh.m_model_matrix;
+
+  // meshes made at runtime (hitboxes etc.) have no node of their own
+  if (mesh.m_scene_node == SCENE_NODE_NONE)
+    return m_graph.world_matrix(entity.m_scene_node) * mesh.m_model_matrix;
+
+  return m_graph.world_matrix(get_entity_node(entity, mesh.m_scene_node));
+}
+
+glm::mat4 Scene::get_instance_world_matrix(const Entity &entity,
+                                           const Mesh &mesh,
+                                           size_t instance) const {
+
+  if (entity.m_scene_node == SCENE_NODE_NONE)
+    return entity.m_model_matrix * mesh.m_instance_matrices[instance];
+
+  if (mesh.m_instance_nodes.empty())
+    return m_graph.world_matrix(entity.m_scene_node) *
+           mesh.m_instance_matrices[instance];
+
+  return m_graph.world_matrix(
+      get_entity_node(entity, mesh.m_instance_nodes[instance]));
+}
+
+bool Scene::mesh_transform_changed(const Entity &entity,
+                                   const Mesh &mesh) const {
+
+  if (entity.m_scene_node == SCENE_NODE_NONE)
+    return false;
+
+  if (mesh.m_scene_node != SCENE_NODE_NONE)
+    return m_graph.updated_last_frame(
+        get_entity_node(entity, mesh.m_scene_node));
+
+  if (mesh.m_instance_nodes.empty())
+    return m_graph.updated_last_frame(entity.m_scene_node);
+
+  for (uint32_t node : mesh.m_instance_nodes)
+    if (m_graph.updated_last_frame(get_entity_node(entity, node)))
+      return true;
+  return false;
+}
+
 
 void Scene::add_light_to_scene(Light to_add) {
 
@@ -3,6 +3,7 @@
 #include "entity.hh"
 #include "light.hh"
 #include "camera.hh"
+#include "scenegraph.hh"
 
 #include <GLFW/glfw3.h>
 #include <glm/ext/matrix_transform.hpp>
@@ -19,12 +20,36 @@
 class Scene {
 public:
 
-  void add_entity_to_scene(Entity to_add);
+  // nodes = the hierarchy the entities meshes refer to (see
+  // Mesh::m_scene_node), it ends up below the entities own root node
+  void add_entity_to_scene(Entity to_add,
+                           const std::vector<scene_node_desc> &nodes = {});
   void add_light_to_scene(Light to_add);
-  
+
+  // hierarchy for an entity that is already in the scene (streaming).
+  // only valid while none of its meshes refer to nodes yet
+  void set_entity_nodes(size_t entity_index,
+                        const std::vector<scene_node_desc> &nodes);
+
+  // world matrix of a mesh that isnt instanced / of one instance
+  glm::mat4 get_mesh_world_matrix(const Entity &entity, const Mesh &mesh) const;
+  glm::mat4 get_instance_world_matrix(const Entity &entity, const Mesh &mesh,
+                                      size_t instance) const;
+
+  // whether any node the mesh depends on moved in the last update
+  bool mesh_transform_changed(const Entity &entity, const Mesh &mesh) const;
+
+  // graph index of a node of the entities hierarchy
+  uint32_t get_entity_node(const Entity &entity, uint32_t node) const {
+    return entity.m_scene_node + 1 + node;
+  }
+
   std::vector<Entity> m_loaded_entities; 
   std::vector<Light> m_loaded_lights;
 
+  // every entity root and everything imported below it
+  Scene_Graph m_graph;
+
   std::unique_ptr<Camera> m_camera;
 
   bool m_scene_vbos_need_refresh = false;
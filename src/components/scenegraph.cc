@@ -0,0 +1,131 @@
+#include "scenegraph.hh"
+
+#include <glm/gtc/type_ptr.hpp>
+
+// stdlib
+#include <algorithm>
+#include <cstring>
+
+void Scene_Graph::clear() {
+  m_parents.clear();
+  m_subtree_sizes.clear();
+  m_local_matrices.clear();
+  m_world_matrices.clear();
+  m_world_versions.clear();
+  m_dirty_nodes.clear();
+}
+
+uint32_t Scene_Graph::insert_subtree(uint32_t parent,
+                                     const std::vector<scene_node_desc> &nodes) {
+  uint32_t first = parent == SCENE_NODE_NONE
+                       ? (uint32_t)size()
+                       : parent + m_subtree_sizes[parent];
+  uint32_t count = (uint32_t)nodes.size();
+  if (count == 0)
+    return first;
+
+  // everything behind the insertion point moves back
+  for (uint32_t &node_parent : m_parents)
+    if (node_parent != SCENE_NODE_NONE && node_parent >= first)
+      node_parent += count;
+  for (uint32_t &dirty : m_dirty_nodes)
+    if (dirty >= first)
+      dirty += count;
+
+  std::vector<uint32_t> parents(count);
+  std::vector<glm::mat4> locals(count);
+  for (uint32_t i = 0; i < count; i++) {
+    parents[i] = nodes[i].parent == SCENE_NODE_NONE ? parent
+                                                     : first + nodes[i].parent;
+    locals[i] = glm::make_mat4(nodes[i].local_matrix);
+  }
+
+  // subtree sizes of the table itself, children come after their parents
+  std::vector<uint32_t> sizes(count, 1);
+  for (uint32_t i = count; i-- > 0;)
+    if (nodes[i].parent != SCENE_NODE_NONE)
+      sizes[nodes[i].parent] += sizes[i];
+
+  m_parents.insert(m_parents.begin() + first, parents.begin(), parents.end());
+  m_subtree_sizes.insert(m_subtree_sizes.begin() + first, sizes.begin(),
+                         sizes.end());
+  m_local_matrices.insert(m_local_matrices.begin() + first, locals.begin(),
+                          locals.end());
+  m_world_matrices.insert(m_world_matrices.begin() + first, count,
+                          glm::mat4(1.0f));
+  m_world_versions.insert(m_world_versions.begin() + first, count, 0);
+
+  for (uint32_t ancestor = parent; ancestor != SCENE_NODE_NONE;
+       ancestor = m_parents[ancestor])
+    m_subtree_sizes[ancestor] += count;
+
+  // the table roots cover the whole insert, that is all update() needs
+  for (uint32_t i = 0; i < count; i++)
+    if (nodes[i].parent == SCENE_NODE_NONE)
+      m_dirty_nodes.push_back(first + i);
+
+  return first;
+}
+
+uint32_t Scene_Graph::add_node(uint32_t parent, const glm::mat4 &local_matrix) {
+  scene_node_desc node;
+  node.parent = SCENE_NODE_NONE;
+  memcpy(node.local_matrix, glm::value_ptr(local_matrix),
+         sizeof(node.local_matrix));
+  return insert_subtree(parent, {node});
+}
+
+void Scene_Graph::set_local_matrix(uint32_t node,
+                                   const glm::mat4 &local_matrix) {
+  m_local_matrices[node] = local_matrix;
+  m_dirty_nodes.push_back(node);
+}
+
+size_t Scene_Graph::update() {
+  m_update_count++;
+  if (m_dirty_nodes.empty())
+    return 0;
+
+  // depth first order: a dirty node inside an earlier dirty subtree is
+  // covered by that one already
+  std::sort(m_dirty_nodes.begin(), m_dirty_nodes.end());
+
+  size_t updated = 0;
+  uint32_t covered_end = 0;
+  for (uint32_t root : m_dirty_nodes) {
+    if (root < covered_end)
+      continue;
+
+    uint32_t end = root + m_subtree_sizes[root];
+    for (uint32_t node = root; node < end; node++) {
+      uint32_t parent = m_parents[node];
+      m_world_matrices[node] =
+          parent == SCENE_NODE_NONE
+              ? m_local_matrices[node]
+              : m_world_matrices[parent] * m_local_matrices[node];
+      m_world_versions[node] = m_update_count;
+    }
+
+    updated += end - root;
+    covered_end = end;
+  }
+
+  m_dirty_nodes.clear();
+  return updated;
+}
+
+std::vector<scene_node_desc> Scene_Graph::export_subtree(uint32_t node) const {
+  std::vector<scene_node_desc> nodes;
+  uint32_t first = node + 1;
+  uint32_t end = node + m_subtree_sizes[node];
+
+  nodes.resize(end - first);
+  for (uint32_t i = first; i < end; i++) {
+    scene_node_desc &desc = nodes[i - first];
+    desc.parent = m_parents[i] == node ? SCENE_NODE_NONE : m_parents[i] - first;
+    memcpy(desc.local_matrix, glm::value_ptr(m_local_matrices[i]),
+           sizeof(desc.local_matrix));
+  }
+
+  return nodes;
+}
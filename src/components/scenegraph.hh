@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+static const uint32_t SCENE_NODE_NONE = 0xFFFFFFFF;
+
+// one node of an imported hierarchy. parent indexes the same table and
+// always comes before the node (depth first), SCENE_NODE_NONE for roots
+struct scene_node_desc {
+  uint32_t parent;
+  float local_matrix[16];
+};
+
+// transform hierarchy in flat depth first arrays. the subtree of node i is
+// exactly [i, i + m_subtree_sizes[i]), so propagating a change is one
+// linear walk over that range and never touches the rest of the scene
+class Scene_Graph {
+public:
+  std::vector<uint32_t> m_parents;
+  std::vector<uint32_t> m_subtree_sizes;
+  std::vector<glm::mat4> m_local_matrices;
+  std::vector<glm::mat4> m_world_matrices;
+
+  // update() count when the world matrix was last recomputed
+  std::vector<uint64_t> m_world_versions;
+
+  size_t size() const { return m_parents.size(); }
+  void clear();
+
+  // inserts nodes (parents relative to the table, roots hang below parent)
+  // at the end of parents subtree. returns the index of nodes[0]. every
+  // index >= that moves back by nodes.size(), callers holding node indices
+  // past the insertion point have to shift them
+  uint32_t insert_subtree(uint32_t parent,
+                          const std::vector<scene_node_desc> &nodes);
+  uint32_t add_node(uint32_t parent, const glm::mat4 &local_matrix);
+
+  void set_local_matrix(uint32_t node, const glm::mat4 &local_matrix);
+  const glm::mat4 &world_matrix(uint32_t node) const {
+    return m_world_matrices[node];
+  }
+
+  // recomputes the world matrices of every subtree below a changed local
+  // matrix. returns the number of nodes that got updated
+  size_t update();
+
+  uint64_t update_count() const { return m_update_count; }
+  bool updated_last_frame(uint32_t node) const {
+    return m_world_versions[node] == m_update_count;
+  }
+
+  // nodes below node (node itself excluded) as a table for insert_subtree
+  std::vector<scene_node_desc> export_subtree(uint32_t node) const;
+
+private:
+  std::vector<uint32_t> m_dirty_nodes;
+  uint64_t m_update_count = 0;
+};
@@ -0,0 +1,249 @@
+#include "shadercache.hh"
+#include "logging.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// "CXPB" + format version of the files in the binary cache
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x42505843;
+static const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct program_binary_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t binary_format;
+  uint32_t binary_length;
+};
+
+// fnv-1a, only used to name cache files
+static uint64_t hash_string(const std::string &data, uint64_t hash) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static std::string inject_defines(const std::string &source,
+                                  const std::vector<std::string> &defines) {
+  if (defines.empty())
+    return source;
+
+  std::string define_block;
+  for (const auto &define : defines)
+    define_block += "#define " + define + "\n";
+
+  // #version has to stay the first statement
+  size_t insert_at = 0;
+  if (source.compare(0, 8, "#version") == 0) {
+    size_t line_end = source.find('\n');
+    insert_at = line_end == std::string::npos ? source.size() : line_end + 1;
+  }
+
+  std::string injected = source;
+  injected.insert(insert_at, define_block);
+  return injected;
+}
+
+Shader_Cache::Shader_Cache(const Gl_Caps *gl_caps,
+                           const std::string &binary_cache_dir)
+    : m_gl_caps(gl_caps), m_binary_cache_dir(binary_cache_dir) {
+
+  m_binary_cache_enabled = m_gl_caps && m_gl_caps->m_has_program_binary;
+  if (!m_binary_cache_enabled) {
+    log_debug("no program binary support, shaders always get compiled");
+    return;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(m_binary_cache_dir, ec);
+  if (ec) {
+    log_error("couldnt create shader cache dir " + m_binary_cache_dir + ": " +
+              ec.message());
+    m_binary_cache_enabled = false;
+  }
+}
+
+const std::string &Shader_Cache::load_source(const std::string &path) {
+  auto found = m_sources.find(path);
+  if (found != m_sources.end())
+    return found->second;
+
+  std::ifstream shader_file(path);
+  if (!shader_file)
+    log_error("couldnt read shader source: " + path);
+
+  std::stringstream shader_stream;
+  shader_stream << shader_file.rdbuf();
+  return m_sources.emplace(path, shader_stream.str()).first->second;
+}
+
+std::string Shader_Cache::binary_path(uint64_t hash) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+  return (std::filesystem::path(m_binary_cache_dir) / name).string();
+}
+
+GLuint Shader_Cache::load_program_binary(uint64_t hash) {
+  std::ifstream binary_file(binary_path(hash), std::ios::binary);
+  if (!binary_file)
+    return 0;
+
+  program_binary_header header;
+  if (!binary_file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != PROGRAM_BINARY_MAGIC ||
+      header.version != PROGRAM_BINARY_VERSION || header.binary_length == 0)
+    return 0;
+
+  std::vector<char> binary(header.binary_length);
+  if (!binary_file.read(binary.data(), binary.size()))
+    return 0;
+
+  GLuint program = glCreateProgram();
+  m_gl_caps->glProgramBinary(program, header.binary_format, binary.data(),
+                             (GLsizei)binary.size());
+
+  // drivers reject binaries after updates etc, thats what the fallback is for
+  GLint link_status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  if (!link_status) {
+    glDeleteProgram(program);
+    m_num_binary_rejects++;
+    log_debug_sub("driver rejected cached program binary, recompiling");
+    return 0;
+  }
+
+  return program;
+}
+
+void Shader_Cache::save_program_binary(uint64_t hash, GLuint program) {
+  GLint binary_length = 0;
+  glGetProgramiv(program, CX_GL_PROGRAM_BINARY_LENGTH, &binary_length);
+  if (binary_length <= 0)
+    return;
+
+  std::vector<char> binary(binary_length);
+  GLenum binary_format = 0;
+  GLsizei written = 0;
+  m_gl_caps->glGetProgramBinary(program, binary_length, &written,
+                                &binary_format, binary.data());
+  if (written <= 0)
+    return;
+
+  program_binary_header header{PROGRAM_BINARY_MAGIC, PROGRAM_BINARY_VERSION,
+                               binary_format, (uint32_t)written};
+
+  // write + rename, a crash mid write never leaves a half file behind
+  std::string final_path = binary_path(hash);
+  std::string temp_path = final_path + ".tmp";
+  {
+    std::ofstream binary_file(temp_path, std::ios::binary | std::ios::trunc);
+    binary_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    binary_file.write(binary.data(), written);
+    if (!binary_file) {
+      log_error("couldnt write program binary " + temp_path);
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(temp_path, final_path, ec);
+  if (ec)
+    log_error("couldnt store program binary " + final_path);
+}
+
+Shader_Handle Shader_Cache::get(const std::string &vertex_path,
+                                const std::string &fragment_path,
+                                const std::vector<std::string> &defines) {
+  m_num_requests++;
+
+  std::string vertex_code = inject_defines(load_source(vertex_path), defines);
+  std::string fragment_code =
+      inject_defines(load_source(fragment_path), defines);
+
+  // keyed by the final sources, so two paths with the same code share too
+  std::string key = vertex_code;
+  key += '\0';
+  key += fragment_code;
+
+  auto found = m_programs.find(key);
+  if (found != m_programs.end()) {
+    if (Shader_Handle alive = found->second.lock())
+      return alive;
+  }
+
+  Shader_Handle program = nullptr;
+  uint64_t binary_hash = 0;
+
+  if (m_binary_cache_enabled) {
+    // defines are part of the sources already
+    binary_hash = hash_string(key, 0xcbf29ce484222325ull);
+    binary_hash = hash_string(m_gl_caps->driver_string(), binary_hash);
+
+    auto load_start = std::chrono::steady_clock::now();
+    GLuint cached_program = load_program_binary(binary_hash);
+    if (cached_program != 0) {
+      program = Shader::from_program(cached_program);
+      m_num_binary_loads++;
+      m_binary_load_seconds += seconds_since(load_start);
+    }
+  }
+
+  if (!program) {
+    auto compile_start = std::chrono::steady_clock::now();
+
+    const Gl_Caps *gl_caps = m_binary_cache_enabled ? m_gl_caps : nullptr;
+    program = Shader::from_source(
+        vertex_code, fragment_code, [gl_caps](unsigned int new_program) {
+          if (gl_caps)
+            gl_caps->glProgramParameteri(
+                new_program, CX_GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        });
+    m_num_compiles++;
+    m_compile_seconds += seconds_since(compile_start);
+
+    if (m_binary_cache_enabled && program->linked)
+      save_program_binary(binary_hash, program->ID);
+  }
+
+  m_programs[key] = program;
+
+  log_debug_sub("shader program " + std::to_string(program->ID) + " (" +
+                vertex_path + ", " + fragment_path + ")");
+  return program;
+}
+
+size_t Shader_Cache::unique_program_count() const {
+  size_t alive = 0;
+  for (const auto &[key, program] : m_programs)
+    if (!program.expired())
+      alive++;
+  return alive;
+}
+
+void Shader_Cache::log_stats() const {
+  log_success("shader programs: " + std::to_string(unique_program_count()) +
+              " unique for " + std::to_string(m_num_requests) + " requests");
+
+  // warm = everything came from disk, cold = everything had to be compiled
+  const char *startup = "mixed";
+  if (m_num_binary_loads == 0)
+    startup = "cold";
+  else if (m_num_compiles == 0)
+    startup = "warm";
+
+  log_debug_sub(std::string(startup) + " shader startup: " +
+                std::to_string(m_num_compiles) + " compiled in " +
+                std::to_string(m_compile_seconds * 1000.0) + " ms, " +
+                std::to_string(m_num_binary_loads) + " restored in " +
+                std::to_string(m_binary_load_seconds * 1000.0) + " ms, " +
+                std::to_string(m_num_binary_rejects) + " rejected binaries");
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../shaders/shaderclass.hh"
+#include "glcaps.hh"
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// hands out one shared program per (vertex source, fragment source, defines)
+// instead of compiling a fresh one for every mesh. gl thread only.
+// with program binary support, linked programs are also kept on disk in
+// m_binary_cache_dir and restored on the next run instead of compiling
+class Shader_Cache {
+public:
+  // gl_caps may be null, that just turns the disk cache off
+  Shader_Cache(const Gl_Caps *gl_caps,
+               const std::string &binary_cache_dir = "cache/shaders");
+
+  // defines are injected as "#define <define>" right after the #version line
+  Shader_Handle get(const std::string &vertex_path,
+                    const std::string &fragment_path,
+                    const std::vector<std::string> &defines = {});
+
+  // programs still referenced by at least one handle
+  size_t unique_program_count() const;
+
+  size_t m_num_requests = 0;
+  size_t m_num_compiles = 0;
+  size_t m_num_binary_loads = 0;
+  size_t m_num_binary_rejects = 0;
+
+  // time spent creating programs (compile + link vs. glProgramBinary)
+  double m_compile_seconds = 0.0;
+  double m_binary_load_seconds = 0.0;
+
+  void log_stats() const;
+
+private:
+  const std::string &load_source(const std::string &path);
+
+  std::string binary_path(uint64_t hash) const;
+  GLuint load_program_binary(uint64_t hash);
+  void save_program_binary(uint64_t hash, GLuint program);
+
+  const Gl_Caps *m_gl_caps = nullptr;
+  std::string m_binary_cache_dir;
+  bool m_binary_cache_enabled = false;
+
+  // file contents by path, read once
+  std::unordered_map<std::string, std::string> m_sources;
+
+  // weak so the program dies with its last user
+  std::unordered_map<std::string, std::weak_ptr<Shader>> m_programs;
+};
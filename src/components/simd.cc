@@ -0,0 +1,28 @@
+#include "simd.hh"
+
+static e_simd_level detect_simd_level() {
+#if CORTEX_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return E_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return E_SIMD_SSE41;
+#endif
+  return E_SIMD_SCALAR;
+}
+
+e_simd_level get_simd_level() {
+  static const e_simd_level level = detect_simd_level();
+  return level;
+}
+
+const char *get_simd_level_name(e_simd_level level) {
+  switch (level) {
+  case E_SIMD_AVX2:
+    return "avx2";
+  case E_SIMD_SSE41:
+    return "sse4.1";
+  default:
+    return "scalar";
+  }
+}
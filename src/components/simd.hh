@@ -0,0 +1,21 @@
+#pragma once
+
+// runtime dispatch for the hand vectorized kernels. the build doesnt pass any
+// -m flags, kernels opt in per function with CORTEX_TARGET_* and only get
+// called once get_simd_level() said the cpu can run them
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CORTEX_SIMD_X86 1
+#define CORTEX_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define CORTEX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define CORTEX_SIMD_X86 0
+#define CORTEX_TARGET_SSE41
+#define CORTEX_TARGET_AVX2
+#endif
+
+enum e_simd_level { E_SIMD_SCALAR, E_SIMD_SSE41, E_SIMD_AVX2 };
+
+// best level this cpu (and os) supports, checked once
+e_simd_level get_simd_level();
+const char *get_simd_level_name(e_simd_level level);
@@ -0,0 +1,58 @@
+#pragma once
+
+// stdlib
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// lock free ring buffer for exactly one producer thread and one consumer
+// thread. capacity gets rounded up to a power of two
+template <typename T> class Spsc_Queue {
+public:
+  explicit Spsc_Queue(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity)
+      rounded <<= 1;
+
+    m_slots.resize(rounded);
+    m_mask = rounded - 1;
+  }
+
+  // producer side. false when the queue is full
+  bool try_push(const T &item) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail == m_slots.size())
+      return false;
+
+    m_slots[head & m_mask] = item;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side. false when the queue is empty
+  bool try_pop(T &item) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+    if (tail == head)
+      return false;
+
+    item = m_slots[tail & m_mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // only exact when called from one of the two sides while the other idles
+  size_t size_approx() const {
+    return m_head.load(std::memory_order_acquire) -
+           m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  std::vector<T> m_slots;
+  size_t m_mask = 0;
+
+  // own cache lines so producer and consumer dont fight over them
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
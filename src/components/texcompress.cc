@@ -0,0 +1,202 @@
+#include "texcompress.hh"
+
+#include <algorithm>
+#include <cstring>
+
+std::vector<mip_level> build_mip_chain(const uint8_t *pixels, int width,
+                                       int height, int channels) {
+  std::vector<mip_level> levels(1);
+  levels[0].width = width;
+  levels[0].height = height;
+  levels[0].pixels.assign(pixels, pixels + (size_t)width * height * channels);
+
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const mip_level &src = levels.back();
+    mip_level dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize((size_t)dst.width * dst.height * channels);
+
+    // 2x2 box, the odd last row/column just gets clamped
+    for (int y = 0; y < dst.height; y++) {
+      int y0 = std::min(y * 2, src.height - 1);
+      int y1 = std::min(y * 2 + 1, src.height - 1);
+
+      for (int x = 0; x < dst.width; x++) {
+        int x0 = std::min(x * 2, src.width - 1);
+        int x1 = std::min(x * 2 + 1, src.width - 1);
+
+        for (int c = 0; c < channels; c++) {
+          int sum = src.pixels[((size_t)y0 * src.width + x0) * channels + c] +
+                    src.pixels[((size_t)y0 * src.width + x1) * channels + c] +
+                    src.pixels[((size_t)y1 * src.width + x0) * channels + c] +
+                    src.pixels[((size_t)y1 * src.width + x1) * channels + c];
+          dst.pixels[((size_t)y * dst.width + x) * channels + c] =
+              (uint8_t)((sum + 2) / 4);
+        }
+      }
+    }
+
+    levels.push_back(std::move(dst));
+  }
+
+  return levels;
+}
+
+// grabs a 4x4 block as rgba, edge blocks repeat the last row/column
+static void fetch_block(const uint8_t *pixels, int width, int height,
+                        int channels, int block_x, int block_y,
+                        uint8_t block[16][4]) {
+  for (int y = 0; y < 4; y++) {
+    int py = std::min(block_y * 4 + y, height - 1);
+    for (int x = 0; x < 4; x++) {
+      int px = std::min(block_x * 4 + x, width - 1);
+      const uint8_t *src = pixels + ((size_t)py * width + px) * channels;
+
+      block[y * 4 + x][0] = src[0];
+      block[y * 4 + x][1] = src[channels > 1 ? 1 : 0];
+      block[y * 4 + x][2] = src[channels > 2 ? 2 : 0];
+      block[y * 4 + x][3] = channels > 3 ? src[3] : 255;
+    }
+  }
+}
+
+static uint16_t pack_565(const uint8_t color[3]) {
+  return (uint16_t)(((color[0] * 31 + 127) / 255) << 11 |
+                    ((color[1] * 63 + 127) / 255) << 5 |
+                    ((color[2] * 31 + 127) / 255));
+}
+
+static void unpack_565(uint16_t packed, int color[3]) {
+  int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+// bounding box endpoints, inset a bit so the palette covers the block better
+static void encode_color_block(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t min_color[3] = {255, 255, 255};
+  uint8_t max_color[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) {
+      min_color[c] = std::min(min_color[c], block[i][c]);
+      max_color[c] = std::max(max_color[c], block[i][c]);
+    }
+  }
+
+  for (int c = 0; c < 3; c++) {
+    int inset = (max_color[c] - min_color[c]) / 16;
+    min_color[c] = (uint8_t)std::min(255, min_color[c] + inset);
+    max_color[c] = (uint8_t)std::max(0, max_color[c] - inset);
+  }
+
+  uint16_t color0 = pack_565(max_color);
+  uint16_t color1 = pack_565(min_color);
+
+  // color0 > color1 selects the 4 color mode
+  uint32_t indices = 0;
+  if (color0 < color1)
+    std::swap(color0, color1);
+
+  if (color0 != color1) {
+    int palette[4][3];
+    unpack_565(color0, palette[0]);
+    unpack_565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      int best_index = 0;
+      int best_distance = 1 << 30;
+      for (int p = 0; p < 4; p++) {
+        int dr = block[i][0] - palette[p][0];
+        int dg = block[i][1] - palette[p][1];
+        int db = block[i][2] - palette[p][2];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+          best_distance = distance;
+          best_index = p;
+        }
+      }
+      indices |= (uint32_t)best_index << (i * 2);
+    }
+  }
+
+  memcpy(out, &color0, 2);
+  memcpy(out + 2, &color1, 2);
+  memcpy(out + 4, &indices, 4);
+}
+
+// alpha0 > alpha1 selects the 8 value mode
+static void encode_alpha_block(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t alpha0 = 0, alpha1 = 255;
+  for (int i = 0; i < 16; i++) {
+    alpha0 = std::max(alpha0, block[i][3]);
+    alpha1 = std::min(alpha1, block[i][3]);
+  }
+
+  uint64_t indices = 0;
+  if (alpha0 != alpha1) {
+    int palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int p = 1; p < 7; p++)
+      palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+    for (int i = 0; i < 16; i++) {
+      int best_index = 0;
+      int best_distance = 1 << 30;
+      for (int p = 0; p < 8; p++) {
+        int distance = std::abs(block[i][3] - palette[p]);
+        if (distance < best_distance) {
+          best_distance = distance;
+          best_index = p;
+        }
+      }
+      indices |= (uint64_t)best_index << (i * 3);
+    }
+  }
+
+  out[0] = alpha0;
+  out[1] = alpha1;
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+std::vector<uint8_t> compress_bc1(const uint8_t *pixels, int width, int height,
+                                  int channels) {
+  int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+  std::vector<uint8_t> compressed((size_t)blocks_x * blocks_y * 8);
+
+  uint8_t block[16][4];
+  for (int by = 0; by < blocks_y; by++) {
+    for (int bx = 0; bx < blocks_x; bx++) {
+      fetch_block(pixels, width, height, channels, bx, by, block);
+      encode_color_block(block,
+                         compressed.data() + ((size_t)by * blocks_x + bx) * 8);
+    }
+  }
+
+  return compressed;
+}
+
+std::vector<uint8_t> compress_bc3(const uint8_t *pixels, int width,
+                                  int height) {
+  int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+  std::vector<uint8_t> compressed((size_t)blocks_x * blocks_y * 16);
+
+  uint8_t block[16][4];
+  for (int by = 0; by < blocks_y; by++) {
+    for (int bx = 0; bx < blocks_x; bx++) {
+      uint8_t *out = compressed.data() + ((size_t)by * blocks_x + bx) * 16;
+      fetch_block(pixels, width, height, 4, bx, by, block);
+      encode_alpha_block(block, out);
+      encode_color_block(block, out + 8);
+    }
+  }
+
+  return compressed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// cpu side texture processing for the import pipeline: mip chains and
+// s3tc block compression. no gl in here, safe on any thread
+
+struct mip_level {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// level 0 = the input, then box filtered halves down to 1x1
+std::vector<mip_level> build_mip_chain(const uint8_t *pixels, int width,
+                                       int height, int channels);
+
+// 4x4 blocks, 8 bytes each. expects rgb or rgba pixels
+std::vector<uint8_t> compress_bc1(const uint8_t *pixels, int width, int height,
+                                  int channels);
+
+// 4x4 blocks, 16 bytes each (bc1 color + interpolated alpha). expects rgba
+std::vector<uint8_t> compress_bc3(const uint8_t *pixels, int width,
+                                  int height);
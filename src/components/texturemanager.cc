@@ -0,0 +1,519 @@
+#include "texturemanager.hh"
+#include "glresources.hh"
+#include "logging.hh"
+#include "texcompress.hh"
+
+// implementation lives with tinygltf's in the renderer
+#include "../libs/stb_image.h"
+
+#include <GLFW/glfw3.h>
+
+// stdlib
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+// ktx2 style cache file: header, level index, then the level payloads
+static const uint32_t TEXTURE_CACHE_MAGIC = 0x58545843; // "CXTX"
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+struct texture_cache_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_stamp;
+  uint32_t internal_format;
+  uint32_t format;
+  uint32_t compressed;
+  uint32_t level_count;
+};
+
+struct texture_cache_level {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// 1 + log2 of the largest texture the cache takes, level 0 bigger than
+// that is a broken file
+static const uint32_t TEXTURE_CACHE_MAX_LEVELS = 16;
+static const uint32_t TEXTURE_CACHE_MAX_SIZE = 1u
+                                              << (TEXTURE_CACHE_MAX_LEVELS - 1);
+
+// bytes one level of the header format takes, 0 for formats decode()
+// never writes
+static uint64_t get_cache_level_size(const texture_cache_header &header,
+                                     uint64_t width, uint64_t height) {
+  if (header.compressed) {
+    uint64_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+    if (header.internal_format == CX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+      return blocks * 8;
+    if (header.internal_format == CX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+      return blocks * 16;
+    return 0;
+  }
+
+  if (header.internal_format == GL_R8 && header.format == GL_RED)
+    return width * height;
+  if (header.internal_format == GL_RGB8 && header.format == GL_RGB)
+    return width * height * 3;
+  if (header.internal_format == GL_RGBA8 && header.format == GL_RGBA)
+    return width * height * 4;
+  return 0;
+}
+
+// the level table has to be exactly what decode() writes: halves down
+// from level 0, back to back, each as big as its format needs. anything
+// else (stale or corrupt file) is a miss
+static bool is_valid_cache_level_table(
+    const texture_cache_header &header,
+    const std::vector<texture_cache_level> &levels) {
+  uint64_t offset = 0;
+  for (size_t i = 0; i < levels.size(); i++) {
+    const texture_cache_level &level = levels[i];
+    if (i == 0) {
+      if (level.width == 0 || level.height == 0 ||
+          level.width > TEXTURE_CACHE_MAX_SIZE ||
+          level.height > TEXTURE_CACHE_MAX_SIZE)
+        return false;
+    } else if (level.width != std::max(levels[i - 1].width / 2, 1u) ||
+               level.height != std::max(levels[i - 1].height / 2, 1u)) {
+      return false;
+    }
+
+    uint64_t size = get_cache_level_size(header, level.width, level.height);
+    if (size == 0 || level.offset != offset || level.size != size)
+      return false;
+    offset += size;
+  }
+  return true;
+}
+
+// changes whenever the source does: size + mtime for files, a hash of the
+// bytes for embedded images
+static uint64_t get_source_stamp(const texture_request &request) {
+  uint64_t stamp = 0xcbf29ce484222325ull;
+
+  if (request.encoded) {
+    for (size_t i = 0; i < request.encoded_size; i++) {
+      stamp ^= request.encoded[i];
+      stamp *= 0x100000001b3ull;
+    }
+    return stamp ^ request.encoded_size;
+  }
+
+  std::error_code ec;
+  auto size = std::filesystem::file_size(request.file_path, ec);
+  if (ec)
+    return 0;
+  auto mtime = std::filesystem::last_write_time(request.file_path, ec);
+  if (ec)
+    return 0;
+
+  return (uint64_t)size * 0x9e3779b97f4a7c15ull ^
+         (uint64_t)mtime.time_since_epoch().count();
+}
+
+Texture_Manager::Texture_Manager(Thread_Pool &thread_pool,
+                                 const Gl_Caps *gl_caps)
+    : m_thread_pool(thread_pool), m_gl_caps(gl_caps) {
+  m_use_s3tc = gl_caps && gl_caps->m_has_s3tc;
+  if (!m_use_s3tc)
+    log_debug("no s3tc support, textures get uploaded uncompressed");
+}
+
+Texture_Manager::~Texture_Manager() {
+  // the context might be gone already on shutdown
+  if (!glfwGetCurrentContext())
+    return;
+
+  for (auto &[key, texture] : m_textures)
+    glDeleteTextures(1, &texture);
+
+  for (GLuint &pbo : m_pbos)
+    if (pbo != 0)
+      glDeleteBuffers(1, &pbo);
+}
+
+GLuint Texture_Manager::find(const std::string &key) const {
+  auto found = m_textures.find(key);
+  return found != m_textures.end() ? found->second : 0;
+}
+
+bool Texture_Manager::read_cache(const texture_request &request,
+                                 uint64_t source_stamp,
+                                 decoded_texture &out) const {
+  std::ifstream cache_file(request.cache_path, std::ios::binary);
+  if (!cache_file)
+    return false;
+
+  texture_cache_header header;
+  if (!cache_file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != TEXTURE_CACHE_MAGIC ||
+      header.version != TEXTURE_CACHE_VERSION || header.level_count == 0 ||
+      header.level_count > TEXTURE_CACHE_MAX_LEVELS)
+    return false;
+
+  if (!request.cache_only && header.source_stamp != source_stamp)
+    return false;
+
+  // compressed cache from a machine with s3tc, this one has none
+  if (header.compressed && !m_use_s3tc)
+    return false;
+
+  std::vector<texture_cache_level> levels(header.level_count);
+  if (!cache_file.read(reinterpret_cast<char *>(levels.data()),
+                       levels.size() * sizeof(texture_cache_level)))
+    return false;
+
+  if (!is_valid_cache_level_table(header, levels))
+    return false;
+
+  // the payload has to be all thats left of the file, checked before
+  // allocating anything for it
+  uint64_t data_size = levels.back().offset + levels.back().size;
+  std::error_code ec;
+  uint64_t file_size = std::filesystem::file_size(request.cache_path, ec);
+  uint64_t table_size =
+      sizeof(header) + levels.size() * sizeof(texture_cache_level);
+  if (ec || file_size < table_size || file_size - table_size != data_size)
+    return false;
+
+  out.data.resize(data_size);
+  if (!cache_file.read(reinterpret_cast<char *>(out.data.data()), data_size))
+    return false;
+
+  out.internal_format = header.internal_format;
+  out.format = header.format;
+  out.compressed = header.compressed != 0;
+  out.levels.clear();
+  for (const auto &level : levels)
+    out.levels.push_back({(int)level.width, (int)level.height,
+                          (size_t)level.offset, (size_t)level.size});
+  return true;
+}
+
+void Texture_Manager::write_cache(const texture_request &request,
+                                  uint64_t source_stamp,
+                                  const decoded_texture &texture) {
+  texture_cache_header header{TEXTURE_CACHE_MAGIC,
+                              TEXTURE_CACHE_VERSION,
+                              source_stamp,
+                              texture.internal_format,
+                              texture.format,
+                              texture.compressed ? 1u : 0u,
+                              (uint32_t)texture.levels.size()};
+
+  std::vector<texture_cache_level> levels;
+  for (const auto &level : texture.levels)
+    levels.push_back({(uint32_t)level.width, (uint32_t)level.height,
+                      (uint64_t)level.offset, (uint64_t)level.size});
+
+  // write + rename so a concurrent reader never sees half a file. the same
+  // image can be decoded by two threads (one per sampler), each gets its
+  // own temp file
+  std::string temp_path =
+      request.cache_path + ".tmp" +
+      std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    cache_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    cache_file.write(reinterpret_cast<const char *>(levels.data()),
+                     levels.size() * sizeof(texture_cache_level));
+    cache_file.write(reinterpret_cast<const char *>(texture.data.data()),
+                     texture.data.size());
+    if (!cache_file) {
+      // read only model dirs are fine, we just decode again next time
+      log_debug_sub("couldnt write texture cache " + request.cache_path);
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(temp_path, request.cache_path, ec);
+  if (!ec)
+    m_cache_writes++;
+}
+
+bool Texture_Manager::decode(const texture_request &request,
+                             decoded_texture &out) {
+  out.key = request.key;
+  out.sampler = request.sampler;
+
+  uint64_t source_stamp = get_source_stamp(request);
+  if (!request.cache_path.empty() &&
+      (source_stamp != 0 || request.cache_only) &&
+      read_cache(request, source_stamp, out)) {
+    m_cache_hits++;
+    return true;
+  }
+
+  if (request.cache_only)
+    return false;
+
+  int width, height, channels;
+  //    stbi_set_flip_vertically_on_load(true); // fuck u
+  unsigned char *pixels = nullptr;
+  if (request.encoded)
+    pixels = stbi_load_from_memory(request.encoded, (int)request.encoded_size,
+                                   &width, &height, &channels, 0);
+  else
+    pixels =
+        stbi_load(request.file_path.c_str(), &width, &height, &channels, 0);
+
+  if (!pixels)
+    return false;
+
+  // grey + alpha has no gl format of its own here, go rgba
+  std::vector<uint8_t> expanded;
+  const uint8_t *source_pixels = pixels;
+  if (channels == 2) {
+    expanded.resize((size_t)width * height * 4);
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+      expanded[i * 4 + 0] = pixels[i * 2];
+      expanded[i * 4 + 1] = pixels[i * 2];
+      expanded[i * 4 + 2] = pixels[i * 2];
+      expanded[i * 4 + 3] = pixels[i * 2 + 1];
+    }
+    source_pixels = expanded.data();
+    channels = 4;
+  }
+
+  std::vector<mip_level> mips =
+      build_mip_chain(source_pixels, width, height, channels);
+  stbi_image_free(pixels);
+
+  // bc1 for rgb, bc3 when there is alpha. single channel stays raw
+  out.compressed = m_use_s3tc && channels >= 3;
+  if (out.compressed) {
+    out.internal_format = channels == 4 ? CX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                        : CX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  } else if (channels == 1) {
+    out.internal_format = GL_R8;
+    out.format = GL_RED;
+  } else if (channels == 3) {
+    out.internal_format = GL_RGB8;
+    out.format = GL_RGB;
+  } else {
+    out.internal_format = GL_RGBA8;
+    out.format = GL_RGBA;
+  }
+
+  out.data.clear();
+  out.levels.clear();
+  size_t uncompressed_size = 0;
+  for (const auto &mip : mips) {
+    std::vector<uint8_t> level_data;
+    if (!out.compressed)
+      level_data = mip.pixels;
+    else if (channels == 4)
+      level_data = compress_bc3(mip.pixels.data(), mip.width, mip.height);
+    else
+      level_data =
+          compress_bc1(mip.pixels.data(), mip.width, mip.height, channels);
+
+    out.levels.push_back(
+        {mip.width, mip.height, out.data.size(), level_data.size()});
+    out.data.insert(out.data.end(), level_data.begin(), level_data.end());
+    uncompressed_size += mip.pixels.size();
+  }
+  m_uncompressed_bytes += uncompressed_size;
+
+  if (!request.cache_path.empty() && source_stamp != 0)
+    write_cache(request, source_stamp, out);
+
+  return true;
+}
+
+void Texture_Manager::ensure_pbo(size_t size) {
+  GLuint &pbo = m_pbos[m_next_pbo];
+  if (pbo == 0)
+    glGenBuffers(1, &pbo);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+  if (m_pbo_sizes[m_next_pbo] < size) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    m_pbo_sizes[m_next_pbo] = size;
+  }
+}
+
+GLuint Texture_Manager::upload(const decoded_texture &texture) {
+  if (!texture.valid())
+    return 0;
+
+  // copy every level into the unpack buffer, the transfer happens async
+  ensure_pbo(texture.data.size());
+  void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                  texture.data.size(),
+                                  GL_MAP_WRITE_BIT |
+                                      GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (mapped) {
+    memcpy(mapped, texture.data.data(), texture.data.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  } else {
+    // mapping failed, plain client memory upload instead
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  m_next_pbo = (m_next_pbo + 1) % 2;
+
+  // immutable storage where the context has it, the levels are then
+  // sub image uploads into the already allocated texture
+  bool immutable = has_immutable_textures(m_gl_caps);
+  GLuint texture_id;
+  if (!immutable || !m_gl_caps->m_has_direct_state_access)
+    glActiveTexture(GL_TEXTURE0);
+  if (immutable) {
+    texture_id = create_gl_texture_2d(m_gl_caps, texture.internal_format,
+                                      (int)texture.levels.size(),
+                                      texture.levels[0].width,
+                                      texture.levels[0].height);
+  } else {
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+  }
+
+  // rgb rows are not 4 byte aligned for every width
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < texture.levels.size(); i++) {
+    const texture_level &level = texture.levels[i];
+    const void *level_data =
+        mapped ? (const void *)(uintptr_t)level.offset
+               : (const void *)(texture.data.data() + level.offset);
+
+    if (immutable && texture.compressed)
+      upload_gl_compressed_texture_level(m_gl_caps, texture_id, (int)i,
+                                         level.width, level.height,
+                                         texture.internal_format, level.size,
+                                         level_data);
+    else if (immutable)
+      upload_gl_texture_level(m_gl_caps, texture_id, (int)i, level.width,
+                              level.height, texture.format, GL_UNSIGNED_BYTE,
+                              level_data);
+    else if (texture.compressed)
+      glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.internal_format,
+                             level.width, level.height, 0,
+                             (GLsizei)level.size, level_data);
+    else
+      glTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.internal_format,
+                   level.width, level.height, 0, texture.format,
+                   GL_UNSIGNED_BYTE, level_data);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  set_gl_texture_parameter(m_gl_caps, texture_id, GL_TEXTURE_MAX_LEVEL,
+                           (GLint)texture.levels.size() - 1);
+
+  // gltf sampler, trilinear + repeat if it doesnt say
+  const texture_sampler &sampler = texture.sampler;
+  set_gl_texture_parameter(m_gl_caps, texture_id, GL_TEXTURE_WRAP_S,
+                           sampler.wrap_s);
+  set_gl_texture_parameter(m_gl_caps, texture_id, GL_TEXTURE_WRAP_T,
+                           sampler.wrap_t);
+  set_gl_texture_parameter(m_gl_caps, texture_id, GL_TEXTURE_MIN_FILTER,
+                           sampler.min_filter >= 0 ? sampler.min_filter
+                                                   : GL_LINEAR_MIPMAP_LINEAR);
+  set_gl_texture_parameter(m_gl_caps, texture_id, GL_TEXTURE_MAG_FILTER,
+                           sampler.mag_filter >= 0 ? sampler.mag_filter
+                                                   : GL_LINEAR);
+
+  m_textures[texture.key] = texture_id;
+  m_uploaded_bytes += texture.data.size();
+  return texture_id;
+}
+
+GLuint Texture_Manager::load(const texture_request &request) {
+  GLuint loaded_texture = find(request.key);
+  if (loaded_texture != 0)
+    return loaded_texture;
+
+  decoded_texture texture;
+  if (!decode(request, texture)) {
+    log_error("failed to load texture: " + request.key);
+    return 0;
+  }
+
+  return upload(texture);
+}
+
+namespace {
+
+// decoded textures waiting for the gl thread
+struct decode_batch_state {
+  std::mutex ready_mutex;
+  std::condition_variable ready_cv;
+  std::deque<decoded_texture> ready;
+};
+
+} // namespace
+
+void Texture_Manager::load_batch(const std::vector<texture_request> &requests) {
+  auto batch_start = std::chrono::steady_clock::now();
+
+  // skip loaded and duplicate keys
+  std::vector<const texture_request *> pending;
+  std::unordered_set<std::string> seen;
+  for (const auto &request : requests)
+    if (find(request.key) == 0 && seen.insert(request.key).second)
+      pending.push_back(&request);
+
+  if (pending.empty())
+    return;
+
+  // workers decode and hand results over, this thread uploads them as they
+  // come in. requests and this stay alive since we wait for every job below
+  auto state = std::make_shared<decode_batch_state>();
+  for (const texture_request *request : pending) {
+    m_thread_pool.submit([this, state, request] {
+      decoded_texture texture;
+      if (!decode(*request, texture))
+        log_error("failed to load texture: " + request->key);
+
+      std::lock_guard<std::mutex> lock(state->ready_mutex);
+      state->ready.push_back(std::move(texture));
+      state->ready_cv.notify_one();
+    });
+  }
+
+  size_t num_uploaded = 0;
+  size_t num_handled = 0;
+  while (num_handled < pending.size()) {
+    decoded_texture texture;
+    {
+      std::unique_lock<std::mutex> lock(state->ready_mutex);
+      state->ready_cv.wait(lock, [&] { return !state->ready.empty(); });
+      texture = std::move(state->ready.front());
+      state->ready.pop_front();
+    }
+    num_handled++;
+
+    if (upload(texture) != 0)
+      num_uploaded++;
+  }
+
+  double batch_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - batch_start)
+                        .count();
+  log_success("loaded " + std::to_string(num_uploaded) + "/" +
+              std::to_string(pending.size()) + " textures in " +
+              std::to_string(batch_ms) + " ms (" +
+              std::to_string(m_thread_pool.num_threads()) + " decoders)");
+  log_stats();
+}
+
+void Texture_Manager::log_stats() const {
+  log_debug_sub(std::to_string(m_textures.size()) + " textures, " +
+                std::to_string(m_uploaded_bytes / 1024) + " KiB in vram (" +
+                std::to_string(m_uncompressed_bytes.load() / 1024) +
+                " KiB uncompressed for fresh decodes), " +
+                std::to_string(m_cache_hits.load()) + " cache hits, " +
+                std::to_string(m_cache_writes.load()) + " cache writes");
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "../glad/glad.h"
+#include "glcaps.hh"
+#include "threadpool.hh"
+
+// stdlib
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// gltf sampler settings, the gltf enums are the gl ones. -1 = not set
+struct texture_sampler {
+  int min_filter = -1;
+  int mag_filter = -1;
+  int wrap_s = GL_REPEAT;
+  int wrap_t = GL_REPEAT;
+};
+
+// where the encoded image comes from: a file on disk or bytes in memory
+// (embedded glb images). encoded has to stay valid until decoded
+struct texture_request {
+  std::string key;
+  std::string file_path;
+  const uint8_t *encoded = nullptr;
+  size_t encoded_size = 0;
+
+  // transcoded result is kept here, empty = no cache
+  std::string cache_path;
+  texture_sampler sampler;
+
+  // no source to check against (embedded image loaded from the mesh
+  // cache), whatever is in cache_path is taken as is
+  bool cache_only = false;
+};
+
+struct texture_level {
+  int width = 0;
+  int height = 0;
+  size_t offset = 0;
+  size_t size = 0;
+};
+
+// upload ready texture: every mip level back to back in data, either raw
+// pixels (format) or s3tc blocks (compressed)
+struct decoded_texture {
+  std::string key;
+  GLenum internal_format = 0;
+  GLenum format = 0;
+  bool compressed = false;
+
+  std::vector<uint8_t> data;
+  std::vector<texture_level> levels;
+  texture_sampler sampler;
+
+  bool valid() const { return !levels.empty(); }
+};
+
+// all 2d textures of the renderer, looked up by key (path or glb#imageN).
+// decoding, mip building and compression run on the thread pool, uploads go
+// through pixel unpack buffers on the gl thread
+class Texture_Manager {
+public:
+  // without s3tc support textures stay uncompressed (still mipmapped)
+  Texture_Manager(Thread_Pool &thread_pool, const Gl_Caps *gl_caps);
+  ~Texture_Manager();
+
+  Texture_Manager(const Texture_Manager &) = delete;
+  Texture_Manager &operator=(const Texture_Manager &) = delete;
+
+  // 0 if not loaded (yet)
+  GLuint find(const std::string &key) const;
+
+  // decodes every not yet loaded request in parallel and uploads each one
+  // as soon as it is ready, so decode and upload overlap
+  void load_batch(const std::vector<texture_request> &requests);
+
+  // single texture, decoded right here. for stragglers
+  GLuint load(const texture_request &request);
+
+  // any thread. reads the cache file if its still valid, else decodes,
+  // builds mips, compresses and writes the cache file
+  bool decode(const texture_request &request, decoded_texture &out);
+
+  // gl thread. stores the texture under texture.key
+  GLuint upload(const decoded_texture &texture);
+
+  size_t texture_count() const { return m_textures.size(); }
+
+  size_t m_uploaded_bytes = 0;
+  std::atomic<size_t> m_uncompressed_bytes = 0;
+  std::atomic<size_t> m_cache_hits = 0;
+  std::atomic<size_t> m_cache_writes = 0;
+
+  void log_stats() const;
+
+private:
+  void ensure_pbo(size_t size);
+
+  bool read_cache(const texture_request &request, uint64_t source_stamp,
+                  decoded_texture &out) const;
+  void write_cache(const texture_request &request, uint64_t source_stamp,
+                   const decoded_texture &texture);
+
+  Thread_Pool &m_thread_pool;
+  const Gl_Caps *m_gl_caps = nullptr;
+  bool m_use_s3tc = false;
+
+  std::unordered_map<std::string, GLuint> m_textures;
+
+  // two unpack buffers, filled in turns so the driver can still be reading
+  // from the previous one
+  GLuint m_pbos[2] = {0, 0};
+  size_t m_pbo_sizes[2] = {0, 0};
+  unsigned int m_next_pbo = 0;
+};
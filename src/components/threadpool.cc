@@ -0,0 +1,102 @@
+#include "threadpool.hh"
+#include "logging.hh"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+Thread_Pool::Thread_Pool(unsigned int num_threads) {
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  m_workers.reserve(num_threads);
+  for (unsigned int i = 0; i < num_threads; i++)
+    m_workers.emplace_back(&Thread_Pool::worker_loop, this);
+
+  log_success("thread pool online with " + std::to_string(num_threads) +
+              " workers");
+}
+
+Thread_Pool::~Thread_Pool() {
+  {
+    std::lock_guard<std::mutex> lock(m_tasks_mutex);
+    m_shutdown = true;
+  }
+  m_tasks_cv.notify_all();
+
+  for (auto &worker : m_workers)
+    worker.join();
+}
+
+void Thread_Pool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_tasks_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_tasks_cv.notify_one();
+}
+
+void Thread_Pool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_tasks_mutex);
+      m_tasks_cv.wait(lock, [this] { return m_shutdown || !m_tasks.empty(); });
+
+      if (m_shutdown && m_tasks.empty())
+        return;
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+namespace {
+
+struct parallel_for_state {
+  size_t count = 0;
+  const std::function<void(size_t)> *job = nullptr;
+
+  std::atomic<size_t> next_index{0};
+  std::atomic<size_t> finished{0};
+
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+};
+
+void run_parallel_for(const std::shared_ptr<parallel_for_state> &state) {
+  size_t index;
+  while ((index = state->next_index.fetch_add(1)) < state->count) {
+    (*state->job)(index);
+
+    if (state->finished.fetch_add(1) + 1 == state->count) {
+      std::lock_guard<std::mutex> lock(state->done_mutex);
+      state->done_cv.notify_all();
+    }
+  }
+}
+
+} // namespace
+
+void Thread_Pool::parallel_for(size_t count,
+                               const std::function<void(size_t)> &job) {
+  if (count == 0)
+    return;
+
+  auto state = std::make_shared<parallel_for_state>();
+  state->count = count;
+  state->job = &job;
+
+  // helpers that only get scheduled after everything is claimed just exit,
+  // so the caller never waits on a queued task (no deadlock when nested)
+  size_t num_helpers = std::min(count - 1, m_workers.size());
+  for (size_t i = 0; i < num_helpers; i++)
+    submit([state] { run_parallel_for(state); });
+
+  run_parallel_for(state);
+
+  std::unique_lock<std::mutex> lock(state->done_mutex);
+  state->done_cv.wait(lock, [&] { return state->finished.load() == count; });
+}
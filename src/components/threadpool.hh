@@ -0,0 +1,41 @@
+#pragma once
+
+// stdlib
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for cpu side work (importing, decoding, ...).
+// never touches gl, everything gl related stays on the context thread
+class Thread_Pool {
+public:
+  // 0 = one worker per hardware thread
+  Thread_Pool(unsigned int num_threads = 0);
+  ~Thread_Pool();
+
+  Thread_Pool(const Thread_Pool &) = delete;
+  Thread_Pool &operator=(const Thread_Pool &) = delete;
+
+  // fire and forget
+  void submit(std::function<void()> task);
+
+  // runs job(i) for every i in [0, count) on the workers and the calling
+  // thread, returns once all of them are done. safe to nest
+  void parallel_for(size_t count, const std::function<void(size_t)> &job);
+
+  unsigned int num_threads() const { return (unsigned int)m_workers.size(); }
+
+private:
+  void worker_loop();
+
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_tasks_mutex;
+  std::condition_variable m_tasks_cv;
+  bool m_shutdown = false;
+};
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "../components/importer.hh"
 #include "../components/logging.hh"
 #include "../components/mesh.hh"
+#include "../components/meshgeometry.hh"
+#include "../components/meshimport.hh"
+#include "../components/meshoptimize.hh"
+#include "../components/scenegraph.hh"
+#include "../components/shadercache.hh"
+#include "../components/texturemanager.hh"
+#include "../components/threadpool.hh"
 #include "../shaders/shaderclass.hh"
 #include "material.hh"
 #include <GLFW/glfw3.h>
@@ -20,220 +28,17 @@
 #include <iostream>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define TINYGLTF_NOEXCEPTION
+#define TINYGLTF_NO_EXTERNAL_IMAGE
 #define JSON_NOEXCEPTION
 #include "../libs/tiny_gltf.h"
 
-struct tan_bin_glob {
-
-  std::vector<float> vert_tangents;
-  std::vector<float> vert_binormals;
-};
-
-std::vector<float> calculate_vert_normals(std::vector<float> mesh_vertices) {
-  std::vector<glm::vec3> vertexNormals; // buffer
-  std::vector<float> mesh_normals;
-  size_t numVertices = mesh_vertices.size() / 3;
-  vertexNormals.resize(numVertices, glm::vec3(0.0f));
-  mesh_normals.reserve(numVertices * 3);
-  for (size_t i = 0; i < mesh_vertices.size(); i += 9) {
-
-    glm::vec3 v0(mesh_vertices[i], mesh_vertices[i + 1],
-                 mesh_vertices[i + 2]); // Vertex 1
-    glm::vec3 v1(mesh_vertices[i + 3], mesh_vertices[i + 4],
-                 mesh_vertices[i + 5]); // Vertex 2
-    glm::vec3 v2(mesh_vertices[i + 6], mesh_vertices[i + 7],
-                 mesh_vertices[i + 8]); // Vertex 3
-
-    // Calculate the normal for the face
-    glm::vec3 faceNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-
-    // Accumulate the face normal to each vertex's normal
-    vertexNormals[i / 3] += faceNormal;     // Vertex 1
-    vertexNormals[i / 3 + 1] += faceNormal; // Vertex 2
-    vertexNormals[i / 3 + 2] += faceNormal; // Vertex 3
-  }
-
-  for (size_t i = 0; i < vertexNormals.size(); ++i) {
-    vertexNormals[i] = glm::normalize(vertexNormals[i]);
-  }
-
-  for (const auto &normal : vertexNormals) {
-    mesh_normals.push_back(normal.x);
-    mesh_normals.push_back(normal.y);
-    mesh_normals.push_back(normal.z);
-  }
-
-  std::cout << "done calculating " << (int)mesh_normals.size() << " normals"
-            << std::endl;
-  return mesh_normals;
-}
-
-tan_bin_glob calculate_vert_tan_bin(std::vector<float> mesh_vertices,
-                                    std::vector<float> mesh_normals,
-                                    std::vector<float> texture_coordinates) {
-
-  std::vector<float> vert_tangents;
-  std::vector<float> vert_binormals;
-
-  tan_bin_glob return_glob;
-
-  vert_tangents.resize(mesh_vertices.size());
-  vert_binormals.resize(mesh_vertices.size());
-
-  for (size_t i = 0, j = 0; i < mesh_vertices.size(); i += 9, j += 6) {
-
-    glm::vec3 v0(mesh_vertices[i], mesh_vertices[i + 1],
-                 mesh_vertices[i + 2]); // Vertex 1
-    glm::vec3 v1(mesh_vertices[i + 3], mesh_vertices[i + 4],
-                 mesh_vertices[i + 5]); // Vertex 2
-    glm::vec3 v2(mesh_vertices[i + 6], mesh_vertices[i + 7],
-                 mesh_vertices[i + 8]); // Vertex 3
-
-    glm::vec2 t0(texture_coordinates[j],
-                 texture_coordinates[j + 1]); // Vertex 1
-    glm::vec2 t1(texture_coordinates[j + 2],
-                 texture_coordinates[j + 3]); // Vertex 2
-    glm::vec2 t2(texture_coordinates[j + 4],
-                 texture_coordinates[j + 5]); // Vertex 3
-
-    glm::vec3 e1(v1 - v0);
-    glm::vec3 e2(v2 - v0);
-
-    glm::vec2 delta_uv_1(t1 - t0);
-    glm::vec2 delta_uv_2(t2 - t0);
-
-    // shoutout wikipedia
-    float f =
-        1 / ((delta_uv_1.x * delta_uv_2.y) - (delta_uv_1.y * delta_uv_2.x));
-
-    glm::vec3 tangent = f * ((delta_uv_2.y * e1) - (delta_uv_1.y * e2));
-    glm::vec3 bitangent = f * ((-delta_uv_1.x * e1) + (delta_uv_1.x * e2));
-
-    for (int vert_id = 0; vert_id < 3; vert_id++) {
-
-      vert_tangents[i + (vert_id * 3)] += tangent.x;
-      vert_tangents[i + (vert_id * 3) + 1] += tangent.y;
-      vert_tangents[i + (vert_id * 3) + 2] += tangent.z;
-
-      vert_binormals[i + (vert_id * 3)] += bitangent.x;
-      vert_binormals[i + (vert_id * 3) + 1] += bitangent.y;
-      vert_binormals[i + (vert_id * 3) + 2] += bitangent.z;
-    }
-  }
-
-  // normalize tangents
-  for (int i = 0; i < (int)vert_tangents.size(); i = i + 3) {
-
-    glm::vec3 to_norm(vert_tangents[i], vert_tangents[i + 1],
-                      vert_tangents[i + 2]);
-    to_norm = glm::normalize(to_norm);
-    vert_tangents[i] = to_norm.x;
-    vert_tangents[i + 1] = to_norm.y;
-    vert_tangents[i + 2] = to_norm.z;
-  }
-
-  // normalize binormals
-  for (int i = 0; i < (int)vert_binormals.size(); i = i + 3) {
-
-    glm::vec3 to_norm(vert_binormals[i], vert_binormals[i + 1],
-                      vert_binormals[i + 2]);
-    to_norm = glm::normalize(to_norm);
-    vert_binormals[i] = to_norm.x;
-    vert_binormals[i + 1] = to_norm.y;
-    vert_binormals[i + 2] = to_norm.z;
-  }
-
-  for (size_t i = 0; i < vert_tangents.size(); i += 3) {
-    glm::vec3 normal(mesh_normals[i], mesh_normals[i + 1], mesh_normals[i + 2]);
-    glm::vec3 tangent(vert_tangents[i], vert_tangents[i + 1],
-                      vert_tangents[i + 2]);
-
-    // Orthogonalize tangent
-    tangent -= normal * glm::dot(normal, tangent);
-    tangent = glm::normalize(tangent);
-
-    // Recalculate bitangent
-    glm::vec3 bitangent = glm::cross(normal, tangent);
-
-    vert_tangents[i] = tangent.x;
-    vert_tangents[i + 1] = tangent.y;
-    vert_tangents[i + 2] = tangent.z;
-
-    vert_binormals[i] = bitangent.x;
-    vert_binormals[i + 1] = bitangent.y;
-    vert_binormals[i + 2] = bitangent.z;
-  }
-
-  return_glob.vert_binormals = vert_binormals;
-  return_glob.vert_tangents = vert_tangents;
-
-  return return_glob;
-}
-
-GLuint bind_texture_to_slot(
-    std::string to_load, unsigned int slot,
-    std::vector<std::tuple<std::string, unsigned int, GLuint>> &texture_map) {
-  printf("trying to load texture into slot: %d\n", slot);
-  int width, height, nrChannels;
-
-  for (int i = 0; i < (int)texture_map.size(); i++) {
-    if (std::get<0>(texture_map[i]) == to_load) {
-      // we dont do anything. jus return the texture handle
-      return std::get<2>(texture_map[i]);
-    }
-  }
-
-  //    stbi_set_flip_vertically_on_load(true); // fuck u
-  unsigned char *data =
-      stbi_load(to_load.c_str(), &width, &height, &nrChannels, 0);
-
-  if (!data) {
-    std::cerr << "failed to load texture: " << to_load << std::endl;
-    return 0;
-  }
-
-  GLenum format;
-  if (nrChannels == 1)
-    format = GL_RED;
-  else if (nrChannels == 3)
-    format = GL_RGB;
-  else if (nrChannels == 4)
-    format = GL_RGBA;
-  else {
-    std::cerr << "unsupported number of channels: " << nrChannels << std::endl;
-    stbi_image_free(data);
-    return 0;
-  }
-
-  GLuint texture;
-  glGenTextures(1, &texture);
-
-  glActiveTexture(GL_TEXTURE0 + slot);
-  glBindTexture(GL_TEXTURE_2D, texture);
-
-  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-               GL_UNSIGNED_BYTE, data);
-  // glGenerateMipmap(GL_TEXTURE_2D);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  stbi_image_free(data);
-
-  texture_map.emplace_back(
-      std::tuple<std::string, unsigned int, GLuint>(to_load, slot, texture));
-
-  return texture;
-}
-
 bool is_valid_texture(const tinygltf::Model &model, int textureIndex) {
   return textureIndex >= 0 && textureIndex < (int)model.textures.size();
 }
@@ -578,280 +383,947 @@ bool check_pbr_textures_present_mesh(const tinygltf::Mesh &mesh,
   return false;
 }
 
-std::vector<Mesh> load_all_meshes_from_gltf(
-    const std::string &file_path,
-    std::atomic<unsigned int> &num_loaded_textures,
-    std::vector<std::tuple<std::string, unsigned int, GLuint>> &texture_map) {
-  tinygltf::Model model;
-  tinygltf::TinyGLTF loader;
-  std::string err, warn;
+// one primitive of one node, in the order a recursive walk would visit them
+struct gltf_primitive_job {
+  int mesh_index;
+  int primitive_index;
+  glm::mat4 global_transform;
+  // index into the node table of flatten_gltf_node_tree
+  uint32_t scene_node = SCENE_NODE_NONE;
+  // every node using this primitive when there is more than one, see
+  // group_gltf_primitive_jobs
+  std::vector<glm::mat4> instance_transforms;
+  std::vector<uint32_t> instance_nodes;
+};
 
-  log_success("importing a gltf file... loading ascii file...");
-  bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, file_path);
+// everything about a primitive that can be worked out without a gl context
+struct decoded_primitive {
+  std::vector<float> vertices;
+  std::vector<float> normals;
+  std::vector<float> tangents;
+  std::vector<float> bitangents;
+  std::vector<float> texcoords;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> lod_indices;
+  std::vector<mesh_lod> lods;
+
+  glm::mat4 global_transform = glm::mat4(1.0f);
+  uint32_t scene_node = SCENE_NODE_NONE;
+  // set = drawn once per matrix, global_transform is identity then
+  std::vector<glm::mat4> instance_transforms;
+  std::vector<uint32_t> instance_nodes;
+
+  // 1 = phong fallback, 2 = textured
+  uint8_t shader_type_carry = 1;
+  std::string texture_path;
+  int embedded_image = -1;
+  texture_sampler sampler;
+
+  // why the primitive got dropped while decoding, logged by the caller
+  std::string decode_error;
+};
 
-  if(!ret)
-    log_error("couldnt load ASCII gltf file!!!");  
-  if (!warn.empty())
-    printf("Warn: %s\n", warn.c_str());
-  if (!err.empty())
-    printf("Err: %s\n", err.c_str());
+// missing normals / tangents, reorder + lods of one decoded primitive,
+// whatever options asks for (see meshoptimize.hh). pool safe, the report
+// gets logged by the caller. pool (optional) splits up big meshes
+mesh_optimize_report
+process_decoded_primitive(decoded_primitive &decoded,
+                          const mesh_import_options &options,
+                          Thread_Pool *pool = nullptr) {
+  // dropped while decoding (or no positions to begin with)
+  if (decoded.vertices.empty())
+    return mesh_optimize_report();
+
+  // before the reorder, that moves every stream along
+  if (decoded.normals.empty())
+    generate_vertex_normals(decoded.vertices, decoded.indices, decoded.normals,
+                            pool);
+  if (!decoded.texcoords.empty() &&
+      (decoded.tangents.empty() || decoded.bitangents.empty()))
+    generate_vertex_tangents(decoded.vertices, decoded.normals,
+                             decoded.texcoords, decoded.indices,
+                             decoded.tangents, decoded.bitangents, pool);
+
+  mesh_optimize_report report;
+  if (options.optimize)
+    report = optimize_mesh_geometry(decoded.indices,
+                                    {{&decoded.vertices, 3},
+                                     {&decoded.normals, 3},
+                                     {&decoded.tangents, 3},
+                                     {&decoded.bitangents, 3},
+                                     {&decoded.texcoords, 2}});
+
+  // lods index the final vertex order, so they come last
+  if (options.generate_lods && !decoded.indices.empty()) {
+    build_lod_chain(decoded.indices, decoded.vertices, decoded.lod_indices,
+                    decoded.lods);
+    report.triangle_count = decoded.indices.size() / 3;
+    report.lod_count = decoded.lods.size();
+    report.coarsest_lod_triangles = decoded.lods.back().index_count / 3;
+  }
 
-  //  check_pbr_textures_present(model);
+  return report;
+}
 
-  std::vector<Mesh> meshes;
-  auto get_index = [&](const tinygltf::Primitive &primitive,
-                       int idx) -> uint32_t {
-    const auto &indexAccessor = model.accessors[primitive.indices];
-    const auto &indexView = model.bufferViews[indexAccessor.bufferView];
-    const auto &indexBuffer = model.buffers[indexView.buffer];
-    const uint8_t *base = indexBuffer.data.data() + indexView.byteOffset +
-                          indexAccessor.byteOffset;
-
-    switch (indexAccessor.componentType) {
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-      return reinterpret_cast<const uint8_t *>(base)[idx];
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-      return reinterpret_cast<const uint16_t *>(base)[idx];
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-      return reinterpret_cast<const uint32_t *>(base)[idx];
-    default:
-      throw std::runtime_error("Unsupported index type");
+void log_optimize_reports(const std::vector<mesh_optimize_report> &reports) {
+  size_t triangles = 0;
+  double misses_before = 0.0, misses_after = 0.0;
+
+  for (const auto &report : reports) {
+    log_optimize_report(report);
+    triangles += report.triangle_count;
+    misses_before += report.before.acmr * report.triangle_count;
+    misses_after += report.after.acmr * report.triangle_count;
+  }
+
+  if (triangles == 0)
+    return;
+
+  log_success("optimized " + std::to_string(triangles) + " triangles, acmr " +
+              std::to_string(misses_before / triangles) + " -> " +
+              std::to_string(misses_after / triangles));
+}
+
+// primitives decode_gltf_primitive had to drop (logged, one line each)
+// and ones without positions go before anything becomes a mesh
+void remove_dropped_primitives(std::vector<decoded_primitive> &decoded) {
+  size_t write = 0;
+  for (size_t i = 0; i < decoded.size(); i++) {
+    if (!decoded[i].decode_error.empty())
+      log_error("dropped gltf primitive " + std::to_string(i) + ": " +
+                decoded[i].decode_error);
+    if (!decoded[i].decode_error.empty() || decoded[i].vertices.empty())
+      continue;
+    if (write != i)
+      decoded[write] = std::move(decoded[i]);
+    write++;
+  }
+  decoded.resize(write);
+}
+
+glm::mat4 get_gltf_node_transform(const gltf_node &node) {
+  if (node.has_matrix)
+    return glm::make_mat4(node.matrix);
+
+  // trs defaults are identity, so they can always be applied
+  glm::mat4 node_transform = glm::translate(
+      glm::mat4(1.0f), glm::vec3(node.translation[0], node.translation[1],
+                                 node.translation[2]));
+  node_transform *= glm::mat4_cast(glm::quat(
+      node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]));
+  node_transform = glm::scale(
+      node_transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+
+  return node_transform;
+}
+
+// phase 1: walk the node tree once (depth first, same order as the old
+// recursive walk) and emit every primitive with its global transform. nodes
+// gets the hierarchy itself in the same order, ready for
+// Scene_Graph::insert_subtree
+std::vector<gltf_primitive_job>
+flatten_gltf_node_tree(const Gltf_Document &document,
+                       std::vector<scene_node_desc> &nodes) {
+  std::vector<gltf_primitive_job> jobs;
+  nodes.clear();
+  if (document.m_scenes.empty())
+    return jobs;
+
+  int scene_index = document.m_default_scene >= 0 &&
+                            document.m_default_scene <
+                                (int)document.m_scenes.size()
+                        ? document.m_default_scene
+                        : 0;
+  const auto &scene = document.m_scenes[scene_index];
+
+  struct pending_node {
+    int node_idx;
+    uint32_t parent;
+    glm::mat4 parent_transform;
+  };
+  std::vector<pending_node> node_stack;
+  for (size_t i = scene.nodes.size(); i-- > 0;)
+    node_stack.push_back({scene.nodes[i], SCENE_NODE_NONE, glm::mat4(1.0f)});
+
+  while (!node_stack.empty()) {
+    pending_node pending = node_stack.back();
+    node_stack.pop_back();
+
+    if (pending.node_idx < 0 ||
+        pending.node_idx >= (int)document.m_nodes.size())
+      continue;
+
+    const auto &node = document.m_nodes[pending.node_idx];
+    glm::mat4 local_transform = get_gltf_node_transform(node);
+    glm::mat4 global_transform = pending.parent_transform * local_transform;
+
+    uint32_t scene_node = (uint32_t)nodes.size();
+    scene_node_desc desc;
+    desc.parent = pending.parent;
+    memcpy(desc.local_matrix, glm::value_ptr(local_transform),
+           sizeof(desc.local_matrix));
+    nodes.push_back(desc);
+
+    if (node.mesh >= 0 && node.mesh < (int)document.m_meshes.size()) {
+      int primitive_count = (int)document.m_meshes[node.mesh].primitives.size();
+      for (int i = 0; i < primitive_count; i++)
+        jobs.push_back({node.mesh, i, global_transform, scene_node});
+    }
+
+    for (size_t i = node.children.size(); i-- > 0;)
+      node_stack.push_back({node.children[i], scene_node, global_transform});
+  }
+
+  return jobs;
+}
+
+// nodes referencing the same gltf mesh only get decoded once, the first
+// job collects the transforms of all of them
+std::vector<gltf_primitive_job>
+group_gltf_primitive_jobs(const std::vector<gltf_primitive_job> &jobs) {
+  std::vector<gltf_primitive_job> grouped;
+  std::unordered_map<uint64_t, size_t> first_job;
+
+  for (const auto &job : jobs) {
+    uint64_t key = ((uint64_t)(uint32_t)job.mesh_index << 32) |
+                   (uint32_t)job.primitive_index;
+    auto [it, inserted] = first_job.emplace(key, grouped.size());
+    if (inserted) {
+      grouped.push_back(job);
+      continue;
+    }
+
+    gltf_primitive_job &group = grouped[it->second];
+    if (group.instance_transforms.empty()) {
+      group.instance_transforms.push_back(group.global_transform);
+      group.instance_nodes.push_back(group.scene_node);
     }
+    group.instance_transforms.push_back(job.global_transform);
+    group.instance_nodes.push_back(job.scene_node);
+  }
+
+  return grouped;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// fnv-1a over everything that ends up in gpu buffers or picks the material
+uint64_t hash_decoded_primitive(const decoded_primitive &decoded) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  auto hash_vector = [&hash](const auto &values) {
+    size_t count = values.size();
+    hash = hash_bytes(hash, &count, sizeof(count));
+    hash = hash_bytes(hash, values.data(), values.size() * sizeof(values[0]));
   };
 
-  log_debug("starting to load gltf node tree...");
+  hash_vector(decoded.vertices);
+  hash_vector(decoded.normals);
+  hash_vector(decoded.tangents);
+  hash_vector(decoded.bitangents);
+  hash_vector(decoded.texcoords);
+  hash_vector(decoded.indices);
+  hash = hash_bytes(hash, &decoded.shader_type_carry,
+                    sizeof(decoded.shader_type_carry));
+  hash = hash_bytes(hash, &decoded.embedded_image,
+                    sizeof(decoded.embedded_image));
+  hash_vector(decoded.texture_path);
+  int sampler[4] = {decoded.sampler.min_filter, decoded.sampler.mag_filter,
+                    decoded.sampler.wrap_s, decoded.sampler.wrap_t};
+  hash = hash_bytes(hash, sampler, sizeof(sampler));
+  return hash;
+}
+
+static bool same_decoded_content(const decoded_primitive &a,
+                                 const decoded_primitive &b) {
+  return a.vertices == b.vertices && a.normals == b.normals &&
+         a.tangents == b.tangents && a.bitangents == b.bitangents &&
+         a.texcoords == b.texcoords && a.indices == b.indices &&
+         a.shader_type_carry == b.shader_type_carry &&
+         a.embedded_image == b.embedded_image &&
+         a.texture_path == b.texture_path &&
+         a.sampler.min_filter == b.sampler.min_filter &&
+         a.sampler.mag_filter == b.sampler.mag_filter &&
+         a.sampler.wrap_s == b.sampler.wrap_s &&
+         a.sampler.wrap_t == b.sampler.wrap_t;
+}
+
+// gltf files that copy the same geometry into several meshes: identical
+// primitives collapse into one with all their transforms as instances
+void merge_duplicate_primitives(std::vector<decoded_primitive> &decoded,
+                                Thread_Pool &thread_pool) {
+  std::vector<uint64_t> hashes(decoded.size());
+  thread_pool.parallel_for(decoded.size(), [&](size_t i) {
+    hashes[i] = hash_decoded_primitive(decoded[i]);
+  });
+
+  std::unordered_map<uint64_t, std::vector<size_t>> by_hash;
+  std::vector<bool> merged(decoded.size(), false);
 
-  std::function<void(int, glm::mat4)> process_node;
-  process_node = [&](int node_idx, glm::mat4 parent_transform) {
-    const auto &node = model.nodes[node_idx];
-    glm::mat4 node_transform = glm::mat4(1.0f);
-
-    if (node.matrix.size() == 16)
-      node_transform = glm::make_mat4(node.matrix.data());
-    else {
-      if (node.translation.size() == 3)
-        node_transform = glm::translate(
-            node_transform, glm::vec3(node.translation[0], node.translation[1],
-                                      node.translation[2]));
-      if (node.rotation.size() == 4)
-        node_transform *=
-            glm::mat4_cast(glm::quat(node.rotation[3], node.rotation[0],
-                                     node.rotation[1], node.rotation[2]));
-      if (node.scale.size() == 3)
-        node_transform =
-            glm::scale(node_transform,
-                       glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+  for (size_t i = 0; i < decoded.size(); i++) {
+    if (decoded[i].vertices.empty())
+      continue;
+
+    size_t target = i;
+    for (size_t candidate : by_hash[hashes[i]])
+      if (same_decoded_content(decoded[candidate], decoded[i])) {
+        target = candidate;
+        break;
+      }
+
+    if (target == i) {
+      by_hash[hashes[i]].push_back(i);
+      continue;
     }
 
-    glm::mat4 global_transform = parent_transform * node_transform;
+    auto as_instances = [](decoded_primitive &primitive) {
+      if (primitive.instance_transforms.empty()) {
+        primitive.instance_transforms.push_back(primitive.global_transform);
+        primitive.instance_nodes.push_back(primitive.scene_node);
+        primitive.global_transform = glm::mat4(1.0f);
+        primitive.scene_node = SCENE_NODE_NONE;
+      }
+    };
+    as_instances(decoded[target]);
+    as_instances(decoded[i]);
+    decoded[target].instance_transforms.insert(
+        decoded[target].instance_transforms.end(),
+        decoded[i].instance_transforms.begin(),
+        decoded[i].instance_transforms.end());
+    decoded[target].instance_nodes.insert(decoded[target].instance_nodes.end(),
+                                          decoded[i].instance_nodes.begin(),
+                                          decoded[i].instance_nodes.end());
+    merged[i] = true;
+  }
 
-    if (node.mesh >= 0) {
-      const auto &found_mesh = model.meshes[node.mesh];
+  size_t write = 0;
+  for (size_t i = 0; i < decoded.size(); i++)
+    if (!merged[i]) {
+      if (write != i)
+        decoded[write] = std::move(decoded[i]);
+      write++;
+    }
 
-      for (const auto &primitive : found_mesh.primitives) {
+  if (write != decoded.size())
+    log_debug("merged " + std::to_string(decoded.size() - write) +
+              " duplicate primitives by content");
+  decoded.resize(write);
+}
 
-        log_debug("importing primitive from node tree...");
+void read_gltf_indices(const uint8_t *base, int component_type, size_t count,
+                       uint32_t *out) {
+  switch (component_type) {
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    for (size_t i = 0; i < count; i++)
+      out[i] = reinterpret_cast<const uint8_t *>(base)[i];
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    for (size_t i = 0; i < count; i++)
+      out[i] = reinterpret_cast<const uint16_t *>(base)[i];
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    memcpy(out, base, count * sizeof(uint32_t));
+    break;
+  default:
+    log_error("Unsupported index type in GLTF");
+    break;
+  }
+}
 
-        const auto &posAccessor =
-            model.accessors[primitive.attributes.at("POSITION")];
-        const auto &posBufferView = model.bufferViews[posAccessor.bufferView];
-        const auto &posBuffer = model.buffers[posBufferView.buffer];
-        const float *positions = reinterpret_cast<const float *>(
-            &posBuffer.data[posBufferView.byteOffset + posAccessor.byteOffset]);
+// one component of any gltf component type as float. normalized integers
+// are mapped to [0, 1] / [-1, 1] like the spec (and KHR_mesh_quantization)
+// wants, everything else is just converted
+static inline float read_gltf_component(const uint8_t *data, int component_type,
+                                        bool normalized) {
+  switch (component_type) {
+  case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+    float value;
+    memcpy(&value, data, sizeof(float));
+    return value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_BYTE: {
+    int8_t value = (int8_t)data[0];
+    return normalized ? std::max(value / 127.0f, -1.0f) : (float)value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return normalized ? data[0] / 255.0f : (float)data[0];
+  case TINYGLTF_COMPONENT_TYPE_SHORT: {
+    int16_t value;
+    memcpy(&value, data, sizeof(int16_t));
+    return normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t value;
+    memcpy(&value, data, sizeof(uint16_t));
+    return normalized ? value / 65535.0f : (float)value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+    uint32_t value;
+    memcpy(&value, data, sizeof(uint32_t));
+    return normalized ? (float)(value / 4294967295.0) : (float)value;
+  }
+  default:
+    return 0.0f;
+  }
+}
 
-        const float *normals = nullptr;
-        if (primitive.attributes.count("NORMAL")) {
-          const auto &accessor =
-              model.accessors[primitive.attributes.at("NORMAL")];
-          const auto &view = model.bufferViews[accessor.bufferView];
-          normals = reinterpret_cast<const float *>(
-              &model.buffers[view.buffer]
-                   .data[view.byteOffset + accessor.byteOffset]);
-        }
+// reads a whole accessor into out, num_components floats per element.
+// handles byteStride (interleaved views) and every component type. extra
+// accessor components are dropped, missing ones stay 0. false if the
+// accessor doesnt fit its buffer
+bool read_gltf_accessor(const importer::Gltf_Source &source,
+                        const gltf_accessor &accessor, int num_components,
+                        float *out) {
+  std::fill(out, out + accessor.count * num_components, 0.0f);
+
+  // no buffer view = all zeros
+  if (accessor.buffer_view < 0)
+    return true;
 
-        const float *tangents = nullptr;
-        if (primitive.attributes.count("TANGENT")) {
-          const auto &accessor =
-              model.accessors[primitive.attributes.at("TANGENT")];
-          const auto &view = model.bufferViews[accessor.bufferView];
-          tangents = reinterpret_cast<const float *>(
-              &model.buffers[view.buffer]
-                   .data[view.byteOffset + accessor.byteOffset]);
-        }
+  const uint8_t *base = source.accessor_data(accessor);
+  if (!base)
+    return false;
 
-        const float *texcoords = nullptr;
-        if (primitive.attributes.count("TEXCOORD_0")) {
-          const auto &accessor =
-              model.accessors[primitive.attributes.at("TEXCOORD_0")];
-          const auto &view = model.bufferViews[accessor.bufferView];
-          texcoords = reinterpret_cast<const float *>(
-              &model.buffers[view.buffer]
-                   .data[view.byteOffset + accessor.byteOffset]);
-        }
+  const gltf_buffer_view &view =
+      source.m_document.m_buffer_views[accessor.buffer_view];
+  int stride = get_gltf_accessor_stride(accessor, view);
+  int component_size = get_gltf_component_size(accessor.component_type);
+  int accessor_components = accessor.components;
+  if (stride <= 0 || component_size <= 0 || accessor_components <= 0)
+    return false;
 
-        log_debug("checking material for textures etc");
-	
-	uint8_t shader_type_carry = 0;
-	std::string texture_path_of_model;
-	
-	if(primitive.material >= 0) {
-
-	  const tinygltf::Material &material =
-            model.materials[primitive.material];
-	  
-	  auto it = material.values.find("baseColorTexture");
-	  if (it != material.values.end() && it->second.TextureIndex() >= 0) {
-	    const tinygltf::Texture &texture =
-              model.textures[it->second.TextureIndex()];
-	    const tinygltf::Image &image = model.images[texture.source];
-	    std::cout << "Texture path: " << image.uri << std::endl;
-	    texture_path_of_model = image.uri;
-	    shader_type_carry = 2;
-	  } else {    
-	    log_error("no materials in mesh! using phong shaders as a fallback.");
-	    shader_type_carry = 1;
-	  }
-	} else {
-	  //also need to use fallback
-	  shader_type_carry = 1;
-	}
-        
-        // END TMP
-
-        std::vector<float> final_vertices, final_normals, final_tangents,
-            final_bitangents, final_texcoords;
-
-        size_t vertex_count = posAccessor.count;
-        if (primitive.indices >= 0) {
-          const auto &indexAccessor = model.accessors[primitive.indices];
-          for (size_t i = 0; i < indexAccessor.count; ++i) {
-            uint32_t idx = get_index(primitive, i);
-
-            final_vertices.insert(final_vertices.end(), &positions[idx * 3],
-                                  &positions[idx * 3 + 3]);
-            if (normals)
-              final_normals.insert(final_normals.end(), &normals[idx * 3],
-                                   &normals[idx * 3 + 3]);
-            if (tangents)
-              final_tangents.insert(final_tangents.end(), &tangents[idx * 4],
-                                    &tangents[idx * 4 + 3]);
-            if (texcoords)
-              final_texcoords.insert(final_texcoords.end(), &texcoords[idx * 2],
-                                     &texcoords[idx * 2 + 2]);
-          }
-        } else {
-          for (size_t i = 0; i < vertex_count; ++i) {
-
-            final_vertices.insert(final_vertices.end(), &positions[i * 3],
-                                  &positions[i * 3 + 3]);
-            if (normals)
-              final_normals.insert(final_normals.end(), &normals[i * 3],
-                                   &normals[i * 3 + 3]);
-            if (tangents)
-              final_tangents.insert(final_tangents.end(), &tangents[i * 4],
-                                    &tangents[i * 4 + 3]);
-            if (texcoords)
-              final_texcoords.insert(final_texcoords.end(), &texcoords[i * 2],
-                                     &texcoords[i * 2 + 2]);
-          }
-        }
+  size_t element_size = (size_t)component_size * accessor_components;
+  size_t needed = view.byte_offset + accessor.byte_offset +
+                  (accessor.count ? (accessor.count - 1) * stride : 0) +
+                  element_size;
+  if (view.buffer < 0 || view.buffer >= (int)source.m_buffer_size.size() ||
+      needed > source.m_buffer_size[view.buffer])
+    return false;
 
-        if (!final_tangents.empty() && !final_normals.empty()) {
-          for (size_t i = 0; i < final_normals.size(); i += 3) {
-            glm::vec3 N(final_normals[i], final_normals[i + 1],
-                        final_normals[i + 2]);
-            glm::vec3 T(final_tangents[i], final_tangents[i + 1],
-                        final_tangents[i + 2]);
-            glm::vec3 B = glm::normalize(glm::cross(N, T));
-            final_bitangents.push_back(B.x);
-            final_bitangents.push_back(B.y);
-            final_bitangents.push_back(B.z);
-          }
-        }
+  int components = std::min(num_components, accessor_components);
+
+  // tightly packed floats, the common case, are just copied
+  if (accessor.component_type == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+      components == num_components &&
+      components == accessor_components && stride == (int)element_size) {
+    memcpy(out, base, accessor.count * element_size);
+    return true;
+  }
+
+  for (size_t i = 0; i < accessor.count; i++) {
+    const uint8_t *element = base + i * stride;
+    for (int c = 0; c < components; c++)
+      out[i * num_components + c] = read_gltf_component(
+          element + c * component_size, accessor.component_type,
+          accessor.normalized);
+  }
+  return true;
+}
+
+// index accessor into out, false (with the reason in error) if it
+// doesnt fit its buffer or points past vertex_count
+bool read_gltf_index_accessor(const importer::Gltf_Source &source,
+                              const gltf_accessor &accessor,
+                              size_t vertex_count, std::vector<uint32_t> &out,
+                              std::string &error) {
+  int component_size = get_gltf_component_size(accessor.component_type);
+  if (accessor.component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+      accessor.component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+      accessor.component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+    error = "unsupported index type " + std::to_string(accessor.component_type);
+    return false;
+  }
+
+  // indices are always tightly packed scalars
+  const uint8_t *base = source.accessor_data(accessor);
+  if (!base || accessor.components != 1) {
+    error = "index accessor without data";
+    return false;
+  }
+
+  const gltf_buffer_view &view =
+      source.m_document.m_buffer_views[accessor.buffer_view];
+  // accessor_data already checked the start against the buffer
+  size_t available = source.m_buffer_size[view.buffer] - view.byte_offset -
+                     accessor.byte_offset;
+  if (accessor.count > available / component_size) {
+    error = "index accessor runs past the end of buffer " +
+            std::to_string(view.buffer);
+    return false;
+  }
 
-        log_success("done importing models, loading shaders...");
+  out.resize(accessor.count);
+  read_gltf_indices(base, accessor.component_type, accessor.count, out.data());
+
+  for (uint32_t index : out) {
+    if (index >= vertex_count) {
+      error = "index " + std::to_string(index) + " past " +
+              std::to_string(vertex_count) + " vertices";
+      out.clear();
+      return false;
+    }
+  }
+  return true;
+}
 
-        if (shader_type_carry == 2) {
-          // use texture shading
-          Shader shader_to_use("src/shaders/shader_src/flat.vert",
-                               "src/shaders/shader_src/flat.frag");
-          Material mat_to_use(E_FACE, shader_to_use);
+// phase 2: pure cpu work, runs on the thread pool. no logging, no gl
+void decode_gltf_primitive(const importer::Gltf_Source &source,
+                           const gltf_primitive_job &job,
+                           decoded_primitive &decoded) {
+  const Gltf_Document &document = source.m_document;
+  const gltf_primitive &primitive =
+      document.m_meshes[job.mesh_index].primitives[job.primitive_index];
+
+  decoded.global_transform = job.global_transform;
+  decoded.scene_node = job.scene_node;
+  if (!job.instance_transforms.empty()) {
+    decoded.global_transform = glm::mat4(1.0f);
+    decoded.scene_node = SCENE_NODE_NONE;
+    decoded.instance_transforms = job.instance_transforms;
+    decoded.instance_nodes = job.instance_nodes;
+  }
 
-          Mesh primitive_mesh(mat_to_use);
-	  primitive_mesh.m_render_mode = E_FILLED;
-	  primitive_mesh.m_type = E_MESH;
-          primitive_mesh.m_vertices_array = std::move(final_vertices);
-          primitive_mesh.m_normals_array = std::move(final_normals);
-          primitive_mesh.m_tangents_array = std::move(final_tangents);
-          primitive_mesh.m_binormals_array = std::move(final_bitangents);
-          primitive_mesh.m_tex_coords_array = std::move(final_texcoords);
-          primitive_mesh.m_model_matrix = global_transform;
+  auto is_valid_accessor = [&](int accessor) {
+    return accessor >= 0 && accessor < (int)document.m_accessors.size();
+  };
 
-          // bind tex to num_loaded_tex and increment.
-          std::filesystem::path cwd = std::filesystem::current_path();
-          std::cout << "Current working directory: " << cwd.string()
-                    << std::endl;
+  // no positions, nothing to draw
+  if (!is_valid_accessor(primitive.position))
+    return;
 
-          // this is garbage hacky shit again TODO: clean shit up lol
-          std::filesystem::path model_path = file_path;
-          std::filesystem::path full_tex_path =
-              cwd / model_path.parent_path() / texture_path_of_model;
-          std::string final_path = full_tex_path.lexically_normal().string();
+  // all attributes are read in place from the mapped buffers, in whatever
+  // layout / component type they come in
+  size_t vertex_count = document.m_accessors[primitive.position].count;
 
-          primitive_mesh.m_material.bound_texture_id = bind_texture_to_slot(
-              final_path, num_loaded_textures.load(), texture_map);
-          primitive_mesh.m_material.m_material_type = E_PBR_TEX;
-          num_loaded_textures.fetch_add(1);
+  auto read_attribute = [&](int accessor_index, int num_components,
+                            std::vector<float> &out) {
+    if (!is_valid_accessor(accessor_index))
+      return;
 
-          meshes.push_back(std::move(primitive_mesh));
+    const gltf_accessor &accessor = document.m_accessors[accessor_index];
+    if (accessor.count != vertex_count)
+      return;
 
-          log_success("yay pbr mesh or so");
+    out.resize(vertex_count * num_components);
+    if (!read_gltf_accessor(source, accessor, num_components, out.data()))
+      out.clear();
+  };
 
-        } else {
-          // use phong shading (fallback)
-          Shader shader_to_use("src/shaders/shader_src/phong.vert",
-                               "src/shaders/shader_src/phong.frag");
-          Material mat_to_use(E_FACE, shader_to_use);
-
-          Mesh primitive_mesh(mat_to_use);
-	  primitive_mesh.m_render_mode = E_FILLED;
-	  primitive_mesh.m_type = E_MESH;
-          primitive_mesh.m_vertices_array = std::move(final_vertices);
-          primitive_mesh.m_normals_array = std::move(final_normals);
-          primitive_mesh.m_tangents_array = std::move(final_tangents);
-          primitive_mesh.m_binormals_array = std::move(final_bitangents);
-          primitive_mesh.m_tex_coords_array = std::move(final_texcoords);
-          primitive_mesh.m_model_matrix = global_transform;
-
-          primitive_mesh.m_material.m_material_type = E_PHONG;
-
-          meshes.push_back(std::move(primitive_mesh));
-
-          log_success("shit phong mesh detected");
-        }
+  if (primitive.material >= 0 &&
+      primitive.material < (int)document.m_materials.size()) {
+    const gltf_material &material = document.m_materials[primitive.material];
+    int texture_index = material.base_color_texture;
+
+    if (texture_index >= 0 && texture_index < (int)document.m_textures.size() &&
+        document.m_textures[texture_index].source >= 0 &&
+        document.m_textures[texture_index].source <
+            (int)document.m_images.size()) {
+      const gltf_texture &texture = document.m_textures[texture_index];
+      const gltf_image &image = document.m_images[texture.source];
+      decoded.texture_path = std::string(image.uri);
+      size_t embedded_size = 0;
+      if (source.embedded_image_data(texture.source, embedded_size))
+        decoded.embedded_image = texture.source;
+      decoded.shader_type_carry = 2;
+
+      if (texture.sampler >= 0 &&
+          texture.sampler < (int)document.m_samplers.size()) {
+        const gltf_sampler &sampler = document.m_samplers[texture.sampler];
+        decoded.sampler.min_filter = sampler.min_filter;
+        decoded.sampler.mag_filter = sampler.mag_filter;
+        decoded.sampler.wrap_s = sampler.wrap_s;
+        decoded.sampler.wrap_t = sampler.wrap_t;
       }
     }
+  }
 
-    for (int child : node.children) {
-      process_node(child, global_transform);
-    }
+  // everything is cleared again when the primitive has to go, a half
+  // decoded one would hand out of range vertices to everything after this
+  auto drop_primitive = [&](const std::string &error) {
+    decoded.decode_error = error;
+    decoded.vertices.clear();
+    decoded.normals.clear();
+    decoded.tangents.clear();
+    decoded.bitangents.clear();
+    decoded.texcoords.clear();
+    decoded.indices.clear();
+    decoded.shader_type_carry = 1;
   };
 
-  int scene_index = model.defaultScene >= 0 ? model.defaultScene : 0;
-  const auto &scene = model.scenes[scene_index];
-  glm::mat4 identity = glm::mat4(1.0f);
+  // vertices stay unique, the index buffer is kept as is
+  read_attribute(primitive.position, 3, decoded.vertices);
+  if (decoded.vertices.empty()) {
+    if (vertex_count > 0)
+      drop_primitive("position accessor doesnt fit its buffer");
+    return;
+  }
+  read_attribute(primitive.normal, 3, decoded.normals);
+  read_attribute(primitive.texcoord_0, 2, decoded.texcoords);
+
+  // gltf tangents are vec4, w = handedness. xyz is kept as the tangent, w
+  // goes into the direction of the bitangent below
+  std::vector<float> tangents;
+  read_attribute(primitive.tangent, 4, tangents);
+  if (!tangents.empty()) {
+    decoded.tangents.resize(vertex_count * 3);
+    for (size_t i = 0; i < vertex_count; ++i)
+      memcpy(&decoded.tangents[i * 3], &tangents[i * 4], 3 * sizeof(float));
+  }
+
+  // indices go against what actually got read, not the accessor count
+  std::string index_error;
+  if (is_valid_accessor(primitive.indices) &&
+      !read_gltf_index_accessor(source, document.m_accessors[primitive.indices],
+                                decoded.vertices.size() / 3, decoded.indices,
+                                index_error)) {
+    drop_primitive(index_error);
+    return;
+  }
+
+  // mirrored uvs have w = -1, their bitangent points the other way
+  if (!decoded.tangents.empty() && !decoded.normals.empty()) {
+    decoded.bitangents.resize(decoded.normals.size());
+    for (size_t i = 0; i < decoded.normals.size(); i += 3) {
+      glm::vec3 N(decoded.normals[i], decoded.normals[i + 1],
+                  decoded.normals[i + 2]);
+      glm::vec3 T(decoded.tangents[i], decoded.tangents[i + 1],
+                  decoded.tangents[i + 2]);
+      float handedness = tangents[i / 3 * 4 + 3] < 0.0f ? -1.0f : 1.0f;
+      glm::vec3 B = glm::normalize(glm::cross(N, T)) * handedness;
+      decoded.bitangents[i] = B.x;
+      decoded.bitangents[i + 1] = B.y;
+      decoded.bitangents[i + 2] = B.z;
+    }
+  }
+}
+
+// the image a decoded primitives texture comes from, path on disk or
+// glb#imageN for embedded ones
+std::string get_texture_image_key(const decoded_primitive &decoded,
+                                  const std::string &file_path) {
+  if (decoded.embedded_image >= 0)
+    return file_path + "#image" + std::to_string(decoded.embedded_image);
+
+  // this is garbage hacky shit again TODO: clean shit up lol
+  std::filesystem::path cwd = std::filesystem::current_path();
+  std::filesystem::path model_path = file_path;
+  std::filesystem::path full_tex_path =
+      cwd / model_path.parent_path() / decoded.texture_path;
+  return full_tex_path.lexically_normal().string();
+}
+
+// key a decoded primitives texture is stored under in the texture map. the
+// sampler lives in the gl texture, so one image used through different
+// samplers is a texture per sampler
+std::string get_texture_key(const decoded_primitive &decoded,
+                            const std::string &file_path) {
+  std::string key = get_texture_image_key(decoded, file_path);
+
+  const texture_sampler &sampler = decoded.sampler;
+  const texture_sampler default_sampler;
+  if (sampler.min_filter != default_sampler.min_filter ||
+      sampler.mag_filter != default_sampler.mag_filter ||
+      sampler.wrap_s != default_sampler.wrap_s ||
+      sampler.wrap_t != default_sampler.wrap_t)
+    key += "#sampler" + std::to_string(sampler.min_filter) + "," +
+           std::to_string(sampler.mag_filter) + "," +
+           std::to_string(sampler.wrap_s) + "," +
+           std::to_string(sampler.wrap_t);
+  return key;
+}
+
+// where the primitives texture has to be decoded from. embedded images
+// point into the source mapping, so it has to outlive the decode. without
+// a source only the bookkeeping fields get filled
+texture_request make_texture_request(const decoded_primitive &decoded,
+                                     const std::string &file_path,
+                                     const std::string &texture_key,
+                                     const importer::Gltf_Source *source) {
+  texture_request request;
+  request.key = texture_key;
+  request.sampler = decoded.sampler;
+
+  // transcoded version sits right next to the image (or the glb)
+  if (decoded.embedded_image >= 0) {
+    if (source)
+      request.encoded = source->embedded_image_data(decoded.embedded_image,
+                                                    request.encoded_size);
+    request.cache_path = file_path + ".image" +
+                         std::to_string(decoded.embedded_image) + ".cxtex";
+  } else {
+    // the transcoded pixels dont depend on the sampler, one cache per image
+    request.file_path = get_texture_image_key(decoded, file_path);
+    request.cache_path = request.file_path + ".cxtex";
+  }
+
+  return request;
+}
+
+// textured meshes get the flat shader, everything else phong. flat reads
+// compact vertices as is, only phong has to decode its normals. draw_data
+// is for meshes in the geometry arena, their model matrices (instances
+// included) come from the draw data buffer, see geometryarena.hh
+Shader_Handle get_material_shader(e_mat_type material_type,
+                                  Shader_Cache &shader_cache,
+                                  bool compact_vertices = false,
+                                  bool instanced = false,
+                                  bool draw_data = false,
+                                  bool multi_draw = false) {
+  std::vector<std::string> defines;
+  if (draw_data) {
+    defines.push_back("DRAW_DATA");
+    if (multi_draw)
+      defines.push_back("MULTI_DRAW");
+  } else if (instanced)
+    defines.push_back("INSTANCED");
+
+  if (material_type == E_PBR_TEX)
+    return shader_cache.get("src/shaders/shader_src/flat.vert",
+                            "src/shaders/shader_src/flat.frag", defines);
+
+  if (compact_vertices)
+    defines.push_back("COMPACT_VERTICES");
+
+  return shader_cache.get("src/shaders/shader_src/phong.vert",
+                          "src/shaders/shader_src/phong.frag", defines);
+}
+
+// phase 3: everything touching gl (shaders, textures). context thread only.
+// textures are expected to be loaded already, source is only needed for
+// stragglers and may be null (streaming)
+Mesh build_mesh_from_decoded(decoded_primitive &decoded,
+                             const std::string &file_path,
+                             const importer::Gltf_Source *source,
+                             Shader_Cache &shader_cache,
+                             Texture_Manager &texture_manager) {
+
+  if (decoded.shader_type_carry == 2) {
+    // use texture shading
+    Material mat_to_use(E_FACE,
+                        get_material_shader(E_PBR_TEX, shader_cache, false,
+                                            !decoded.instance_transforms.empty()));
+
+    Mesh primitive_mesh(mat_to_use);
+    primitive_mesh.m_render_mode = E_FILLED;
+    primitive_mesh.m_type = E_MESH;
+    primitive_mesh.m_vertices_array = std::move(decoded.vertices);
+    primitive_mesh.m_normals_array = std::move(decoded.normals);
+    primitive_mesh.m_tangents_array = std::move(decoded.tangents);
+    primitive_mesh.m_binormals_array = std::move(decoded.bitangents);
+    primitive_mesh.m_tex_coords_array = std::move(decoded.texcoords);
+    primitive_mesh.m_indices_array = std::move(decoded.indices);
+    primitive_mesh.m_lod_indices_array = std::move(decoded.lod_indices);
+    primitive_mesh.m_lods = std::move(decoded.lods);
+    primitive_mesh.update_index_type();
+    primitive_mesh.update_bounds();
+    primitive_mesh.m_model_matrix = decoded.global_transform;
+    primitive_mesh.m_scene_node = decoded.scene_node;
+    primitive_mesh.m_instance_matrices = std::move(decoded.instance_transforms);
+    primitive_mesh.m_instance_nodes = std::move(decoded.instance_nodes);
+
+    texture_request texture_source = make_texture_request(
+        decoded, file_path, get_texture_key(decoded, file_path), source);
+    GLuint loaded_texture = texture_manager.find(texture_source.key);
+
+    if (loaded_texture == 0 && source)
+      loaded_texture = texture_manager.load(texture_source);
+    else if (loaded_texture == 0)
+      log_error("texture was never uploaded: " + texture_source.key);
+
+    texture_source.encoded = nullptr;
+    texture_source.encoded_size = 0;
+    primitive_mesh.m_material.m_texture_source = texture_source;
+    primitive_mesh.m_material.bound_texture_id = loaded_texture;
+    primitive_mesh.m_material.m_material_type = E_PBR_TEX;
+
+    log_success("yay pbr mesh or so");
+    return primitive_mesh;
+  }
 
-  for (int node_idx : scene.nodes) {
-    process_node(node_idx, identity);
+  // use phong shading (fallback)
+  Material mat_to_use(E_FACE,
+                      get_material_shader(E_PHONG, shader_cache, false,
+                                          !decoded.instance_transforms.empty()));
+
+  Mesh primitive_mesh(mat_to_use);
+  primitive_mesh.m_render_mode = E_FILLED;
+  primitive_mesh.m_type = E_MESH;
+  primitive_mesh.m_vertices_array = std::move(decoded.vertices);
+  primitive_mesh.m_normals_array = std::move(decoded.normals);
+  primitive_mesh.m_tangents_array = std::move(decoded.tangents);
+  primitive_mesh.m_binormals_array = std::move(decoded.bitangents);
+  primitive_mesh.m_tex_coords_array = std::move(decoded.texcoords);
+  primitive_mesh.m_indices_array = std::move(decoded.indices);
+  primitive_mesh.m_lod_indices_array = std::move(decoded.lod_indices);
+  primitive_mesh.m_lods = std::move(decoded.lods);
+  primitive_mesh.update_index_type();
+  primitive_mesh.update_bounds();
+  primitive_mesh.m_model_matrix = decoded.global_transform;
+  primitive_mesh.m_scene_node = decoded.scene_node;
+  primitive_mesh.m_instance_matrices = std::move(decoded.instance_transforms);
+  primitive_mesh.m_instance_nodes = std::move(decoded.instance_nodes);
+
+  primitive_mesh.m_material.m_material_type = E_PHONG;
+
+  log_success("shit phong mesh detected");
+  return primitive_mesh;
+}
+
+// nodes (optional) gets the node hierarchy the meshes refer to, see
+// Scene::add_entity_to_scene
+std::vector<Mesh> load_all_meshes_from_gltf(
+    const std::string &file_path, Thread_Pool &thread_pool,
+    Shader_Cache &shader_cache, Texture_Manager &texture_manager,
+    const mesh_import_options &import_options = {},
+    std::vector<scene_node_desc> *nodes = nullptr,
+    std::vector<std::string> *source_files = nullptr) {
+  importer::Gltf_Source source;
+
+  log_success("importing a gltf file... mapping gltf/glb file...");
+  if (!importer::load_gltf_source(file_path, source)) {
+    log_error("couldnt load gltf file!!!");
+    return {};
   }
 
+  log_debug("starting to load gltf node tree...");
+  std::vector<scene_node_desc> node_table;
+  std::vector<gltf_primitive_job> jobs = group_gltf_primitive_jobs(
+      flatten_gltf_node_tree(source.m_document, node_table));
+  log_debug_sub(std::to_string(node_table.size()) + " nodes in the hierarchy");
+
+  log_debug("decoding " + std::to_string(jobs.size()) + " primitives on " +
+            std::to_string(thread_pool.num_threads()) + " threads...");
+  std::vector<decoded_primitive> decoded(jobs.size());
+  std::vector<mesh_optimize_report> optimize_reports(jobs.size());
+  thread_pool.parallel_for(jobs.size(), [&](size_t i) {
+    decode_gltf_primitive(source, jobs[i], decoded[i]);
+    optimize_reports[i] =
+        process_decoded_primitive(decoded[i], import_options, &thread_pool);
+  });
+  remove_dropped_primitives(decoded);
+  log_optimize_reports(optimize_reports);
+  merge_duplicate_primitives(decoded, thread_pool);
+
+  // all images at once, decoded on the pool while this thread uploads
+  std::vector<texture_request> texture_requests;
+  for (const auto &primitive : decoded)
+    if (primitive.shader_type_carry == 2)
+      texture_requests.push_back(make_texture_request(
+          primitive, file_path, get_texture_key(primitive, file_path),
+          &source));
+  texture_manager.load_batch(texture_requests);
+
+  log_success("done importing models, loading shaders...");
+
+  std::vector<Mesh> meshes;
+  meshes.reserve(decoded.size());
+  for (auto &primitive : decoded)
+    meshes.push_back(build_mesh_from_decoded(primitive, file_path, &source,
+                                             shader_cache, texture_manager));
+
+  // everything got copied out of the mappings, give the pages back
+  source.release();
+
+  if (nodes)
+    *nodes = std::move(node_table);
+  if (source_files)
+    *source_files = source.m_file_paths;
+
   log_success("GLTF scene fully loaded with multiple meshes!");
 
-  for (auto mesh : meshes) {
+  for (const auto &mesh : meshes) {
 
     std::cout << "mesh in meshes with n vertices: "
-              << mesh.m_vertices_array.size() << std::endl;
+              << mesh.m_vertices_array.size() / 3
+              << " and n indices: " << mesh.m_indices_array.size() << std::endl;
+  }
+
+  return meshes;
+}
+
+// obj / ply through the same pipeline as gltf primitives. no textures
+// and no hierarchy, every mesh is phong shaded at the origin
+std::vector<Mesh> load_all_meshes_from_mesh_file(
+    const std::string &file_path, Thread_Pool &thread_pool,
+    Shader_Cache &shader_cache, Texture_Manager &texture_manager,
+    const mesh_import_options &import_options = {}) {
+  std::vector<importer::imported_mesh> imported;
+  if (!importer::load_mesh_file(file_path, thread_pool, imported)) {
+    log_error("couldnt load mesh file!!!");
+    return {};
+  }
+
+  std::vector<decoded_primitive> decoded(imported.size());
+  for (size_t i = 0; i < imported.size(); i++) {
+    decoded[i].vertices = std::move(imported[i].positions);
+    decoded[i].normals = std::move(imported[i].normals);
+    decoded[i].texcoords = std::move(imported[i].texcoords);
+    decoded[i].indices = std::move(imported[i].indices);
+  }
+  imported.clear();
+
+  std::vector<mesh_optimize_report> optimize_reports(decoded.size());
+  thread_pool.parallel_for(decoded.size(), [&](size_t i) {
+    optimize_reports[i] =
+        process_decoded_primitive(decoded[i], import_options, &thread_pool);
+  });
+  remove_dropped_primitives(decoded);
+  log_optimize_reports(optimize_reports);
+  merge_duplicate_primitives(decoded, thread_pool);
+
+  std::vector<Mesh> meshes;
+  meshes.reserve(decoded.size());
+  for (auto &primitive : decoded)
+    meshes.push_back(build_mesh_from_decoded(primitive, file_path, nullptr,
+                                             shader_cache, texture_manager));
+
+  log_success("mesh file fully loaded, " + std::to_string(meshes.size()) +
+              " meshes");
+  return meshes;
+}
+
+// processed meshes straight from a mesh cache file (see meshcache.hh).
+// streams are final already, init_scene_vbos only uploads them
+std::vector<Mesh> load_all_meshes_from_cache(const std::string &cache_path,
+                                             Shader_Cache &shader_cache,
+                                             Texture_Manager &texture_manager,
+                                             std::vector<scene_node_desc> &nodes) {
+  Mesh_Cache_File cache_file;
+  if (!cache_file.open(cache_path))
+    return {};
+
+  nodes = cache_file.nodes();
+
+  std::vector<Mesh> meshes;
+  meshes.reserve(cache_file.mesh_count());
+
+  std::vector<texture_request> texture_requests;
+  for (size_t i = 0; i < cache_file.mesh_count(); i++) {
+    e_mat_type material_type =
+        (e_mat_type)cache_file.record(i).material_type;
+    Mesh mesh(Material(E_FACE, get_material_shader(material_type, shader_cache)));
+
+    if (!mesh.deserialize(cache_file, i)) {
+      log_error("couldnt read mesh " + std::to_string(i) + " from cache");
+      return {};
+    }
+
+    if (material_type == E_PBR_TEX)
+      texture_requests.push_back(mesh.m_material.m_texture_source);
+    meshes.push_back(std::move(mesh));
   }
 
+  texture_manager.load_batch(texture_requests);
+  for (auto &mesh : meshes)
+    if (mesh.m_material.m_material_type == E_PBR_TEX)
+      mesh.m_material.bound_texture_id =
+          texture_manager.find(mesh.m_material.m_texture_source.key);
+
   return meshes;
 }
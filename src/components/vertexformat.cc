@@ -0,0 +1,274 @@
+#include "vertexformat.hh"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// stdlib
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint32_t get_encoded_size(e_vertex_encoding encoding, uint8_t components) {
+  switch (encoding) {
+  case E_ENCODING_FLOAT:
+    return components * sizeof(float);
+  case E_ENCODING_HALF:
+    return components * sizeof(uint16_t);
+  case E_ENCODING_UNORM16:
+    // always 4 wide, 3 would break the alignment of whatever follows
+    return 4 * sizeof(uint16_t);
+  case E_ENCODING_OCTAHEDRAL_SNORM16:
+    return 2 * sizeof(int16_t);
+  case E_ENCODING_SNORM_2_10_10_10:
+    return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+void vertex_stream_format::add(e_vertex_semantic semantic,
+                               e_vertex_encoding encoding,
+                               uint8_t components) {
+  if (attribute_count == MAX_ATTRIBUTES)
+    return;
+  attributes[attribute_count++] = {semantic, encoding, components, stride};
+  stride += get_encoded_size(encoding, components);
+}
+
+vertex_format get_vertex_format(bool compact, bool has_tex_coords,
+                                bool has_normals, bool has_tangents) {
+  vertex_format format;
+  if (compact) {
+    format.position.add(E_SEMANTIC_POSITION, E_ENCODING_UNORM16, 3);
+    if (has_tex_coords)
+      format.shading.add(E_SEMANTIC_TEX_COORD, E_ENCODING_HALF, 2);
+    if (has_normals)
+      format.shading.add(E_SEMANTIC_NORMAL, E_ENCODING_OCTAHEDRAL_SNORM16, 2);
+    if (has_tangents)
+      format.shading.add(E_SEMANTIC_TANGENT, E_ENCODING_SNORM_2_10_10_10, 4);
+  } else {
+    format.position.add(E_SEMANTIC_POSITION, E_ENCODING_FLOAT, 3);
+    if (has_tex_coords)
+      format.shading.add(E_SEMANTIC_TEX_COORD, E_ENCODING_FLOAT, 2);
+    if (has_normals)
+      format.shading.add(E_SEMANTIC_NORMAL, E_ENCODING_FLOAT, 3);
+    if (has_tangents)
+      format.shading.add(E_SEMANTIC_TANGENT, E_ENCODING_FLOAT, 4);
+  }
+  return format;
+}
+
+// round to nearest, no nan handling needed for uvs
+uint16_t float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent <= 0) {
+    // subnormal half or zero
+    if (exponent < -10)
+      return (uint16_t)sign;
+    mantissa |= 0x800000;
+    uint32_t shift = (uint32_t)(14 - exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1)
+      half_mantissa++;
+    return (uint16_t)(sign | half_mantissa);
+  }
+
+  if (exponent >= 31)
+    return (uint16_t)(sign | 0x7C00);
+
+  uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+  // carry into the exponent is fine, thats how rounding up works here
+  if (mantissa & 0x1000)
+    half++;
+  return (uint16_t)half;
+}
+
+static int16_t to_snorm16(float value) {
+  return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+void octahedral_encode(const float *normal, int16_t *out) {
+  float x = normal[0], y = normal[1], z = normal[2];
+  float l1_norm = std::fabs(x) + std::fabs(y) + std::fabs(z);
+  if (l1_norm <= 0.0f) {
+    out[0] = out[1] = 0;
+    return;
+  }
+
+  x /= l1_norm;
+  y /= l1_norm;
+
+  // lower hemisphere gets folded over the diagonals
+  if (z < 0.0f) {
+    float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+
+  out[0] = to_snorm16(x);
+  out[1] = to_snorm16(y);
+}
+
+static int32_t to_snorm10(float value) {
+  return (int32_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f);
+}
+
+// +1 unless the binormal points against cross(normal, tangent)
+static float get_tangent_handedness(const float *normal, const float *tangent,
+                                    const float *binormal) {
+  if (binormal == nullptr)
+    return 1.0f;
+  glm::vec3 cross = glm::cross(glm::vec3(normal[0], normal[1], normal[2]),
+                               glm::vec3(tangent[0], tangent[1], tangent[2]));
+  return glm::dot(cross, glm::vec3(binormal[0], binormal[1], binormal[2])) <
+                 0.0f
+             ? -1.0f
+             : 1.0f;
+}
+
+// one attribute of every vertex, the encoding switch stays out of the loop
+static void write_attribute(const vertex_attribute &attribute,
+                            uint32_t stride, uint8_t *out,
+                            size_t vertex_count, const float *source,
+                            const float *normals, const float *binormals,
+                            const glm::vec3 &bounds_min,
+                            const glm::vec3 &bounds_max) {
+  uint8_t *dst = out + attribute.offset;
+  // tangents are read as 3 floats, the 4th component is the handedness
+  uint32_t source_components =
+      attribute.semantic == E_SEMANTIC_TANGENT ? 3 : attribute.components;
+
+  switch (attribute.encoding) {
+  case E_ENCODING_FLOAT:
+    for (size_t v = 0; v < vertex_count; v++, dst += stride) {
+      const float *in = source + v * source_components;
+      memcpy(dst, in, source_components * sizeof(float));
+      if (attribute.semantic == E_SEMANTIC_TANGENT) {
+        float handedness = get_tangent_handedness(
+            &normals[v * 3], in, binormals ? &binormals[v * 3] : nullptr);
+        memcpy(dst + 3 * sizeof(float), &handedness, sizeof(float));
+      }
+    }
+    break;
+
+  case E_ENCODING_HALF:
+    for (size_t v = 0; v < vertex_count; v++, dst += stride) {
+      uint16_t half[4];
+      for (uint32_t c = 0; c < attribute.components; c++)
+        half[c] = float_to_half(source[v * source_components + c]);
+      memcpy(dst, half, attribute.components * sizeof(uint16_t));
+    }
+    break;
+
+  case E_ENCODING_UNORM16: {
+    glm::vec3 extent = bounds_max - bounds_min;
+    for (size_t v = 0; v < vertex_count; v++, dst += stride) {
+      uint16_t quantized[4] = {0, 0, 0, 0};
+      for (int c = 0; c < 3; c++) {
+        float normalized =
+            extent[c] > 0.0f
+                ? (source[v * source_components + c] - bounds_min[c]) /
+                      extent[c]
+                : 0.0f;
+        quantized[c] = (uint16_t)std::lround(
+            std::clamp(normalized, 0.0f, 1.0f) * 65535.0f);
+      }
+      memcpy(dst, quantized, sizeof(quantized));
+    }
+    break;
+  }
+
+  case E_ENCODING_OCTAHEDRAL_SNORM16:
+    for (size_t v = 0; v < vertex_count; v++, dst += stride) {
+      int16_t encoded[2];
+      octahedral_encode(&source[v * 3], encoded);
+      memcpy(dst, encoded, sizeof(encoded));
+    }
+    break;
+
+  case E_ENCODING_SNORM_2_10_10_10:
+    for (size_t v = 0; v < vertex_count; v++, dst += stride) {
+      const float *in = &source[v * 3];
+      float length = std::sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+      float scale = length > 0.0f ? 1.0f / length : 0.0f;
+      float handedness = get_tangent_handedness(
+          &normals[v * 3], in, binormals ? &binormals[v * 3] : nullptr);
+
+      // w: 01 = +1, 11 = -1 as 2 bit twos complement
+      uint32_t packed = (uint32_t)(to_snorm10(in[0] * scale) & 0x3FF) |
+                        (uint32_t)(to_snorm10(in[1] * scale) & 0x3FF) << 10 |
+                        (uint32_t)(to_snorm10(in[2] * scale) & 0x3FF) << 20 |
+                        (handedness < 0.0f ? 3u : 1u) << 30;
+      memcpy(dst, &packed, sizeof(packed));
+    }
+    break;
+  }
+}
+
+interleaved_vertices build_interleaved_vertices(
+    const vertex_format &format, const std::vector<float> &positions,
+    const std::vector<float> &tex_coords, const std::vector<float> &normals,
+    const std::vector<float> &tangents, const std::vector<float> &binormals,
+    const glm::vec3 &bounds_min, const glm::vec3 &bounds_max) {
+  interleaved_vertices vertices;
+  size_t vertex_count = positions.size() / 3;
+
+  const float *binormal_data =
+      binormals.size() == vertex_count * 3 ? binormals.data() : nullptr;
+
+  auto fill_stream = [&](const vertex_stream_format &stream,
+                         std::vector<uint8_t> &out) {
+    out.assign(vertex_count * stream.stride, 0);
+    for (uint32_t i = 0; i < stream.attribute_count; i++) {
+      const vertex_attribute &attribute = stream.attributes[i];
+      const std::vector<float> *source = nullptr;
+      size_t source_components = 3;
+      switch (attribute.semantic) {
+      case E_SEMANTIC_POSITION:
+        source = &positions;
+        break;
+      case E_SEMANTIC_TEX_COORD:
+        source = &tex_coords;
+        source_components = 2;
+        break;
+      case E_SEMANTIC_NORMAL:
+        source = &normals;
+        break;
+      case E_SEMANTIC_TANGENT:
+        source = &tangents;
+        // handedness needs the normal too
+        if (normals.size() != vertex_count * 3)
+          continue;
+        break;
+      }
+
+      // attributes the mesh has no (complete) data for stay zeroed
+      if (source->size() != vertex_count * source_components)
+        continue;
+      write_attribute(attribute, stream.stride, out.data(), vertex_count,
+                      source->data(), normals.data(), binormal_data,
+                      bounds_min, bounds_max);
+    }
+  };
+
+  fill_stream(format.position, vertices.positions);
+  fill_stream(format.shading, vertices.shading);
+  return vertices;
+}
+
+glm::mat4 get_dequantization_matrix(const glm::vec3 &bounds_min,
+                                    const glm::vec3 &bounds_max) {
+  glm::vec3 extent = bounds_max - bounds_min;
+
+  // flat axes have every vertex at 0, any scale works
+  for (int c = 0; c < 3; c++)
+    if (extent[c] <= 0.0f)
+      extent[c] = 1.0f;
+
+  return glm::scale(glm::translate(glm::mat4(1.0f), bounds_min), extent);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// stdlib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// what goes into a meshes vertex buffers. every mesh gets two of them:
+//
+//   position stream  positions only, tight. the depth / shadow pass reads
+//                    nothing else, so it only fetches this one
+//   shading stream   tex coord, normal, tangent interleaved, one fetch per
+//                    vertex for the shading passes
+//
+// binormals arent stored, tangent.w holds the handedness and the shaders
+// rebuild them as cross(normal, tangent.xyz) * tangent.w
+//
+// float format   12 + 36 bytes per vertex (was 56 as five float streams)
+// compact format  8 + 12 bytes per vertex:
+//   position  4x unorm16, inside the mesh bounds (w unused, keeps alignment)
+//   tex coord 2x half float
+//   normal    2x snorm16, octahedral
+//   tangent   snorm 2_10_10_10, handedness in the 2 bit w
+
+enum e_vertex_semantic : uint8_t {
+  E_SEMANTIC_POSITION = 0,
+  E_SEMANTIC_TEX_COORD = 1,
+  E_SEMANTIC_NORMAL = 2,
+  E_SEMANTIC_TANGENT = 3,
+};
+
+enum e_vertex_encoding : uint8_t {
+  E_ENCODING_FLOAT,
+  E_ENCODING_HALF,
+  E_ENCODING_UNORM16,
+  E_ENCODING_OCTAHEDRAL_SNORM16,
+  E_ENCODING_SNORM_2_10_10_10,
+};
+
+// one attribute inside a stream. the semantic is the shader location,
+// components is what the shader sees (w of unorm16 positions is ignored)
+struct vertex_attribute {
+  e_vertex_semantic semantic;
+  e_vertex_encoding encoding;
+  uint8_t components;
+  uint32_t offset;
+};
+
+struct vertex_stream_format {
+  static const uint32_t MAX_ATTRIBUTES = 4;
+
+  vertex_attribute attributes[MAX_ATTRIBUTES];
+  uint32_t attribute_count = 0;
+  uint32_t stride = 0;
+
+  // appends behind the last attribute, everything encodes to a multiple of
+  // 4 bytes so offsets stay aligned
+  void add(e_vertex_semantic semantic, e_vertex_encoding encoding,
+           uint8_t components);
+};
+
+struct vertex_format {
+  vertex_stream_format position;
+  vertex_stream_format shading;
+
+  uint32_t bytes_per_vertex() const { return position.stride + shading.stride; }
+};
+
+// bytes one attribute takes in its stream
+uint32_t get_encoded_size(e_vertex_encoding encoding, uint8_t components);
+
+// float or compact layout, attributes without data are left out
+vertex_format get_vertex_format(bool compact, bool has_tex_coords,
+                                bool has_normals, bool has_tangents);
+
+// the two streams, ready for glBufferData
+struct interleaved_vertices {
+  std::vector<uint8_t> positions;
+  std::vector<uint8_t> shading;
+
+  size_t byte_size() const { return positions.size() + shading.size(); }
+};
+
+uint16_t float_to_half(float value);
+
+// unit vector -> 2x snorm16 on the octahedron
+void octahedral_encode(const float *normal, int16_t *out);
+
+// float arrays of a mesh (3 floats per position/normal/tangent/binormal,
+// 2 per uv) into the streams of format. binormals only decide the tangent
+// handedness, without them its +1. the bounds are only used for unorm16
+// positions
+interleaved_vertices build_interleaved_vertices(
+    const vertex_format &format, const std::vector<float> &positions,
+    const std::vector<float> &tex_coords, const std::vector<float> &normals,
+    const std::vector<float> &tangents, const std::vector<float> &binormals,
+    const glm::vec3 &bounds_min, const glm::vec3 &bounds_max);
+
+// maps the unorm16 positions back into mesh space. goes in front of the
+// model matrix, so no shader has to know about the quantization
+glm::mat4 get_dequantization_matrix(const glm::vec3 &bounds_min,
+                                    const glm::vec3 &bounds_max);
@@ -1,12 +1,64 @@
 #include "renderer.hh"
+#include "components/importer.hh"
+#include "components/meshgeometry.hh"
+#include "components/meshimport.hh"
+
+// stdlib
+#include <string>
+#include <vector>
 
 //defines
 #define window_width 1920
 #define window_height 1080
-int main () {
+int main (int argc, char **argv) {
+
+  // cpu only, no window needed
+  if (argc > 1 && std::string(argv[1]) == "--bench-vertex-basis") {
+    Thread_Pool bench_pool;
+    benchmark_vertex_basis(bench_pool);
+    return 0;
+  }
+
+  // gltf files to parse, the sample scenes if none are given
+  if (argc > 1 && std::string(argv[1]) == "--bench-gltf-parse") {
+    std::vector<std::string> files(argv + 2, argv + argc);
+    if (files.empty())
+      files = {"models/scene.gltf", "models/crazy.gltf",
+               "models/multiple_cubes.gltf", "models/cube.glb",
+               "models/tex_cube/tex_cube.gltf"};
+    importer::benchmark_gltf_parse(files);
+    return 0;
+  }
+
+  // obj / ply import throughput, the files are logged one by one
+  if (argc > 2 && std::string(argv[1]) == "--bench-mesh-import") {
+    Thread_Pool bench_pool;
+    for (int i = 2; i < argc; i++) {
+      std::vector<importer::imported_mesh> meshes;
+      importer::load_mesh_file(argv[i], bench_pool, meshes);
+    }
+    return 0;
+  }
 
   Renderer main_renderer(1920,1080);
-  main_renderer.init_scene("models/potter/scene.gltf");
+
+  // opt in switches for the scene below, any order
+  bool stream_scene = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--stream")
+      stream_scene = true;
+    else if (arg == "--compact-vertices")
+      main_renderer.m_use_compact_vertices = true;
+    else if (arg == "--optimize-meshes")
+      main_renderer.m_import_options.optimize = true;
+    else if (arg == "--generate-lods")
+      main_renderer.m_import_options.generate_lods = true;
+    else if (arg == "--occlusion-culling")
+      main_renderer.m_use_occlusion_culling = true;
+  }
+
+  main_renderer.init_scene("models/potter/scene.gltf", stream_scene);
   //main_renderer.init_scene("models/debug_cubes/debug_cubes.gltf");
   //main_renderer.init_scene("models/diorama/scene.gltf");
 
@@ -19,28 +19,53 @@
 #include <glm/gtc/type_ptr.hpp>
 
 // stdlib
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 // components (custom)
 #include "components/animation.hh"
 #include "components/entity.hh"
+#include "components/gldebug.hh"
+#include "components/glresources.hh"
 #include "components/input.hh"
 #include "components/light.hh"
 #include "components/logging.hh"
 #include "components/mesh.hh"
 #include "components/scene.hh"
 #include "components/utility.hh"
+#include "components/vertexformat.hh"
 #include "components/animationmanager.hh"
 #include "shaders/shaderclass.hh"
 
 
 #define DEF_NEAR_CLIP_PLANE 0.01f
 #define DEF_FAR_CLIP_PLANE 10000.0f
+#define DEF_FOV_DEGREES 90.0f
+
+// per draw gl checks, compiled out in release builds (-DNDEBUG). with debug
+// output the driver reports errors through the callback, glGetError after
+// every call would only add syncs then
+#ifdef NDEBUG
+#define CHECK_GL_DRAW(context) ((void)0)
+#define CHECK_GL_VAO(vao) ((void)0)
+#else
+#define CHECK_GL_DRAW(context)                                                 \
+  do {                                                                         \
+    if (!m_gl_debug_output)                                                    \
+      check_gl_error(context);                                                 \
+  } while (0)
+#define CHECK_GL_VAO(vao)                                                      \
+  do {                                                                         \
+    if (glIsVertexArray(vao) == GL_FALSE)                                      \
+      log_error("no valid VAO id! cant render mesh.");                         \
+  } while (0)
+#endif
 
 void Renderer::setup_render_properties() {
 
@@ -62,6 +87,7 @@ void Renderer::framebuffer_size_callback(GLFWwindow *window, int width,
 
 
 void Renderer::render_frame() {
+  auto frame_start = std::chrono::steady_clock::now();
 
   if (!m_active_scene->m_camera) {
     log_error("no camera in scene! stopping render!");
@@ -86,16 +112,29 @@ void Renderer::render_frame() {
   // handle all abstracted stuff that changes the scene somehow
   setup_render_properties();
   m_animation_manager->handle_scene_animations(m_application_current_time);
-  m_physics_manager->handle_scene_physics();
+  // world matrices of everything below a changed local matrix
+  m_frame_nodes_updated = m_active_scene->m_graph.update();
+  // hitboxes are built once from all meshes, so wait for the stream to finish
+  if (!scene_stream_active())
+    m_physics_manager->handle_scene_physics();
   m_input_manager->process_input(associated_window, m_application_current_time, m_deltaTime);
 
+  // take over whatever the stream loader finished since last frame
+  drain_stream_queue();
+
   // make sure data changes get reflected in VRAM
   if(m_active_scene->m_scene_vbos_need_refresh)
     init_scene_vbos();
+
+  // meshes whose nodes moved (or that are new) pick up their world matrix
+  update_mesh_transforms();
   
   // setup constants for render pass
   glfwGetWindowSize(associated_window, &m_viewport_width, &m_viewport_height);
 
+  // one lod per mesh for this frame, shadow and main pass draw the same
+  select_mesh_lods();
+
   depth_shader->use();
 
   // configure spotlight shadow mapping
@@ -118,39 +157,80 @@ void Renderer::render_frame() {
   // (float)shadow_width / (float)shadow_height, 0.1f,50.0f);
   glm::mat4 light_space_matrix = light_projection_mat * light_look_at;
 
-  depth_shader->use();
+  glm::mat4 view_mat = glm::lookAt(m_active_scene->m_camera->m_cameraPos,
+                                   m_active_scene->m_camera->m_cameraLookAt +
+                                       m_active_scene->m_camera->m_cameraPos,
+                                   m_active_scene->m_camera->m_cameraUp);
+
+  // projection matrix
+  glm::mat4 projection_mat = glm::perspective(
+      glm::radians(DEF_FOV_DEGREES),
+      (float)m_viewport_width / (float)m_viewport_height,
+      DEF_NEAR_CLIP_PLANE, DEF_FAR_CLIP_PLANE);
+
+  // everything both passes share goes up once, per draw only "model" is left
+  frame_uniforms frame_data;
+  frame_data.view = view_mat;
+  frame_data.projection = projection_mat;
+  frame_data.light_space_matrix = light_space_matrix;
+  frame_data.view_position =
+      glm::vec4(m_active_scene->m_camera->m_cameraPos, 1.0f);
+  frame_data.light_position = glm::vec4(light_pos_new, 1.0f);
+  // TMP ghetto light color
+  frame_data.light_color = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+  upload_frame_uniforms(frame_data);
 
   glViewport(0, 0, shadow_map_width, shadow_map_height);
   glBindFramebuffer(GL_FRAMEBUFFER, window_depth_map_fbo);
   glClear(GL_DEPTH_BUFFER_BIT);
 
-  check_gl_error("after setting viewport stuff up (depth)");
+  // what each pass can see at all, the queues skip the rest
+  glm::mat4 camera_view_projection = projection_mat * view_mat;
+  cull_meshes(camera_view_projection, light_space_matrix);
+  // whatever the biggest close meshes hide drops out of the main pass
+  cull_occluded_meshes(camera_view_projection,
+                       m_active_scene->m_camera->m_cameraPos);
+
+  // both passes as sorted queues, binds that wouldnt change anything
+  // get skipped
+  build_render_queues(m_active_scene->m_camera->m_cameraPos, light_pos_new);
+
+  // model matrices of arena meshes, the cache doesnt know about this unit
+  if (m_geometry_arena && m_gl_caps->m_has_direct_state_access) {
+    m_gl_caps->glBindTextureUnit(TEXTURE_UNIT_DRAW_DATA,
+                                 m_geometry_arena->draw_data_texture());
+  } else if (m_geometry_arena) {
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_DRAW_DATA);
+    glBindTexture(GL_TEXTURE_BUFFER, m_geometry_arena->draw_data_texture());
+  }
+  m_bind_cache.reset();
+  m_frame_gl_draws = 0;
+  m_frame_multi_draws = 0;
 
   // render scene from light pov
-  for (auto &entity : m_active_scene->m_loaded_entities) {
-    for (auto &mesh : entity.m_mesh) {
+  for (const draw_batch &batch : m_shadow_batches) {
+    const Mesh &mesh = *m_shadow_queue.items()[batch.first_item].mesh;
 
-      // bind meshes vao context
-      glBindVertexArray(mesh.m_mesh_vao);
-      if (glIsVertexArray(mesh.m_mesh_vao) == GL_FALSE) {
-        log_error("no valid VAO id! cant render mesh.");
-      }
-
-      check_gl_error("before setting uniforms (depth)");
+    GLenum polygon_mode = mesh.m_render_mode == E_WIREFRAME ? GL_LINE : GL_FILL;
+    if (m_bind_cache.change(E_BIND_POLYGON_MODE, polygon_mode))
+      glPolygonMode(GL_FRONT_AND_BACK, polygon_mode);
 
-      upload_to_uniform("model", depth_shader->ID,
-                        entity.m_model_matrix * mesh.m_model_matrix);
-      upload_to_uniform("light_space_matrix", depth_shader->ID,
-                        light_space_matrix);
+    // bind meshes vao context
+    if (m_bind_cache.change(E_BIND_VAO, mesh.m_mesh_vao)) {
+      glBindVertexArray(mesh.m_mesh_vao);
+      CHECK_GL_VAO(mesh.m_mesh_vao);
+    }
 
-      check_gl_error("after setting uniforms (depth)");
+    CHECK_GL_DRAW("before setting uniforms (depth)");
 
-      // we renderin
-      glDrawArrays(GL_TRIANGLES, 0, mesh.m_vertices_array.size() / 3);
+    Shader *mesh_depth_shader = get_depth_shader(mesh);
+    if (m_bind_cache.change(E_BIND_PROGRAM, mesh_depth_shader->ID))
+      mesh_depth_shader->use();
 
-      check_gl_error("after glDrawArrays (depth)");
-    }
+    // we renderin
+    submit_draw_batch(m_shadow_queue, batch, *mesh_depth_shader);
   }
+  check_gl_pass("after shadow pass");
 
   // rebind old fb
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -161,91 +241,45 @@ void Renderer::render_frame() {
   glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  check_gl_error("after clearing frame");
-
-  glm::mat4 view_mat = glm::lookAt(m_active_scene->m_camera->m_cameraPos,
-                                   m_active_scene->m_camera->m_cameraLookAt +
-                                       m_active_scene->m_camera->m_cameraPos,
-                                   m_active_scene->m_camera->m_cameraUp);
-
-  // projection matrix
-  glm::mat4 projection_mat = glm::perspective(
-      glm::radians(90.0f), (float)m_viewport_width / (float)m_viewport_height,
-      DEF_NEAR_CLIP_PLANE, DEF_FAR_CLIP_PLANE);
-
   // render meshes
-  for (auto &entity : m_active_scene->m_loaded_entities) {
-    for (auto &mesh : entity.m_mesh) {
-
-      //change hitbox or flat style
-      if(mesh.m_render_mode == E_WIREFRAME)
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      else
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-      
-      // bind meshes vao context
-      glBindVertexArray(mesh.m_mesh_vao);
-      if (glIsVertexArray(mesh.m_mesh_vao) == GL_FALSE) {
-        log_error("no valid VAO id! cant render mesh.");
-      }
-
-      check_gl_error("after binding vao");
+  for (const draw_batch &batch : m_main_batches) {
+    const Mesh &mesh = *m_main_queue.items()[batch.first_item].mesh;
 
-      mesh.m_material.m_shader.use();
+    //change hitbox or flat style
+    GLenum polygon_mode = mesh.m_render_mode == E_WIREFRAME ? GL_LINE : GL_FILL;
+    if (m_bind_cache.change(E_BIND_POLYGON_MODE, polygon_mode))
+      glPolygonMode(GL_FRONT_AND_BACK, polygon_mode);
 
-      check_gl_error("after setting shader active");
-
-      if (mesh.m_material.m_material_type == E_PBR_TEX) {
-
-        // bind texture to uniform
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mesh.m_material.bound_texture_id);
-        GLint loc_tex =
-            glGetUniformLocation(mesh.m_material.m_shader.ID, "uTexture");
-        glUniform1i(loc_tex, 0);
-        // bind depth map to uniform
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, window_depth_map);
-        GLint loc_depth =
-            glGetUniformLocation(mesh.m_material.m_shader.ID, "uDepthMap");
-        glUniform1i(loc_depth, 1);
-
-        check_gl_error("after uploading textures");
-      }
-
-      // TMP ghetto light + color
-      glm::vec3 light_position =
-          m_active_scene->m_loaded_lights[0].get_light_position();
-
-      upload_to_uniform("objectColor", mesh.m_material.m_shader.ID,
-                        glm::vec3(0.5, 0.8, 0.2));
-      upload_to_uniform("lightColor", mesh.m_material.m_shader.ID,
-                        glm::vec3(0.8, 0.8, 0.8));
-
-      upload_to_uniform("model", mesh.m_material.m_shader.ID,
-                        entity.m_model_matrix * mesh.m_model_matrix);
+    // bind meshes vao context
+    if (m_bind_cache.change(E_BIND_VAO, mesh.m_mesh_vao)) {
+      glBindVertexArray(mesh.m_mesh_vao);
+      CHECK_GL_VAO(mesh.m_mesh_vao);
+    }
 
-      upload_to_uniform("view", mesh.m_material.m_shader.ID, view_mat);
-      upload_to_uniform("viewPosition", mesh.m_material.m_shader.ID,
-                        m_active_scene->m_camera->m_cameraPos);
-      upload_to_uniform("projection", mesh.m_material.m_shader.ID,
-                        projection_mat);
-      upload_to_uniform("lightPosition", mesh.m_material.m_shader.ID,
-                        light_position);
-      upload_to_uniform("viewPos", mesh.m_material.m_shader.ID,
-                        m_active_scene->m_camera->m_cameraPos);
+    CHECK_GL_DRAW("after binding vao");
 
-      upload_to_uniform("light_space_matrix", mesh.m_material.m_shader.ID,
-                        light_space_matrix);
+    if (m_bind_cache.change(E_BIND_PROGRAM, mesh.m_material.m_shader->ID))
+      mesh.m_material.m_shader->use();
 
-      check_gl_error("after setting uniforms");
+    CHECK_GL_DRAW("after setting shader active");
 
-      // we renderin
-      glDrawArrays(GL_TRIANGLES, 0, mesh.m_vertices_array.size() / 3);
+    if (mesh.m_material.m_material_type == E_PBR_TEX) {
+      // the samplers point at these units since the program was linked
+      bind_texture_unit(TEXTURE_UNIT_DIFFUSE, mesh.m_material.bound_texture_id);
+      bind_texture_unit(TEXTURE_UNIT_SHADOW_MAP, window_depth_map);
 
-      check_gl_error("after glDrawArrays");
+      CHECK_GL_DRAW("after uploading textures");
     }
+
+    // we renderin
+    submit_draw_batch(m_main_queue, batch, *mesh.m_material.m_shader);
   }
+  check_gl_pass("after main pass");
+
+  m_frame_binds = m_bind_cache.m_binds;
+  m_frame_binds_skipped = m_bind_cache.m_binds_skipped;
+  m_bind_cache.m_binds = 0;
+  m_bind_cache.m_binds_skipped = 0;
 
   ////////////////////////
   // finally draw visualizers for all lights in the scene
@@ -254,95 +288,730 @@ void Renderer::render_frame() {
 
     // bind meshes vao context
     glBindVertexArray(light_source.m_light_visualizer_mesh.m_mesh_vao);
-    if (glIsVertexArray(light_source.m_light_visualizer_mesh.m_mesh_vao) ==
-        GL_FALSE) {
-      log_error("no valid VAO id! cant render mesh.");
-    }
+    CHECK_GL_VAO(light_source.m_light_visualizer_mesh.m_mesh_vao);
 
-    check_gl_error("after binding vao (lights)");
+    CHECK_GL_DRAW("after binding vao (lights)");
 
-    light_source.m_light_visualizer_mesh.m_material.m_shader.use();
+    light_source.m_light_visualizer_mesh.m_material.m_shader->use();
 
-    check_gl_error("after setting shader active (lights)");
+    CHECK_GL_DRAW("after setting shader active (lights)");
 
     if (light_source.m_light_visualizer_mesh.m_material.m_material_type ==
         E_PBR_TEX) {
 
-      // bind texture to uniform
-      glActiveTexture(GL_TEXTURE0);
+      glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_DIFFUSE);
       glBindTexture(
           GL_TEXTURE_2D,
           light_source.m_light_visualizer_mesh.m_material.bound_texture_id);
-      GLint loc_tex = glGetUniformLocation(
-          light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-          "uTexture");
-      glUniform1i(loc_tex, 0);
-      // bind depth map to uniform
-      glActiveTexture(GL_TEXTURE1);
+      glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_SHADOW_MAP);
       glBindTexture(GL_TEXTURE_2D, window_depth_map);
-      GLint loc_depth = glGetUniformLocation(
-          light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-          "uDepthMap");
-      glUniform1i(loc_depth, 1);
 
-      check_gl_error("after uploading textures");
+      CHECK_GL_DRAW("after uploading textures");
     }
 
     upload_to_uniform(
-        "objectColor",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        glm::vec3(0.5, 0.8, 0.2));
-    upload_to_uniform(
-        "lightColor",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        glm::vec3(0.8, 0.8, 0.8));
-    upload_to_uniform(
-        "model", light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
+        light_source.m_light_visualizer_mesh.m_material.m_shader->model_location,
         light_source.m_light_matrix);
 
-    upload_to_uniform(
-        "view", light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        view_mat);
-    upload_to_uniform(
-        "viewPosition",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        m_active_scene->m_camera->m_cameraPos);
-    upload_to_uniform(
-        "projection",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        projection_mat);
-    upload_to_uniform(
-        "lightPosition",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        glm::vec3(0.0f));
-    upload_to_uniform(
-        "viewPos", light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        m_active_scene->m_camera->m_cameraPos);
-    upload_to_uniform(
-        "light_space_matrix",
-        light_source.m_light_visualizer_mesh.m_material.m_shader.ID,
-        light_space_matrix);
-
-    check_gl_error("after setting uniforms");
+    CHECK_GL_DRAW("after setting uniforms");
 
     // we renderin
-    glDrawArrays(GL_TRIANGLES, 0,
-                 light_source.m_light_visualizer_mesh.m_vertices_array.size() /
-                     3);
+    draw_mesh(light_source.m_light_visualizer_mesh);
 
-    check_gl_error("after glDrawArrays (lights)");
+    CHECK_GL_DRAW("after draw_mesh (lights)");
   }
+  check_gl_pass("after light visualizers");
+
+  // cpu side of the frame, the swap waits for the gpu
+  m_frame_cpu_ms += std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - frame_start)
+                        .count();
+  m_frame_count++;
 
   // draw to screen
   glfwSwapBuffers(associated_window);
   glfwPollEvents();
+
+  if (m_time_to_first_frame < 0.0) {
+    m_time_to_first_frame = glfwGetTime() - m_scene_init_time;
+    log_success("time to first frame: " +
+                std::to_string(m_time_to_first_frame * 1000.0) + " ms");
+  }
+
+  log_frame_stats();
+}
+
+// material texel of the draw data (see geometryarena.hh)
+static glm::vec4 get_draw_material(const Mesh &mesh) {
+  return glm::vec4((float)mesh.m_material.m_material_type,
+                   (float)mesh.m_material.bound_texture_id, 0.0f, 0.0f);
+}
+
+// the scene graph was updated at the start of the frame, this only copies
+// out what moved. instanced meshes reupload their instance buffer then
+void Renderer::update_mesh_transforms() {
+  m_frame_transforms_refreshed = 0;
+
+  for (auto &entity : m_active_scene->m_loaded_entities) {
+    for (auto &mesh : entity.m_mesh) {
+      if (!mesh.m_world_matrix_stale &&
+          !m_active_scene->mesh_transform_changed(entity, mesh))
+        continue;
+
+      mesh.m_world_matrix_stale = false;
+      m_frame_transforms_refreshed++;
+
+      if (mesh.m_instance_matrices.empty()) {
+        mesh.m_world_matrix = m_active_scene->get_mesh_world_matrix(entity, mesh);
+        mesh.m_model_uniform = mesh.m_world_matrix * mesh.m_dequant_matrix;
+        update_mesh_bounds(mesh);
+        if (mesh.m_geometry.valid())
+          m_geometry_arena->set_draw_data(mesh.m_geometry.first_draw_slot,
+                                          mesh.m_model_uniform,
+                                          get_draw_material(mesh));
+        continue;
+      }
+
+      // instance buffer holds full world matrices, nothing left for "model"
+      mesh.m_model_uniform = glm::mat4(1.0f);
+      mesh.m_instance_world_matrices.resize(mesh.m_instance_matrices.size());
+      std::vector<glm::mat4> instance_data(mesh.m_instance_matrices.size());
+      for (size_t i = 0; i < instance_data.size(); i++) {
+        mesh.m_instance_world_matrices[i] =
+            m_active_scene->get_instance_world_matrix(entity, mesh, i);
+        instance_data[i] =
+            mesh.m_instance_world_matrices[i] * mesh.m_dequant_matrix;
+      }
+      update_mesh_bounds(mesh);
+
+      // arena meshes have one draw data slot per instance
+      if (mesh.m_geometry.valid()) {
+        for (size_t i = 0; i < instance_data.size(); i++)
+          m_geometry_arena->set_draw_data(
+              mesh.m_geometry.first_draw_slot + (uint32_t)i, instance_data[i],
+              get_draw_material(mesh));
+        continue;
+      }
+
+      if (mesh.m_instances_glid == 0)
+        continue;
+      update_gl_buffer(m_gl_caps.get(), mesh.m_instances_glid, 0,
+                       instance_data.size() * sizeof(glm::mat4),
+                       instance_data.data());
+    }
+  }
+
+  if (m_geometry_arena)
+    m_geometry_arena->upload_draw_data();
+}
+
+// screen space error of every lod from the bounding sphere, see the
+// m_lod_* members in renderer.hh. instanced meshes go by their closest
+// instance and only get culled if every instance is too small
+void Renderer::select_mesh_lods() {
+  m_frame_triangles_full = 0;
+  m_frame_triangles_drawn = 0;
+  m_frame_meshes_culled = 0;
+  m_frame_draw_calls = 0;
+  m_frame_instances = 0;
+
+  const glm::vec3 &camera_pos = m_active_scene->m_camera->m_cameraPos;
+
+  // world units at distance 1 -> pixels
+  float pixels_per_unit =
+      (float)m_viewport_height /
+      (2.0f * std::tan(glm::radians(DEF_FOV_DEGREES) * 0.5f));
+
+  for (auto &entity : m_active_scene->m_loaded_entities) {
+    for (auto &mesh : entity.m_mesh) {
+      size_t instances = mesh.instance_count();
+      size_t full_triangles =
+          (mesh.m_indices_array.empty() ? mesh.m_vertices_array.size() / 9
+                                        : mesh.m_indices_array.size() / 3) *
+          instances;
+      m_frame_triangles_full += full_triangles;
+      m_frame_instances += instances;
+      mesh.m_lod_culled = false;
+      mesh.m_current_lod = std::min(mesh.m_current_lod,
+                                    mesh.m_lods.empty() ? 0
+                                                        : mesh.m_lods.size() - 1);
+
+      if (mesh.m_type != E_MESH || mesh.m_lods.empty()) {
+        mesh.m_current_lod = 0;
+        m_frame_triangles_drawn += full_triangles;
+        m_frame_draw_calls++;
+        continue;
+      }
+
+      glm::vec3 local_center = (mesh.m_bounds_min + mesh.m_bounds_max) * 0.5f;
+      float local_radius =
+          glm::length(mesh.m_bounds_max - mesh.m_bounds_min) * 0.5f;
+
+      // largest on screen size of any instance, per world unit of error
+      float units_to_pixels = 0.0f;
+      float diameter_pixels = 0.0f;
+      bool camera_inside = false;
+      for (size_t i = 0; i < instances && !camera_inside; i++) {
+        const glm::mat4 &world = mesh.m_instance_world_matrices.empty()
+                                     ? mesh.m_world_matrix
+                                     : mesh.m_instance_world_matrices[i];
+
+        float scale = std::max({glm::length(glm::vec3(world[0])),
+                                glm::length(glm::vec3(world[1])),
+                                glm::length(glm::vec3(world[2]))});
+        glm::vec3 center = glm::vec3(world * glm::vec4(local_center, 1.0f));
+        float radius = local_radius * scale;
+        float distance = glm::length(center - camera_pos) - radius;
+
+        if (distance <= DEF_NEAR_CLIP_PLANE) {
+          camera_inside = true;
+          continue;
+        }
+
+        float instance_pixels = scale * pixels_per_unit / distance;
+        units_to_pixels = std::max(units_to_pixels, instance_pixels);
+        diameter_pixels = std::max(diameter_pixels,
+                                   2.0f * local_radius * instance_pixels);
+      }
+
+      // camera inside the bounds, nothing to save here
+      if (camera_inside) {
+        mesh.m_current_lod = 0;
+        m_frame_triangles_drawn += full_triangles;
+        m_frame_draw_calls++;
+        continue;
+      }
+
+      if (diameter_pixels < m_lod_cull_pixels) {
+        mesh.m_lod_culled = true;
+        m_frame_meshes_culled++;
+        continue;
+      }
+
+      auto coarsest_within = [&](float pixels) {
+        size_t lod = 0;
+        while (lod + 1 < mesh.m_lods.size() &&
+               mesh.m_lods[lod + 1].error * units_to_pixels <= pixels)
+          lod++;
+        return lod;
+      };
+
+      size_t current = mesh.m_current_lod;
+      if (mesh.m_lods[current].error * units_to_pixels > m_lod_error_pixels)
+        mesh.m_current_lod = coarsest_within(m_lod_error_pixels);
+      else
+        mesh.m_current_lod = std::max(
+            current,
+            coarsest_within(m_lod_error_pixels * (1.0f - m_lod_hysteresis)));
+
+      m_frame_triangles_drawn +=
+          mesh.m_lods[mesh.m_current_lod].index_count / 3 * instances;
+      m_frame_draw_calls++;
+    }
+  }
+}
+
+// one glGetError sweep per pass, for when there is no debug callback
+void Renderer::check_gl_pass(const char *context) {
+  if (!m_gl_debug_output)
+    check_gl_error(context);
+}
+
+// world bounds of every instance, the cull bvh picks them up with the next
+// refit unless it gets rebuilt anyway
+void Renderer::update_mesh_bounds(Mesh &mesh) {
+  if (mesh.m_instance_world_matrices.empty()) {
+    mesh.m_world_bounds = get_world_bounds(mesh.m_bounds_min,
+                                           mesh.m_bounds_max,
+                                           mesh.m_world_matrix);
+  } else {
+    mesh.m_world_bounds =
+        get_world_bounds(mesh.m_bounds_min, mesh.m_bounds_max,
+                         mesh.m_instance_world_matrices[0]);
+    for (size_t i = 1; i < mesh.m_instance_world_matrices.size(); i++)
+      merge_world_bounds(mesh.m_world_bounds,
+                         get_world_bounds(mesh.m_bounds_min,
+                                          mesh.m_bounds_max,
+                                          mesh.m_instance_world_matrices[i]));
+  }
+
+  if (!m_cull_bvh_dirty && mesh.m_cull_item != Cull_Bvh::INVALID)
+    m_cull_bvh.update_item(mesh.m_cull_item, mesh.m_world_bounds);
+}
+
+// camera and light frustum against the cull bvh, the result goes into the
+// meshes m_in_*_frustum flags. skyboxes are never culled
+void Renderer::cull_meshes(const glm::mat4 &camera_view_projection,
+                           const glm::mat4 &light_space_matrix) {
+  if (m_cull_bvh_dirty) {
+    m_cull_meshes.clear();
+    std::vector<world_bounds> bounds;
+    for (auto &entity : m_active_scene->m_loaded_entities) {
+      for (auto &mesh : entity.m_mesh) {
+        mesh.m_cull_item = (uint32_t)m_cull_meshes.size();
+        m_cull_meshes.push_back(&mesh);
+        bounds.push_back(mesh.m_world_bounds);
+      }
+    }
+    m_cull_bvh.build(bounds);
+    m_cull_bvh_dirty = false;
+  } else {
+    m_cull_bvh.refit();
+  }
+
+  if (!m_use_frustum_culling) {
+    for (Mesh *mesh : m_cull_meshes)
+      mesh->m_in_camera_frustum = mesh->m_in_light_frustum = true;
+    m_frame_camera_cull = cull_stats();
+    m_frame_light_cull = cull_stats();
+    return;
+  }
+
+  m_cull_bvh.cull(get_frustum_planes(camera_view_projection), m_cull_visible,
+                  m_frame_camera_cull);
+  for (size_t i = 0; i < m_cull_meshes.size(); i++)
+    m_cull_meshes[i]->m_in_camera_frustum =
+        m_cull_visible[i] || m_cull_meshes[i]->m_type == E_SKYBOX;
+
+  m_cull_bvh.cull(get_frustum_planes(light_space_matrix), m_cull_visible,
+                  m_frame_light_cull);
+  for (size_t i = 0; i < m_cull_meshes.size(); i++)
+    m_cull_meshes[i]->m_in_light_frustum =
+        m_cull_visible[i] || m_cull_meshes[i]->m_type == E_SKYBOX;
+}
+
+// main pass occlusion culling on the cpu, see the m_occlu* members in
+// renderer.hh. occluders are single (not instanced) filled meshes, the
+// bounds of instanced meshes cover every instance and say nothing about
+// how much one of them hides. occluders arent tested themselves
+void Renderer::cull_occluded_meshes(const glm::mat4 &camera_view_projection,
+                                    const glm::vec3 &camera_pos) {
+  m_frame_occluders = 0;
+  m_frame_occluder_triangles = 0;
+  m_frame_occlusion_tested = 0;
+  m_frame_occlusion_rejected = 0;
+  m_frame_occlusion_ms = 0.0;
+  for (Mesh *mesh : m_cull_meshes)
+    mesh->m_occluded = false;
+  if (!m_use_occlusion_culling)
+    return;
+
+  auto start = std::chrono::steady_clock::now();
+
+  // biggest on screen first
+  std::vector<std::pair<float, Mesh *>> candidates;
+  for (Mesh *mesh : m_cull_meshes) {
+    if (!mesh->m_in_camera_frustum || mesh->m_lod_culled ||
+        mesh->m_type != E_MESH || mesh->m_render_mode != E_FILLED ||
+        !mesh->m_instance_world_matrices.empty() ||
+        mesh->m_vertices_array.empty())
+      continue;
+
+    const world_bounds &bounds = mesh->m_world_bounds;
+    float size = bounds.radius / std::max(glm::length(bounds.center - camera_pos),
+                                          DEF_NEAR_CLIP_PLANE);
+    if (size >= m_occluder_min_size)
+      candidates.push_back({size, mesh});
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  m_occlusion_buffer.begin_frame(m_occlusion_width, m_occlusion_height,
+                                 camera_view_projection);
+
+  std::vector<uint8_t> is_occluder(m_cull_meshes.size(), 0);
+  for (const auto &candidate : candidates) {
+    if (m_frame_occluders >= m_occluder_budget)
+      break;
+    Mesh &mesh = *candidate.second;
+
+    // full detail only. non indexed meshes are left out, there are no real
+    // occluders among them
+    const uint32_t *indices = mesh.m_indices_array.data();
+    size_t index_count = mesh.m_indices_array.size();
+    if (index_count == 0 ||
+        m_frame_occluder_triangles + index_count / 3 >
+            m_occluder_triangle_budget)
+      continue;
+
+    m_occlusion_buffer.add_occluder(mesh.m_vertices_array.data(), indices,
+                                    index_count, mesh.m_world_matrix);
+    is_occluder[mesh.m_cull_item] = 1;
+    m_frame_occluders++;
+    m_frame_occluder_triangles += index_count / 3;
+  }
+
+  if (m_frame_occluders > 0) {
+    m_occlusion_buffer.rasterize(m_thread_pool.get());
+
+    for (Mesh *mesh : m_cull_meshes) {
+      if (!mesh->m_in_camera_frustum || mesh->m_lod_culled ||
+          mesh->m_type == E_SKYBOX || is_occluder[mesh->m_cull_item])
+        continue;
+
+      m_frame_occlusion_tested++;
+      if (!m_occlusion_buffer.is_visible(mesh->m_world_bounds.min,
+                                         mesh->m_world_bounds.max)) {
+        mesh->m_occluded = true;
+        m_frame_occlusion_rejected++;
+      }
+    }
+  }
+
+  m_frame_occlusion_ms = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+// shadow and main pass of everything select_mesh_lods left visible and
+// inside the pass frustum, minus occluded meshes in the main pass. key
+// depth is the distance of the nearest instance to the pass eye
+void Renderer::build_render_queues(const glm::vec3 &camera_pos,
+                                   const glm::vec3 &light_pos) {
+  m_shadow_queue.clear();
+  m_main_queue.clear();
+
+  for (auto &entity : m_active_scene->m_loaded_entities) {
+    for (auto &mesh : entity.m_mesh) {
+      bool in_main_pass = mesh.m_in_camera_frustum && !mesh.m_occluded;
+      if (mesh.m_lod_culled || (!in_main_pass && !mesh.m_in_light_frustum))
+        continue;
+
+      glm::vec4 local_center =
+          glm::vec4((mesh.m_bounds_min + mesh.m_bounds_max) * 0.5f, 1.0f);
+      float camera_distance = DEF_FAR_CLIP_PLANE;
+      float light_distance = DEF_FAR_CLIP_PLANE;
+      for (size_t i = 0; i < mesh.instance_count(); i++) {
+        const glm::mat4 &world = mesh.m_instance_world_matrices.empty()
+                                     ? mesh.m_world_matrix
+                                     : mesh.m_instance_world_matrices[i];
+        glm::vec3 center = glm::vec3(world * local_center);
+        camera_distance =
+            std::min(camera_distance, glm::length(center - camera_pos));
+        light_distance =
+            std::min(light_distance, glm::length(center - light_pos));
+      }
+
+      e_render_layer layer = mesh.m_render_mode == E_WIREFRAME
+                                 ? E_RENDER_LAYER_WIREFRAME
+                                 : E_RENDER_LAYER_FILLED;
+
+      if (mesh.m_in_light_frustum)
+        m_shadow_queue.push(
+            layer, m_shadow_queue.program_id(get_depth_shader(mesh)->ID), 0,
+            m_shadow_queue.vao_id(mesh.m_mesh_vao),
+            Render_Queue::quantize_depth(light_distance, DEF_FAR_CLIP_PLANE),
+            &mesh);
+
+      if (!in_main_pass)
+        continue;
+      GLuint texture = mesh.m_material.m_material_type == E_PBR_TEX
+                           ? (GLuint)mesh.m_material.bound_texture_id
+                           : 0;
+      m_main_queue.push(
+          layer, m_main_queue.program_id(mesh.m_material.m_shader->ID),
+          m_main_queue.texture_id(texture), m_main_queue.vao_id(mesh.m_mesh_vao),
+          Render_Queue::quantize_depth(camera_distance, DEF_FAR_CLIP_PLANE),
+          &mesh);
+    }
+  }
+
+  m_shadow_queue.sort();
+  m_main_queue.sort();
+
+  m_indirect_commands.clear();
+  build_draw_batches(m_shadow_queue, true, m_shadow_batches);
+  build_draw_batches(m_main_queue, false, m_main_batches);
+
+  // every command of the frame in one upload, orphaning the last frames
+  if (m_indirect_commands.empty())
+    return;
+  if (m_indirect_buffer == 0)
+    glGenBuffers(1, &m_indirect_buffer);
+  glBindBuffer(CX_GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+  glBufferData(CX_GL_DRAW_INDIRECT_BUFFER,
+               m_indirect_commands.size() *
+                   sizeof(draw_elements_indirect_command),
+               m_indirect_commands.data(), GL_STREAM_DRAW);
+}
+
+// instanced meshes need the depth variant reading the instance matrix,
+// arena meshes the one reading the draw data
+Shader *Renderer::get_depth_shader(const Mesh &mesh) const {
+  if (mesh.m_geometry.valid())
+    return depth_draw_data_shader.get();
+  return mesh.m_instance_matrices.empty() ? depth_shader.get()
+                                          : depth_instanced_shader.get();
+}
+
+// runs of sorted items that need no state change in between. with multi
+// draw, runs of arena meshes also get their indirect commands
+void Renderer::build_draw_batches(const Render_Queue &queue, bool shadow_pass,
+                                  std::vector<draw_batch> &batches) {
+  batches.clear();
+  const std::vector<render_item> &items = queue.items();
+
+  const Mesh *previous = nullptr;
+  for (uint32_t i = 0; i < items.size(); i++) {
+    const Mesh &mesh = *items[i].mesh;
+
+    bool same_state =
+        previous != nullptr &&
+        previous->m_render_mode == mesh.m_render_mode &&
+        previous->m_mesh_vao == mesh.m_mesh_vao &&
+        previous->m_geometry.index_type == mesh.m_geometry.index_type;
+    if (same_state && shadow_pass)
+      same_state = get_depth_shader(*previous) == get_depth_shader(mesh);
+    else if (same_state)
+      same_state = previous->m_material.m_shader == mesh.m_material.m_shader &&
+                   previous->m_material.m_material_type ==
+                       mesh.m_material.m_material_type &&
+                   (mesh.m_material.m_material_type != E_PBR_TEX ||
+                    previous->m_material.bound_texture_id ==
+                        mesh.m_material.bound_texture_id);
+
+    if (!same_state)
+      batches.push_back(
+          {i, 0, (uint32_t)m_indirect_commands.size(), 0});
+    previous = &mesh;
+
+    draw_batch &batch = batches.back();
+    batch.item_count++;
+    // same vao, so either every item of the batch is in the arena or none
+    if (!m_use_multi_draw || !mesh.m_geometry.valid())
+      continue;
+
+    const geometry_allocation &geometry = mesh.m_geometry;
+    draw_elements_indirect_command command;
+    command.count = geometry.index_count;
+    command.first_index = geometry.first_index();
+    if (mesh.m_current_lod < mesh.m_lods.size()) {
+      command.count = (uint32_t)mesh.m_lods[mesh.m_current_lod].index_count;
+      command.first_index +=
+          (uint32_t)mesh.m_lods[mesh.m_current_lod].index_offset;
+    }
+    command.instance_count = geometry.draw_slots;
+    command.base_vertex = (int32_t)geometry.base_vertex;
+    command.base_instance = geometry.first_draw_slot;
+    m_indirect_commands.push_back(command);
+    batch.command_count++;
+  }
+}
+
+// one multi draw for arena batches, else every item on its own. state is
+// bound by the caller
+void Renderer::submit_draw_batch(const Render_Queue &queue,
+                                 const draw_batch &batch,
+                                 const Shader &shader) {
+  const std::vector<render_item> &items = queue.items();
+
+  if (batch.command_count > 0) {
+    GLenum index_type = items[batch.first_item].mesh->m_geometry.index_type;
+    m_gl_caps->glMultiDrawElementsIndirect(
+        GL_TRIANGLES, index_type,
+        (void *)((size_t)batch.first_command *
+                 sizeof(draw_elements_indirect_command)),
+        (GLsizei)batch.command_count, 0);
+    m_frame_gl_draws++;
+    m_frame_multi_draws++;
+    CHECK_GL_DRAW("after multi draw");
+    return;
+  }
+
+  for (uint32_t i = batch.first_item; i < batch.first_item + batch.item_count;
+       i++) {
+    const Mesh &mesh = *items[i].mesh;
+    if (mesh.m_geometry.valid()) {
+      draw_arena_mesh(mesh, shader);
+    } else {
+      upload_to_uniform(shader.model_location, mesh.m_model_uniform);
+      CHECK_GL_DRAW("after setting uniforms");
+      draw_mesh(mesh);
+    }
+    m_frame_gl_draws++;
+    CHECK_GL_DRAW("after draw_mesh");
+  }
 }
 
-void Renderer::init_scene(const char *scene_fp) {
+// without multi draw: the first slot goes in as a uniform, gl_InstanceID
+// does the rest
+void Renderer::draw_arena_mesh(const Mesh &mesh, const Shader &shader) {
+  const geometry_allocation &geometry = mesh.m_geometry;
+  glUniform1i(shader.draw_base_location, (GLint)geometry.first_draw_slot);
+
+  size_t first_index = geometry.first_index();
+  size_t index_count = geometry.index_count;
+  if (mesh.m_current_lod < mesh.m_lods.size()) {
+    first_index += mesh.m_lods[mesh.m_current_lod].index_offset;
+    index_count = mesh.m_lods[mesh.m_current_lod].index_count;
+  }
+  size_t index_size = geometry.index_type == GL_UNSIGNED_SHORT
+                          ? sizeof(uint16_t)
+                          : sizeof(uint32_t);
+  glDrawElementsInstancedBaseVertex(
+      GL_TRIANGLES, (GLsizei)index_count, geometry.index_type,
+      (void *)(first_index * index_size), (GLsizei)geometry.draw_slots,
+      (GLint)geometry.base_vertex);
+}
+
+// glActiveTexture + glBindTexture, each only when it would change anything.
+// with dsa a single glBindTextureUnit, the active unit never moves
+void Renderer::bind_texture_unit(int unit, GLuint texture) {
+  e_bind_slot slot = unit == 0 ? E_BIND_TEXTURE_UNIT_0 : E_BIND_TEXTURE_UNIT_1;
+  if (!m_bind_cache.change(slot, texture))
+    return;
+  if (m_gl_caps->m_has_direct_state_access) {
+    m_gl_caps->glBindTextureUnit(unit, texture);
+    return;
+  }
+  if (m_bind_cache.change(E_BIND_ACTIVE_TEXTURE, (uint32_t)unit))
+    glActiveTexture(GL_TEXTURE0 + unit);
+  glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void Renderer::log_frame_stats() {
+  if (m_application_current_time - m_last_frame_stats_time < 5.0)
+    return;
+  m_last_frame_stats_time = m_application_current_time;
+
+  if (m_frame_count > 0)
+    log_debug("cpu frame time: " +
+              std::to_string(m_frame_cpu_ms / m_frame_count) + " ms avg over " +
+              std::to_string(m_frame_count) + " frames");
+  m_frame_cpu_ms = 0.0;
+  m_frame_count = 0;
+
+  log_debug("frame triangles: " + std::to_string(m_frame_triangles_drawn) +
+            " drawn of " + std::to_string(m_frame_triangles_full) + ", " +
+            std::to_string(m_frame_meshes_culled) + " meshes culled, " +
+            std::to_string(m_frame_draw_calls) + " draw calls for " +
+            std::to_string(m_frame_instances) + " instances per pass, " +
+            std::to_string(m_frame_nodes_updated) + " of " +
+            std::to_string(m_active_scene->m_graph.size()) +
+            " nodes updated, " + std::to_string(m_frame_transforms_refreshed) +
+            " mesh transforms refreshed");
+  log_debug_sub(std::to_string(m_frame_binds) + " gl binds, " +
+                std::to_string(m_frame_binds_skipped) +
+                " redundant binds skipped last frame");
+  log_debug_sub(std::to_string(m_frame_gl_draws) + " gl draw calls (" +
+                std::to_string(m_frame_multi_draws) +
+                " multi draws) over both passes last frame");
+  auto log_cull = [&](const char *pass, const cull_stats &stats) {
+    log_debug_sub(std::string(pass) + " frustum: " +
+                  std::to_string(stats.items_visible) + " meshes visible, " +
+                  std::to_string(stats.items_culled) + " culled, " +
+                  std::to_string(stats.nodes_tested) + " of " +
+                  std::to_string(m_cull_bvh.node_count()) +
+                  " bvh nodes tested");
+  };
+  log_cull("camera", m_frame_camera_cull);
+  log_cull("light", m_frame_light_cull);
+
+  if (m_use_occlusion_culling) {
+    // of every main pass mesh the occluders could have hidden
+    size_t draws = m_frame_occlusion_tested + m_frame_occluders;
+    double rejected = draws > 0 ? 100.0 * m_frame_occlusion_rejected / draws
+                                : 0.0;
+    log_debug_sub("occlusion: " + std::to_string(m_frame_occlusion_rejected) +
+                  " of " + std::to_string(draws) + " main pass draws rejected (" +
+                  std::to_string(rejected) + "%), " +
+                  std::to_string(m_frame_occluders) + " occluders / " +
+                  std::to_string(m_frame_occluder_triangles) +
+                  " triangles into " +
+                  std::to_string(m_occlusion_buffer.width()) + "x" +
+                  std::to_string(m_occlusion_buffer.height()) + ", " +
+                  std::to_string(m_frame_occlusion_ms) + " ms");
+  }
+}
+
+// what merging identical geometry into instanced meshes saved
+void Renderer::log_instancing_stats() {
+  size_t draw_calls_saved = 0;
+  int64_t bytes_saved = 0;
+
+  for (const auto &entity : m_active_scene->m_loaded_entities) {
+    for (const auto &mesh : entity.m_mesh) {
+      if (mesh.m_instance_matrices.size() < 2)
+        continue;
+
+      size_t index_size = mesh.m_index_type == GL_UNSIGNED_SHORT
+                              ? sizeof(uint16_t)
+                              : sizeof(uint32_t);
+      size_t mesh_bytes =
+          (mesh.m_vertices_array.size() + mesh.m_tex_coords_array.size() +
+           mesh.m_normals_array.size() + mesh.m_tangents_array.size() +
+           mesh.m_binormals_array.size()) *
+              sizeof(float) +
+          (mesh.m_indices_array.size() + mesh.m_lod_indices_array.size()) *
+              index_size;
+
+      size_t copies = mesh.m_instance_matrices.size() - 1;
+      draw_calls_saved += copies;
+      bytes_saved += (int64_t)(copies * mesh_bytes) -
+                     (int64_t)(mesh.m_instance_matrices.size() *
+                               sizeof(glm::mat4));
+    }
+  }
+
+  if (draw_calls_saved > 0)
+    log_success("instancing saves " + std::to_string(draw_calls_saved) +
+                " draw calls per pass and " +
+                std::to_string(bytes_saved / 1024) + " KiB of buffers");
+}
+
+void Renderer::init_scene(const char *scene_fp, bool stream_scene) {
+
+  log_peak_rss("before scene init");
+
+  stop_scene_stream();
+  m_scene_init_time = glfwGetTime();
+  m_time_to_first_frame = -1.0;
+  m_time_to_full_load = -1.0;
+  m_vertex_bytes_float = 0;
+  m_vertex_bytes_uploaded = 0;
+  m_vertices_uploaded = 0;
+  m_vertex_buffers_created = 0;
+  // the old scenes meshes go away with it
+  if (m_geometry_arena)
+    m_geometry_arena->clear();
+  m_cull_meshes.clear();
+  m_cull_bvh_dirty = true;
+
+  // processed meshes from the last run, if neither the scene files nor the
+  // import options changed since
+  m_mesh_cache_path = std::string(scene_fp) + ".cxmesh";
+  bool mesh_cache_hit = false;
 
   Entity load_entity;
-  load_entity.m_mesh = std::move(
-      load_all_meshes_from_gltf(scene_fp, num_loaded_textures, m_texture_map));
+  std::vector<scene_node_desc> scene_nodes;
+  if (mesh_cache_is_fresh(m_mesh_cache_path, m_import_options)) {
+    double cache_start = glfwGetTime();
+    load_entity.m_mesh = load_all_meshes_from_cache(
+        m_mesh_cache_path, *m_shader_cache, *m_texture_manager, scene_nodes);
+    mesh_cache_hit = !load_entity.m_mesh.empty();
+
+    if (mesh_cache_hit)
+      log_success("mesh cache hit, " +
+                  std::to_string(load_entity.m_mesh.size()) + " meshes in " +
+                  std::to_string((glfwGetTime() - cache_start) * 1000.0) +
+                  " ms");
+  }
+
+  // nothing left to stream with a cache hit, thats faster than any stream.
+  // obj / ply are one big parallel import anyway, the stream is gltf only
+  bool mesh_file = importer::is_mesh_file(scene_fp);
+  stream_scene = stream_scene && !mesh_cache_hit && !mesh_file;
+
+  // streamed scenes start out empty and fill up while already rendering
+  std::vector<std::string> source_files = {scene_fp};
+  if (!stream_scene && !mesh_cache_hit && mesh_file)
+    load_entity.m_mesh = load_all_meshes_from_mesh_file(
+        scene_fp, *m_thread_pool, *m_shader_cache, *m_texture_manager,
+        m_import_options);
+  else if (!stream_scene && !mesh_cache_hit)
+    load_entity.m_mesh = std::move(load_all_meshes_from_gltf(
+        scene_fp, *m_thread_pool, *m_shader_cache, *m_texture_manager,
+        m_import_options, &scene_nodes, &source_files));
 
   //  glDisable(GL_CULL_FACE);
 
@@ -355,7 +1024,8 @@ void Renderer::init_scene(const char *scene_fp) {
   m_active_scene->m_camera = std::make_unique<Camera>();
 
   Light main_light(std::move(load_all_meshes_from_gltf(
-      "models/light/scene.gltf", num_loaded_textures, m_texture_map))[0]);
+      "models/light/scene.gltf", *m_thread_pool, *m_shader_cache,
+      *m_texture_manager))[0]);
   main_light.m_light_type = E_POINT_LIGHT;
   main_light.m_color = 0xFFFFFF;
   main_light.m_strength = 10;
@@ -363,17 +1033,23 @@ void Renderer::init_scene(const char *scene_fp) {
   main_light.m_light_matrix =
       glm::translate(main_light.m_light_matrix, glm::vec3(10.0f, 2.0f, 1.0f));
 
-  m_active_scene->add_entity_to_scene(load_entity);
+  m_active_scene->add_entity_to_scene(load_entity, scene_nodes);
   m_active_scene->add_light_to_scene(main_light);
 
   // initialize scene vbos
   init_scene_vbos();
 
+  // streams are final after the vbo init (normals, tangents), store them
+  if (!stream_scene && !mesh_cache_hit)
+    write_mesh_cache(m_mesh_cache_path,
+                     m_active_scene->m_loaded_entities[0].m_mesh,
+                     scene_nodes, m_import_options, source_files);
+
   // Initialize shader programs
   log_debug("Initializing Shader Programs for scene...");
   for (auto &entity_to_render : m_active_scene->m_loaded_entities) {
     for (auto &mesh_of_entity : entity_to_render.m_mesh) {
-      mesh_of_entity.m_material.m_shader.use();
+      mesh_of_entity.m_material.m_shader->use();
     }
   }
   log_success("Finished initialization for Shader Programs");
@@ -381,16 +1057,28 @@ void Renderer::init_scene(const char *scene_fp) {
   // SHADOW MAPPING
   glGenFramebuffers(1, &window_depth_map_fbo);
 
-  glGenTextures(1, &window_depth_map);
-  glBindTexture(GL_TEXTURE_2D, window_depth_map);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, shadow_map_width,
-               shadow_map_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+  const Gl_Caps *gl_caps = m_gl_caps.get();
+  if (has_immutable_textures(gl_caps)) {
+    window_depth_map =
+        create_gl_texture_2d(gl_caps, GL_DEPTH_COMPONENT32F, 1,
+                             shadow_map_width, shadow_map_height);
+  } else {
+    glGenTextures(1, &window_depth_map);
+    glBindTexture(GL_TEXTURE_2D, window_depth_map);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, shadow_map_width,
+                 shadow_map_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+  }
+  set_gl_texture_parameter(gl_caps, window_depth_map, GL_TEXTURE_MIN_FILTER,
+                           GL_NEAREST);
+  set_gl_texture_parameter(gl_caps, window_depth_map, GL_TEXTURE_MAG_FILTER,
+                           GL_NEAREST);
+  set_gl_texture_parameter(gl_caps, window_depth_map, GL_TEXTURE_WRAP_S,
+                           GL_CLAMP_TO_BORDER);
+  set_gl_texture_parameter(gl_caps, window_depth_map, GL_TEXTURE_WRAP_T,
+                           GL_CLAMP_TO_BORDER);
   float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-  glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+  set_gl_texture_parameter(gl_caps, window_depth_map, GL_TEXTURE_BORDER_COLOR,
+                           borderColor);
 
   glBindFramebuffer(GL_FRAMEBUFFER, window_depth_map_fbo);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
@@ -399,13 +1087,256 @@ void Renderer::init_scene(const char *scene_fp) {
   glReadBuffer(GL_NONE);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  depth_shader = new Shader("src/shaders/shader_src/depth.vert",
-                            "src/shaders/shader_src/depth.frag");
-  
+  depth_shader = m_shader_cache->get("src/shaders/shader_src/depth.vert",
+                                     "src/shaders/shader_src/depth.frag");
+  depth_instanced_shader =
+      m_shader_cache->get("src/shaders/shader_src/depth.vert",
+                          "src/shaders/shader_src/depth.frag", {"INSTANCED"});
+  depth_draw_data_shader = m_shader_cache->get(
+      "src/shaders/shader_src/depth.vert", "src/shaders/shader_src/depth.frag",
+      m_use_multi_draw ? std::vector<std::string>{"DRAW_DATA", "MULTI_DRAW"}
+                       : std::vector<std::string>{"DRAW_DATA"});
+
+  if (stream_scene) {
+    m_stream_scene_path = scene_fp;
+    m_stream_total_meshes = 0;
+    m_stream_loaded_meshes = 0;
+    m_stream_finished = false;
+    m_stream_cancel = false;
+    m_stream_queue = std::make_unique<Spsc_Queue<streamed_item *>>(256);
+    m_stream_thread = std::thread(&Renderer::stream_scene_worker, this);
+    log_debug("streaming scene in the background: " + m_stream_scene_path);
+  } else {
+    m_time_to_full_load = glfwGetTime() - m_scene_init_time;
+    m_shader_cache->log_stats();
+    log_vertex_stats();
+    log_instancing_stats();
+  }
+
+  log_peak_rss("after scene init");
   log_success("done initializing renderer.");
 }
 
+struct streamed_item {
+  bool is_texture = false;
+  bool is_node_table = false;
+
+  // node table items: the scene hierarchy, always the first item, and the
+  // files it came from for the mesh cache
+  std::vector<scene_node_desc> nodes;
+  std::vector<std::string> source_files;
+
+  // texture items: mip levels ready for upload under texture.key
+  decoded_texture texture;
+
+  // mesh items
+  decoded_primitive primitive;
+
+  // what this item is going to cost us on the gpu side
+  size_t upload_bytes = 0;
+
+};
+
+// runs on m_stream_thread. no gl, no scene access, only the queue
+void Renderer::stream_scene_worker() {
+  importer::Gltf_Source source;
+  if (!importer::load_gltf_source(m_stream_scene_path, source)) {
+    m_stream_finished = true;
+    return;
+  }
+
+  auto *node_item = new streamed_item();
+  node_item->is_node_table = true;
+  node_item->source_files = source.m_file_paths;
+  std::vector<gltf_primitive_job> jobs = group_gltf_primitive_jobs(
+      flatten_gltf_node_tree(source.m_document, node_item->nodes));
+  node_item->upload_bytes = node_item->nodes.size() * sizeof(scene_node_desc);
+  m_stream_total_meshes = jobs.size();
+
+  // queue full = gl thread is behind, wait instead of piling up memory
+  auto push_item = [this](streamed_item *item) {
+    while (!m_stream_queue->try_push(item)) {
+      if (m_stream_cancel) {
+        delete item;
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  };
+
+  // meshes refer to nodes, so the hierarchy has to be in the scene first
+  if (!push_item(node_item))
+    return;
+
+  std::unordered_set<std::string> decoded_textures;
+
+  // decode in pool sized batches so the first meshes show up early
+  const size_t batch_size = std::max(1u, m_thread_pool->num_threads());
+  for (size_t first = 0; first < jobs.size() && !m_stream_cancel;
+       first += batch_size) {
+    size_t count = std::min(batch_size, jobs.size() - first);
+    std::vector<decoded_primitive> decoded(count);
+
+    std::vector<mesh_optimize_report> optimize_reports(count);
+    m_thread_pool->parallel_for(count, [&](size_t i) {
+      decode_gltf_primitive(source, jobs[first + i], decoded[i]);
+      optimize_reports[i] = process_decoded_primitive(
+          decoded[i], m_import_options, m_thread_pool.get());
+    });
+    log_optimize_reports(optimize_reports);
+
+    // dropped primitives and content duplicates (only within a batch,
+    // earlier meshes are gone) arent meshes to wait for
+    size_t batch_meshes = decoded.size();
+    remove_dropped_primitives(decoded);
+    merge_duplicate_primitives(decoded, *m_thread_pool);
+    m_stream_total_meshes -= batch_meshes - decoded.size();
+
+    // images first seen in this batch, decoded in parallel as well
+    std::vector<texture_request> texture_requests;
+    for (const auto &primitive : decoded) {
+      if (primitive.shader_type_carry != 2)
+        continue;
+
+      std::string key = get_texture_key(primitive, m_stream_scene_path);
+      if (decoded_textures.insert(key).second)
+        texture_requests.push_back(
+            make_texture_request(primitive, m_stream_scene_path, key, &source));
+    }
+
+    std::vector<streamed_item *> texture_items(texture_requests.size());
+    m_thread_pool->parallel_for(texture_requests.size(), [&](size_t i) {
+      texture_items[i] = new streamed_item();
+      texture_items[i]->is_texture = true;
+      if (!m_texture_manager->decode(texture_requests[i],
+                                     texture_items[i]->texture))
+        log_error("failed to decode streamed texture: " +
+                  texture_requests[i].key);
+
+      texture_items[i]->upload_bytes = texture_items[i]->texture.data.size();
+    });
+
+    // textures go out before the meshes using them
+    for (size_t i = 0; i < texture_items.size(); i++) {
+      if (!push_item(texture_items[i])) {
+        for (size_t j = i + 1; j < texture_items.size(); j++)
+          delete texture_items[j];
+        return;
+      }
+    }
+
+    for (auto &primitive : decoded) {
+      auto *mesh_item = new streamed_item();
+      mesh_item->upload_bytes =
+          (primitive.vertices.size() + primitive.normals.size() +
+           primitive.tangents.size() + primitive.bitangents.size() +
+           primitive.texcoords.size()) *
+              sizeof(float) +
+          primitive.indices.size() * sizeof(uint32_t);
+      mesh_item->primitive = std::move(primitive);
+
+      if (!push_item(mesh_item))
+        return;
+    }
+  }
+
+  source.release();
+  m_stream_finished = true;
+}
+
+// gl thread side of the stream. uploads until the frame budget is used up
+void Renderer::drain_stream_queue() {
+  if (!m_stream_queue)
+    return;
+
+  auto budget_start = std::chrono::steady_clock::now();
+  size_t budget_bytes_used = 0;
+  Entity &stream_entity = m_active_scene->m_loaded_entities[0];
+
+  streamed_item *item = nullptr;
+  while (m_stream_queue->try_pop(item)) {
+    if (item->is_node_table) {
+      m_active_scene->set_entity_nodes(0, item->nodes);
+      m_stream_nodes = std::move(item->nodes);
+      m_stream_source_files = std::move(item->source_files);
+    } else if (item->is_texture) {
+      if (item->texture.valid())
+        m_texture_manager->upload(item->texture);
+    } else {
+      Mesh mesh =
+          build_mesh_from_decoded(item->primitive, m_stream_scene_path,
+                                  nullptr, *m_shader_cache, *m_texture_manager);
+      init_mesh_vbos(mesh);
+      stream_entity.m_mesh.push_back(std::move(mesh));
+      m_stream_loaded_meshes++;
+      // the vector may have moved every mesh
+      m_cull_bvh_dirty = true;
+
+      if (m_load_progress_callback)
+        m_load_progress_callback(m_stream_loaded_meshes,
+                                 m_stream_total_meshes.load());
+    }
+
+    budget_bytes_used += item->upload_bytes;
+    delete item;
+
+    double budget_ms_used = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - budget_start)
+                                .count();
+    if (budget_bytes_used >= m_stream_budget_bytes ||
+        budget_ms_used >= m_stream_budget_ms)
+      break;
+  }
+
+  // finished has to be read before the last emptiness check
+  if (m_stream_finished.load() && m_stream_queue->size_approx() == 0) {
+    m_stream_thread.join();
+    m_stream_queue.reset();
+
+    m_time_to_full_load = glfwGetTime() - m_scene_init_time;
+    log_success("scene stream done, " + std::to_string(m_stream_loaded_meshes) +
+                " meshes in " + std::to_string(m_time_to_full_load * 1000.0) +
+                " ms");
+    m_shader_cache->log_stats();
+    m_texture_manager->log_stats();
+    log_vertex_stats();
+    log_instancing_stats();
+    log_peak_rss("after scene stream");
+
+    // cancelled or broken streams would leave an incomplete cache behind
+    if (m_stream_loaded_meshes > 0 &&
+        m_stream_loaded_meshes == m_stream_total_meshes.load())
+      write_mesh_cache(m_mesh_cache_path,
+                       m_active_scene->m_loaded_entities[0].m_mesh,
+                       m_stream_nodes, m_import_options, m_stream_source_files);
+    m_stream_nodes.clear();
+    m_stream_source_files.clear();
+  }
+}
+
+void Renderer::stop_scene_stream() {
+  if (!m_stream_queue)
+    return;
+
+  m_stream_cancel = true;
+  if (m_stream_thread.joinable())
+    m_stream_thread.join();
+
+  streamed_item *item = nullptr;
+  while (m_stream_queue->try_pop(item))
+    delete item;
+
+  m_stream_queue.reset();
+}
+
 void Renderer::cleanup_mesh_vbos(Mesh& mesh) {
+  // the vao belongs to the arena then
+  if (mesh.m_geometry.valid()) {
+    m_geometry_arena->release(mesh.m_geometry);
+    mesh.m_mesh_vao = 0;
+  }
+
   if (mesh.m_mesh_vao != 0) {
     glDeleteVertexArrays(1, &mesh.m_mesh_vao);
     mesh.m_mesh_vao = 0;
@@ -419,10 +1350,283 @@ void Renderer::cleanup_mesh_vbos(Mesh& mesh) {
   };
 
   delete_buffer(mesh.m_vertices_glid);
-  delete_buffer(mesh.m_tex_coords_glid);
-  delete_buffer(mesh.m_normals_glid);
-  delete_buffer(mesh.m_tangents_glid);
-  delete_buffer(mesh.m_binormals_glid);
+  delete_buffer(mesh.m_shading_glid);
+  delete_buffer(mesh.m_indices_glid);
+  delete_buffer(mesh.m_instances_glid);
+}
+
+void Renderer::init_mesh_ebo(Mesh &mesh) {
+  if (mesh.m_indices_array.empty())
+    return;
+
+  // lods go right behind the full index list, see mesh_lod
+  size_t index_count =
+      mesh.m_indices_array.size() + mesh.m_lod_indices_array.size();
+  const Gl_Caps *gl_caps = m_gl_caps.get();
+
+  if (mesh.m_index_type == GL_UNSIGNED_SHORT) {
+    std::vector<uint16_t> packed_indices;
+    packed_indices.reserve(index_count);
+    packed_indices.insert(packed_indices.end(), mesh.m_indices_array.begin(),
+                          mesh.m_indices_array.end());
+    packed_indices.insert(packed_indices.end(),
+                          mesh.m_lod_indices_array.begin(),
+                          mesh.m_lod_indices_array.end());
+    mesh.m_indices_glid = create_gl_buffer(
+        gl_caps, packed_indices.size() * sizeof(uint16_t),
+        packed_indices.data(), false);
+  } else if (mesh.m_lod_indices_array.empty()) {
+    mesh.m_indices_glid = create_gl_buffer(
+        gl_caps, index_count * sizeof(uint32_t), mesh.m_indices_array.data(),
+        false);
+  } else {
+    std::vector<uint32_t> indices;
+    indices.reserve(index_count);
+    indices.insert(indices.end(), mesh.m_indices_array.begin(),
+                   mesh.m_indices_array.end());
+    indices.insert(indices.end(), mesh.m_lod_indices_array.begin(),
+                   mesh.m_lod_indices_array.end());
+    mesh.m_indices_glid = create_gl_buffer(
+        gl_caps, indices.size() * sizeof(uint32_t), indices.data(), false);
+  }
+
+  // expects the meshes vao to be bound, the ebo binding is part of its state
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.m_indices_glid);
+}
+
+// one mat4 per instance at locations 5-8, expects the vao to be bound. the
+// contents come from update_mesh_transforms before the first draw
+void Renderer::init_mesh_instances(Mesh &mesh) {
+  if (mesh.m_instance_matrices.empty())
+    return;
+
+  // dynamic either way, even static instances get their first matrices
+  // through update_gl_buffer
+  mesh.m_instances_glid = create_gl_buffer(
+      m_gl_caps.get(), mesh.m_instance_matrices.size() * sizeof(glm::mat4),
+      nullptr, true);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.m_instances_glid);
+  mesh.m_world_matrix_stale = true;
+
+  for (GLuint column = 0; column < 4; column++) {
+    GLuint location = 5 + column;
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                          (void *)(column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+}
+
+void Renderer::draw_mesh(const Mesh &mesh) {
+  if (!mesh.m_instance_matrices.empty()) {
+    GLsizei instances = (GLsizei)mesh.m_instance_matrices.size();
+    if (mesh.m_indices_array.empty()) {
+      glDrawArraysInstanced(GL_TRIANGLES, 0,
+                            (GLsizei)(mesh.m_vertices_array.size() / 3),
+                            instances);
+      return;
+    }
+
+    size_t index_offset = 0;
+    size_t index_count = mesh.m_indices_array.size();
+    if (mesh.m_current_lod < mesh.m_lods.size()) {
+      index_offset = mesh.m_lods[mesh.m_current_lod].index_offset;
+      index_count = mesh.m_lods[mesh.m_current_lod].index_count;
+    }
+    size_t index_size =
+        mesh.m_index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                               : sizeof(uint32_t);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)index_count,
+                            mesh.m_index_type,
+                            (void *)(index_offset * index_size), instances);
+    return;
+  }
+
+  if (!mesh.m_indices_array.empty() &&
+      mesh.m_current_lod < mesh.m_lods.size()) {
+    const mesh_lod &lod = mesh.m_lods[mesh.m_current_lod];
+    size_t index_size =
+        mesh.m_index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                               : sizeof(uint32_t);
+    glDrawElements(GL_TRIANGLES, (GLsizei)lod.index_count, mesh.m_index_type,
+                   (void *)(lod.index_offset * index_size));
+  } else if (!mesh.m_indices_array.empty())
+    glDrawElements(GL_TRIANGLES, (GLsizei)mesh.m_indices_array.size(),
+                   mesh.m_index_type, (void *)0);
+  else
+    glDrawArrays(GL_TRIANGLES, 0, mesh.m_vertices_array.size() / 3);
+}
+
+// normals / tangents the mesh came without (see meshgeometry.hh). pool
+// safe, no gl, no logging
+static void generate_missing_vertex_basis(Mesh &mesh, Thread_Pool *pool) {
+  if (mesh.m_normals_array.empty())
+    generate_vertex_normals(mesh.m_vertices_array, mesh.m_indices_array,
+                            mesh.m_normals_array, pool);
+
+  if (!mesh.m_tex_coords_array.empty() &&
+      (mesh.m_tangents_array.empty() || mesh.m_binormals_array.empty()))
+    generate_vertex_tangents(mesh.m_vertices_array, mesh.m_normals_array,
+                             mesh.m_tex_coords_array, mesh.m_indices_array,
+                             mesh.m_tangents_array, mesh.m_binormals_array,
+                             pool);
+}
+
+void Renderer::init_mesh_vbos(Mesh &mesh) {
+  log_debug_sub("Reinitializing VBOs for mesh (needs refresh)");
+
+  // Clean up old buffers to prevent leaks
+  cleanup_mesh_vbos(mesh);
+
+  // normally done by init_scene_vbos / the importer already
+  generate_missing_vertex_basis(mesh, m_thread_pool.get());
+
+  if (mesh.m_tangents_array.empty() || mesh.m_binormals_array.empty()) {
+    log_error("Mesh has no usable UVs; using zeroed tangents/binormals");
+    mesh.m_tangents_array.resize(mesh.m_vertices_array.size(), 0.0f);
+    mesh.m_binormals_array.resize(mesh.m_vertices_array.size(), 0.0f);
+  }
+
+  m_vertex_bytes_float += (mesh.m_vertices_array.size() +
+                           mesh.m_tex_coords_array.size() +
+                           mesh.m_normals_array.size() +
+                           mesh.m_tangents_array.size() +
+                           mesh.m_binormals_array.size()) *
+                          sizeof(float);
+
+  // dequantization might change below
+  mesh.m_world_matrix_stale = true;
+
+  bool compact = m_use_compact_vertices && mesh.m_type == E_MESH;
+  mesh.m_dequant_matrix =
+      compact ? get_dequantization_matrix(mesh.m_bounds_min, mesh.m_bounds_max)
+              : glm::mat4(1.0f);
+
+  // scene meshes go into the arena, anything that doesnt fit keeps its own
+  // buffers
+  if (mesh.m_type == E_MESH && m_use_geometry_arena && m_geometry_arena &&
+      init_arena_mesh(mesh, compact)) {
+    mesh.m_material.m_shader = get_material_shader(
+        mesh.m_material.m_material_type, *m_shader_cache, compact, false, true,
+        m_use_multi_draw);
+    mesh.m_mesh_vbo_needs_refresh = false;
+    log_debug_sub("Successfully added mesh to the geometry arena");
+    return;
+  }
+
+  if (mesh.m_type == E_MESH)
+    mesh.m_material.m_shader = get_material_shader(
+        mesh.m_material.m_material_type, *m_shader_cache, compact,
+        !mesh.m_instance_matrices.empty());
+
+  glGenVertexArrays(1, &mesh.m_mesh_vao);
+  glBindVertexArray(mesh.m_mesh_vao);
+
+  m_vertex_bytes_uploaded += init_mesh_vertex_streams(
+      mesh, get_vertex_format(compact, !mesh.m_tex_coords_array.empty(),
+                              !mesh.m_normals_array.empty(),
+                              !mesh.m_tangents_array.empty()));
+  m_vertices_uploaded += mesh.m_vertices_array.size() / 3;
+  m_vertex_buffers_created +=
+      (mesh.m_vertices_glid != 0) + (mesh.m_shading_glid != 0);
+  init_mesh_ebo(mesh);
+  init_mesh_instances(mesh);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  mesh.m_mesh_vbo_needs_refresh = false;
+  log_debug_sub("Successfully updated VBOs for mesh");
+}
+
+// vertices, indices (lods included) and one draw data slot per instance
+// in the arena. triangle soups get a plain index list, the arena only
+// draws indexed
+bool Renderer::init_arena_mesh(Mesh &mesh, bool compact) {
+  e_geometry_pool pool =
+      compact ? E_GEOMETRY_POOL_COMPACT : E_GEOMETRY_POOL_FLOAT;
+  uint32_t vertex_count = (uint32_t)(mesh.m_vertices_array.size() / 3);
+
+  std::vector<uint32_t> soup_indices;
+  GLenum index_type = mesh.m_index_type;
+  if (mesh.m_indices_array.empty()) {
+    soup_indices.resize(vertex_count);
+    for (uint32_t i = 0; i < vertex_count; i++)
+      soup_indices[i] = i;
+    index_type = vertex_count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  }
+  const std::vector<uint32_t> &indices =
+      mesh.m_indices_array.empty() ? soup_indices : mesh.m_indices_array;
+
+  interleaved_vertices vertices = build_interleaved_vertices(
+      m_geometry_arena->get_format(pool), mesh.m_vertices_array,
+      mesh.m_tex_coords_array, mesh.m_normals_array, mesh.m_tangents_array,
+      mesh.m_binormals_array, mesh.m_bounds_min, mesh.m_bounds_max);
+
+  if (!m_geometry_arena->add(pool, vertices, vertex_count, indices,
+                             mesh.m_lod_indices_array, index_type,
+                             (uint32_t)mesh.instance_count(),
+                             mesh.m_geometry)) {
+    log_error("mesh didnt fit into the geometry arena, using own buffers");
+    return false;
+  }
+
+  mesh.m_mesh_vao = m_geometry_arena->vao(pool);
+  m_vertex_bytes_uploaded += vertices.byte_size();
+  m_vertices_uploaded += vertex_count;
+  return true;
+}
+
+// position + shading stream of the mesh as described by format, expects
+// the vao to be bound. the float arrays stay around for the mesh cache.
+// returns the bytes uploaded
+size_t Renderer::init_mesh_vertex_streams(Mesh &mesh,
+                                          const vertex_format &format) {
+  interleaved_vertices vertices = build_interleaved_vertices(
+      format, mesh.m_vertices_array, mesh.m_tex_coords_array,
+      mesh.m_normals_array, mesh.m_tangents_array, mesh.m_binormals_array,
+      mesh.m_bounds_min, mesh.m_bounds_max);
+  const Gl_Caps *gl_caps = m_gl_caps.get();
+  auto upload_stream = [gl_caps](GLuint &buffer_id,
+                                 const vertex_stream_format &stream,
+                                 const std::vector<uint8_t> &data) {
+    if (data.empty() || stream.attribute_count == 0)
+      return;
+    buffer_id = create_gl_buffer(gl_caps, data.size(), data.data(), false);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    set_vertex_attribute_pointers(stream);
+  };
+
+  upload_stream(mesh.m_vertices_glid, format.position, vertices.positions);
+  upload_stream(mesh.m_shading_glid, format.shading, vertices.shading);
+  return vertices.byte_size();
+}
+
+void Renderer::log_vertex_stats() {
+  if (m_vertex_bytes_float == 0)
+    return;
+
+  double saved = 100.0 * (1.0 - (double)m_vertex_bytes_uploaded /
+                                    (double)m_vertex_bytes_float);
+  log_success("vertex data: " +
+              std::to_string(m_vertex_bytes_uploaded / 1024) + " KiB on gpu, " +
+              std::to_string(m_vertex_bytes_float / 1024) +
+              " KiB as floats (" + std::to_string((int)saved) + "% saved)");
+
+  if (m_vertices_uploaded == 0)
+    return;
+  vertex_format format = get_vertex_format(m_use_compact_vertices, true,
+                                           true, true);
+  log_debug_sub(std::to_string(m_vertex_bytes_uploaded / m_vertices_uploaded) +
+                " B/vertex on average over " +
+                std::to_string(m_vertices_uploaded) + " vertices, " +
+                std::to_string(format.position.stride) + " position + " +
+                std::to_string(format.shading.stride) + " shading for " +
+                (m_use_compact_vertices ? "compact" : "float") +
+                " meshes, " + std::to_string(m_vertex_buffers_created) +
+                " vertex buffers");
+  if (m_geometry_arena)
+    m_geometry_arena->log_stats();
 }
 
 void Renderer::init_scene_vbos() {
@@ -446,33 +1650,14 @@ void Renderer::init_scene_vbos() {
     // Clean up existing GL resources if they exist
     cleanup_mesh_vbos(mesh);
 
-    // Generate new VAO + VBOs
+    // positions + uvs for the flat shader, always floats
     glGenVertexArrays(1, &mesh.m_mesh_vao);
     glBindVertexArray(mesh.m_mesh_vao);
 
-    // Vertices
-    if (!mesh.m_vertices_array.empty()) {
-      glGenBuffers(1, &mesh.m_vertices_glid);
-      glBindBuffer(GL_ARRAY_BUFFER, mesh.m_vertices_glid);
-      glBufferData(GL_ARRAY_BUFFER,
-                   mesh.m_vertices_array.size() * sizeof(float),
-                   mesh.m_vertices_array.data(),
-                   GL_STATIC_DRAW);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-      glEnableVertexAttribArray(0);
-    }
-
-    // TexCoords (optional)
-    if (!mesh.m_tex_coords_array.empty()) {
-      glGenBuffers(1, &mesh.m_tex_coords_glid);
-      glBindBuffer(GL_ARRAY_BUFFER, mesh.m_tex_coords_glid);
-      glBufferData(GL_ARRAY_BUFFER,
-                   mesh.m_tex_coords_array.size() * sizeof(float),
-                   mesh.m_tex_coords_array.data(),
-                   GL_STATIC_DRAW);
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-      glEnableVertexAttribArray(1);
-    }
+    init_mesh_vertex_streams(
+        mesh, get_vertex_format(false, !mesh.m_tex_coords_array.empty(),
+                                false, false));
+    init_mesh_ebo(mesh);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -484,113 +1669,55 @@ void Renderer::init_scene_vbos() {
   ////////////////////////////////////
   // Update Entity Mesh VBOs
   ////////////////////////////////////
+
+  // missing normals / tangents of all dirty meshes at once, off the gl
+  // thread. big meshes split up further inside
+  std::vector<Mesh *> dirty_meshes;
+  for (auto &entity : m_active_scene->m_loaded_entities)
+    for (auto &mesh : entity.m_mesh)
+      if (mesh.m_mesh_vbo_needs_refresh)
+        dirty_meshes.push_back(&mesh);
+  m_thread_pool->parallel_for(dirty_meshes.size(), [&](size_t i) {
+    generate_missing_vertex_basis(*dirty_meshes[i], m_thread_pool.get());
+  });
+
   for (auto &entity : m_active_scene->m_loaded_entities) {
     for (auto &mesh : entity.m_mesh) {
       if (!mesh.m_mesh_vbo_needs_refresh)
         continue;  
 
-      log_debug_sub("Reinitializing VBOs for mesh (needs refresh)");
-
-      // Clean up old buffers to prevent leaks
-      cleanup_mesh_vbos(mesh);
-
-      // Recalculate normals if missing
-      if (mesh.m_normals_array.empty()) {
-        log_debug("Mesh missing normals, recalculating...");
-        mesh.m_normals_array = calculate_vert_normals(mesh.m_vertices_array);
-      }
-
-      // Recalculate tangents/binormals if needed and texcoords exist
-      if (!mesh.m_tex_coords_array.empty()) {
-        if (mesh.m_tangents_array.empty() || mesh.m_binormals_array.empty()) {
-          log_debug("Missing tangents/binormals, calculating...");
-          tan_bin_glob tb = calculate_vert_tan_bin(
-              mesh.m_vertices_array, mesh.m_normals_array, mesh.m_tex_coords_array);
-          mesh.m_tangents_array = tb.vert_tangents;
-          mesh.m_binormals_array = tb.vert_binormals;
-        }
-      } else {
-        log_error("Mesh has no UVs; using zeroed tangents/binormals");
-        mesh.m_tangents_array.resize(mesh.m_vertices_array.size(), 0.0f);
-        mesh.m_binormals_array.resize(mesh.m_vertices_array.size(), 0.0f);
-      }
-
-      // Create VAO
-      glGenVertexArrays(1, &mesh.m_mesh_vao);
-      glBindVertexArray(mesh.m_mesh_vao);
-
-      // verts
-      if (!mesh.m_vertices_array.empty()) {
-        glGenBuffers(1, &mesh.m_vertices_glid);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.m_vertices_glid);
-        glBufferData(GL_ARRAY_BUFFER,
-                     mesh.m_vertices_array.size() * sizeof(float),
-                     mesh.m_vertices_array.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-      }
-
-      // tex coords
-      if (!mesh.m_tex_coords_array.empty()) {
-        glGenBuffers(1, &mesh.m_tex_coords_glid);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.m_tex_coords_glid);
-        glBufferData(GL_ARRAY_BUFFER,
-                     mesh.m_tex_coords_array.size() * sizeof(float),
-                     mesh.m_tex_coords_array.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-      }
-
-      // normals
-      if (!mesh.m_normals_array.empty()) {
-        glGenBuffers(1, &mesh.m_normals_glid);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.m_normals_glid);
-        glBufferData(GL_ARRAY_BUFFER,
-                     mesh.m_normals_array.size() * sizeof(float),
-                     mesh.m_normals_array.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(2);
-      }
-
-      // tangents
-      if (!mesh.m_tangents_array.empty()) {
-        glGenBuffers(1, &mesh.m_tangents_glid);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.m_tangents_glid);
-        glBufferData(GL_ARRAY_BUFFER,
-                     mesh.m_tangents_array.size() * sizeof(float),
-                     mesh.m_tangents_array.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(3);
-      }
-
-      // binormals
-      if (!mesh.m_binormals_array.empty()) {
-        glGenBuffers(1, &mesh.m_binormals_glid);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.m_binormals_glid);
-        glBufferData(GL_ARRAY_BUFFER,
-                     mesh.m_binormals_array.size() * sizeof(float),
-                     mesh.m_binormals_array.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(4);
-      }
-
-      glBindVertexArray(0);
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-      mesh.m_mesh_vbo_needs_refresh = false;
-      log_debug_sub("Successfully updated VBOs for mesh");
+      init_mesh_vbos(mesh);
     }
   }
 
   m_active_scene->m_scene_vbos_need_refresh = false;
+  // hitboxes etc. get added through here
+  m_cull_bvh_dirty = true;
   log_success("Successfully initialized/updated VBOs for all dirty meshes!");
 }
 
-template <typename T>
-void Renderer::upload_to_uniform(std::string location, GLuint shader_id,
-                                 T input) {
+// uploads the frame block, allocated on first use. orphaned each frame so
+// the driver doesnt have to wait for last frames draws
+void Renderer::upload_frame_uniforms(const frame_uniforms &frame_data) {
+  if (m_frame_ubo == 0) {
+    glGenBuffers(1, &m_frame_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frame_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_uniforms), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, m_frame_ubo);
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_frame_ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_uniforms), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_uniforms), &frame_data);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-  GLuint loc = glGetUniformLocation(shader_id, location.c_str());
+// location comes from the programs cache (Shader::get_uniform_location),
+// -1 is ignored by gl
+template <typename T>
+void Renderer::upload_to_uniform(GLint loc, T input) {
 
   if constexpr (std::is_same<T, glm::mat4>::value) {
     glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(input));
@@ -607,6 +1734,33 @@ void Renderer::upload_to_uniform(std::string location, GLuint shader_id,
   }
 };
 
+// newest core context the driver hands out, 3.3 at the very least. what
+// the renderer actually uses on top of 3.3 is decided by Gl_Caps
+static GLFWwindow *create_gl_window(uint window_width, uint window_height) {
+  static const int versions[][2] = {{4, 6}, {4, 5}, {4, 4}, {4, 3},
+                                    {4, 2}, {4, 1}, {4, 0}, {3, 3}};
+
+  for (const auto &[major, minor] : versions) {
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifndef NDEBUG
+    // debug output is only guaranteed to say anything in a debug context
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+
+    GLFWwindow *window = glfwCreateWindow(window_width, window_height,
+                                          "cortex - dev build", NULL, NULL);
+    if (window != NULL) {
+      log_debug("created a gl " + std::to_string(major) + "." +
+                std::to_string(minor) + " core context");
+      return window;
+    }
+  }
+  return NULL;
+}
+
 Renderer::Renderer(uint window_width, uint window_height) {
 
   std::cout << R"(                     __                 
@@ -625,15 +1779,11 @@ _/ ___\/  _ \_  __ \   __\/ __ \\  \/  /
   m_input_manager = std::move(std::make_unique<Input_Manager>(nullptr));
   m_animation_manager = std::move(std::make_unique<Animation_Manager>(nullptr));
   m_physics_manager = std::move(std::make_unique<Physics_Manager>(nullptr));
+  m_thread_pool = std::make_unique<Thread_Pool>();
   
   // Create the window for this renderer
   glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  associated_window = glfwCreateWindow(window_width, window_height,
-                                       "cortex - dev build", NULL, NULL);
+  associated_window = create_gl_window(window_width, window_height);
   if (associated_window == NULL) {
     log_error("failed to create glfw window!");
     glfwTerminate();
@@ -647,6 +1797,20 @@ _/ ___\/  _ \_  __ \   __\/ __ \\  \/  /
     return;
   }
 
+  // everything past 3.3 core + the program cache on top of it
+  m_gl_caps = std::make_unique<Gl_Caps>();
+  m_gl_caps->load();
+#ifndef NDEBUG
+  m_gl_debug_output =
+      enable_gl_debug_output(*m_gl_caps, m_gl_debug_synchronous);
+#endif
+  m_shader_cache = std::make_unique<Shader_Cache>(m_gl_caps.get());
+  m_use_multi_draw = m_gl_caps->m_has_multi_draw_indirect;
+  m_geometry_arena = std::make_unique<Geometry_Arena>(m_gl_caps.get());
+  m_texture_manager = std::make_unique<Texture_Manager>(*m_thread_pool,
+                                                        m_gl_caps.get());
+  m_physics_manager->m_shader_cache = m_shader_cache.get();
+
   // setup
   glViewport(0, 0, m_viewport_width, m_viewport_height);
   glEnable(GL_DEPTH_TEST);
@@ -684,3 +1848,8 @@ _/ ___\/  _ \_  __ \   __\/ __ \\  \/  /
   return;
   
 }
+
+Renderer::~Renderer() {
+  // loader thread uses the thread pool, so it has to go first
+  stop_scene_stream();
+}
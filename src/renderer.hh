@@ -6,6 +6,18 @@
 #include "./components/input.hh"
 #include "./components/animationmanager.hh"
 #include "components/physicsmanager.hh"
+#include "components/threadpool.hh"
+#include "components/spscqueue.hh"
+#include "components/shadercache.hh"
+#include "components/glcaps.hh"
+#include "components/texturemanager.hh"
+#include "components/meshoptimize.hh"
+#include "components/frameuniforms.hh"
+#include "components/renderqueue.hh"
+#include "components/geometryarena.hh"
+#include "components/cullbvh.hh"
+#include "components/occlusion.hh"
+#include "components/vertexformat.hh"
 
 #include <GLFW/glfw3.h>
 #include <glm/ext/matrix_transform.hpp>
@@ -21,6 +33,11 @@
 #include <vector>
 #include <cstdint>
 #include <atomic>
+#include <functional>
+#include <thread>
+
+// decoded mesh or texture on its way from the stream loader to the gl thread
+struct streamed_item;
 
 class Renderer {
 public:
@@ -35,6 +52,15 @@ public:
 
   // animation handline
   std::unique_ptr<Physics_Manager> m_physics_manager = nullptr;
+
+  // cpu workers for importing etc.
+  std::unique_ptr<Thread_Pool> m_thread_pool = nullptr;
+
+  // what the context supports beyond 3.3 core
+  std::unique_ptr<Gl_Caps> m_gl_caps = nullptr;
+
+  // one gl program per unique shader source + defines
+  std::unique_ptr<Shader_Cache> m_shader_cache = nullptr;
   
   
   GLFWwindow* associated_window;
@@ -46,7 +72,9 @@ public:
   // Render properties
   unsigned int window_depth_map;
   unsigned int window_depth_map_fbo;
-  Shader* depth_shader;
+  Shader_Handle depth_shader;
+  Shader_Handle depth_instanced_shader;
+  Shader_Handle depth_draw_data_shader;
   const unsigned int shadow_map_width = 4000;
   const unsigned int shadow_map_height = 4000;
 
@@ -56,9 +84,129 @@ public:
   
   // Scene management
   std::shared_ptr<Scene> m_active_scene;
-  std::atomic<uint32_t> num_loaded_textures = 0;
 
-  std::vector<std::tuple<std::string, unsigned int, GLuint>> m_texture_map;
+  // every 2d texture, by path / glb#imageN
+  std::unique_ptr<Texture_Manager> m_texture_manager = nullptr;
+
+  // processing of imported geometry (see meshoptimize.hh)
+  mesh_import_options m_import_options;
+
+  // lod selection: coarsest level whose error stays under m_lod_error_pixels
+  // on screen. going coarser needs (1 - m_lod_hysteresis) of that, so a
+  // mesh sitting right at a threshold doesnt flip every frame. meshes
+  // smaller than m_lod_cull_pixels arent drawn at all (0 = off)
+  float m_lod_error_pixels = 1.0f;
+  float m_lod_hysteresis = 0.25f;
+  float m_lod_cull_pixels = 2.0f;
+
+  // triangles of the main pass, full meshes vs what actually got drawn
+  size_t m_frame_triangles_full = 0;
+  size_t m_frame_triangles_drawn = 0;
+  size_t m_frame_meshes_culled = 0;
+  size_t m_frame_draw_calls = 0;
+  size_t m_frame_instances = 0;
+  // scene graph nodes recomputed / meshes that picked up a new transform
+  size_t m_frame_nodes_updated = 0;
+  size_t m_frame_transforms_refreshed = 0;
+  double m_last_frame_stats_time = 0.0;
+  // cpu time of render_frame up to the swap, summed until the next stats log
+  double m_frame_cpu_ms = 0.0;
+  size_t m_frame_count = 0;
+
+  // gl errors come through the KHR_debug callback (debug builds only), see
+  // gldebug.hh. without it errors are checked once per pass
+  bool m_gl_debug_output = false;
+  bool m_gl_debug_synchronous = true;
+
+  // std140 block with view / projection / light data, once per frame
+  GLuint m_frame_ubo = 0;
+
+  // sorted draws of the shadow / main pass, rebuilt every frame
+  Render_Queue m_shadow_queue;
+  Render_Queue m_main_queue;
+  Bind_Cache m_bind_cache;
+  // state changes issued / avoided over both passes of the last frame
+  size_t m_frame_binds = 0;
+  size_t m_frame_binds_skipped = 0;
+
+  // scene meshes in a few shared buffers (see geometryarena.hh). with multi
+  // draw indirect every state bucket of a pass is a single draw call
+  std::unique_ptr<Geometry_Arena> m_geometry_arena = nullptr;
+  bool m_use_geometry_arena = true;
+  bool m_use_multi_draw = false;
+  std::vector<draw_batch> m_shadow_batches;
+  std::vector<draw_batch> m_main_batches;
+  std::vector<draw_elements_indirect_command> m_indirect_commands;
+  GLuint m_indirect_buffer = 0;
+  // draw calls of both passes last frame, multi draws included
+  size_t m_frame_gl_draws = 0;
+  size_t m_frame_multi_draws = 0;
+
+  // frustum culling of both passes, camera and light frustum each against
+  // a bvh over the world bounds of every scene mesh (see cullbvh.hh).
+  // rebuilt when meshes come or go, refit when they move
+  bool m_use_frustum_culling = true;
+  Cull_Bvh m_cull_bvh;
+  bool m_cull_bvh_dirty = true;
+  std::vector<Mesh *> m_cull_meshes;
+  std::vector<uint8_t> m_cull_visible;
+  cull_stats m_frame_camera_cull;
+  cull_stats m_frame_light_cull;
+
+  // software occlusion culling of the main pass (see occlusion.hh), off
+  // unless asked for. the biggest close meshes (radius / distance >=
+  // m_occluder_min_size) go into an m_occlusion_width x m_occlusion_height
+  // cpu depth buffer at full detail, up to m_occluder_budget meshes /
+  // m_occluder_triangle_budget triangles. lods arent used, a simplified
+  // surface can stick out of the real one. every other mesh in the camera
+  // frustum is tested against it
+  bool m_use_occlusion_culling = false;
+  Occlusion_Buffer m_occlusion_buffer;
+  int m_occlusion_width = 256;
+  int m_occlusion_height = 128;
+  size_t m_occluder_budget = 32;
+  size_t m_occluder_triangle_budget = 16384;
+  float m_occluder_min_size = 0.05f;
+  size_t m_frame_occluders = 0;
+  size_t m_frame_occluder_triangles = 0;
+  size_t m_frame_occlusion_tested = 0;
+  size_t m_frame_occlusion_rejected = 0;
+  double m_frame_occlusion_ms = 0.0;
+
+  // quantized vertex streams for scene meshes (see vertexformat.hh)
+  bool m_use_compact_vertices = false;
+  // what the uploaded meshes would take as floats vs what they take
+  size_t m_vertex_bytes_float = 0;
+  size_t m_vertex_bytes_uploaded = 0;
+  size_t m_vertices_uploaded = 0;
+  size_t m_vertex_buffers_created = 0;
+
+  // <scene>.cxmesh, processed meshes of the current scene
+  std::string m_mesh_cache_path;
+
+  // streamed scene loading. a loader thread decodes, render_frame uploads
+  std::unique_ptr<Spsc_Queue<streamed_item *>> m_stream_queue = nullptr;
+  std::thread m_stream_thread;
+  std::string m_stream_scene_path;
+  std::atomic<bool> m_stream_finished = false;
+  std::atomic<bool> m_stream_cancel = false;
+  std::atomic<size_t> m_stream_total_meshes = 0;
+  size_t m_stream_loaded_meshes = 0;
+  // node table as imported, goes into the mesh cache once the stream is done
+  std::vector<scene_node_desc> m_stream_nodes;
+  std::vector<std::string> m_stream_source_files;
+
+  // per frame upload budget, whichever runs out first
+  size_t m_stream_budget_bytes = 16 * 1024 * 1024;
+  double m_stream_budget_ms = 4.0;
+
+  // (loaded meshes, total meshes), called on the gl thread
+  std::function<void(size_t, size_t)> m_load_progress_callback = nullptr;
+
+  // seconds since init_scene was called
+  double m_scene_init_time = 0.0;
+  double m_time_to_first_frame = -1.0;
+  double m_time_to_full_load = -1.0;
   
   /////////////////////
   // CALLBACK FUNCTIONS
@@ -69,11 +217,42 @@ public:
   static void framebuffer_size_callback(GLFWwindow *window, int width, int height);
   void processInput(GLFWwindow *window);
 
-  template <typename T> void upload_to_uniform(std::string location, GLuint shader_id, T input);
+  template <typename T> void upload_to_uniform(GLint location, T input);
+  void upload_frame_uniforms(const frame_uniforms &frame_data);
 
   void init_scene_vbos();
   void cleanup_mesh_vbos(Mesh& mesh);
-  void init_scene(const char* scene_fp);
+  void init_mesh_ebo(Mesh& mesh);
+  void init_mesh_instances(Mesh& mesh);
+  void draw_mesh(const Mesh& mesh);
+  void update_mesh_transforms();
+  void select_mesh_lods();
+  void update_mesh_bounds(Mesh &mesh);
+  void cull_meshes(const glm::mat4 &camera_view_projection,
+                   const glm::mat4 &light_space_matrix);
+  void cull_occluded_meshes(const glm::mat4 &camera_view_projection,
+                            const glm::vec3 &camera_pos);
+  void build_render_queues(const glm::vec3 &camera_pos,
+                           const glm::vec3 &light_pos);
+  void build_draw_batches(const Render_Queue &queue, bool shadow_pass,
+                          std::vector<draw_batch> &batches);
+  void submit_draw_batch(const Render_Queue &queue, const draw_batch &batch,
+                         const Shader &shader);
+  void draw_arena_mesh(const Mesh &mesh, const Shader &shader);
+  Shader *get_depth_shader(const Mesh &mesh) const;
+  void bind_texture_unit(int unit, GLuint texture);
+  void check_gl_pass(const char *context);
+  void log_frame_stats();
+  void log_instancing_stats();
+  void init_mesh_vbos(Mesh& mesh);
+  bool init_arena_mesh(Mesh& mesh, bool compact);
+  size_t init_mesh_vertex_streams(Mesh& mesh, const vertex_format& format);
+  void log_vertex_stats();
+  void init_scene(const char* scene_fp, bool stream_scene = false);
+  void stream_scene_worker();
+  void drain_stream_queue();
+  void stop_scene_stream();
+  bool scene_stream_active() const { return m_stream_queue != nullptr; }
   void render_frame();
   bool save_frame_to_png(const char* filename, int width, int height);
   void setup_render_properties();
@@ -83,6 +262,7 @@ public:
   /////////////////////
 
   Renderer(uint window_width, uint window_height);
+  ~Renderer();
  
 };
 
@@ -1,10 +1,51 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+#endif
+#if defined(DRAW_DATA) && defined(MULTI_DRAW)
+layout (location = 4) in uint aDrawId;
+#endif
+
+// per frame, shared by every program (frame_uniforms in frameuniforms.hh)
+layout(std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 light_space_matrix;
+    vec4 view_position;
+    vec4 light_position;
+    vec4 light_color;
+};
 
-uniform mat4 light_space_matrix;
 uniform mat4 model;
 
+#ifdef DRAW_DATA
+// per draw model matrices of arena meshes, 5 texels per slot
+// (DRAW_DATA_TEXELS in geometryarena.hh)
+uniform samplerBuffer uDrawData;
+#ifndef MULTI_DRAW
+uniform int uDrawBase;
+#endif
+
+mat4 get_draw_model()
+{
+#ifdef MULTI_DRAW
+    int texel = int(aDrawId) * 5;
+#else
+    int texel = (uDrawBase + gl_InstanceID) * 5;
+#endif
+    return mat4(texelFetch(uDrawData, texel), texelFetch(uDrawData, texel + 1),
+                texelFetch(uDrawData, texel + 2), texelFetch(uDrawData, texel + 3));
+}
+#endif
+
 void main()
 {
+#if defined(DRAW_DATA)
+    gl_Position = light_space_matrix * get_draw_model() * vec4(aPos, 1.0);
+#elif defined(INSTANCED)
+    gl_Position = light_space_matrix * model * aInstanceModel * vec4(aPos, 1.0);
+#else
     gl_Position = light_space_matrix * model * vec4(aPos, 1.0);
+#endif
 }  
\ No newline at end of file
@@ -2,18 +2,57 @@
 
 layout(location = 0) in vec3 aPos;     // Vertex position (x, y, z)
 layout(location = 1) in vec2 aTexCoord; // Texture coordinate (u, v)
+#ifdef INSTANCED
+layout(location = 5) in mat4 aInstanceModel; // Per instance transform
+#endif
+#if defined(DRAW_DATA) && defined(MULTI_DRAW)
+layout(location = 4) in uint aDrawId;   // Draw data slot (baseInstance + instance)
+#endif
 
 out vec2 TexCoord;
 out vec4 FragLightSpacePos;
 
-uniform mat4 model;                     
-uniform mat4 view;                      
-uniform mat4 projection;
-uniform mat4 light_space_matrix;
-uniform vec3 lightPosition;             
+// per frame, shared by every program (frame_uniforms in frameuniforms.hh)
+layout(std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 light_space_matrix;
+    vec4 view_position;
+    vec4 light_position;
+    vec4 light_color;
+};
+
+uniform mat4 model;
+
+#ifdef DRAW_DATA
+// per draw model matrices of arena meshes, 5 texels per slot
+// (DRAW_DATA_TEXELS in geometryarena.hh)
+uniform samplerBuffer uDrawData;
+#ifndef MULTI_DRAW
+uniform int uDrawBase;
+#endif
+
+mat4 get_draw_model()
+{
+#ifdef MULTI_DRAW
+    int texel = int(aDrawId) * 5;
+#else
+    int texel = (uDrawBase + gl_InstanceID) * 5;
+#endif
+    return mat4(texelFetch(uDrawData, texel), texelFetch(uDrawData, texel + 1),
+                texelFetch(uDrawData, texel + 2), texelFetch(uDrawData, texel + 3));
+}
+#endif
 
 void main() {
-    FragLightSpacePos = light_space_matrix *  model *  vec4(aPos, 1.0);
-    gl_Position = projection * view * model * vec4(aPos, 1.0); 
+#if defined(DRAW_DATA)
+    mat4 modelMatrix = get_draw_model();
+#elif defined(INSTANCED)
+    mat4 modelMatrix = model * aInstanceModel;
+#else
+    mat4 modelMatrix = model;
+#endif
+    FragLightSpacePos = light_space_matrix *  modelMatrix *  vec4(aPos, 1.0);
+    gl_Position = projection * view * modelMatrix * vec4(aPos, 1.0); 
     TexCoord = aTexCoord;
 }
\ No newline at end of file
@@ -6,14 +6,24 @@ in vec3 FragPos;
 in vec3 Normal;     
 in vec3 LightPos;   
 
-uniform vec3 viewPos;
-uniform vec3 lightColor;
-uniform vec3 objectColor;
+// per frame, shared by every program (frame_uniforms in frameuniforms.hh)
+layout(std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 light_space_matrix;
+    vec4 view_position;
+    vec4 light_position;
+    vec4 light_color;
+};
+
+// same for every mesh for now, so it stays at its default
+uniform vec3 objectColor = vec3(0.5, 0.8, 0.2);
 
 void main()
 {
 
     float ambientStrength = 0.1;
+    vec3 lightColor = light_color.rgb;
     vec3 ambient = ambientStrength * lightColor;
 
     vec3 norm = normalize(Normal);
@@ -22,7 +32,7 @@ void main()
     vec3 diffuse = diff * lightColor;
 
     float shininess = 32.0; // Shininess factor
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(view_position.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = spec * lightColor;
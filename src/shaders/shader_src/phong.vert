@@ -1,24 +1,83 @@
 #version 330 core
 
 layout(location = 0) in vec3 aPos;      // Vertex position
+#ifdef COMPACT_VERTICES
+layout(location = 2) in vec2 aNormalOct; // Octahedral normal (snorm16)
+#else
 layout(location = 2) in vec3 aNormal;   // Vertex normal
+#endif
+#ifdef INSTANCED
+layout(location = 5) in mat4 aInstanceModel; // Per instance transform
+#endif
+#if defined(DRAW_DATA) && defined(MULTI_DRAW)
+layout(location = 4) in uint aDrawId;   // Draw data slot (baseInstance + instance)
+#endif
 
 out vec3 FragPos;                       // Position of the fragment
 out vec3 Normal;                        // Normal of the fragment
 out vec3 LightPos;                      // Position of the light
 
+// per frame, shared by every program (frame_uniforms in frameuniforms.hh)
+layout(std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 light_space_matrix;
+    vec4 view_position;
+    vec4 light_position;
+    vec4 light_color;
+};
+
 uniform mat4 model;                     // Model matrix
-uniform mat4 view;                      // View matrix
-uniform mat4 projection;                // Projection matrix
-uniform vec3 lightPosition;             // Light position
+
+#ifdef DRAW_DATA
+// per draw model matrices of arena meshes, 5 texels per slot
+// (DRAW_DATA_TEXELS in geometryarena.hh)
+uniform samplerBuffer uDrawData;
+#ifndef MULTI_DRAW
+uniform int uDrawBase;
+#endif
+
+mat4 get_draw_model()
+{
+#ifdef MULTI_DRAW
+    int texel = int(aDrawId) * 5;
+#else
+    int texel = (uDrawBase + gl_InstanceID) * 5;
+#endif
+    return mat4(texelFetch(uDrawData, texel), texelFetch(uDrawData, texel + 1),
+                texelFetch(uDrawData, texel + 2), texelFetch(uDrawData, texel + 3));
+}
+#endif
+
+#ifdef COMPACT_VERTICES
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#endif
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0)); 
+#ifdef COMPACT_VERTICES
+    vec3 aNormal = octahedral_decode(aNormalOct);
+#endif
+#if defined(DRAW_DATA)
+    mat4 modelMatrix = get_draw_model();
+#elif defined(INSTANCED)
+    mat4 modelMatrix = model * aInstanceModel;
+#else
+    mat4 modelMatrix = model;
+#endif
+
+    FragPos = vec3(modelMatrix * vec4(aPos, 1.0)); 
     //Normal = mat3(transpose(inverse(model))) * aNormal;
     Normal = aNormal;
 
-    LightPos = lightPosition; // Pass light position to fragment shader
+    LightPos = light_position.xyz; // Pass light position to fragment shader
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0); // Final vertex position
+    gl_Position = projection * view * modelMatrix * vec4(aPos, 1.0); // Final vertex position
 }
@@ -7,10 +7,17 @@ out vec3 FragPos;                       // Position of the fragment
 out vec3 Normal;                        // Normal of the fragment
 out vec3 LightPos;                      // Position of the light
 
+// per frame, shared by every program (frame_uniforms in frameuniforms.hh)
+layout(std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 light_space_matrix;
+    vec4 view_position;
+    vec4 light_position;
+    vec4 light_color;
+};
+
 uniform mat4 model;                     // Model matrix
-uniform mat4 view;                      // View matrix
-uniform mat4 projection;                // Projection matrix
-uniform vec3 lightPosition;             // Light position
 
 void main()
 {
@@ -18,7 +25,7 @@ void main()
     //Normal = mat3(transpose(inverse(model))) * aNormal;
     Normal = aNormal;
 
-    LightPos = lightPosition; // Pass light position to fragment shader
+    LightPos = light_position.xyz; // Pass light position to fragment shader
 
     gl_Position = projection * view * model * vec4(aPos, 1.0); // Final vertex position
 }
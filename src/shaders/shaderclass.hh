@@ -3,15 +3,36 @@
 #include "../glad/glad.h"
 #include "../components/logging.hh"
 
+#include <GLFW/glfw3.h>
+
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// binding point of the per frame std140 block every program shares
+// (frame_data in the shaders, see frameuniforms.hh)
+static const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+// texture units of the samplers, assigned once per program
+static const int TEXTURE_UNIT_DIFFUSE = 0;
+static const int TEXTURE_UNIT_SHADOW_MAP = 1;
+// per draw data of arena meshes (samplerBuffer, see geometryarena.hh)
+static const int TEXTURE_UNIT_DRAW_DATA = 2;
+
 class Shader
 {
 public:
-    unsigned int ID;
+    unsigned int ID = 0;
+    bool linked = false;
+    // the only uniform set per draw, -1 if the program doesnt have it
+    int model_location = -1;
+    // first draw data slot, per draw instead of model for arena meshes
+    // drawn without multi draw
+    int draw_base_location = -1;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
@@ -44,6 +65,113 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        compile(vertexCode, fragmentCode, nullptr);
+    }
+    // builds the program from already loaded sources (see Shader_Cache)
+    // ------------------------------------------------------------------------
+    // before_link gets the program right before glLinkProgram (hints etc.)
+    static std::shared_ptr<Shader> from_source(const std::string &vertexCode, const std::string &fragmentCode,
+                                               const std::function<void(unsigned int)> &before_link = nullptr)
+    {
+        std::shared_ptr<Shader> shader(new Shader());
+        shader->compile(vertexCode, fragmentCode, before_link);
+        return shader;
+    }
+    // takes ownership of an already linked program (program binary cache)
+    // ------------------------------------------------------------------------
+    static std::shared_ptr<Shader> from_program(unsigned int program)
+    {
+        std::shared_ptr<Shader> shader(new Shader());
+        shader->ID = program;
+        shader->linked = true;
+        // a restored binary starts out with default block bindings / sampler units
+        shader->setup_program();
+        return shader;
+    }
+    // programs are shared through handles, a copy would delete it twice
+    // ------------------------------------------------------------------------
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+    ~Shader()
+    {
+        // handles can outlive the context (glfwTerminate at shutdown)
+        if (ID != 0 && glfwGetCurrentContext())
+            glDeleteProgram(ID);
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() 
+    {
+      glUseProgram(ID); 
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value)
+    {         
+        glUniform1i(get_uniform_location(name), (int)value); 
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value)
+    { 
+        glUniform1i(get_uniform_location(name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value)
+    { 
+        glUniform1f(get_uniform_location(name), value); 
+    }
+    // looked up once per name, locations dont change after the link
+    // ------------------------------------------------------------------------
+    int get_uniform_location(const std::string &name)
+    {
+        auto found = m_uniform_locations.find(name);
+        if (found != m_uniform_locations.end())
+            return found->second;
+
+        int location = glGetUniformLocation(ID, name.c_str());
+        m_uniform_locations.emplace(name, location);
+        return location;
+    }
+
+private:
+    std::unordered_map<std::string, int> m_uniform_locations;
+
+    Shader() = default;
+    // everything about a program that only has to be set once: the frame
+    // block binding, sampler units and the per draw locations
+    // ------------------------------------------------------------------------
+    void setup_program()
+    {
+        if (!linked)
+            return;
+
+        unsigned int frame_block = glGetUniformBlockIndex(ID, "frame_data");
+        if (frame_block != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, frame_block, FRAME_UNIFORM_BINDING);
+
+        // sampler values are program state, glUniform needs it current
+        int previous_program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+        glUseProgram(ID);
+        int texture_location = get_uniform_location("uTexture");
+        if (texture_location >= 0)
+            glUniform1i(texture_location, TEXTURE_UNIT_DIFFUSE);
+        int depth_location = get_uniform_location("uDepthMap");
+        if (depth_location >= 0)
+            glUniform1i(depth_location, TEXTURE_UNIT_SHADOW_MAP);
+        int draw_data_location = get_uniform_location("uDrawData");
+        if (draw_data_location >= 0)
+            glUniform1i(draw_data_location, TEXTURE_UNIT_DRAW_DATA);
+        glUseProgram(previous_program);
+
+        model_location = get_uniform_location("model");
+        draw_base_location = get_uniform_location("uDrawBase");
+    }
+    // compiles and links both stages into ID
+    // ------------------------------------------------------------------------
+    void compile(const std::string &vertexCode, const std::string &fragmentCode,
+                 const std::function<void(unsigned int)> &before_link)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -62,36 +190,18 @@ public:
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (before_link)
+            before_link(ID);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        int link_status = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &link_status);
+        linked = link_status != 0;
+        setup_program();
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() 
-    {
-      glUseProgram(ID); 
-    }
-    // utility uniform functions
-    // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-    }
-    // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -118,3 +228,6 @@ private:
         }
     }
 };
+
+// shared, refcounted program. the last material letting go deletes it
+using Shader_Handle = std::shared_ptr<Shader>;